@@ -17,7 +17,9 @@
 #ifndef SX1276HELPERS_H
 #define SX1276HELPERS_H
 
+#include <cstdint>
 #include <sx1276Regs-Fsk.h>
+#include <SX1276Shadow.h>
 
 #if defined(ESP8266)
 
@@ -93,6 +95,7 @@ namespace Radio {
     bool inStdbyOrSleep();
     bool setParams();
     bool setCarrier(Carrier param, uint32_t value);
+    void setFrequencyWord(const uint8_t *frf);
     regBandWidth bwRegs(uint8_t bandwidth);
     void dump();
     void dumpReal();
@@ -100,6 +103,40 @@ namespace Radio {
 
     uint16_t readWord(uint8_t regAddr);
     void writeWord(uint8_t regAddr, uint16_t value);
-    
+
+    uint8_t readFrame(uint8_t *out, uint8_t maxLen);
+
+    const ShadowStats &shadowStats();
+    void setShadowVerify(bool verify);
+    uint8_t verifyShadow();
+
+    /*
+        Drains one received io-homecontrol frame from the FIFO in four SPI transactions instead of two per byte:
+        CtrlByte1 first, its MsgLen field gives the frame length ((CB1 & 0x1F) + 1), the remainder is read in one burst.
+        Anything left in the FIFO afterwards (malformed length) is drained byte by byte, as the old loop did, so
+        the output is identical; bytes beyond maxLen are discarded. Returns the number of bytes stored in out.
+        Bus only needs readByte(reg) and readBytes(reg, out, len), so the logic can be exercised with a mock.
+    */
+    template <typename Bus>
+    uint8_t readFrame(Bus &bus, uint8_t *out, uint8_t maxLen) {
+        auto fifoNotEmpty = [&bus]() { return (bus.readByte(REG_IRQFLAGS2) & RF_IRQFLAGS2_FIFOEMPTY) == 0; };
+
+        if (maxLen == 0 || !fifoNotEmpty())
+            return 0;
+
+        out[0] = bus.readByte(REG_FIFO);
+        uint8_t length = (out[0] & 0x1F) + 1;
+        if (length > maxLen)
+            length = maxLen;
+        if (length > 1)
+            bus.readBytes(REG_FIFO, out + 1, length - 1);
+
+        while (fifoNotEmpty()) {
+            uint8_t extra = bus.readByte(REG_FIFO);
+            if (length < maxLen)
+                out[length++] = extra;
+        }
+        return length;
+    }
 }
 #endif // SX1276HELPERS_H
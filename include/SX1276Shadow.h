@@ -0,0 +1,189 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef SX1276SHADOW_H
+#define SX1276SHADOW_H
+
+#include <cstdint>
+#include <cstdio>
+#include <sx1276Regs-Fsk.h>
+
+/*
+    Write-through shadow of the SX1276 configuration registers touched on every mode transition.
+    Only registers the chip never changes by itself are shadowed; FIFO, IRQ flags, RSSI, AFC... always go to the bus.
+    Once a register has been read or written, read() is served from memory and write() skips values already in place.
+    With verify on, every value served from memory is checked against the chip first (debug only, costs a read).
+*/
+namespace Radio {
+    struct ShadowStats {
+        uint32_t writes;        ///< Register writes sent to the chip
+        uint32_t skipped;       ///< Writes dropped because the register already held the value
+        uint32_t readsAvoided;  ///< Reads served from the shadow
+        uint32_t mismatches;    ///< Shadow found out of sync with the chip (verify mode)
+    };
+
+    constexpr bool isShadowed(uint8_t regAddr) {
+        switch (regAddr) {
+            case REG_OPMODE:
+            case REG_FRFMSB:
+            case REG_FRFMID:
+            case REG_FRFLSB:
+            case REG_PREAMBLEMSB:
+            case REG_PREAMBLELSB:
+            case REG_SYNCCONFIG:
+            case REG_DIOMAPPING1:
+            case REG_DIOMAPPING2:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /*
+        Bus needs readByte(reg), readBytes(reg, out, len) and writeBytes(reg, in, len), one SPI transaction each.
+        Raw writes done outside the shadow must be reported with track() to keep it coherent.
+    */
+    template <typename Bus>
+    class RegisterShadow {
+    public:
+        explicit RegisterShadow(Bus &bus, bool verify = false) : _bus(bus), _verify(verify) {}
+
+        uint8_t read(uint8_t regAddr) {
+            if (!isShadowed(regAddr))
+                return _bus.readByte(regAddr);
+            if (isValid(regAddr) && checked(regAddr)) {
+                _stats.readsAvoided++;
+                return _value[regAddr];
+            }
+            uint8_t value = _bus.readByte(regAddr);
+            store(regAddr, value);
+            return value;
+        }
+
+        void write(uint8_t regAddr, uint8_t value) {
+            writeBurst(regAddr, &value, 1);
+        }
+
+        /// Read-modify-write from the shadow: keep the bits in keepMask, OR in bits
+        void writeMasked(uint8_t regAddr, uint8_t keepMask, uint8_t bits) {
+            write(regAddr, (read(regAddr) & keepMask) | bits);
+        }
+
+        /// Consecutive registers in one transaction, skipped when all of them already hold the values
+        void writeBurst(uint8_t regAddr, const uint8_t *in, uint8_t len) {
+            if (upToDate(regAddr, in, len)) {
+                _stats.skipped++;
+                return;
+            }
+            _bus.writeBytes(regAddr, const_cast<uint8_t *>(in), len);
+            _stats.writes++;
+            track(regAddr, in, len);
+        }
+
+        /// Record a write done directly on the bus. FIFO bursts do not auto-increment the address
+        void track(uint8_t regAddr, const uint8_t *in, uint8_t len) {
+            if (regAddr == REG_FIFO) return;
+            for (uint8_t i = 0; i < len; ++i)
+                if (isShadowed(regAddr + i))
+                    store(regAddr + i, in[i]);
+        }
+
+        /// Forget everything, e.g. after a chip reset
+        void invalidate() {
+            for (auto &word : _valid) word = 0;
+        }
+
+        /// Compare every known register with the chip, resync the ones that differ. Returns the number of mismatches
+        uint8_t verifyAll() {
+            uint8_t count = 0;
+            for (uint8_t regAddr = 0; regAddr < 0x80; ++regAddr)
+                if (isValid(regAddr) && !checked(regAddr, true))
+                    count++;
+            return count;
+        }
+
+        void setVerify(bool verify) { _verify = verify; }
+        bool verify() const { return _verify; }
+
+        const ShadowStats &stats() const { return _stats; }
+        void resetStats() { _stats = {}; }
+
+    private:
+        bool isValid(uint8_t regAddr) const { return _valid[regAddr >> 5] & (1UL << (regAddr & 0x1F)); }
+
+        void store(uint8_t regAddr, uint8_t value) {
+            _value[regAddr] = value;
+            _valid[regAddr >> 5] |= 1UL << (regAddr & 0x1F);
+        }
+
+        bool upToDate(uint8_t regAddr, const uint8_t *in, uint8_t len) {
+            if (regAddr == REG_FIFO) return false;
+            for (uint8_t i = 0; i < len; ++i) {
+                uint8_t reg = regAddr + i;
+                if (!isShadowed(reg) || !isValid(reg) || _value[reg] != in[i]) return false;
+            }
+            for (uint8_t i = 0; i < len; ++i)
+                if (!checked(regAddr + i)) return false;
+            return true;
+        }
+
+        // In verify mode, read the chip to confirm the shadowed value; on mismatch the shadow takes the chip value
+        bool checked(uint8_t regAddr, bool force = false) {
+            if (!_verify && !force) return true;
+            uint8_t actual = _bus.readByte(regAddr);
+            if (actual == _value[regAddr]) return true;
+            _stats.mismatches++;
+            printf("SX1276 shadow mismatch reg 0x%2.2x: shadow 0x%2.2x chip 0x%2.2x\n", regAddr, _value[regAddr], actual);
+            _value[regAddr] = actual;
+            return false;
+        }
+
+        Bus &_bus;
+        bool _verify;
+        uint8_t _value[0x80]{};
+        uint32_t _valid[4]{};
+        ShadowStats _stats{};
+    };
+
+    /*
+        Mode transitions expressed on the shadow, shared by SX1276Helpers and the native tests.
+        The caller still waits for TxReady / PllLock afterwards.
+    */
+    template <typename Shadow>
+    void enterStandby(Shadow &regs) {
+        regs.writeMasked(REG_OPMODE, RF_OPMODE_MASK, RF_OPMODE_STANDBY);
+    }
+
+    template <typename Shadow>
+    void enterTx(Shadow &regs) {
+        // Enabling Sync word - Size must be set to SYNCSIZE_2 (0x01 in header file)
+        regs.writeMasked(REG_SYNCCONFIG, RF_SYNCCONFIG_SYNCSIZE_MASK, RF_SYNCCONFIG_SYNCSIZE_2);
+        regs.writeMasked(REG_OPMODE, RF_OPMODE_MASK, RF_OPMODE_TRANSMITTER);
+    }
+
+    template <typename Shadow>
+    void enterRx(Shadow &regs) {
+        regs.writeMasked(REG_SYNCCONFIG, RF_SYNCCONFIG_SYNCSIZE_MASK, RF_SYNCCONFIG_SYNCSIZE_3);
+        regs.writeMasked(REG_OPMODE, RF_OPMODE_MASK, RF_OPMODE_RECEIVER);
+    }
+
+    template <typename Shadow>
+    void setPreamble(Shadow &regs, uint16_t preambleLen) {
+        uint8_t out[2] = {static_cast<uint8_t>(preambleLen >> 8), static_cast<uint8_t>(preambleLen & 0xFF)};
+        regs.writeBurst(REG_PREAMBLEMSB, out, sizeof(out));
+    }
+}
+#endif // SX1276SHADOW_H
@@ -82,6 +82,14 @@ namespace TimersUS {
         _attach_us(microseconds, true, reinterpret_cast<callback_with_arg_t>(callback), arg32);
     }
 
+    // Added one-shot as uS
+    template<typename TArg>
+    void once_us(uint64_t microseconds, void (*callback)(TArg), TArg arg) {
+        static_assert(sizeof(TArg) <= sizeof(uint32_t), "once_us() callback argument size must be <= 4 bytes");
+        auto arg32 = (uint32_t)arg;
+        _attach_us(microseconds, false, reinterpret_cast<callback_with_arg_t>(callback), arg32);
+    }
+
     void detach();
     bool active();
 
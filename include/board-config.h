@@ -86,6 +86,7 @@
 #endif
 
 #define SPI_CLK_FRQ                                 10000000
+//#define SX1276_SHADOW_VERIFY                        // Check the register shadow against the chip on every cached access (debug)
 
 /*
  * Defines the time required for the TCXO to wakeup [ms].
@@ -50,6 +50,8 @@ extern "C" {
 
 #include <utils.h>
 #include <tokens.h>
+#include <iohcCommandTable.h>
+#include <iohcCommandQueue.h>
 
 namespace IOHC {
   class iohcRemote1W;
@@ -57,7 +59,6 @@ namespace IOHC {
 
 #if defined(ESP32)
   #include <TickerUsESP32.h>
-  #define MAXCMDS 80
 #endif
 
 #if defined(SSD1306_DISPLAY)
@@ -66,15 +67,6 @@ extern Adafruit_SSD1306 display;
 
 enum class ConnState { Connecting, Connected, Disconnected };
 extern ConnState mqttStatus;
-void tokenize(std::string const &str, const char delim, Tokens &out);
-
-struct _cmdEntry {
-    char cmd[15];
-    char description[61];
-    void (*handler)(Tokens*);
-};
-extern _cmdEntry* _cmdHandler[MAXCMDS];
-extern uint8_t lastEntry;
 
 
 #if defined(DEBUG)
@@ -97,12 +89,19 @@ extern bool scanMode;
 #endif
 
 extern TimerHandle_t consoleTimer;
+/// Shared by the serial CLI, MQTT and /api/command
+extern IOHC::iohcCommandTable commands;
+/// MQTT and web API commands waiting for the command worker
+extern IOHC::iohcCommandQueue commandQueue;
 
 
 bool addHandler(char *cmd, char *description, void (*handler)(Tokens*));
 char *cmdReceived(bool echo = false);
 void cmdFuncHandler();
 void createCommands();
+/// Queues command for the worker task; its outcome goes to the result hook of its source
+IOHC::iohcCommandQueue::Push submit(const IOHC::Command &command, uint32_t *ticket = nullptr);
+void startCommandWorker();
 void init();
 
 }
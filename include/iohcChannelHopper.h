@@ -0,0 +1,220 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_CHANNEL_HOPPER_H
+#define IOHC_CHANNEL_HOPPER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define HOP_MAX_CHANNELS        3
+#define HOP_MIN_DWELL_US        4000    // Adaptive dwell never goes below, long enough to detect a preamble
+#define HOP_MAX_DWELL_US        40000
+#define HOP_PREAMBLE_HOLD_US    420000  // Longest wait for the frame after a preamble: 1W wake-up preamble (1920 bytes) + margin
+#define HOP_FOLLOW_UP_US        45000   // Stay after a frame: 2W answers and 1W repeats come within that window
+#define HOP_SCORE_FRAME         256     // Traffic score added per frame received on a channel
+#define HOP_SCORE_FLOOR         64      // Keeps quiet channels in the rotation
+
+/*
+    Timer-driven frequency hopping over the io-homecontrol channels.
+    Frequency words are computed once, a hop is a single 3-byte burst. Each channel gets a dwell time from a share
+    of the full cycle proportional to its recent traffic, bounded by HOP_MIN/MAX_DWELL_US; with adaptive off,
+    every channel gets the base dwell. A dwell expiring while a preamble is being received is extended up to
+    HOP_PREAMBLE_HOLD_US; hopping away anyway is counted as a preamble abort.
+    Hardware goes through Driver, so the same engine runs against a simulated radio:
+      void tune(const uint8_t frf[3])   write REG_FRFMSB..LSB (fast hop: the LSB write switches the PLL)
+      void arm(uint32_t delayUs)        one-shot timer calling onTimer(), replaces any pending one
+      bool idle()                       false while transmitting or receiving: the hop is postponed
+    Every call but retune() must come from the same task.
+*/
+namespace IOHC {
+    /// SX1276 carrier word: Frf = f * 2^19 / FXOSC (32 MHz), rounded
+    constexpr uint32_t iohcFrfWord(uint32_t frequencyHz) {
+        return static_cast<uint32_t>(((static_cast<uint64_t>(frequencyHz) << 19) + 16000000ULL) / 32000000ULL);
+    }
+
+    struct HopChannelStats {
+        uint32_t dwells;            ///< Visits
+        uint64_t totalDwellUs;
+        uint32_t preambles;         ///< Preambles detected
+        uint32_t frames;            ///< Frames received
+        uint32_t holds;             ///< Dwells extended for a preamble
+        uint32_t preambleAborts;    ///< Hopped away while a preamble was being received
+        uint32_t dwellUs;           ///< Current dwell
+    };
+
+    struct HopStats {
+        uint32_t hops;
+        uint32_t postponed;         ///< Dwell ended while the radio was busy
+        uint32_t maxLateUs;         ///< Worst timer lateness
+    };
+
+    template <typename Driver>
+    class iohcChannelHopper {
+    public:
+        explicit iohcChannelHopper(Driver &driver) : _driver(driver) {}
+
+        /// Channels in Hz, the first one is tuned first. Returns false if there is nothing to hop over
+        bool configure(const uint32_t *frequencies, uint8_t count, uint32_t dwellUs, bool adaptive = true) {
+            stop();
+            if (count > HOP_MAX_CHANNELS) count = HOP_MAX_CHANNELS;
+            _count = count;
+            _baseDwellUs = dwellUs;
+            _adaptive = adaptive;
+            for (uint8_t i = 0; i < count; ++i) {
+                uint32_t word = iohcFrfWord(frequencies[i]);
+                _channels[i].frequency = frequencies[i];
+                _channels[i].frf[0] = static_cast<uint8_t>(word >> 16);
+                _channels[i].frf[1] = static_cast<uint8_t>(word >> 8);
+                _channels[i].frf[2] = static_cast<uint8_t>(word);
+                _channels[i].score = 0;
+            }
+            resetStats();
+            return count > 1;
+        }
+
+        void start(uint64_t nowUs) {
+            if (_count < 2) return;
+            _running = true;
+            _current = 0;
+            enter(nowUs);
+        }
+
+        void stop() { _running = false; }
+        bool running() const { return _running; }
+
+        uint8_t channel() const { return _current; }
+        uint32_t frequency() const { return _channels[_current].frequency; }
+        uint8_t channels() const { return _count; }
+
+        /// Preamble detected on the current channel; repeated calls for the same preamble are ignored
+        void onPreamble(uint64_t nowUs) {
+            if (!_running || _preambleUs) return;
+            _stats[_current].preambles++;
+            _preambleUs = nowUs;
+        }
+
+        /// False preamble or receiver restarted: nothing to wait for any more
+        void onPreambleLost() { _preambleUs = 0; }
+
+        /// Frame received on the current channel
+        void onFrame(uint64_t nowUs) {
+            if (!_running) return;
+            _preambleUs = 0;
+            _stats[_current].frames++;
+            uint32_t &score = _channels[_current].score;
+            score = score + HOP_SCORE_FRAME > UINT16_MAX ? UINT16_MAX : score + HOP_SCORE_FRAME;
+            // Answers and repeats follow on the same channel
+            if (_dueUs < nowUs + HOP_FOLLOW_UP_US) arm(nowUs, HOP_FOLLOW_UP_US);
+        }
+
+        /// Timer armed through Driver::arm(). Early or stale callbacks are ignored
+        void onTimer(uint64_t nowUs) {
+            if (!_running || nowUs < _dueUs) return;
+            uint32_t late = static_cast<uint32_t>(nowUs - _dueUs);
+            if (late > _global.maxLateUs) _global.maxLateUs = late;
+
+            if (_preambleUs) {
+                uint64_t holdEnd = _preambleUs + HOP_PREAMBLE_HOLD_US;
+                if (nowUs < holdEnd) {
+                    _stats[_current].holds++;
+                    arm(nowUs, static_cast<uint32_t>(holdEnd - nowUs));
+                    return;
+                }
+                _stats[_current].preambleAborts++;
+                _preambleUs = 0;
+            }
+            if (!_driver.idle()) {
+                _global.postponed++;
+                arm(nowUs, _dwellUs);
+                return;
+            }
+            leave(nowUs);
+            _current = _current + 1 >= _count ? 0 : _current + 1;
+            _global.hops++;
+            enter(nowUs);
+        }
+
+        /// Tune the current channel again, e.g. after transmitting on another frequency. Only reads the channel table
+        void retune() {
+            if (_count) _driver.tune(_channels[_current].frf);
+        }
+
+        const HopChannelStats &stats(uint8_t channel) const { return _stats[channel]; }
+        const HopStats &stats() const { return _global; }
+        void resetStats() {
+            for (auto &stats : _stats) stats = {};
+            _global = {};
+        }
+
+    private:
+        struct Channel {
+            uint32_t frequency;
+            uint8_t frf[3];
+            uint32_t score;         ///< Decaying frame count, HOP_SCORE_FRAME per frame
+        };
+
+        void enter(uint64_t nowUs) {
+            _driver.tune(_channels[_current].frf);
+            _enteredUs = nowUs;
+            _preambleUs = 0;
+            _dwellUs = dwell(_current);
+            _stats[_current].dwells++;
+            _stats[_current].dwellUs = _dwellUs;
+            arm(nowUs, _dwellUs);
+        }
+
+        void leave(uint64_t nowUs) {
+            _stats[_current].totalDwellUs += nowUs - _enteredUs;
+            uint32_t &score = _channels[_current].score;
+            score -= score / 8;
+        }
+
+        // Share of the whole cycle, weighted by traffic
+        uint32_t dwell(uint8_t channel) const {
+            if (!_adaptive) return _baseDwellUs;
+            uint64_t cycle = static_cast<uint64_t>(_baseDwellUs) * _count;
+            uint64_t reserved = static_cast<uint64_t>(HOP_MIN_DWELL_US) * _count;
+            if (cycle <= reserved) return HOP_MIN_DWELL_US;
+            uint64_t total = 0;
+            for (uint8_t i = 0; i < _count; ++i) total += _channels[i].score + HOP_SCORE_FLOOR;
+            uint64_t share = (cycle - reserved) * (_channels[channel].score + HOP_SCORE_FLOOR) / total;
+            uint64_t dwell = HOP_MIN_DWELL_US + share;
+            return static_cast<uint32_t>(dwell > HOP_MAX_DWELL_US ? HOP_MAX_DWELL_US : dwell);
+        }
+
+        void arm(uint64_t nowUs, uint32_t delayUs) {
+            _dueUs = nowUs + delayUs;
+            _driver.arm(delayUs);
+        }
+
+        Driver &_driver;
+        Channel _channels[HOP_MAX_CHANNELS]{};
+        uint8_t _count = 0;
+        uint8_t _current = 0;
+        bool _running = false;
+        bool _adaptive = true;
+        uint32_t _baseDwellUs = 0;
+        uint32_t _dwellUs = 0;
+        uint64_t _enteredUs = 0;
+        uint64_t _dueUs = 0;
+        uint64_t _preambleUs = 0;   ///< Last preamble detection on the current channel, 0: none
+        HopChannelStats _stats[HOP_MAX_CHANNELS]{};
+        HopStats _global{};
+    };
+}
+
+#endif // IOHC_CHANNEL_HOPPER_H
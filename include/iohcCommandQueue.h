@@ -0,0 +1,208 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_COMMAND_QUEUE_H
+#define IOHC_COMMAND_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <iohcLatencyHistogram.h>
+
+#ifndef COMMAND_QUEUE_DEPTH
+#define COMMAND_QUEUE_DEPTH     16      // Commands waiting for the command worker
+#endif
+#define COMMAND_AIR_TIMEOUT_MS  3000    // Longest wait for the TX report of a command's frames
+#define COMMAND_ON_AIR_DEPTH    4       // TX reports waiting for the command worker, late ones included
+
+/*
+    Commands coming from MQTT and the web API, between the network callbacks accepting them and the command worker
+    task running them: NVS writes, the remotes file and the radio no longer hold up the TCP stack.
+      - Coalescing: a target position replaces the one still waiting for the same device from the same source, as
+        long as nothing else was queued for that device after it. It keeps the ticket of the waiting command, whose
+        result then reports the newest target. A slider drag costs one frame per radio slot, not one per step.
+      - Bounded: when full, new commands are rejected; a queued command is never dropped for a newer one.
+    Each accepted command gets a ticket; the worker reports it acknowledged (on air, or run for the commands without
+    a frame) or failed through done(), with its ingress to air latency.
+    Slots keep their string capacity, so once warmed up pushing and popping do not allocate.
+    All calls are thread-safe.
+*/
+namespace IOHC {
+    enum class CommandKind : uint8_t {
+        Button,         ///< Remote button (RemoteButton in button), value the position of Absolute
+        TravelTime,     ///< value seconds
+        Line,           ///< Command line in text, the device description in argument if any
+        Topic,          ///< iown/<command> topic in text, its data in argument
+    };
+
+    enum class CommandSource : uint8_t {
+        Mqtt,
+        Web,
+    };
+
+    struct Command {
+        CommandKind kind = CommandKind::Button;
+        CommandSource source = CommandSource::Mqtt;
+        uint8_t button = 0;
+        bool coalesce = false;      ///< Target position: only the newest for the device matters
+        uint32_t device = 0;        ///< 24-bit remote address, 0: none
+        int32_t value = 0;
+        std::string text;
+        std::string argument;
+        uint32_t ticket = 0;        ///< Unique per queued command, shared by the targets coalesced into it
+        int64_t queuedUs = 0;       ///< Ingress, of the newest value when coalesced
+    };
+
+    struct CommandQueueStats {
+        uint32_t queued;
+        uint32_t coalesced;         ///< Commands that replaced a waiting target position of their device and source
+        uint32_t rejected;          ///< Refused, queue full
+        uint32_t executed;          ///< Taken by the worker
+        uint32_t acknowledged;
+        uint32_t failed;            ///< Unknown device, unknown command, frames not sent
+        uint16_t maxDepth;
+        LatencyHistogram waitLatency;   ///< Ingress to the worker
+        LatencyHistogram airLatency;    ///< Ingress to the first frame on air
+    };
+
+    inline uint32_t deviceKey(const uint8_t *node) {
+        return static_cast<uint32_t>(node[0]) << 16 | static_cast<uint32_t>(node[1]) << 8 | node[2];
+    }
+
+    class iohcCommandQueue {
+    public:
+        enum class Push : uint8_t {
+            Queued,
+            Coalesced,
+            Rejected,
+        };
+
+        iohcCommandQueue() : _slots(COMMAND_QUEUE_DEPTH) {}
+
+        /// Queues command at nowUs; its ticket goes to *ticket unless rejected
+        Push push(const Command &command, int64_t nowUs, uint32_t *ticket = nullptr) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (command.coalesce && command.device) {
+                // The last command waiting for the device; replacing anything older would reorder it
+                for (size_t i = _count; i-- > 0;) {
+                    Command &waiting = _slots[(_head + i) % COMMAND_QUEUE_DEPTH];
+                    if (waiting.device != command.device) continue;
+                    if (!waiting.coalesce || waiting.kind != command.kind || waiting.button != command.button ||
+                        waiting.source != command.source)
+                        break;
+                    // Same ticket and source: the result of the newest target answers every push it replaced
+                    waiting.value = command.value;
+                    waiting.queuedUs = nowUs;
+                    _stats.coalesced++;
+                    if (ticket) *ticket = waiting.ticket;
+                    return Push::Coalesced;
+                }
+            }
+            if (_count == COMMAND_QUEUE_DEPTH) {
+                _stats.rejected++;
+                return Push::Rejected;
+            }
+            Command &slot = _slots[(_head + _count) % COMMAND_QUEUE_DEPTH];
+            assign(slot, command, nowUs);
+            _count++;
+            _stats.queued++;
+            if (_count > _stats.maxDepth) _stats.maxDepth = _count;
+            if (ticket) *ticket = slot.ticket;
+            return Push::Queued;
+        }
+
+        /// Moves the oldest command into out, reusing its buffers; false when empty
+        bool pop(Command &out, int64_t nowUs) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_count) return false;
+            Command &front = _slots[_head];
+            std::swap(out.text, front.text);
+            std::swap(out.argument, front.argument);
+            out.kind = front.kind;
+            out.source = front.source;
+            out.button = front.button;
+            out.coalesce = front.coalesce;
+            out.device = front.device;
+            out.value = front.value;
+            out.ticket = front.ticket;
+            out.queuedUs = front.queuedUs;
+            _head = (_head + 1) % COMMAND_QUEUE_DEPTH;
+            _count--;
+            _stats.executed++;
+            _stats.waitLatency.add(static_cast<uint32_t>(nowUs - out.queuedUs));
+            return true;
+        }
+
+        /// Outcome of command, as returned by pop(); airUs: first frame on air, 0 when it had none
+        void done(const Command &command, bool acknowledged, int64_t airUs = 0) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!acknowledged) {
+                _stats.failed++;
+                return;
+            }
+            _stats.acknowledged++;
+            if (airUs) _stats.airLatency.add(static_cast<uint32_t>(airUs - command.queuedUs));
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _count;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _head = 0;
+            _count = 0;
+        }
+
+        CommandQueueStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats;
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats = {};
+            _stats.maxDepth = _count;
+        }
+
+    private:
+        void assign(Command &slot, const Command &command, int64_t nowUs) {
+            slot.kind = command.kind;
+            slot.source = command.source;
+            slot.button = command.button;
+            slot.coalesce = command.coalesce;
+            slot.device = command.device;
+            slot.value = command.value;
+            slot.text.assign(command.text);
+            slot.argument.assign(command.argument);
+            slot.ticket = ++_tickets;
+            slot.queuedUs = nowUs;
+        }
+
+        mutable std::mutex _mutex;
+        std::vector<Command> _slots;
+        size_t _head = 0;
+        size_t _count = 0;
+        uint32_t _tickets = 0;
+        CommandQueueStats _stats{};
+    };
+}
+
+#endif // IOHC_COMMAND_QUEUE_H
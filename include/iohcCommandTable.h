@@ -0,0 +1,252 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_COMMAND_TABLE_H
+#define IOHC_COMMAND_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tokens.h>
+
+#define COMMAND_TABLE_SLOTS     128     // Power of two above the number of commands
+#define COMMAND_TABLE_BUCKETS   32      // First-level buckets, each with its own displacement
+#define COMMAND_MAX_TOKENS      16      // Words of a command line, the rest is dropped
+
+/*
+    Command names and their dispatch, shared by the serial CLI, the MQTT iown/<command> topics and /api/command.
+    The names are known at compile time, so is their perfect hash (hash and displace): a name goes to one of
+    COMMAND_TABLE_BUCKETS buckets, the bucket's displacement picks its slot, a single compare confirms it. No probing,
+    no strcmp over every registered command.
+    A command line is split into string_views over the caller's buffer; the Tokens handed to the handler are only
+    built once the command is known.
+    Handlers are registered once at startup (Cmd::createCommands), dispatching is read-only afterwards.
+*/
+namespace IOHC {
+    /// Every command: registering a name missing here fails, COMMANDS.md documents them
+    inline constexpr std::string_view commandNames[] = {
+        "powerOn", "setTemp", "setMode", "setPresence", "setWindow", "midnight", "associate", "custom", "custom60",
+        "pair", "add", "remove", "open", "close", "stop", "position", "absolute", "vent", "force",
+        "mode1", "mode2", "mode3", "mode4",
+        "new1W", "del1W", "edit1W", "time1W", "stats1W", "list1W",
+        "newRemote", "linkRemote", "unlinkRemote", "delRemote",
+        "discovery", "stopDiscovery", "getName", "scanMode", "scanDump", "verbose", "pairMode",
+        "dump",
+        "rxStats", "rxFilter", "rxDedupe", "deviceIndex", "linkStats", "wakeStats", "txStats", "hopStats", "regCache",
+        "jsonArena", "commandQueue", "apiCache",
+        "ls", "cat", "rm", "lastAddr",
+        "mqttIp", "mqttUser", "mqttPass", "mqttDiscovery", "mqttQueue", "discoveryStats",
+        "discover28", "discover2A",
+        "help",
+    };
+    constexpr size_t COMMAND_COUNT = sizeof(commandNames) / sizeof(commandNames[0]);
+    static_assert(COMMAND_COUNT < COMMAND_TABLE_SLOTS, "COMMAND_TABLE_SLOTS too small");
+
+    /// Seeded FNV-1a with a final mix, the table only uses the low bits
+    constexpr uint32_t commandHash(std::string_view name, uint32_t seed) {
+        uint32_t hash = 2166136261u ^ seed * 0x9E3779B9u;
+        for (char c : name) hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+        hash ^= hash >> 15;
+        hash *= 0x2C1B3C6Du;
+        return hash ^ hash >> 12;
+    }
+
+    struct CommandPerfectHash {
+        uint16_t displacement[COMMAND_TABLE_BUCKETS];
+        uint8_t slot[COMMAND_TABLE_SLOTS];          ///< Command index + 1, 0 when free
+    };
+
+    /// Largest buckets first, each gets the first displacement putting all its names in free slots
+    constexpr CommandPerfectHash buildCommandHash() {
+        CommandPerfectHash table{};
+        uint8_t bucketSize[COMMAND_TABLE_BUCKETS]{};
+        bool placed[COMMAND_TABLE_BUCKETS]{};
+        for (size_t i = 0; i < COMMAND_COUNT; i++)
+            bucketSize[commandHash(commandNames[i], 0) % COMMAND_TABLE_BUCKETS]++;
+
+        for (size_t round = 0; round < COMMAND_TABLE_BUCKETS; round++) {
+            size_t bucket = 0;
+            while (placed[bucket]) bucket++;
+            for (size_t b = bucket + 1; b < COMMAND_TABLE_BUCKETS; b++)
+                if (!placed[b] && bucketSize[b] > bucketSize[bucket]) bucket = b;
+            placed[bucket] = true;
+            if (!bucketSize[bucket]) continue;
+
+            for (uint16_t displacement = 1;; displacement++) {
+                uint8_t slots[COMMAND_COUNT]{};
+                uint8_t commands[COMMAND_COUNT]{};
+                size_t count = 0;
+                bool fits = true;
+                for (size_t i = 0; fits && i < COMMAND_COUNT; i++) {
+                    if (commandHash(commandNames[i], 0) % COMMAND_TABLE_BUCKETS != bucket) continue;
+                    const uint8_t slot = commandHash(commandNames[i], displacement) % COMMAND_TABLE_SLOTS;
+                    fits = !table.slot[slot];
+                    for (size_t k = 0; fits && k < count; k++) fits = slots[k] != slot;
+                    slots[count] = slot;
+                    commands[count++] = static_cast<uint8_t>(i);
+                }
+                if (!fits) continue;
+                for (size_t k = 0; k < count; k++) table.slot[slots[k]] = commands[k] + 1;
+                table.displacement[bucket] = displacement;
+                break;
+            }
+        }
+        return table;
+    }
+
+    inline constexpr CommandPerfectHash commandPerfectHash = buildCommandHash();
+
+    /// Position of name in commandNames, -1 when it is not a command
+    constexpr int commandIndex(std::string_view name) {
+        const uint16_t displacement = commandPerfectHash.displacement[commandHash(name, 0) % COMMAND_TABLE_BUCKETS];
+        const uint8_t slot = commandPerfectHash.slot[commandHash(name, displacement) % COMMAND_TABLE_SLOTS];
+        return slot && commandNames[slot - 1] == name ? slot - 1 : -1;
+    }
+
+    constexpr bool commandHashIsPerfect() {
+        for (size_t i = 0; i < COMMAND_COUNT; i++)
+            if (commandIndex(commandNames[i]) != static_cast<int>(i)) return false;
+        return true;
+    }
+    static_assert(commandHashIsPerfect(), "duplicate command name");
+
+    /// Typed arguments, parsed from a token without copying it
+    namespace commandArg {
+        inline bool toU32(std::string_view text, uint32_t &out, uint8_t base = 10) {
+            if (text.empty() || text.size() > 10) return false;
+            uint64_t value = 0;
+            for (char c : text) {
+                uint8_t digit;
+                if (c >= '0' && c <= '9') digit = c - '0';
+                else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+                else return false;
+                if (digit >= base) return false;
+                value = value * base + digit;
+            }
+            if (value > UINT32_MAX) return false;
+            out = static_cast<uint32_t>(value);
+            return true;
+        }
+
+        inline bool toI32(std::string_view text, int32_t &out) {
+            const bool negative = !text.empty() && text[0] == '-';
+            uint32_t magnitude;
+            if (!toU32(negative ? text.substr(1) : text, magnitude)) return false;
+            if (magnitude > (negative ? 2147483648u : 2147483647u)) return false;
+            out = negative ? static_cast<int32_t>(0u - magnitude) : static_cast<int32_t>(magnitude);
+            return true;
+        }
+
+        /// Exactly length bytes written as 2 * length hex digits
+        inline bool toHex(std::string_view text, uint8_t *out, size_t length) {
+            if (text.size() != length * 2) return false;
+            for (size_t i = 0; i < length; i++) {
+                uint32_t byte;
+                if (!toU32(text.substr(i * 2, 2), byte, 16)) return false;
+                out[i] = static_cast<uint8_t>(byte);
+            }
+            return true;
+        }
+    }
+
+    enum class CommandResult : uint8_t {
+        Done,
+        Empty,          ///< Nothing but delimiters
+        Unknown,        ///< Not a command, or not registered in this build
+    };
+
+    class iohcCommandTable {
+    public:
+        using Handler = void (*)(Tokens *);
+
+        struct Entry {
+            const char *name;
+            const char *description;
+            Handler handler;
+        };
+
+        /// false when name is not in commandNames or already registered: the first registration wins
+        bool add(const char *name, const char *description, Handler handler) {
+            const int index = commandIndex(name);
+            if (index < 0 || _entries[index].handler) return false;
+            _entries[index] = {commandNames[index].data(), description, handler};
+            _order[_registered++] = static_cast<uint8_t>(index);
+            return true;
+        }
+
+        const Entry *find(std::string_view name) const {
+            const int index = commandIndex(name);
+            return index >= 0 && _entries[index].handler ? &_entries[index] : nullptr;
+        }
+
+        /// Words of line between delimiters, runs of delimiters count as one; at most max
+        static size_t split(std::string_view line, char delim, std::string_view *out, size_t max) {
+            size_t count = 0;
+            size_t pos = 0;
+            while (count < max) {
+                while (pos < line.size() && line[pos] == delim) pos++;
+                if (pos >= line.size()) break;
+                size_t end = line.find(delim, pos);
+                if (end == std::string_view::npos) end = line.size();
+                out[count++] = line.substr(pos, end - pos);
+                pos = end;
+            }
+            return count;
+        }
+
+        /// A CLI or /api/command line; argument, when given, becomes the handler's second token
+        CommandResult dispatch(std::string_view line, char delim = ' ', const std::string *argument = nullptr) const {
+            std::string_view words[COMMAND_MAX_TOKENS];
+            const size_t count = split(line, delim, words, COMMAND_MAX_TOKENS);
+            if (!count) return CommandResult::Empty;
+            return run(find(words[0]), words, count, argument);
+        }
+
+        /// An MQTT message: the command is the last level of topic, the words of data its arguments
+        CommandResult dispatchTopic(std::string_view topic, std::string_view data, char delim = ' ') const {
+            std::string_view words[COMMAND_MAX_TOKENS];
+            words[0] = topic;
+            const size_t count = 1 + split(data, delim, words + 1, COMMAND_MAX_TOKENS - 1);
+            const size_t level = topic.rfind('/');
+            return run(find(level == std::string_view::npos ? topic : topic.substr(level + 1)), words, count, nullptr);
+        }
+
+        /// Registered commands in registration order
+        size_t size() const { return _registered; }
+        const Entry &operator[](size_t i) const { return _entries[_order[i]]; }
+
+    private:
+        static CommandResult run(const Entry *entry, const std::string_view *words, size_t count,
+                                 const std::string *argument) {
+            if (!entry) return CommandResult::Unknown;
+            Tokens tokens;
+            tokens.reserve(count + (argument ? 1 : 0));
+            tokens.emplace_back(words[0]);
+            if (argument) tokens.push_back(*argument);
+            for (size_t i = 1; i < count; i++) tokens.emplace_back(words[i]);
+            entry->handler(&tokens);
+            return CommandResult::Done;
+        }
+
+        Entry _entries[COMMAND_COUNT]{};
+        uint8_t _order[COMMAND_COUNT]{};
+        size_t _registered = 0;
+    };
+}
+
+#endif // IOHC_COMMAND_TABLE_H
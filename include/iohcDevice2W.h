@@ -3,7 +3,7 @@
 
 #include <Arduino.h>
 #include <vector>
-#include <map>
+#include <iohcDeviceIndex.h>
 
 // Forward declarations
 namespace IOHC {
@@ -180,10 +180,12 @@ public:
 class Device2WManager {
 private:
     static Device2WManager* instance;
-    std::map<String, Device2W*> devices;  // Keyed by address hex string
+    std::vector<Device2W*> devices;       // Slots of the shared device index, in insertion order
     String jsonFilePath;
     
     Device2WManager() : jsonFilePath("/2W.json") {}
+
+    void insert(Device2W* device);
     
 public:
     // Singleton access
@@ -0,0 +1,347 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_DEVICE_INDEX_H
+#define IOHC_DEVICE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define DEVICE_INDEX_NONE           UINT32_MAX  // No entry of that kind
+#define DEVICE_INDEX_MIN_CAPACITY   16          // Rows allocated by the first insertion, then doubled
+#define DEVICE_INDEX_MAX_LOAD       70          // Percent of rows used before the table doubles
+
+/*
+    Address and name lookups shared by every device container: 1W remotes, 2W devices, system table objects and the
+    remote map. Each container keeps its own storage and registers the position (slot) of its entries here.
+      - Addresses: open addressing with linear probing on the packed 24-bit address. One row per address holds the
+        slot of every kind, so a received frame finds its 1W remote and its remote map entry with a single probe.
+      - Names: FNV-1a hash of a name or description, with the kind and slot. Only the hash is kept, the caller
+        confirms a candidate against its own entry (findName), several entries may share a name.
+    Deletion shifts the following rows back, no tombstones, so lookups never slow down with churn. Lookups do not
+    allocate; insertions only when a table doubles.
+    All calls are thread-safe; findName runs its match callback with the lock held.
+*/
+namespace IOHC {
+    enum class DeviceKind : uint8_t {
+        Remote1W,
+        Device2W,
+        SystemObject,
+        RemoteMap,
+        Count
+    };
+
+    struct DeviceSlots {
+        uint32_t slot[static_cast<uint8_t>(DeviceKind::Count)];
+
+        uint32_t operator[](DeviceKind kind) const { return slot[static_cast<uint8_t>(kind)]; }
+        bool has(DeviceKind kind) const { return (*this)[kind] != DEVICE_INDEX_NONE; }
+    };
+
+    struct DeviceIndexStats {
+        uint32_t addresses;
+        uint32_t names;
+        uint32_t addressCapacity;
+        uint32_t nameCapacity;
+        uint32_t longestProbe;      ///< Rows visited by the worst address lookup
+    };
+
+    class iohcDeviceIndex {
+    public:
+        static constexpr uint32_t pack(const uint8_t *address) {
+            return static_cast<uint32_t>(address[0]) << 16 | static_cast<uint32_t>(address[1]) << 8 | address[2];
+        }
+
+        /// Six hex digits, either case, as used in MQTT topics and CLI arguments
+        static bool parseAddress(const char *hex, size_t length, uint8_t *address) {
+            if (length != 6) return false;
+            for (size_t i = 0; i < 6; i++) {
+                char c = hex[i];
+                uint8_t nibble;
+                if (c >= '0' && c <= '9') nibble = c - '0';
+                else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+                else return false;
+                address[i / 2] = (i & 1) ? (address[i / 2] << 4 | nibble) : nibble;
+            }
+            return true;
+        }
+
+        static bool parseAddress(const std::string &hex, uint8_t *address) {
+            return parseAddress(hex.data(), hex.size(), address);
+        }
+
+        static uint32_t hashName(const char *name, size_t length) {
+            uint32_t hash = 2166136261u;
+            for (size_t i = 0; i < length; i++) hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+            return hash ? hash : 1;    // 0 marks a free row
+        }
+
+        /// Shared by every device container
+        static iohcDeviceIndex &instance() {
+            static iohcDeviceIndex index;
+            return index;
+        }
+
+        /// Sizes both tables for devices entries, so loading them does not rehash
+        void reserve(size_t devices) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            size_t capacity = capacityFor(devices);
+            if (capacity > _addresses.size()) rehashAddresses(capacity);
+            if (capacity > _names.size()) rehashNames(capacity);
+        }
+
+        void put(DeviceKind kind, const uint8_t *address, uint32_t slot) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            AddressRow *row = findAddress(pack(address));
+            if (!row) {
+                if ((_addressCount + 1) * 100 > _addresses.size() * DEVICE_INDEX_MAX_LOAD)
+                    rehashAddresses(_addresses.empty() ? DEVICE_INDEX_MIN_CAPACITY : _addresses.size() * 2);
+                row = &insertAddress(pack(address));
+            }
+            uint32_t &current = row->slots[static_cast<uint8_t>(kind)];
+            if (current == DEVICE_INDEX_NONE) _counts[static_cast<uint8_t>(kind)]++;
+            current = slot;
+        }
+
+        /// Drops the entry of kind; the address row goes with its last entry
+        bool erase(DeviceKind kind, const uint8_t *address) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            AddressRow *row = findAddress(pack(address));
+            if (!row || row->slots[static_cast<uint8_t>(kind)] == DEVICE_INDEX_NONE) return false;
+            row->slots[static_cast<uint8_t>(kind)] = DEVICE_INDEX_NONE;
+            _counts[static_cast<uint8_t>(kind)]--;
+            for (uint32_t slot : row->slots)
+                if (slot != DEVICE_INDEX_NONE) return true;
+            removeAddressAt(row - _addresses.data());
+            return true;
+        }
+
+        /// Slot of the entry of kind at address, DEVICE_INDEX_NONE if there is none
+        uint32_t find(DeviceKind kind, const uint8_t *address) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const AddressRow *row = findAddress(pack(address));
+            return row ? row->slots[static_cast<uint8_t>(kind)] : DEVICE_INDEX_NONE;
+        }
+
+        /// Slots of every kind at address
+        DeviceSlots find(const uint8_t *address) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const AddressRow *row = findAddress(pack(address));
+            DeviceSlots slots;
+            for (uint8_t k = 0; k < static_cast<uint8_t>(DeviceKind::Count); k++)
+                slots.slot[k] = row ? row->slots[k] : DEVICE_INDEX_NONE;
+            return slots;
+        }
+
+        void putName(DeviceKind kind, const std::string &name, uint32_t slot) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            uint32_t hash = hashName(name.data(), name.size());
+            if (findNameRow(hash, kind, slot)) return;
+            if ((_nameCount + 1) * 100 > _names.size() * DEVICE_INDEX_MAX_LOAD)
+                rehashNames(_names.empty() ? DEVICE_INDEX_MIN_CAPACITY : _names.size() * 2);
+            insertName({hash, slot, kind});
+        }
+
+        bool eraseName(DeviceKind kind, const std::string &name, uint32_t slot) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            NameRow *row = findNameRow(hashName(name.data(), name.size()), kind, slot);
+            if (!row) return false;
+            removeNameAt(row - _names.data());
+            return true;
+        }
+
+        /// First slot of kind registered under name for which matches(slot) confirms it, DEVICE_INDEX_NONE if none
+        template<typename Match>
+        uint32_t findName(DeviceKind kind, const std::string &name, Match &&matches) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_names.empty()) return DEVICE_INDEX_NONE;
+            uint32_t hash = hashName(name.data(), name.size());
+            size_t mask = _names.size() - 1;
+            for (size_t i = home(hash, _nameBits); _names[i].hash; i = (i + 1) & mask)
+                if (_names[i].hash == hash && _names[i].kind == kind && matches(_names[i].slot)) return _names[i].slot;
+            return DEVICE_INDEX_NONE;
+        }
+
+        /// Drops every address and name of kind, before a container registers its entries again
+        void clear(DeviceKind kind) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &row : _addresses) row.slots[static_cast<uint8_t>(kind)] = DEVICE_INDEX_NONE;
+            _counts[static_cast<uint8_t>(kind)] = 0;
+            for (auto &row : _names)
+                if (row.hash && row.kind == kind) row.hash = 0;
+            rehashAddresses(_addresses.size());
+            rehashNames(_names.size());
+        }
+
+        size_t size(DeviceKind kind) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _counts[static_cast<uint8_t>(kind)];
+        }
+
+        DeviceIndexStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            DeviceIndexStats stats{static_cast<uint32_t>(_addressCount), static_cast<uint32_t>(_nameCount),
+                                   static_cast<uint32_t>(_addresses.size()), static_cast<uint32_t>(_names.size()), 0};
+            size_t mask = _addresses.size() - 1;
+            for (size_t i = 0; i < _addresses.size(); i++) {
+                if (!_addresses[i].key) continue;
+                uint32_t probe = ((i - home(_addresses[i].key, _addressBits)) & mask) + 1;
+                if (probe > stats.longestProbe) stats.longestProbe = probe;
+            }
+            return stats;
+        }
+
+    private:
+        static constexpr uint32_t USED = 0x80000000;    // Set in the key of used address rows
+
+        struct AddressRow {
+            uint32_t key;           ///< Packed address | USED, 0: free
+            uint32_t slots[static_cast<uint8_t>(DeviceKind::Count)];
+        };
+
+        struct NameRow {
+            uint32_t hash;          ///< 0: free
+            uint32_t slot;
+            DeviceKind kind;
+        };
+
+        static size_t capacityFor(size_t entries) {
+            size_t capacity = DEVICE_INDEX_MIN_CAPACITY;
+            while (entries * 100 > capacity * DEVICE_INDEX_MAX_LOAD) capacity *= 2;
+            return capacity;
+        }
+
+        /// Fibonacci hashing: the top bits of the product spread consecutive addresses
+        static size_t home(uint32_t key, uint8_t bits) {
+            return bits ? static_cast<uint32_t>(key * 2654435769u) >> (32 - bits) : 0;
+        }
+
+        static uint8_t bitsFor(size_t capacity) {
+            uint8_t bits = 0;
+            while ((static_cast<size_t>(1) << bits) < capacity) bits++;
+            return bits;
+        }
+
+        const AddressRow *findAddress(uint32_t packed) const {
+            if (_addresses.empty()) return nullptr;
+            uint32_t key = packed | USED;
+            size_t mask = _addresses.size() - 1;
+            for (size_t i = home(key, _addressBits); _addresses[i].key; i = (i + 1) & mask)
+                if (_addresses[i].key == key) return &_addresses[i];
+            return nullptr;
+        }
+
+        AddressRow *findAddress(uint32_t packed) {
+            return const_cast<AddressRow *>(static_cast<const iohcDeviceIndex *>(this)->findAddress(packed));
+        }
+
+        AddressRow &insertAddress(uint32_t packed) {
+            uint32_t key = packed | USED;
+            size_t mask = _addresses.size() - 1;
+            size_t i = home(key, _addressBits);
+            while (_addresses[i].key) i = (i + 1) & mask;
+            _addresses[i].key = key;
+            for (auto &slot : _addresses[i].slots) slot = DEVICE_INDEX_NONE;
+            _addressCount++;
+            return _addresses[i];
+        }
+
+        /// Backward shift: rows after the hole move up unless the hole is before their home
+        void removeAddressAt(size_t hole) {
+            size_t mask = _addresses.size() - 1;
+            for (size_t i = (hole + 1) & mask; _addresses[i].key; i = (i + 1) & mask) {
+                size_t h = home(_addresses[i].key, _addressBits);
+                if (((i - h) & mask) >= ((i - hole) & mask)) {
+                    _addresses[hole] = _addresses[i];
+                    hole = i;
+                }
+            }
+            _addresses[hole].key = 0;
+            _addressCount--;
+        }
+
+        void rehashAddresses(size_t capacity) {
+            std::vector<AddressRow> old;
+            old.swap(_addresses);
+            _addresses.assign(capacity, AddressRow{});
+            _addressBits = bitsFor(capacity);
+            _addressCount = 0;
+            for (const auto &row : old) {
+                if (!row.key) continue;
+                bool empty = true;
+                for (uint32_t slot : row.slots) empty &= slot == DEVICE_INDEX_NONE;
+                if (empty) continue;
+                AddressRow &moved = insertAddress(row.key & ~USED);
+                memcpy(moved.slots, row.slots, sizeof(row.slots));
+            }
+        }
+
+        NameRow *findNameRow(uint32_t hash, DeviceKind kind, uint32_t slot) {
+            if (_names.empty()) return nullptr;
+            size_t mask = _names.size() - 1;
+            for (size_t i = home(hash, _nameBits); _names[i].hash; i = (i + 1) & mask)
+                if (_names[i].hash == hash && _names[i].kind == kind && _names[i].slot == slot) return &_names[i];
+            return nullptr;
+        }
+
+        void insertName(const NameRow &row) {
+            size_t mask = _names.size() - 1;
+            size_t i = home(row.hash, _nameBits);
+            while (_names[i].hash) i = (i + 1) & mask;
+            _names[i] = row;
+            _nameCount++;
+        }
+
+        void removeNameAt(size_t hole) {
+            size_t mask = _names.size() - 1;
+            for (size_t i = (hole + 1) & mask; _names[i].hash; i = (i + 1) & mask) {
+                size_t h = home(_names[i].hash, _nameBits);
+                if (((i - h) & mask) >= ((i - hole) & mask)) {
+                    _names[hole] = _names[i];
+                    hole = i;
+                }
+            }
+            _names[hole].hash = 0;
+            _nameCount--;
+        }
+
+        void rehashNames(size_t capacity) {
+            std::vector<NameRow> old;
+            old.swap(_names);
+            _names.assign(capacity, NameRow{});
+            _nameBits = bitsFor(capacity);
+            _nameCount = 0;
+            for (const auto &row : old)
+                if (row.hash) insertName(row);
+        }
+
+        std::vector<AddressRow> _addresses;
+        std::vector<NameRow> _names;
+        size_t _addressCount = 0;
+        size_t _nameCount = 0;
+        uint8_t _addressBits = 0;
+        uint8_t _nameBits = 0;
+        size_t _counts[static_cast<uint8_t>(DeviceKind::Count)] = {};
+        mutable std::mutex _mutex;
+    };
+}
+
+#endif // IOHC_DEVICE_INDEX_H
@@ -0,0 +1,213 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_DISCOVERY_CACHE_H
+#define IOHC_DISCOVERY_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define DISCOVERY_FILE          "/discovery.json"
+#define DISCOVERY_RATE          50      // Discovery configs per second once the burst is spent
+#define DISCOVERY_BURST         20      // Configs published back to back after a pause
+
+/*
+    Home Assistant discovery configs last published, by config topic, as a 64-bit digest of topic and payload seeded
+    with the broker address: a reconnect only publishes the configs that are new or changed since, a new broker gets
+    them all. Kept in DISCOVERY_FILE across reboots.
+    A discovery pass marks every config it checks; the ones left unmarked at its end belong to entities that are gone
+    and get cleared on the broker.
+    All calls are thread-safe.
+*/
+namespace IOHC {
+    struct DiscoveryStats {
+        uint32_t passes;
+        uint32_t published;     ///< Configs new or changed, published
+        uint32_t unchanged;     ///< Configs skipped, the broker has them
+        uint32_t cleared;       ///< Stale configs cleared at the end of a pass
+        uint32_t lastPassMs;    ///< Connected to the last config queued, last pass
+    };
+
+    class iohcDiscoveryCache {
+    public:
+        static uint64_t digest(uint64_t seed, const std::string &topic, const char *payload, size_t length) {
+            uint64_t hash = 14695981039346656037ull ^ seed;
+            auto mix = [&hash](const char *data, size_t n) {
+                for (size_t i = 0; i < n; i++) hash = (hash ^ static_cast<uint8_t>(data[i])) * 1099511628211ull;
+            };
+            mix(topic.data(), topic.size());
+            mix("", 1);
+            mix(payload, length);
+            return hash;
+        }
+
+        static uint64_t seedOf(const std::string &broker) {
+            return digest(0, broker, "", 0);
+        }
+
+        /// Starts a pass against broker; digests recorded for another broker no longer match
+        void begin(const std::string &broker) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _seed = seedOf(broker);
+            _pass++;
+        }
+
+        uint64_t seed() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _seed;
+        }
+
+        /// Marks topic as part of the pass; true when payload has to be published
+        bool changed(const std::string &topic, const char *payload, size_t length) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const uint64_t hash = digest(_seed, topic, payload, length);
+            Entry &entry = _entries[topic];
+            entry.pass = _pass;
+            if (entry.digest == hash) {
+                _stats.unchanged++;
+                return false;
+            }
+            return true;
+        }
+
+        /// payload of topic was accepted by the MQTT client
+        void published(const std::string &topic, const char *payload, size_t length) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const uint64_t hash = digest(_seed, topic, payload, length);
+            Entry &entry = _entries[topic];
+            entry.digest = hash;
+            entry.pass = _pass;
+            _stats.published++;
+            _dirty = true;
+        }
+
+        /// topic was cleared on the broker
+        void forget(const std::string &topic) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _dirty |= _entries.erase(topic) > 0;
+        }
+
+        /// Ends the pass: removes the configs it did not check and returns their topics, to clear on the broker
+        std::vector<std::string> end(uint32_t elapsedMs) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::vector<std::string> stale;
+            for (auto it = _entries.begin(); it != _entries.end();) {
+                if (it->second.pass == _pass) {
+                    ++it;
+                    continue;
+                }
+                stale.push_back(it->first);
+                it = _entries.erase(it);
+            }
+            _stats.passes++;
+            _stats.cleared += stale.size();
+            _stats.lastPassMs = elapsedMs;
+            _dirty |= !stale.empty();
+            return stale;
+        }
+
+        /// Everything is published again on the next pass (Home Assistant restarted, retained configs lost)
+        void invalidate() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &kv : _entries) kv.second.digest = 0;
+            _dirty = true;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _dirty |= !_entries.empty();
+            _entries.clear();
+        }
+
+        /// Loaded from DISCOVERY_FILE: not dirty, the pass of the entries is unknown
+        void restore(const std::string &topic, uint64_t digest) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _entries[topic] = {digest, 0};
+        }
+
+        /// Calls f(topic, digest) for every entry and clears the dirty flag, for DISCOVERY_FILE
+        template <typename F>
+        void store(F &&f) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto &kv : _entries) f(kv.first, kv.second.digest);
+            _dirty = false;
+        }
+
+        bool dirty() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _dirty;
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _entries.size();
+        }
+
+        DiscoveryStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats;
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats = {};
+        }
+
+    private:
+        struct Entry {
+            uint64_t digest;
+            uint32_t pass;
+        };
+
+        mutable std::mutex _mutex;
+        std::unordered_map<std::string, Entry> _entries;
+        uint64_t _seed = 0;
+        uint32_t _pass = 0;
+        bool _dirty = false;
+        DiscoveryStats _stats{};
+    };
+
+    /// Token bucket spacing the discovery publishes: burst back to back, then rate per second
+    class DiscoveryPacer {
+    public:
+        explicit DiscoveryPacer(uint32_t rate = DISCOVERY_RATE, uint32_t burst = DISCOVERY_BURST)
+            : _intervalUs(1000000 / rate), _burstUs(static_cast<int64_t>(burst) * _intervalUs) {}
+
+        /// Takes a token at nowUs; microseconds to wait before publishing, 0 when one was available
+        uint32_t acquire(int64_t nowUs) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_started || nowUs - _readyUs > _burstUs) {
+                _readyUs = nowUs - _burstUs;
+                _started = true;
+            }
+            _readyUs += _intervalUs;
+            return _readyUs > nowUs ? static_cast<uint32_t>(_readyUs - nowUs) : 0;
+        }
+
+    private:
+        std::mutex _mutex;
+        int64_t _intervalUs;
+        int64_t _burstUs;
+        int64_t _readyUs = 0;       ///< Time the bucket would be empty again
+        bool _started = false;
+    };
+}
+
+#endif // IOHC_DISCOVERY_CACHE_H
@@ -0,0 +1,502 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_FRAME_H
+#define IOHC_FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define IOHC_FRAME_HEADER_LEN   9       // CtrlByte1, CtrlByte2, target, source, cmd
+#define IOHC_FRAME_MAX_LEN      32      // CtrlByte1.MsgLen is 5 bits: length - 1
+#define IOHC_1W_AUTH_LEN        8       // Sequence number and MAC closing authenticated 1W frames
+
+#define FRAME_CB1_ONE_WAY       0x20
+#define FRAME_CB1_START         0x40
+#define FRAME_CB1_END           0x80
+#define FRAME_CB2_PRIO          0x04
+#define FRAME_CB2_LPM           0x20
+#define FRAME_CB2_ROUTED        0x40
+#define FRAME_CB2_BEACON        0x80
+
+/*
+    Frame codec: builders writing a frame straight into a caller supplied IOHC_FRAME_MAX_LEN bytes buffer (usually
+    iohcPacket::payload.buffer), and read-only views over a received one. Nothing is allocated and everything is
+    constexpr, so a frame can be checked at compile time.
+    iohcFrames::<command>() starts a builder with the command parameters in place and the CtrlByte1 start/end bits
+    seen on air for that command; flags and extra bytes are chained, finish() writes both control bytes (MsgLen
+    included) and returns the frame length to put in iohcPacket::buffer_length. A frame that would not fit returns 0.
+    Authenticated 1W frames end with sequence() and mac(), the MAC being computed over macInput() taken before them.
+    The views check the command and its parameter length (valid()) before anything is read from the frame.
+*/
+namespace IOHC {
+    enum class FrameCmd : uint8_t {
+        Execute = 0x00,
+        Activate = 0x01,                ///< 1W mode / activate function
+        GetStatus = 0x03,
+        StatusAnswer = 0x04,
+        Identify = 0x1E,
+        WritePrivate = 0x20,
+        PrivateAck = 0x21,
+        Discover = 0x28,
+        DiscoverAnswer = 0x29,
+        DiscoverRemote = 0x2A,
+        DiscoverRemoteAnswer = 0x2B,
+        DiscoverActuator = 0x2C,        ///< Alive check
+        DiscoverActuatorAck = 0x2D,
+        LearningMode = 0x2E,
+        LearningModeAck = 0x2F,
+        KeyTransfer1W = 0x30,
+        AskChallenge = 0x31,
+        KeyTransfer = 0x32,
+        KeyTransferAck = 0x33,
+        AddressRequest = 0x36,
+        AddressAnswer = 0x37,
+        LaunchKeyTransfer = 0x38,
+        RemoveController = 0x39,
+        ChallengeRequest = 0x3C,
+        ChallengeAnswer = 0x3D,
+        GetName = 0x50,
+        NameAnswer = 0x51,
+        SetName = 0x52,
+        SetNameAck = 0x53,
+        GetGeneralInfo1 = 0x54,
+        GeneralInfo1Answer = 0x55,
+        GetGeneralInfo2 = 0x56,
+        GeneralInfo2Answer = 0x57,
+        Error = 0xFE
+    };
+
+    /// Parameter bytes of a command, -1 when it varies (Execute, GetStatus, WritePrivate, unknown commands)
+    constexpr int frameParamsLen(uint8_t cmd, bool oneWay = false) {
+        switch (static_cast<FrameCmd>(cmd)) {
+            case FrameCmd::StatusAnswer: return 14;
+            case FrameCmd::Identify: return 2;
+            case FrameCmd::Discover:
+            case FrameCmd::DiscoverActuator:
+            case FrameCmd::DiscoverActuatorAck:
+            case FrameCmd::AskChallenge:
+            case FrameCmd::KeyTransferAck:
+            case FrameCmd::AddressRequest:
+            case FrameCmd::SetNameAck:
+            case FrameCmd::GetName:
+            case FrameCmd::GetGeneralInfo1:
+            case FrameCmd::GetGeneralInfo2: return 0;
+            case FrameCmd::DiscoverAnswer:
+            case FrameCmd::DiscoverRemoteAnswer: return 9;
+            case FrameCmd::DiscoverRemote: return 12;
+            case FrameCmd::LearningMode:
+            case FrameCmd::RemoveController: return oneWay ? 1 + IOHC_1W_AUTH_LEN : 1;
+            case FrameCmd::LearningModeAck:
+            case FrameCmd::Error: return 1;
+            case FrameCmd::KeyTransfer1W: return 20;
+            case FrameCmd::KeyTransfer: return 16;
+            case FrameCmd::AddressAnswer: return 3;
+            case FrameCmd::LaunchKeyTransfer:
+            case FrameCmd::ChallengeRequest:
+            case FrameCmd::ChallengeAnswer: return 6;
+            case FrameCmd::NameAnswer:
+            case FrameCmd::SetName: return 16;
+            case FrameCmd::GeneralInfo1Answer: return 14;
+            case FrameCmd::GeneralInfo2Answer: return 16;
+            default: return -1;
+        }
+    }
+
+    class iohcFrameBuilder {
+    public:
+        constexpr iohcFrameBuilder(uint8_t (&frame)[IOHC_FRAME_MAX_LEN], uint8_t cmd) : _frame(frame) {
+            for (uint8_t i = 0; i < IOHC_FRAME_HEADER_LEN; i++) _frame[i] = 0;
+            _frame[8] = cmd;
+        }
+        constexpr iohcFrameBuilder(uint8_t (&frame)[IOHC_FRAME_MAX_LEN], FrameCmd cmd)
+            : iohcFrameBuilder(frame, static_cast<uint8_t>(cmd)) {}
+
+        constexpr iohcFrameBuilder &from(const uint8_t *address) { return copy(5, address); }
+        constexpr iohcFrameBuilder &to(const uint8_t *address) { return copy(2, address); }
+        constexpr iohcFrameBuilder &oneWay(bool on = true) { return flag(_ctrl1, FRAME_CB1_ONE_WAY, on); }
+        /// First frame of an exchange
+        constexpr iohcFrameBuilder &first(bool on = true) { return flag(_ctrl1, FRAME_CB1_START, on); }
+        /// Last frame of an exchange
+        constexpr iohcFrameBuilder &last(bool on = true) { return flag(_ctrl1, FRAME_CB1_END, on); }
+        constexpr iohcFrameBuilder &lowPower(bool on = true) { return flag(_ctrl2, FRAME_CB2_LPM, on); }
+        constexpr iohcFrameBuilder &priority(bool on = true) { return flag(_ctrl2, FRAME_CB2_PRIO, on); }
+        constexpr iohcFrameBuilder &ctrl2(uint8_t value) {
+            _ctrl2 = value;
+            return *this;
+        }
+
+        constexpr iohcFrameBuilder &byte(uint8_t value) {
+            if (_length < IOHC_FRAME_MAX_LEN) _frame[_length++] = value;
+            else _overflow = true;
+            return *this;
+        }
+        constexpr iohcFrameBuilder &bytes(const uint8_t *data, size_t len) {
+            for (size_t i = 0; i < len; i++) byte(data[i]);
+            return *this;
+        }
+        /// Big endian, as every 16 bits field on air
+        constexpr iohcFrameBuilder &word(uint16_t value) { return byte(value >> 8).byte(value & 0xFF); }
+        constexpr iohcFrameBuilder &sequence(uint16_t value) { return word(value); }
+        constexpr iohcFrameBuilder &mac(const uint8_t *mac) { return bytes(mac, 6); }
+
+        /// Command and parameters written so far: what the 1W MAC is computed on, before sequence()
+        constexpr const uint8_t *macInput() const { return _frame + 8; }
+        constexpr uint8_t macInputLen() const { return _length - 8; }
+        constexpr uint8_t length() const { return _length; }
+
+        /// Writes the control bytes; frame length, 0 if it did not fit
+        constexpr uint8_t finish() {
+            if (_overflow) return 0;
+            _frame[0] = static_cast<uint8_t>(_ctrl1 | (_length - 1));
+            _frame[1] = _ctrl2;
+            return _length;
+        }
+
+    private:
+        constexpr iohcFrameBuilder &copy(uint8_t offset, const uint8_t *address) {
+            for (uint8_t i = 0; i < 3; i++) _frame[offset + i] = address[i];
+            return *this;
+        }
+        constexpr iohcFrameBuilder &flag(uint8_t &ctrl, uint8_t mask, bool on) {
+            ctrl = static_cast<uint8_t>(on ? ctrl | mask : ctrl & ~mask);
+            return *this;
+        }
+
+        uint8_t (&_frame)[IOHC_FRAME_MAX_LEN];
+        uint8_t _length = IOHC_FRAME_HEADER_LEN;
+        uint8_t _ctrl1 = FRAME_CB1_START;
+        uint8_t _ctrl2 = 0;
+        bool _overflow = false;
+    };
+
+    /// One builder per command, 2W unless suffixed 1W; from/to given, parameters in place
+    namespace iohcFrames {
+        using Buffer = uint8_t[IOHC_FRAME_MAX_LEN];
+
+        constexpr iohcFrameBuilder request(Buffer &frame, FrameCmd cmd, const uint8_t *from, const uint8_t *to) {
+            iohcFrameBuilder builder(frame, cmd);
+            builder.from(from).to(to);
+            return builder;
+        }
+
+        /// Middle of an exchange: neither first nor last frame
+        constexpr iohcFrameBuilder exchange(Buffer &frame, FrameCmd cmd, const uint8_t *from, const uint8_t *to) {
+            iohcFrameBuilder builder = request(frame, cmd, from, to);
+            builder.first(false);
+            return builder;
+        }
+
+        /// Closes an exchange started by the other side
+        constexpr iohcFrameBuilder answer(Buffer &frame, FrameCmd cmd, const uint8_t *from, const uint8_t *to) {
+            iohcFrameBuilder builder = request(frame, cmd, from, to);
+            builder.first(false).last();
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder execute(Buffer &frame, const uint8_t *from, const uint8_t *to, uint8_t originator,
+                                           uint8_t acei, uint16_t main, uint8_t fp1 = 0, uint8_t fp2 = 0) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::Execute, from, to);
+            builder.byte(originator).byte(acei).word(main).byte(fp1).byte(fp2);
+            return builder;
+        }
+
+        /// 1W execute: continue with the optional data bytes, then sequence() and mac()
+        constexpr iohcFrameBuilder execute1W(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                             uint8_t originator, uint8_t acei, uint16_t main, uint8_t fp1 = 0,
+                                             uint8_t fp2 = 0) {
+            iohcFrameBuilder builder = execute(frame, from, to, originator, acei, main, fp1, fp2);
+            builder.oneWay().last();
+            return builder;
+        }
+
+        /// Type and parameter; some devices take one more byte
+        constexpr iohcFrameBuilder getStatus(Buffer &frame, const uint8_t *from, const uint8_t *to, uint8_t type = 0x03,
+                                             uint16_t parameter = 0) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::GetStatus, from, to);
+            builder.byte(type).word(parameter);
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder identify(Buffer &frame, const uint8_t *from, const uint8_t *to, uint16_t value) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::Identify, from, to);
+            builder.word(value);
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder writePrivate(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                                const uint8_t *data, size_t len) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::WritePrivate, from, to);
+            builder.bytes(data, len);
+            return builder;
+        }
+
+        /// Broadcast, single frame
+        constexpr iohcFrameBuilder discover(Buffer &frame, const uint8_t *from, const uint8_t *to) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::Discover, from, to);
+            builder.last();
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder discoverAnswer(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                                  uint16_t nodeType, const uint8_t *backbone, uint8_t manufacturer,
+                                                  uint8_t multiInfo, uint16_t timestamp) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::DiscoverAnswer, from, to);
+            builder.last().word(nodeType).bytes(backbone, 3).byte(manufacturer).byte(multiInfo).word(timestamp);
+            return builder;
+        }
+
+        /// Broadcast, 12 bytes announcing the controller
+        constexpr iohcFrameBuilder discoverRemote(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                                  const uint8_t *data) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::DiscoverRemote, from, to);
+            builder.last().lowPower().bytes(data, 12);
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder aliveCheck(Buffer &frame, const uint8_t *from, const uint8_t *to) {
+            return request(frame, FrameCmd::DiscoverActuator, from, to);
+        }
+
+        constexpr iohcFrameBuilder learningMode(Buffer &frame, const uint8_t *from, const uint8_t *to, uint8_t mode) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::LearningMode, from, to);
+            builder.byte(mode);
+            return builder;
+        }
+
+        /// 1W pairing: continue with sequence() and mac()
+        constexpr iohcFrameBuilder learningMode1W(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                                  uint8_t mode = 0x00) {
+            iohcFrameBuilder builder = learningMode(frame, from, to, mode);
+            builder.oneWay().last();
+            return builder;
+        }
+
+        /// 1W remove: continue with sequence() and mac()
+        constexpr iohcFrameBuilder removeController1W(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                                      uint8_t data = 0x00) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::RemoveController, from, to);
+            builder.oneWay().last().byte(data);
+            return builder;
+        }
+
+        /// 1W key transfer, not authenticated: the sequence number closes it
+        constexpr iohcFrameBuilder keyTransfer1W(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                                 const uint8_t *encryptedKey, uint8_t manufacturer, uint8_t data,
+                                                 uint16_t sequence) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::KeyTransfer1W, from, to);
+            builder.oneWay().last().bytes(encryptedKey, 16).byte(manufacturer).byte(data).sequence(sequence);
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder askChallenge(Buffer &frame, const uint8_t *from, const uint8_t *to) {
+            return request(frame, FrameCmd::AskChallenge, from, to);
+        }
+
+        constexpr iohcFrameBuilder keyTransfer(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                               const uint8_t *encryptedKey) {
+            iohcFrameBuilder builder = exchange(frame, FrameCmd::KeyTransfer, from, to);
+            builder.bytes(encryptedKey, 16);
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder addressRequest(Buffer &frame, const uint8_t *from, const uint8_t *to) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::AddressRequest, from, to);
+            builder.priority();
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder launchKeyTransfer(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                                     const uint8_t *challenge) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::LaunchKeyTransfer, from, to);
+            builder.bytes(challenge, 6);
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder challengeRequest(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                                    const uint8_t *challenge) {
+            iohcFrameBuilder builder = exchange(frame, FrameCmd::ChallengeRequest, from, to);
+            builder.bytes(challenge, 6);
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder challengeAnswer(Buffer &frame, const uint8_t *from, const uint8_t *to,
+                                                   const uint8_t *mac) {
+            iohcFrameBuilder builder = exchange(frame, FrameCmd::ChallengeAnswer, from, to);
+            builder.mac(mac);
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder getName(Buffer &frame, const uint8_t *from, const uint8_t *to) {
+            return request(frame, FrameCmd::GetName, from, to);
+        }
+
+        /// name is padded with zeros to 16 bytes
+        constexpr iohcFrameBuilder setName(Buffer &frame, const uint8_t *from, const uint8_t *to, const char *name) {
+            iohcFrameBuilder builder = request(frame, FrameCmd::SetName, from, to);
+            size_t i = 0;
+            for (; name[i] && i < 16; i++) builder.byte(static_cast<uint8_t>(name[i]));
+            for (; i < 16; i++) builder.byte(0);
+            return builder;
+        }
+
+        constexpr iohcFrameBuilder getGeneralInfo1(Buffer &frame, const uint8_t *from, const uint8_t *to) {
+            return request(frame, FrameCmd::GetGeneralInfo1, from, to);
+        }
+
+        constexpr iohcFrameBuilder getGeneralInfo2(Buffer &frame, const uint8_t *from, const uint8_t *to) {
+            return request(frame, FrameCmd::GetGeneralInfo2, from, to);
+        }
+    }
+
+    class iohcFrameView {
+    public:
+        /// length as received, CRC bytes allowed after the frame
+        constexpr iohcFrameView(const uint8_t *frame, size_t length) : _frame(frame), _received(length) {}
+
+        /// Complete header, and no more announced than received
+        constexpr bool valid() const {
+            return _received >= IOHC_FRAME_HEADER_LEN && length() >= IOHC_FRAME_HEADER_LEN && length() <= _received;
+        }
+        /// Command and parameter length match what the protocol expects for it
+        constexpr bool is(FrameCmd command) const {
+            if (!valid() || cmd() != static_cast<uint8_t>(command)) return false;
+            int expected = frameParamsLen(cmd(), oneWay());
+            return expected < 0 || paramsLen() == expected;
+        }
+
+        constexpr uint8_t length() const { return _received ? (_frame[0] & 0x1F) + 1 : 0; }
+        constexpr bool oneWay() const { return _frame[0] & FRAME_CB1_ONE_WAY; }
+        constexpr bool first() const { return _frame[0] & FRAME_CB1_START; }
+        constexpr bool last() const { return _frame[0] & FRAME_CB1_END; }
+        constexpr uint8_t ctrl2() const { return _frame[1]; }
+        constexpr bool lowPower() const { return _frame[1] & FRAME_CB2_LPM; }
+        constexpr bool priority() const { return _frame[1] & FRAME_CB2_PRIO; }
+        constexpr const uint8_t *target() const { return _frame + 2; }
+        constexpr const uint8_t *source() const { return _frame + 5; }
+        constexpr uint8_t cmd() const { return _frame[8]; }
+        constexpr const uint8_t *params() const { return _frame + IOHC_FRAME_HEADER_LEN; }
+        constexpr uint8_t paramsLen() const { return length() - IOHC_FRAME_HEADER_LEN; }
+        constexpr uint8_t param(uint8_t index) const { return _frame[IOHC_FRAME_HEADER_LEN + index]; }
+        constexpr uint16_t word(uint8_t index) const { return (param(index) << 8) | param(index + 1); }
+
+        /// Authenticated 1W frames
+        constexpr uint16_t sequence() const { return word(paramsLen() - IOHC_1W_AUTH_LEN); }
+        constexpr const uint8_t *mac() const { return _frame + length() - 6; }
+        constexpr const uint8_t *macInput() const { return _frame + 8; }
+        constexpr uint8_t macInputLen() const { return length() - 8 - IOHC_1W_AUTH_LEN; }
+
+    protected:
+        const uint8_t *_frame;
+        size_t _received;
+    };
+
+    /// 0x00 execute, 2W (6 bytes) or 1W (6 or 8 bytes, then sequence and MAC)
+    class iohcExecuteView : public iohcFrameView {
+    public:
+        using iohcFrameView::iohcFrameView;
+        constexpr bool valid() const {
+            if (!iohcFrameView::valid() || cmd() != static_cast<uint8_t>(FrameCmd::Execute)) return false;
+            uint8_t len = oneWay() ? paramsLen() - IOHC_1W_AUTH_LEN : paramsLen();
+            return len == 6 || len == 8;
+        }
+        constexpr uint8_t originator() const { return param(0); }
+        constexpr uint8_t acei() const { return param(1); }
+        constexpr uint16_t main() const { return word(2); }
+        constexpr uint8_t fp1() const { return param(4); }
+        constexpr uint8_t fp2() const { return param(5); }
+        constexpr bool hasData() const { return paramsLen() - (oneWay() ? IOHC_1W_AUTH_LEN : 0) == 8; }
+        constexpr uint16_t data() const { return word(6); }
+    };
+
+    /// 0x38 launch key transfer, 0x3C challenge request, 0x3D challenge answer
+    class iohcChallengeView : public iohcFrameView {
+    public:
+        using iohcFrameView::iohcFrameView;
+        constexpr bool valid() const {
+            return is(FrameCmd::ChallengeRequest) || is(FrameCmd::ChallengeAnswer) || is(FrameCmd::LaunchKeyTransfer);
+        }
+        constexpr const uint8_t *challenge() const { return params(); }
+    };
+
+    /// 0x29 / 0x2B discovery answers
+    class iohcDiscoverAnswerView : public iohcFrameView {
+    public:
+        using iohcFrameView::iohcFrameView;
+        constexpr bool valid() const { return is(FrameCmd::DiscoverAnswer) || is(FrameCmd::DiscoverRemoteAnswer); }
+        constexpr uint16_t nodeType() const { return word(0) >> 6; }
+        constexpr uint8_t nodeSubtype() const { return param(1) & 0x3F; }
+        constexpr const uint8_t *backbone() const { return params() + 2; }
+        constexpr uint8_t manufacturer() const { return param(5); }
+        constexpr uint8_t multiInfo() const { return param(6); }
+        constexpr uint16_t timestamp() const { return word(7); }
+    };
+
+    /// 0x32 2W key transfer, 0x30 1W key transfer
+    class iohcKeyTransferView : public iohcFrameView {
+    public:
+        using iohcFrameView::iohcFrameView;
+        constexpr bool valid() const { return is(FrameCmd::KeyTransfer) || is(FrameCmd::KeyTransfer1W); }
+        constexpr const uint8_t *key() const { return params(); }
+        constexpr uint8_t manufacturer() const { return param(16); }
+        constexpr uint8_t data() const { return param(17); }
+        constexpr uint16_t sequence() const { return word(18); }
+    };
+
+    /// 1W 0x2E pairing and 0x39 remove
+    class iohcAuth1WView : public iohcFrameView {
+    public:
+        using iohcFrameView::iohcFrameView;
+        constexpr bool valid() const {
+            return oneWay() && (is(FrameCmd::LearningMode) || is(FrameCmd::RemoveController));
+        }
+        constexpr uint8_t data() const { return param(0); }
+    };
+
+    /// 0x37 address answer
+    class iohcAddressAnswerView : public iohcFrameView {
+    public:
+        using iohcFrameView::iohcFrameView;
+        constexpr bool valid() const { return is(FrameCmd::AddressAnswer); }
+        constexpr const uint8_t *address() const { return params(); }
+    };
+
+    /// 0x51 name answer, 0x52 set name: up to 16 characters, zero padded
+    class iohcNameView : public iohcFrameView {
+    public:
+        using iohcFrameView::iohcFrameView;
+        constexpr bool valid() const { return is(FrameCmd::NameAnswer) || is(FrameCmd::SetName); }
+        const char *name() const { return reinterpret_cast<const char *>(params()); }
+        constexpr uint8_t nameLen() const {
+            uint8_t len = 0;
+            while (len < 16 && param(len)) len++;
+            return len;
+        }
+    };
+
+    /// 0x04 status answer, 0x55 / 0x57 general info answers: raw bytes, decoded by the device
+    class iohcInfoView : public iohcFrameView {
+    public:
+        using iohcFrameView::iohcFrameView;
+        constexpr bool valid() const {
+            return is(FrameCmd::StatusAnswer) || is(FrameCmd::GeneralInfo1Answer) || is(FrameCmd::GeneralInfo2Answer);
+        }
+        constexpr const uint8_t *info() const { return params(); }
+        constexpr uint8_t infoLen() const { return paramsLen(); }
+    };
+}
+
+#endif // IOHC_FRAME_H
@@ -0,0 +1,216 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_FRAME_TEMPLATES_H
+#define IOHC_FRAME_TEMPLATES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <iohcFrame.h>
+#include <iohcCryptoHelpers.h>
+#include <iohcLatencyHistogram.h>
+
+#ifndef IOHC_1W_TEMPLATE_REMOTES
+#define IOHC_1W_TEMPLATE_REMOTES    16      // 1W remotes with precomputed frames, about 120 bytes each
+#endif
+#define IOHC_1W_TEMPLATE_LEN        (IOHC_FRAME_HEADER_LEN + 6 + IOHC_1W_AUTH_LEN)  // 1W execute, no data bytes
+
+/*
+    Ready-to-send 1W execute frames for the next sequence number of each remote, one per common action, with
+    their MAC. They are built when the gateway is idle (precompute() from the main loop), so a button press only
+    copies 23 bytes where it used to build the frame and run AES. A template is only handed out when the remote's
+    node, key, type and sequence number still match the ones it was built for, anything else is a miss and the
+    frame is built on the spot. Sending consumes the sequence number: track() with the next one drops every
+    template of that remote until the next idle pass.
+    Press-to-queue latencies are kept apart for hits and misses.
+    All calls are thread-safe.
+*/
+namespace IOHC {
+    enum class Action1W : uint8_t {
+        Open,
+        Close,
+        Stop,
+        Vent,
+        ForceOpen,
+        Count
+    };
+
+    /// Main parameter of the 0x00 execute sent for action
+    constexpr uint16_t action1WMain(Action1W action) {
+        switch (action) {
+            case Action1W::Close: return 0xc800;
+            case Action1W::Stop: return 0xd200;
+            case Action1W::Vent: return 0xd803;
+            case Action1W::ForceOpen: return 0x6400;
+            default: return 0x0000;
+        }
+    }
+
+    struct FrameTemplateStats {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t built;             ///< Templates computed by precompute()
+        uint32_t invalidated;       ///< Ready templates dropped by a key, type or sequence change
+        LatencyHistogram hit;
+        LatencyHistogram miss;
+    };
+
+    class iohcFrameTemplates {
+    public:
+        /// Frame and length for action at sequence, 0 if it did not fit
+        static uint8_t build(const uint8_t *node, const uint8_t *key, uint16_t typn, uint16_t sequence,
+                             Action1W action, uint8_t *frame) {
+            // Broadcast to the remote's device type, as forgePacket() addresses it
+            uint16_t broadcast = static_cast<uint16_t>((typn << 6) + 0b111111);
+            const uint8_t target[3] = {0x00, static_cast<uint8_t>(broadcast >> 8), static_cast<uint8_t>(broadcast)};
+            iohcFrames::Buffer buffer;
+            iohcFrameBuilder builder = iohcFrames::execute1W(buffer, node, target, 0x01, 0x43, action1WMain(action));
+            builder.lowPower();
+            const uint8_t seq[2] = {static_cast<uint8_t>(sequence >> 8), static_cast<uint8_t>(sequence)};
+            uint8_t hmac[16];
+            iohcCrypto::create_1W_hmac(hmac, seq, key, builder.macInput(), builder.macInputLen());
+            uint8_t length = builder.sequence(sequence).mac(hmac).finish();
+            memcpy(frame, buffer, length);
+            return length;
+        }
+
+        /// Declares a remote, or updates it; false when every slot is taken
+        bool track(const uint8_t *node, const uint8_t *key, uint16_t typn, uint16_t sequence) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Slot *slot = find(node);
+            if (!slot) {
+                for (auto &s : _slots)
+                    if (!s.used) {
+                        slot = &s;
+                        break;
+                    }
+                if (!slot) return false;
+                *slot = Slot();
+                slot->used = true;
+                memcpy(slot->node, node, 3);
+            }
+            if (slot->sequence != sequence || slot->typn != typn || memcmp(slot->key, key, 16) != 0) {
+                _stats.invalidated += popcount(slot->ready);
+                slot->ready = 0;
+                slot->sequence = sequence;
+                slot->typn = typn;
+                memcpy(slot->key, key, 16);
+            }
+            return true;
+        }
+
+        void forget(const uint8_t *node) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (Slot *slot = find(node)) {
+                // The key does not outlive the remote
+                *slot = Slot();
+            }
+        }
+
+        /// Builds up to budget missing templates, the oldest remote first; how many were built
+        size_t precompute(size_t budget = SIZE_MAX) {
+            size_t done = 0;
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &slot : _slots) {
+                if (!slot.used) continue;
+                for (uint8_t a = 0; a < static_cast<uint8_t>(Action1W::Count); a++) {
+                    if (slot.ready & (1u << a)) continue;
+                    if (done == budget) return done;
+                    build(slot.node, slot.key, slot.typn, slot.sequence, static_cast<Action1W>(a), slot.frames[a]);
+                    slot.ready |= 1u << a;
+                    _stats.built++;
+                    done++;
+                }
+            }
+            return done;
+        }
+
+        /// Writes the frame for action at sequence into frame (IOHC_1W_TEMPLATE_LEN bytes); its length. hit tells
+        /// whether it came ready
+        uint8_t take(const uint8_t *node, const uint8_t *key, uint16_t typn, uint16_t sequence, Action1W action,
+                     uint8_t *frame, bool *hit = nullptr) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                Slot *slot = find(node);
+                uint8_t bit = 1u << static_cast<uint8_t>(action);
+                if (slot && (slot->ready & bit) && slot->sequence == sequence && slot->typn == typn &&
+                    memcmp(slot->key, key, 16) == 0) {
+                    memcpy(frame, slot->frames[static_cast<uint8_t>(action)], IOHC_1W_TEMPLATE_LEN);
+                    _stats.hits++;
+                    if (hit) *hit = true;
+                    return IOHC_1W_TEMPLATE_LEN;
+                }
+                _stats.misses++;
+            }
+            if (hit) *hit = false;
+            return build(node, key, typn, sequence, action, frame);
+        }
+
+        void recordLatency(bool hit, uint32_t us) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            (hit ? _stats.hit : _stats.miss).add(us);
+        }
+
+        /// Templates ready to be sent
+        size_t ready() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            size_t count = 0;
+            for (const auto &slot : _slots) count += popcount(slot.ready);
+            return count;
+        }
+
+        FrameTemplateStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats;
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats = FrameTemplateStats();
+        }
+
+    private:
+        struct Slot {
+            bool used = false;
+            uint8_t ready = 0;          ///< One bit per Action1W
+            uint8_t node[3] = {};
+            uint8_t key[16] = {};
+            uint16_t typn = 0;
+            uint16_t sequence = 0;
+            uint8_t frames[static_cast<uint8_t>(Action1W::Count)][IOHC_1W_TEMPLATE_LEN] = {};
+        };
+
+        Slot *find(const uint8_t *node) {
+            for (auto &slot : _slots)
+                if (slot.used && memcmp(slot.node, node, 3) == 0) return &slot;
+            return nullptr;
+        }
+
+        static size_t popcount(uint8_t bits) {
+            size_t count = 0;
+            for (; bits; bits &= bits - 1) count++;
+            return count;
+        }
+
+        Slot _slots[IOHC_1W_TEMPLATE_REMOTES];
+        FrameTemplateStats _stats{};
+        mutable std::mutex _mutex;
+    };
+}
+
+#endif // IOHC_FRAME_TEMPLATES_H
@@ -0,0 +1,245 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_JSON_ARENA_H
+#define IOHC_JSON_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#if __has_include(<ArduinoJson.h>)
+#include <ArduinoJson.h>
+#endif
+
+#define JSON_ARENA_SIZE     4096    // Bytes per task building transient JSON documents
+#define JSON_ARENA_MAX      8       // Arenas listed by the jsonArena command
+
+/*
+    Bump allocator for the JSON documents living a few milliseconds: the frame published from the RX path, the
+    WebSocket broadcasts, the /api responses. Each task building them gets its own arena on first use (local()),
+    a JsonScratch scope hands it to ArduinoJson and rewinds it when the document is gone. Nothing goes back to the
+    heap in between, so once the arena exists these documents do not touch the heap at all.
+      - Blocks are only reclaimed at the end of the scope, except the last one: freeing it pops it, reallocating it
+        grows it in place (ArduinoJson growing a string).
+      - What does not fit goes to the heap and is counted as a fallback; ArduinoJson frees it as usual.
+    An arena belongs to one task and is not thread-safe; stats() may be read from another task.
+    Tasks that come and go (the MQTT post-connect task) keep the default allocator, their arena would leak.
+*/
+namespace IOHC {
+    struct JsonArenaStats {
+        uint32_t scopes;        ///< JsonScratch scopes opened
+        uint32_t allocations;
+        uint32_t fallbacks;     ///< Allocations that did not fit and went to the heap
+        uint32_t peak;          ///< Most bytes in use at once, headers included
+    };
+
+    class iohcJsonArena {
+    public:
+        static constexpr size_t ALIGN = alignof(std::max_align_t);
+
+        explicit iohcJsonArena(size_t capacity = JSON_ARENA_SIZE)
+            : _capacity(roundUp(capacity)), _buffer(static_cast<uint8_t *>(malloc(_capacity))) {
+            if (!_buffer) _capacity = 0;
+        }
+
+        ~iohcJsonArena() { free(_buffer); }
+
+        iohcJsonArena(const iohcJsonArena &) = delete;
+        iohcJsonArena &operator=(const iohcJsonArena &) = delete;
+
+        /// The calling task's arena, created on first use
+        static iohcJsonArena &local() {
+            static thread_local iohcJsonArena *arena = nullptr;
+            if (!arena) {
+                arena = new iohcJsonArena();
+                Registry &registry = arenas();
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                if (registry.count < JSON_ARENA_MAX) registry.list[registry.count++] = arena;
+            }
+            return *arena;
+        }
+
+        /// Calls f(arena) for every task arena
+        template <typename F>
+        static void each(F &&f) {
+            Registry &registry = arenas();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (size_t i = 0; i < registry.count; i++) f(*registry.list[i]);
+        }
+
+        void *allocate(size_t size) {
+            _stats.allocations++;
+            if (_used + HEADER + roundUp(size) > _capacity) {
+                _stats.fallbacks++;
+                return malloc(size);
+            }
+            uint8_t *block = _buffer + _used;
+            *reinterpret_cast<size_t *>(block) = size;
+            grow(_used + HEADER + roundUp(size));
+            return block + HEADER;
+        }
+
+        void deallocate(void *p) {
+            if (!p) return;
+            if (!owns(p)) {
+                free(p);
+                return;
+            }
+            if (isLast(p)) _used = static_cast<uint8_t *>(p) - HEADER - _buffer;
+        }
+
+        void *reallocate(void *p, size_t size) {
+            if (!p) return allocate(size);
+            if (!owns(p)) return realloc(p, size);
+            const size_t old = sizeOf(p);
+            const size_t offset = static_cast<uint8_t *>(p) - _buffer;
+            if (isLast(p) && offset + roundUp(size) <= _capacity) {
+                *reinterpret_cast<size_t *>(static_cast<uint8_t *>(p) - HEADER) = size;
+                _used = offset;
+                grow(offset + roundUp(size));
+                return p;
+            }
+            if (size <= old) return p;
+            void *moved = allocate(size);
+            if (!moved) return nullptr;
+            memcpy(moved, p, old);
+            deallocate(p);
+            return moved;
+        }
+
+        bool owns(const void *p) const {
+            return p >= _buffer && p < _buffer + _capacity;
+        }
+
+        /// Scope start: what is allocated after it goes with rewind(mark)
+        size_t open() {
+            _stats.scopes++;
+            return _used;
+        }
+
+        void rewind(size_t mark) {
+            if (mark < _used) _used = mark;
+        }
+
+        size_t used() const { return _used; }
+        size_t capacity() const { return _capacity; }
+        JsonArenaStats stats() const { return _stats; }
+        void resetStats() { _stats = {}; }
+
+    private:
+        static constexpr size_t HEADER = ALIGN;     ///< Requested size, keeps the payload aligned
+
+        struct Registry {
+            std::mutex mutex;
+            iohcJsonArena *list[JSON_ARENA_MAX];
+            size_t count = 0;
+        };
+
+        static Registry &arenas() {
+            static Registry registry;
+            return registry;
+        }
+
+        static size_t roundUp(size_t size) { return (size + ALIGN - 1) & ~(ALIGN - 1); }
+
+        static size_t sizeOf(const void *p) {
+            return *reinterpret_cast<const size_t *>(static_cast<const uint8_t *>(p) - HEADER);
+        }
+
+        bool isLast(const void *p) const {
+            return static_cast<const uint8_t *>(p) + roundUp(sizeOf(p)) == _buffer + _used;
+        }
+
+        void grow(size_t used) {
+            _used = used;
+            if (_used > _stats.peak) _stats.peak = _used;
+        }
+
+        size_t _capacity;
+        uint8_t *_buffer;
+        size_t _used = 0;
+        JsonArenaStats _stats{};
+    };
+
+#ifdef ARDUINOJSON_VERSION
+    class JsonArenaAllocator : public ArduinoJson::Allocator {
+    public:
+        explicit JsonArenaAllocator(iohcJsonArena &arena) : _arena(arena) {}
+
+        void *allocate(size_t size) override { return _arena.allocate(size); }
+        void deallocate(void *p) override { _arena.deallocate(p); }
+        void *reallocate(void *p, size_t size) override { return _arena.reallocate(p, size); }
+
+    private:
+        iohcJsonArena &_arena;
+    };
+#endif
+
+    /*
+        One transient document and its output, on the calling task's arena. Declare it before the JsonDocument so
+        the document is destroyed first:
+            JsonScratch scratch;
+            JsonDocument doc(scratch.allocator());
+            ...
+            size_t length = measureJson(doc);
+            char *out = scratch.buffer(length + 1);
+            serializeJson(doc, out, length + 1);
+    */
+    class JsonScratch {
+    public:
+        explicit JsonScratch(iohcJsonArena &arena = iohcJsonArena::local())
+            : _arena(arena), _mark(arena.open())
+#ifdef ARDUINOJSON_VERSION
+            , _allocator(arena)
+#endif
+        {}
+
+        ~JsonScratch() {
+            free(_heap);
+            _arena.rewind(_mark);
+        }
+
+        JsonScratch(const JsonScratch &) = delete;
+        JsonScratch &operator=(const JsonScratch &) = delete;
+
+#ifdef ARDUINOJSON_VERSION
+        ArduinoJson::Allocator *allocator() { return &_allocator; }
+#endif
+
+        /// Output buffer valid until the scope ends; one per scope
+        char *buffer(size_t size) {
+            void *p = _arena.allocate(size);
+            if (p && !_arena.owns(p)) {
+                free(_heap);
+                _heap = p;
+            }
+            return static_cast<char *>(p);
+        }
+
+    private:
+        iohcJsonArena &_arena;
+        size_t _mark;
+#ifdef ARDUINOJSON_VERSION
+        JsonArenaAllocator _allocator;
+#endif
+        void *_heap = nullptr;
+    };
+}
+
+#endif // IOHC_JSON_ARENA_H
@@ -0,0 +1,144 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_JSON_SNAPSHOT_H
+#define IOHC_JSON_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#define SNAPSHOT_ETAG_SIZE      19      // 16 hex digits, the quotes and the terminator
+
+/*
+    Serialized body of a GET endpoint (/api/devices, /api/remotes, /api/mqtt), built once per change of what it shows
+    and served to every poll until the next one, with a strong ETag: clients sending it back in If-None-Match get a
+    304 without a body.
+      - The caller passes a key summing up the state shown: the version counter of the table, bumped by its mutation
+        paths, folded with the fields changing on their own (positions of moving covers). A new key rebuilds the body.
+      - The ETag is a digest of the body itself, so it only changes when the bytes do and is the same across reboots.
+    Bodies are shared: a rebuild does not touch the one a response is still sending.
+    All calls are thread-safe.
+*/
+namespace IOHC {
+    struct SnapshotStats {
+        uint32_t requests;
+        uint32_t notModified;   ///< 304, the client had the current ETag
+        uint32_t hits;          ///< 200 from the cached body
+        uint32_t builds;        ///< Bodies serialized, once per change
+        uint64_t bytesSent;     ///< Bodies sent
+        uint64_t bytesSaved;    ///< Bodies not sent, 304
+    };
+
+    class iohcJsonSnapshot {
+    public:
+        struct Reply {
+            bool notModified = false;
+            std::shared_ptr<const std::string> body;
+            char etag[SNAPSHOT_ETAG_SIZE] = {};
+        };
+
+        /// FNV-1a 64, chained through hash
+        static uint64_t digest(const void *data, size_t length, uint64_t hash = 14695981039346656037ull) {
+            const auto *bytes = static_cast<const uint8_t *>(data);
+            for (size_t i = 0; i < length; i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return hash;
+        }
+
+        /// If-None-Match lists etag: weak comparison (W/ ignored), "*" matches anything
+        static bool matches(const char *ifNoneMatch, const char *etag) {
+            if (!ifNoneMatch) return false;
+            const size_t length = strlen(etag);
+            for (const char *p = ifNoneMatch; *p;) {
+                while (*p == ' ' || *p == '\t' || *p == ',') p++;
+                if (*p == '*') return true;
+                if (p[0] == 'W' && p[1] == '/') p += 2;
+                const char *end = p;
+                while (*end && *end != ',') end++;
+                const char *last = end;
+                while (last > p && (last[-1] == ' ' || last[-1] == '\t')) last--;
+                if (static_cast<size_t>(last - p) == length && memcmp(p, etag, length) == 0) return true;
+                p = end;
+            }
+            return false;
+        }
+
+        /// Body for key, serialized by build(std::string &) when key changed; 304 when ifNoneMatch has its ETag
+        template <typename Build>
+        Reply serve(uint64_t key, const char *ifNoneMatch, Build &&build) {
+            Reply reply;
+            bool built = false;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stats.requests++;
+                if (_body && _key == key) {
+                    reply.body = _body;
+                    memcpy(reply.etag, _etag, sizeof(reply.etag));
+                }
+            }
+            if (!reply.body) {
+                // Outside the lock: a request for the body being replaced still gets the old one
+                auto body = std::make_shared<std::string>();
+                build(*body);
+                snprintf(reply.etag, sizeof(reply.etag), "\"%016llx\"",
+                         static_cast<unsigned long long>(digest(body->data(), body->size())));
+                reply.body = std::move(body);
+                built = true;
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (built) {
+                _key = key;
+                _body = reply.body;
+                memcpy(_etag, reply.etag, sizeof(_etag));
+                _stats.builds++;
+            }
+            if (matches(ifNoneMatch, reply.etag)) {
+                reply.notModified = true;
+                _stats.notModified++;
+                _stats.bytesSaved += reply.body->size();
+                reply.body.reset();
+                return reply;
+            }
+            if (!built) _stats.hits++;
+            _stats.bytesSent += reply.body->size();
+            return reply;
+        }
+
+        SnapshotStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats;
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats = {};
+        }
+
+    private:
+        mutable std::mutex _mutex;
+        uint64_t _key = 0;
+        std::shared_ptr<const std::string> _body;
+        char _etag[SNAPSHOT_ETAG_SIZE] = {};
+        SnapshotStats _stats{};
+    };
+}
+
+#endif // IOHC_JSON_SNAPSHOT_H
@@ -0,0 +1,69 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_LATENCY_HISTOGRAM_H
+#define IOHC_LATENCY_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define IOHC_LATENCY_BUCKETS        16      // Powers of two in microseconds: < 1 us .. >= 16 ms
+
+/*
+    Log2 latency histogram, min/max/mean plus bucket counts, cheap enough to update on every event.
+    Not thread-safe by itself: the owner updates it under its own lock.
+*/
+namespace IOHC {
+    struct LatencyHistogram {
+        uint32_t count;
+        uint32_t minUs;
+        uint32_t maxUs;
+        uint64_t totalUs;
+        uint32_t buckets[IOHC_LATENCY_BUCKETS];   ///< buckets[0] < 1 us, buckets[i] [2^(i-1), 2^i) us
+
+        static size_t bucket(uint32_t us) {
+            size_t b = 0;
+            while (us && b < IOHC_LATENCY_BUCKETS - 1) {
+                us >>= 1;
+                b++;
+            }
+            return b;
+        }
+
+        void add(uint32_t us) {
+            if (!count || us < minUs) minUs = us;
+            if (us > maxUs) maxUs = us;
+            count++;
+            totalUs += us;
+            buckets[bucket(us)]++;
+        }
+
+        uint32_t meanUs() const { return count ? static_cast<uint32_t>(totalUs / count) : 0; }
+
+        /// Upper bound of the bucket holding the given percentile, in us
+        uint32_t percentileUs(uint8_t percent) const {
+            uint64_t target = (static_cast<uint64_t>(count) * percent + 99) / 100;
+            uint64_t seen = 0;
+            for (size_t b = 0; b < IOHC_LATENCY_BUCKETS; b++) {
+                seen += buckets[b];
+                if (count && seen >= target) return b ? 1u << b : 1;
+            }
+            return maxUs;
+        }
+    };
+}
+
+#endif // IOHC_LATENCY_HISTOGRAM_H
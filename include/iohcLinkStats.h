@@ -0,0 +1,207 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_LINK_STATS_H
+#define IOHC_LINK_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sx1276Regs-Fsk.h>
+
+#define LINK_BURST_LEN          (REG_FEILSB - REG_LNA + 1)  // REG_LNA..REG_FEILSB, read in one SPI transaction
+#define LINK_RSSI_BUCKETS       12      // 5 dB wide from -130 dBm, the last one open-ended
+#define LINK_RSSI_FLOOR_DBM     -130
+#define LINK_FEI_BUCKETS        9       // 2 kHz wide centred on 0, the outer ones open-ended
+#define LINK_LNA_BUCKETS        6       // LnaGain G1 (max) .. G6
+#ifndef LINK_MAX_CHANNELS
+#define LINK_MAX_CHANNELS       4
+#endif
+#ifndef LINK_MAX_SOURCES
+#define LINK_MAX_SOURCES        16      // Least recently heard source is replaced when full
+#endif
+
+/*
+    Per-frame link metrics, captured from one register burst at PayloadReady and kept as raw register values.
+    Conversions to dBm/Hz happen only when reporting. Histograms have fixed buckets, per channel and per source.
+*/
+namespace IOHC {
+    struct LinkSample {
+        uint8_t rssi;       ///< RegRssiValue: -dBm * 2
+        uint8_t floor;      ///< RegRssiThresh, same unit
+        uint8_t lna;        ///< LnaGain: 1 (max gain) .. 6
+        int16_t afc;        ///< AFC correction applied, in Fstep (61.035 Hz)
+        int16_t fei;        ///< Frequency error measured on the preamble, in Fstep
+
+        int16_t rssiDbmX2() const { return -static_cast<int16_t>(rssi); }
+        float rssiDbm() const { return -rssi / 2.0f; }
+        /// Margin above the RSSI threshold, in dB
+        uint8_t snrDb() const { return floor > rssi ? (floor - rssi) / 2 : 0; }
+        int32_t afcHz() const { return afc * 61035 / 1000; }
+        int32_t feiHz() const { return fei * 61035 / 1000; }
+        /// LNA gain relative to G1, in dB
+        uint8_t lnaAttenuationDb() const {
+            static const uint8_t attenuation[] = {0, 0, 6, 12, 24, 36, 48, 48};
+            return attenuation[lna & 0x07];
+        }
+    };
+
+    /// regs[0] is REG_LNA, LINK_BURST_LEN bytes
+    inline LinkSample linkSampleFromBurst(const uint8_t *regs) {
+        LinkSample sample;
+        sample.lna = (regs[0] >> 5) & 0x07;
+        sample.floor = regs[REG_RSSITHRESH - REG_LNA];
+        sample.rssi = regs[REG_RSSIVALUE - REG_LNA];
+        sample.afc = static_cast<int16_t>((regs[REG_AFCMSB - REG_LNA] << 8) | regs[REG_AFCLSB - REG_LNA]);
+        sample.fei = static_cast<int16_t>((regs[REG_FEIMSB - REG_LNA] << 8) | regs[REG_FEILSB - REG_LNA]);
+        return sample;
+    }
+
+    struct LinkHistogram {
+        uint32_t frames;
+        int16_t rssiMinX2;          ///< dBm * 2
+        int16_t rssiMaxX2;
+        int64_t rssiSumX2;
+        int64_t feiSumHz;
+        uint32_t rssi[LINK_RSSI_BUCKETS];
+        uint32_t fei[LINK_FEI_BUCKETS];
+        uint32_t lna[LINK_LNA_BUCKETS];
+
+        static size_t rssiBucket(const LinkSample &s) {
+            int32_t above = s.rssiDbmX2() - LINK_RSSI_FLOOR_DBM * 2;
+            if (above < 0) return 0;
+            size_t bucket = static_cast<size_t>(above / 10);
+            return bucket < LINK_RSSI_BUCKETS ? bucket : LINK_RSSI_BUCKETS - 1;
+        }
+
+        static size_t feiBucket(const LinkSample &s) {
+            int32_t shifted = s.feiHz() + LINK_FEI_BUCKETS * 1000;
+            if (shifted < 0) return 0;
+            size_t bucket = static_cast<size_t>(shifted / 2000);
+            return bucket < LINK_FEI_BUCKETS ? bucket : LINK_FEI_BUCKETS - 1;
+        }
+
+        void add(const LinkSample &s) {
+            int16_t rssiX2 = s.rssiDbmX2();
+            if (!frames || rssiX2 < rssiMinX2) rssiMinX2 = rssiX2;
+            if (!frames || rssiX2 > rssiMaxX2) rssiMaxX2 = rssiX2;
+            frames++;
+            rssiSumX2 += rssiX2;
+            feiSumHz += s.feiHz();
+            rssi[rssiBucket(s)]++;
+            fei[feiBucket(s)]++;
+            if (s.lna >= 1 && s.lna <= LINK_LNA_BUCKETS) lna[s.lna - 1]++;
+        }
+
+        float rssiMeanDbm() const { return frames ? rssiSumX2 / 2.0f / frames : 0; }
+        int32_t feiMeanHz() const { return frames ? static_cast<int32_t>(feiSumHz / frames) : 0; }
+    };
+
+    struct LinkChannel {
+        uint32_t frequency;
+        LinkHistogram histogram;
+    };
+
+    struct LinkSource {
+        uint32_t address;           ///< 24-bit source address, first byte most significant
+        uint32_t lastSeen;          ///< Frame counter value when last heard
+        LinkHistogram histogram;
+    };
+
+    class iohcLinkStats {
+    public:
+        /// One received frame. frame is the raw io-homecontrol frame, the source address sits at bytes 5..7
+        void record(const LinkSample &sample, uint32_t frequency, const uint8_t *frame, uint8_t length) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _frames++;
+            if (LinkChannel *channel = findChannel(frequency))
+                channel->histogram.add(sample);
+            if (length >= 8) {
+                uint32_t address = (frame[5] << 16) | (frame[6] << 8) | frame[7];
+                LinkSource &source = findSource(address);
+                source.lastSeen = _frames;
+                source.histogram.add(sample);
+            }
+        }
+
+        uint32_t frames() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _frames;
+        }
+
+        /// Copies of the entries, for reporting without holding the lock
+        size_t channels(LinkChannel *out, size_t max) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            size_t count = 0;
+            for (size_t i = 0; i < LINK_MAX_CHANNELS && count < max; ++i)
+                if (_channels[i].frequency) out[count++] = _channels[i];
+            return count;
+        }
+
+        size_t sources(LinkSource *out, size_t max) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            size_t count = 0;
+            for (size_t i = 0; i < LINK_MAX_SOURCES && count < max; ++i)
+                if (_sources[i].lastSeen) out[count++] = _sources[i];
+            return count;
+        }
+
+        uint32_t evicted() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _evicted;
+        }
+
+        void reset() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &channel : _channels) channel = {};
+            for (auto &source : _sources) source = {};
+            _frames = 0;
+            _evicted = 0;
+        }
+
+    private:
+        LinkChannel *findChannel(uint32_t frequency) {
+            for (auto &channel : _channels) {
+                if (channel.frequency == frequency) return &channel;
+                if (!channel.frequency) {
+                    channel.frequency = frequency;
+                    return &channel;
+                }
+            }
+            return nullptr;
+        }
+
+        LinkSource &findSource(uint32_t address) {
+            LinkSource *oldest = &_sources[0];
+            for (auto &source : _sources) {
+                if (source.lastSeen && source.address == address) return source;
+                if (source.lastSeen < oldest->lastSeen) oldest = &source;
+            }
+            if (oldest->lastSeen) _evicted++;
+            *oldest = {};
+            oldest->address = address;
+            return *oldest;
+        }
+
+        mutable std::mutex _mutex;
+        uint32_t _frames = 0;
+        uint32_t _evicted = 0;
+        LinkChannel _channels[LINK_MAX_CHANNELS]{};
+        LinkSource _sources[LINK_MAX_SOURCES]{};
+    };
+}
+
+#endif // IOHC_LINK_STATS_H
@@ -0,0 +1,268 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_MQTT_QUEUE_H
+#define IOHC_MQTT_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <iohcLatencyHistogram.h>
+#include <iohcTopicRouter.h>
+
+#ifndef MQTT_QUEUE_DEPTH
+#define MQTT_QUEUE_DEPTH        32      // Messages waiting for the publisher task
+#endif
+#define MQTT_QUEUE_HIGH_WATER   24      // Producers are told to back off from this depth...
+#define MQTT_QUEUE_LOW_WATER    8       // ...until the queue drained down to this one
+
+/*
+    Outbound MQTT messages, between the producers (RX callback, position tracking, command handlers, discovery) and
+    the publisher task, the only one talking to the MQTT client.
+      - Policy per topic filter: QoS, retain and whether only the last value matters (coalesce). A coalescing topic
+        still waiting is updated in place, a burst of positions costs one publish.
+      - Bounded: when full, the oldest event (non-coalescing message) makes room; with none left the new message is
+        dropped. State is never pushed out by events.
+      - Backpressure: congested() from the high water mark until the queue drained to the low water mark. Producers
+        that can skip work (the RX path building the frame JSON) check it first; the others may wait.
+    The publisher peeks the oldest message, publishes it and pops it. A coalesced update in between is kept and
+    published again, the newest value is never lost. A message may carry a callback, run by pop() once the client
+    accepted it (the discovery cache records what the broker really has).
+    Slots keep their string capacity, so once warmed up pushing and peeking do not allocate.
+    All calls are thread-safe.
+*/
+namespace IOHC {
+    struct MqttPolicy {
+        uint8_t qos = 0;
+        bool retain = false;
+        bool coalesce = false;      ///< Only the last value matters: replaced while waiting, kept over events
+    };
+
+    struct MqttQueueStats {
+        uint32_t queued;
+        uint32_t coalesced;     ///< Updates that replaced a waiting value of their topic
+        uint32_t dropped;       ///< New messages refused, queue full of state
+        uint32_t evicted;       ///< Events pushed out by newer messages
+        uint32_t skipped;       ///< Messages producers did not build because of backpressure
+        uint32_t published;
+        uint32_t retries;       ///< Publishes refused by the client, kept for the next attempt
+        uint32_t congestions;   ///< Times the high water mark was reached
+        uint16_t maxDepth;
+        LatencyHistogram latency;   ///< Push to accepted by the client
+    };
+
+    class iohcMqttQueue {
+    public:
+        enum class Push : uint8_t {
+            Queued,
+            Coalesced,
+            Dropped,
+        };
+
+        struct Message {
+            using Published = void (*)(const Message &sent);
+
+            std::string topic;
+            std::string payload;
+            MqttPolicy policy;
+            uint32_t hash = 0;
+            uint32_t version = 0;       ///< Unique per push and per coalesced update
+            int64_t pushedUs = 0;
+            Published published = nullptr;     ///< Called with the message once the client accepted it
+        };
+
+        iohcMqttQueue() : _slots(MQTT_QUEUE_DEPTH) {}
+
+        /// Policy of the topics matching filter ("+" and "#" allowed); other topics get the default policy
+        bool setPolicy(const char *filter, MqttPolicy policy) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _policies.add(filter, policy);
+        }
+
+        void setDefaultPolicy(MqttPolicy policy) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _defaultPolicy = policy;
+        }
+
+        MqttPolicy policyFor(const char *topic) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return lookupPolicy(topic, strlen(topic));
+        }
+
+        Push push(const char *topic, const char *payload, size_t length, int64_t nowUs,
+                  Message::Published published = nullptr) {
+            const size_t topicLength = strlen(topic);
+            const uint32_t hash = hashTopic(topic, topicLength);
+            std::lock_guard<std::mutex> lock(_mutex);
+            const MqttPolicy policy = lookupPolicy(topic, topicLength);
+
+            if (policy.coalesce) {
+                for (size_t i = 0; i < _count; i++) {
+                    Message &waiting = _slots[(_head + i) % MQTT_QUEUE_DEPTH];
+                    if (waiting.hash == hash && waiting.policy.coalesce &&
+                        waiting.topic.compare(0, std::string::npos, topic, topicLength) == 0) {
+                        waiting.payload.assign(payload, length);
+                        waiting.version = ++_versions;
+                        waiting.published = published;
+                        _stats.coalesced++;
+                        return Push::Coalesced;
+                    }
+                }
+            }
+            if (_count == MQTT_QUEUE_DEPTH && !evictOldestEvent()) {
+                _stats.dropped++;
+                return Push::Dropped;
+            }
+
+            Message &slot = _slots[(_head + _count) % MQTT_QUEUE_DEPTH];
+            slot.topic.assign(topic, topicLength);
+            slot.payload.assign(payload, length);
+            slot.policy = policy;
+            slot.hash = hash;
+            slot.version = ++_versions;
+            slot.pushedUs = nowUs;
+            slot.published = published;
+            _count++;
+            _stats.queued++;
+            if (_count > _stats.maxDepth) _stats.maxDepth = _count;
+            if (!_congested && _count >= MQTT_QUEUE_HIGH_WATER) {
+                _congested = true;
+                _stats.congestions++;
+            }
+            return Push::Queued;
+        }
+
+        /// Copies the oldest message into out, reusing its buffers; false when empty
+        bool peek(Message &out) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_count) return false;
+            const Message &front = _slots[_head];
+            out.topic.assign(front.topic);
+            out.payload.assign(front.payload);
+            out.policy = front.policy;
+            out.hash = front.hash;
+            out.version = front.version;
+            out.pushedUs = front.pushedUs;
+            out.published = front.published;
+            return true;
+        }
+
+        /// sent, as returned by peek(), was accepted by the client; runs its callback outside the lock
+        void pop(const Message &sent, int64_t nowUs) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stats.published++;
+                _stats.latency.add(static_cast<uint32_t>(nowUs - sent.pushedUs));
+                // Evicted meanwhile, or updated with a newer value still to publish
+                if (_count && _slots[_head].version == sent.version) removeFront();
+            }
+            if (sent.published) sent.published(sent);
+        }
+
+        void retried() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.retries++;
+        }
+
+        /// A producer did not build a message because of congested()
+        void skipped() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.skipped++;
+        }
+
+        bool congested() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _congested;
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _count;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            while (_count) removeFront();
+        }
+
+        MqttQueueStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats;
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats = {};
+            _stats.maxDepth = _count;
+        }
+
+    private:
+        static uint32_t hashTopic(const char *topic, size_t length) {
+            uint32_t hash = 2166136261u;
+            for (size_t i = 0; i < length; i++) hash = (hash ^ static_cast<uint8_t>(topic[i])) * 16777619u;
+            return hash;
+        }
+
+        MqttPolicy lookupPolicy(const char *topic, size_t length) const {
+            iohcTopicRouter<MqttPolicy>::Match match;
+            return _policies.match(topic, length, match) ? match.handler : _defaultPolicy;
+        }
+
+        void removeFront() {
+            _head = (_head + 1) % MQTT_QUEUE_DEPTH;
+            _count--;
+            if (_congested && _count <= MQTT_QUEUE_LOW_WATER) _congested = false;
+        }
+
+        /// Frees the slot of the oldest event, shifting the newer messages down; false when all are state
+        bool evictOldestEvent() {
+            for (size_t i = 0; i < _count; i++) {
+                const size_t at = (_head + i) % MQTT_QUEUE_DEPTH;
+                if (_slots[at].policy.coalesce) continue;
+                if (i == 0) {
+                    removeFront();
+                } else {
+                    for (size_t k = i; k + 1 < _count; k++)
+                        std::swap(_slots[(_head + k) % MQTT_QUEUE_DEPTH], _slots[(_head + k + 1) % MQTT_QUEUE_DEPTH]);
+                    _count--;
+                }
+                _stats.evicted++;
+                return true;
+            }
+            return false;
+        }
+
+        mutable std::mutex _mutex;
+        std::vector<Message> _slots;
+        size_t _head = 0;
+        size_t _count = 0;
+        uint32_t _versions = 0;
+        bool _congested = false;
+        iohcTopicRouter<MqttPolicy> _policies;
+        MqttPolicy _defaultPolicy{};
+        MqttQueueStats _stats{};
+    };
+}
+
+#endif // IOHC_MQTT_QUEUE_H
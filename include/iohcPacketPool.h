@@ -0,0 +1,121 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_PACKET_POOL_H
+#define IOHC_PACKET_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/*
+    Fixed pool of reference-counted packets for the TX path. acquire() hands out a reset packet holding one
+    reference; whoever queues it gives that reference to the radio, which drops it once the batch is complete.
+    A caller wanting to reuse the buffer takes its own reference with retain() before sending, and release()s it
+    when done. dispose() is the single way the radio lets go of a packet: pool packets are released, packets
+    allocated with new (outside of the pool) are deleted.
+    All calls are thread-safe.
+*/
+namespace IOHC {
+    struct PacketPoolStats {
+        uint32_t acquired;
+        uint32_t exhausted;     ///< acquire() found no free packet
+        uint32_t inUse;
+        uint32_t highWater;
+    };
+
+    template <typename T, size_t N>
+    class iohcPacketPool {
+        static_assert(N > 0 && N <= 255, "iohcPacketPool index is stored on 8 bits");
+
+    public:
+        iohcPacketPool() {
+            for (size_t i = 0; i < N; ++i) _free[i] = static_cast<uint8_t>(N - 1 - i);
+            _freeCount = N;
+        }
+
+        iohcPacketPool(const iohcPacketPool &) = delete;
+        iohcPacketPool &operator=(const iohcPacketPool &) = delete;
+
+        static constexpr size_t capacity() { return N; }
+
+        /// Reset packet with one reference, nullptr when every packet is in use
+        T *acquire() {
+            uint8_t idx;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_freeCount) {
+                    _stats.exhausted++;
+                    return nullptr;
+                }
+                idx = _free[--_freeCount];
+                _stats.acquired++;
+                if (++_stats.inUse > _stats.highWater) _stats.highWater = _stats.inUse;
+            }
+            _refs[idx].store(1, std::memory_order_relaxed);
+            _items[idx] = T();
+            return &_items[idx];
+        }
+
+        bool owns(const T *item) const { return item >= _items && item < _items + N; }
+
+        void retain(T *item) {
+            if (owns(item)) _refs[indexOf(item)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// Drops one reference; true when the packet went back to the pool
+        bool release(T *item) {
+            if (!owns(item)) return false;
+            uint8_t idx = indexOf(item);
+            if (_refs[idx].fetch_sub(1, std::memory_order_acq_rel) != 1) return false;
+            std::lock_guard<std::mutex> lock(_mutex);
+            _free[_freeCount++] = idx;
+            _stats.inUse--;
+            return true;
+        }
+
+        /// Let go of a packet handed over by its owner, whichever way it was allocated
+        void dispose(T *item) {
+            if (owns(item)) release(item);
+            else delete item;
+        }
+
+        uint8_t refs(const T *item) const { return owns(item) ? _refs[indexOf(item)].load() : 0; }
+
+        size_t available() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _freeCount;
+        }
+
+        PacketPoolStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats;
+        }
+
+    private:
+        uint8_t indexOf(const T *item) const { return static_cast<uint8_t>(item - _items); }
+
+        T _items[N]{};
+        std::atomic<uint8_t> _refs[N]{};
+        uint8_t _free[N]{};
+        size_t _freeCount = 0;
+        PacketPoolStats _stats{};
+        mutable std::mutex _mutex;
+    };
+}
+
+#endif // IOHC_PACKET_POOL_H
@@ -48,7 +48,6 @@ private:
     address currentPairingAddr;
     bool pairingActive;
     uint32_t lastStepTime;
-    iohcPacket* lastSentPacket;  // Track last packet to prevent memory corruption
     
     // Device challenge received from CMD 0x3C (6 bytes for 2W)
     uint8_t deviceChallenge[6];
@@ -79,7 +78,7 @@ private:
     
     PairingController() : deviceMgr(nullptr), radio(nullptr), 
                          pairingActive(false), lastStepTime(0), hasSystemKey(false),
-                         hasChallenge(false), commandBeingAuthenticated(0), lastSentPacket(nullptr), 
+                         hasChallenge(false), commandBeingAuthenticated(0), 
                          autoPairMode(false), cmd2ABroadcastCount(0), pendingRetryFunc(nullptr), 
                          retryCount(0), lastRetryTime(0) {
         memset(currentPairingAddr, 0, 3);
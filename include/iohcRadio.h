@@ -20,13 +20,23 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #include <Delegate.h>
 #include <cstdint>
 
 #include <board-config.h>
+#include <iohcChannelHopper.h>
 #include <iohcCryptoHelpers.h>
+#include <iohcLinkStats.h>
 #include <iohcPacket.h>
+#include <iohcPacketPool.h>
+#include <iohcRxFilter.h>
+#include <iohcRxDedupe.h>
+#include <iohcRxRing.h>
+#include <iohcTxQueue.h>
+#include <iohcTxSequencer.h>
+#include <iohcWakeTracker.h>
 
 #if defined(RADIO_SX127X)
         #include <SX1276Helpers.h>
@@ -41,7 +51,13 @@
 #define SM_GRANULARITY_US               130ULL  // Ticker function frequency in uS (100 minimum) 4 x 26µs = 104
 #define SM_GRANULARITY_MS               1       // Ticker function frequency in uS
 #define SM_PREAMBLE_RECOVERY_TIMEOUT_US 1378 // 12500   // SM_GRANULARITY_US * PREAMBLE_LSB //12500   // Maximum duration in uS of Preamble before reset of receiver
-#define DEFAULT_SCAN_INTERVAL_US        13520   // Default uS between frequency changes
+#define DEFAULT_SCAN_INTERVAL_US        13520   // Default mean dwell per channel in uS when hopping, see iohcChannelHopper
+#ifndef IOHC_RX_POOL_SIZE
+#define IOHC_RX_POOL_SIZE               16      // RX records preallocated between radio task and RX callback task (power of 2)
+#endif
+#ifndef IOHC_TX_POOL_SIZE
+#define IOHC_TX_POOL_SIZE               32      // TX packets preallocated, see allocPacket()
+#endif
 
 /*
     Singleton class to implement an IOHC Radio abstraction layer for controllers.
@@ -51,6 +67,17 @@
 namespace IOHC {
     using IohcPacketDelegate = Delegate<bool(iohcPacket *iohc)>;
 
+    /// Compact copy of a received frame, as stored in the RX pool
+    struct RxRecord {
+        uint8_t buffer[MAX_FRAME_LEN];
+        uint8_t length;
+        uint32_t frequency;
+        LinkSample link;
+        RxVerdict verdict;      ///< Keep or Sniff, dropped frames never reach the pool
+    };
+    using RxFrameRing = iohcRxRing<RxRecord, IOHC_RX_POOL_SIZE>;
+    using TxPacketPool = iohcPacketPool<iohcPacket, IOHC_TX_POOL_SIZE>;
+
     class iohcRadio  {
         public:
             static iohcRadio *getInstance();
@@ -65,7 +92,16 @@ namespace IOHC {
                 ERROR        ///< Error or unknown state
             };
             void start(uint8_t num_freqs, uint32_t *scan_freqs, uint32_t scanTimeUs, IohcPacketDelegate rxCallback, IohcPacketDelegate txCallback);
-            void send(std::vector<iohcPacket*>&iohcTx);
+            bool send(std::vector<iohcPacket*>&iohcTx, TxPriority priority = TxPriority::Normal,
+                      TxSource source = TxSource::Other, uint32_t deadlineMs = 0, TxDoneDelegate onDone = nullptr);
+            bool sendAt(std::vector<iohcPacket*>&iohcTx, uint64_t startUs, TxPriority priority = TxPriority::Normal,
+                        TxSource source = TxSource::Other, uint32_t deadlineMs = 0, TxDoneDelegate onDone = nullptr);
+            /// Packet for send(): from the TX pool, or from the heap when the pool is exhausted
+            static iohcPacket *allocPacket() {
+                iohcPacket *packet = _txPool.acquire();
+                return packet ? packet : new iohcPacket();
+            }
+            static TxPacketPool &txPool() { return _txPool; }
             void sendAuto(std::vector<iohcPacket*>&iohcTx); // Nieuwe versie voor AutoTxRx
             static void setRadioState(RadioState newState);
             static const char* radioStateToString(RadioState state);
@@ -73,11 +109,28 @@ namespace IOHC {
             static void tickerCounter(iohcRadio *radio);
             static TaskHandle_t txTaskHandle; // TX Task handle
             static volatile bool txComplete;
+            static volatile bool hopDue;    // Dwell timer fired, handled by the interrupt task
+            static volatile bool txTimerDue;    // TX sequencer timer fired, handled by the interrupt task
+            static volatile bool scheduleDue;   // Delayed batch start reached, handled by the interrupt task
+            static RxRingStats rxStats() { return rxRing.stats(); }
+            static void setRxOverflowPolicy(RxOverflowPolicy policy) { rxRing.setOverflowPolicy(policy); }
+            static RxOverflowPolicy rxOverflowPolicy() { return rxRing.overflowPolicy(); }
+            static iohcLinkStats &linkStats() { return _linkStats; }
+            static iohcRxFilter &rxFilter() { return _rxFilter; }
+            static iohcRxDedupe &rxDedupe() { return _rxDedupe; }
+            static iohcWakeTracker &wakeTracker() { return _wakeTracker; }
+            const TxSeqStats &txStats() const { return txSequencer.stats(); }
+            TxSourceStats txQueueStats(TxSource source) const { return txQueue.stats(source); }
+            static volatile uint64_t packetSentStamp; // DIO0 time stamp, taken in the ISR
+            const HopStats &hopStats() const { return hopper.stats(); }
+            const HopChannelStats &hopStats(uint8_t channel) const { return hopper.stats(channel); }
+            uint8_t hopChannels() const { return hopper.channels(); }
+            uint32_t scanFrequency(uint8_t channel) const { return scan_freqs[channel]; }
             //static void setPreambleLength(uint16_t preambleLen);
 
         private:
             iohcRadio();
-            bool receive(bool stats);
+            bool receive();
             bool sent(iohcPacket *packet);
 
             static iohcRadio *_iohcRadio;
@@ -86,8 +139,13 @@ namespace IOHC {
             
             volatile static bool send_lock;
             
-            // RX callback queue and task
-            static QueueHandle_t rxCallbackQueue;
+            // RX pool shared with the callback task
+            static RxFrameRing rxRing;
+            static iohcLinkStats _linkStats;    // Fed by the RX callback task
+            static iohcRxFilter _rxFilter;      // Applied in the radio task, before the pool
+            static iohcRxDedupe _rxDedupe;      // Repeats stop in the RX callback task, before decoding
+            static iohcWakeTracker _wakeTracker;    // Picks the preamble of each batch
+            static TxPacketPool _txPool;
             static TaskHandle_t rxCallbackTaskHandle;
             static void rxCallbackTask(void *pvParameters);
 
@@ -97,27 +155,69 @@ namespace IOHC {
             static void txTaskLoop(void *pvParameters);
             static void lightTxTask(void *pvParameters);
             //TaskHandle_t txTaskHandle = nullptr;
-            static void IRAM_ATTR onTxTicker(void *arg);
+            static void IRAM_ATTR onTxTimer(void *arg);
+            static void IRAM_ATTR onScheduleTimer(void *arg);
+            static void IRAM_ATTR onHopTimer(void *arg);
+            bool enqueue(std::vector<iohcPacket*>&iohcTx, uint64_t startUs, TxPriority priority, TxSource source,
+                         uint32_t deadlineMs, TxDoneDelegate &onDone);
+            void reportCompleted();
+            bool onPacketSent();
+            void onTxTimerDue();
+            void onScheduleDue();
+            bool dispatchNext();
+            bool takeTxLog(iohcPacket &out);
+            static bool choosePreamble(const iohcPacket *packet, uint64_t nowUs);
+            static bool expectedPreamble(const iohcPacket *packet, uint64_t nowUs);
 
             uint8_t num_freqs = 0;
             uint32_t *scan_freqs{};
             uint32_t scanTimeUs{};
-            uint8_t currentFreqIdx = 0;
 
         #if defined(ESP8266)
             Timers::TickerUs TickTimer;
             Timers::TickerUs Sender;
+            Timers::TickerUs Scheduler;
+            Timers::TickerUs Hopper;
 //            Timers::TickerUs FreqScanner;
         #elif defined(ESP32)
             TimersUS::TickerUsESP32 TickTimer;
             TimersUS::TickerUsESP32 Sender;
+            TimersUS::TickerUsESP32 Scheduler;  // Start of the next delayed batch
+            TimersUS::TickerUsESP32 Hopper;     // Channel dwell
         #endif
             iohcPacket *iohc{};
-            iohcPacket *delayed{};
             
             IohcPacketDelegate rxCB = nullptr;
             IohcPacketDelegate txCB = nullptr;
             std::vector<iohcPacket*> packets2send{};
+            TxBatch<iohcPacket> txActive;       // Batch being sent, its packets are in packets2send
+            bool firstShortPreamble = false;    // Preamble of the first frame of the batch being sent
+            iohcPacket txLog;                   // First frame of the last batch started, logged by the RX callback task
+            volatile bool txLogPending = false;
+
+            // Hardware side of the TX sequencer, packets2send holds the frames
+            struct TxDriver {
+                iohcRadio *radio;
+                TxSlot slot(size_t frame, bool first) const;
+                void transmit(size_t frame, bool first);
+                void arm(uint32_t delayUs);
+                void listen();
+                void finish();
+            };
+            iohcTxQueue<iohcPacket> txQueue;
+            TxDriver txDriver{this};
+            iohcTxSequencer<TxDriver> txSequencer{txDriver};
+            SemaphoreHandle_t txMutex = nullptr;  // PacketSent (interrupt task) vs timer task vs send()
+
+            // Hardware side of the channel hopper, driven from the interrupt task
+            struct HopDriver {
+                iohcRadio *radio;
+                void tune(const uint8_t frf[3]);
+                void arm(uint32_t delayUs);
+                bool idle() const;
+            };
+            HopDriver hopDriver{this};
+            iohcChannelHopper<HopDriver> hopper{hopDriver};
         protected:
             static void i_preamble();
             static void i_payload();
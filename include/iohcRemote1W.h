@@ -18,10 +18,14 @@
 #define IOHC_1W_DEVICE_H
 
 #include <iohcDevice.h>
+#include <atomic>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <tokens.h>
 #include <blind_position.h>
+#include <iohcFrameTemplates.h>
+#include <iohcDeviceIndex.h>
 
 #define IOHC_1W_REMOTE  "/1W.json"
 
@@ -30,6 +34,8 @@
     The type of the controller can be managed changing related value within its profile file (1W.json)
     Type can be multiple, as it would be for KLI310, KLI312 and KLI313
     Also, the address and private key can be configured within the same json file.
+    Commands run on the command worker while the web server and MQTT read the remotes: every change holds the
+    remotes lock, and so do the callers of getRemotes() and find() for as long as they use what those return.
 */
 namespace IOHC {
     enum class RemoteButton {
@@ -68,7 +74,8 @@ namespace IOHC {
         static iohcRemote1W* getInstance();
         ~iohcRemote1W() override = default;
 
-        void cmd(RemoteButton cmd, Tokens* data);
+        /// Sends the button of the remote data[1]; true when frames were queued, onDone then gets their TX report
+        bool cmd(RemoteButton cmd, Tokens* data, TxDoneDelegate onDone = nullptr);
         void handleRemoteAction(RemoteButton cmd, const std::string &description);
         bool load() override;
         bool save() override;
@@ -76,26 +83,52 @@ namespace IOHC {
 
         static void forgePacket(iohcPacket* packet, uint16_t typn);
 
+        /// Held by every change to the remotes; recursive, a command saves the file and publishes under it
+        std::unique_lock<std::recursive_mutex> lock() const { return std::unique_lock<std::recursive_mutex>(_mutex); }
         const std::vector<remote>& getRemotes() const;
+        /// Through the shared device index, nullptr when unknown
+        remote *find(const address node);
+        remote *findByDescription(const std::string &description);
         bool addRemote(const std::string &name);
         bool removeRemote(const std::string &description);
         bool renameRemote(const std::string &description, const std::string &name);
         bool setTravelTime(const std::string &description, uint32_t travelTime);
         void updatePositions();
+        /// Only when the remotes lock is free
+        void updatePositions(std::try_to_lock_t);
+        /// Bumped by every load and save, the remotes changed
+        uint32_t version() const { return _version.load(); }
+        /// Main loop hook: builds one missing frame template
+        void idle();
+        iohcFrameTemplates &templates() { return _templates; }
 
     private:
         iohcRemote1W();
 
         static iohcRemote1W* _iohcRemote1W;
 
+        bool sendPrecomputed(remote &r, Action1W action, int64_t pressedUs, TxDoneDelegate &onDone);
+        /// r.sequence was just spent: persists it and drops the templates built for the previous one
+        void sequenceSpent(const remote &r);
+        /// Hands packets2send to the radio; false when there is nothing to send
+        bool transmit(TxDoneDelegate &onDone);
+        /// Registers every remote in the device index again, after remotes changed positions
+        void reindex();
+        /// Position tracking and state published for a button, sent by us or heard from the remote itself
+        void applyAction(remote &r, RemoteButton cmd);
+
     protected:
         int8_t target[3];
 
 
         std::vector<remote> remotes;
+        std::atomic<uint32_t> _version{0};
+        mutable std::recursive_mutex _mutex;
 
         std::vector<iohcPacket *> packets2send{};
 
+        iohcFrameTemplates _templates;
+
     };
 }
 #endif
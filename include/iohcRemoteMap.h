@@ -2,6 +2,8 @@
 #define IOHC_REMOTE_MAP_H
 
 #include <iohcPacket.h>
+#include <iohcDeviceIndex.h>
+#include <atomic>
 #include <vector>
 #include <string>
 
@@ -19,19 +21,25 @@ namespace IOHC {
         static iohcRemoteMap* getInstance();
         ~iohcRemoteMap() = default;
 
+        /// Through the shared device index
         const entry* find(const address node) const;
+        entry* find(const address node);
         bool load();
         bool add(const address node, const std::string &name);
         bool linkDevice(const address node, const std::string &device);
         bool unlinkDevice(const address node, const std::string &device);
         bool remove(const address node);
         const std::vector<entry>& getEntries() const;
+        /// Bumped by every load and save, the entries changed
+        uint32_t version() const { return _version.load(); }
 
     private:
         iohcRemoteMap();
         bool save();
+        void reindex();
         static iohcRemoteMap* _instance;
         std::vector<entry> _entries;
+        std::atomic<uint32_t> _version{0};
     };
 }
 
@@ -0,0 +1,161 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_RX_DEDUPE_H
+#define IOHC_RX_DEDUPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <iohcFrame.h>
+
+#ifndef RX_DEDUPE_ENTRIES
+#define RX_DEDUPE_ENTRIES           16      // Frames remembered; the least recently heard one is replaced
+#endif
+#define RX_DEDUPE_1W_WINDOW_MS      1000    // A 1W rolling code is never reused: repeats of a press, every channel
+#define RX_DEDUPE_2W_WINDOW_MS      100     // Shorter than a 2W retry, so a retried request still gets its answer
+
+/*
+    Repeat suppression for received frames, checked in the RX callback task before a frame is decoded, logged and
+    handed to the RX callback. A 1W remote sends each press several times on every channel and the gateway hears
+    most copies; without this each one ran the JSON build, the MQTT publish and handleRemoteAction again.
+    A frame is identified by its source, its command and a token:
+      - 1W authenticated frames: the rolling code, sequence number and the start of the MAC
+      - anything else: a 32-bit FNV-1a hash of the target and the parameters
+    It is a repeat when the same identity was heard less than the window of its protocol ago. Each copy restarts the
+    window, so a held button stays suppressed. Windows can be changed at runtime, 0 turns suppression off.
+    All calls are thread-safe.
+*/
+namespace IOHC {
+    struct RxDedupeStats {
+        uint32_t unique;
+        uint32_t repeats1W;
+        uint32_t repeats2W;
+        uint32_t evicted;       ///< Entries replaced while still inside their window
+    };
+
+    class iohcRxDedupe {
+    public:
+        /// frame as received, length bytes (CRC included or not); true when it repeats a frame heard recently
+        bool isRepeat(const uint8_t *frame, uint8_t length, uint32_t nowMs) {
+            // CtrlByte1.MsgLen is the frame length minus one
+            uint8_t frameLen = length ? (frame[0] & 0x1F) + 1 : 0;
+            if (frameLen < IOHC_FRAME_HEADER_LEN || frameLen > length) return false;
+            const bool oneWay = frame[0] & 0x20;
+            const uint32_t token = tokenFor(frame, frameLen, oneWay);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            const uint32_t window = oneWay ? _window1WMs : _window2WMs;
+            if (!window) {
+                _stats.unique++;
+                return false;
+            }
+            Entry *oldest = &_entries[0];
+            for (auto &entry : _entries) {
+                if (entry.used && entry.token == token && entry.cmd == frame[8] && entry.oneWay == oneWay &&
+                    !memcmp(entry.source, frame + 5, 3)) {
+                    const bool repeat = nowMs - entry.heardMs < window;
+                    entry.heardMs = nowMs;
+                    if (!repeat) {
+                        _stats.unique++;
+                        return false;
+                    }
+                    (oneWay ? _stats.repeats1W : _stats.repeats2W)++;
+                    return true;
+                }
+                // A free entry, else the one heard longest ago
+                if (oldest->used && (!entry.used || nowMs - entry.heardMs > nowMs - oldest->heardMs))
+                    oldest = &entry;
+            }
+            if (oldest->used && nowMs - oldest->heardMs < (oldest->oneWay ? _window1WMs : _window2WMs))
+                _stats.evicted++;
+            oldest->used = true;
+            oldest->oneWay = oneWay;
+            oldest->cmd = frame[8];
+            memcpy(oldest->source, frame + 5, 3);
+            oldest->token = token;
+            oldest->heardMs = nowMs;
+            _stats.unique++;
+            return false;
+        }
+
+        void setWindows(uint32_t window1WMs, uint32_t window2WMs) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _window1WMs = window1WMs;
+            _window2WMs = window2WMs;
+        }
+
+        uint32_t window1WMs() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _window1WMs;
+        }
+
+        uint32_t window2WMs() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _window2WMs;
+        }
+
+        /// Forgets every frame heard: the next copy of anything is unique
+        void clear() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &entry : _entries) entry = Entry();
+        }
+
+        RxDedupeStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats;
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats = {};
+        }
+
+    private:
+        struct Entry {
+            bool used = false;
+            bool oneWay = false;
+            uint8_t cmd = 0;
+            uint8_t source[3] = {};
+            uint32_t token = 0;
+            uint32_t heardMs = 0;
+        };
+
+        static uint32_t tokenFor(const uint8_t *frame, uint8_t frameLen, bool oneWay) {
+            if (oneWay && frameLen >= IOHC_FRAME_HEADER_LEN + IOHC_1W_AUTH_LEN) {
+                const uint8_t *auth = frame + frameLen - IOHC_1W_AUTH_LEN;
+                return static_cast<uint32_t>(auth[0]) << 24 | static_cast<uint32_t>(auth[1]) << 16 |
+                       static_cast<uint32_t>(auth[2]) << 8 | auth[3];
+            }
+            uint32_t hash = 2166136261u;
+            auto mix = [&hash](const uint8_t *bytes, size_t count) {
+                for (size_t i = 0; i < count; i++) hash = (hash ^ bytes[i]) * 16777619u;
+            };
+            mix(frame + 2, 3);
+            mix(frame + IOHC_FRAME_HEADER_LEN, frameLen - IOHC_FRAME_HEADER_LEN);
+            return hash;
+        }
+
+        mutable std::mutex _mutex;
+        Entry _entries[RX_DEDUPE_ENTRIES];
+        uint32_t _window1WMs = RX_DEDUPE_1W_WINDOW_MS;
+        uint32_t _window2WMs = RX_DEDUPE_2W_WINDOW_MS;
+        RxDedupeStats _stats{};
+    };
+}
+
+#endif // IOHC_RX_DEDUPE_H
@@ -0,0 +1,142 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_RX_FILTER_H
+#define IOHC_RX_FILTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#define RX_HEADER_LEN               9       // CtrlByte1, CtrlByte2, target, source, cmd
+#define RX_FILTER_MAX_ADDRESSES     4       // Own addresses: controller, emulated gateways
+
+/*
+    Early verdict on a received frame, taken in the radio task right after the FIFO is read, from the raw header
+    bytes only. Nothing is decoded, allocated or formatted for a frame that is dropped: its pool record is reused.
+      - Keep:   addressed to one of our addresses or broadcast, goes to the RX callbacks
+      - Sniff:  for another controller, only logged and counted in the link statistics
+      - Drop:   discarded in the radio task, only counted here
+    Frames for other controllers get the configured verdict (Sniff or Drop). Frames whose CtrlByte1 length does not
+    cover a complete header, or is longer than what was received, are malformed and always dropped.
+    Promiscuous mode keeps every frame, as before this filter existed.
+    classify() is called from the radio task only; configuration and counters may be used from any task.
+*/
+namespace IOHC {
+    enum class RxVerdict : uint8_t {
+        Keep,
+        Sniff,
+        Drop
+    };
+
+    struct RxFilterStats {
+        uint32_t kept;
+        uint32_t sniffed;
+        uint32_t dropped;       ///< Including malformed frames
+        uint32_t malformed;
+    };
+
+    class iohcRxFilter {
+    public:
+        /// 2W broadcast, or one of the 1W group addresses 00003B..00003F
+        static bool isBroadcast(const uint8_t *target) {
+            if (target[0] == 0xFF && target[1] == 0xFF && target[2] == 0xFF) return true;
+            return target[0] == 0x00 && target[1] == 0x00 && target[2] >= 0x3B && target[2] <= 0x3F;
+        }
+
+        /// Returns false when the table is full. Set up before the radio starts
+        bool addAddress(const uint8_t *address) {
+            uint8_t count = _count.load(std::memory_order_relaxed);
+            for (uint8_t i = 0; i < count; ++i)
+                if (!memcmp(_addresses[i], address, 3)) return true;
+            if (count >= RX_FILTER_MAX_ADDRESSES) return false;
+            memcpy(_addresses[count], address, 3);
+            _count.store(count + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool isOwn(const uint8_t *target) const {
+            uint8_t count = _count.load(std::memory_order_acquire);
+            for (uint8_t i = 0; i < count; ++i)
+                if (!memcmp(_addresses[i], target, 3)) return true;
+            return false;
+        }
+
+        /// Verdict for frames addressed to other controllers: Sniff or Drop
+        void setOthers(RxVerdict verdict) {
+            _others.store(verdict == RxVerdict::Keep ? RxVerdict::Sniff : verdict, std::memory_order_relaxed);
+        }
+        RxVerdict others() const { return _others.load(std::memory_order_relaxed); }
+
+        void setPromiscuous(bool promiscuous) { _promiscuous.store(promiscuous, std::memory_order_relaxed); }
+        bool promiscuous() const { return _promiscuous.load(std::memory_order_relaxed); }
+
+        /// frame as read from the FIFO, length bytes
+        RxVerdict classify(const uint8_t *frame, uint8_t length) {
+            RxVerdict verdict = verdictFor(frame, length);
+            switch (verdict) {
+                case RxVerdict::Keep: count(_kept); break;
+                case RxVerdict::Sniff: count(_sniffed); break;
+                case RxVerdict::Drop: count(_dropped); break;
+            }
+            return verdict;
+        }
+
+        RxFilterStats stats() const {
+            return {_kept.load(std::memory_order_relaxed), _sniffed.load(std::memory_order_relaxed),
+                    _dropped.load(std::memory_order_relaxed), _malformed.load(std::memory_order_relaxed)};
+        }
+
+        void resetStats() {
+            _kept.store(0, std::memory_order_relaxed);
+            _sniffed.store(0, std::memory_order_relaxed);
+            _dropped.store(0, std::memory_order_relaxed);
+            _malformed.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        RxVerdict verdictFor(const uint8_t *frame, uint8_t length) {
+            if (promiscuous()) return RxVerdict::Keep;
+            // CtrlByte1.MsgLen is the frame length minus one, CRC excluded
+            uint8_t frameLen = length ? (frame[0] & 0x1F) + 1 : 0;
+            if (frameLen < RX_HEADER_LEN || frameLen > length) {
+                count(_malformed);
+                return RxVerdict::Drop;
+            }
+            const uint8_t *target = frame + 2;
+            if (isOwn(target) || isBroadcast(target)) return RxVerdict::Keep;
+            return others();
+        }
+
+        // Single writer: no read-modify-write needed
+        static void count(std::atomic<uint32_t> &counter) {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        uint8_t _addresses[RX_FILTER_MAX_ADDRESSES][3]{};
+        std::atomic<uint8_t> _count{0};
+        std::atomic<RxVerdict> _others{RxVerdict::Drop};
+        std::atomic<bool> _promiscuous{false};
+
+        std::atomic<uint32_t> _kept{0};
+        std::atomic<uint32_t> _sniffed{0};
+        std::atomic<uint32_t> _dropped{0};
+        std::atomic<uint32_t> _malformed{0};
+    };
+}
+
+#endif // IOHC_RX_FILTER_H
@@ -0,0 +1,166 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_RX_RING_H
+#define IOHC_RX_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+    Fixed-capacity pool of RX records shared between one producer (the radio task) and one consumer
+    (the RX callback task). Records never move: two lock-free index rings pass ownership around.
+      - ready: producer -> consumer, records holding a received frame
+      - free:  consumer -> producer, records given back after processing
+    No heap is used after construction, and neither side ever blocks.
+    With DropOldest, the producer may also steal the oldest ready record, hence the CAS on readyTail.
+*/
+namespace IOHC {
+    enum class RxOverflowPolicy : uint8_t {
+        DropNewest,     ///< Incoming frame is discarded when every record is in use
+        DropOldest      ///< Oldest frame still waiting for the consumer is recycled
+    };
+
+    struct RxRingStats {
+        uint32_t pushed;        ///< Frames handed to the consumer
+        uint32_t popped;        ///< Frames taken by the consumer
+        uint32_t dropped;       ///< Incoming frames lost (DropNewest)
+        uint32_t overwritten;   ///< Queued frames recycled before being consumed (DropOldest)
+        uint32_t highWater;     ///< Maximum number of frames waiting at once
+    };
+
+    template <typename T, size_t N>
+    class iohcRxRing {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "iohcRxRing capacity must be a power of 2");
+        static_assert(N <= 256, "iohcRxRing record index is stored on 8 bits");
+
+    public:
+        explicit iohcRxRing(RxOverflowPolicy policy = RxOverflowPolicy::DropNewest) : _policy(policy) {
+            for (size_t i = 0; i < N; ++i)
+                _freeSlots[i].store(static_cast<uint8_t>(i), std::memory_order_relaxed);
+            _freeHead.store(N, std::memory_order_release);
+        }
+
+        iohcRxRing(const iohcRxRing &) = delete;
+        iohcRxRing &operator=(const iohcRxRing &) = delete;
+
+        static constexpr size_t capacity() { return N; }
+
+        void setOverflowPolicy(RxOverflowPolicy policy) { _policy.store(policy, std::memory_order_relaxed); }
+        RxOverflowPolicy overflowPolicy() const { return _policy.load(std::memory_order_relaxed); }
+
+        /// Producer: get a record to fill, or nullptr if the frame has to be dropped
+        T *acquire() {
+            uint32_t tail = _freeTail.load(std::memory_order_relaxed);
+            if (tail != _freeHead.load(std::memory_order_acquire)) {
+                uint8_t idx = _freeSlots[tail & MASK].load(std::memory_order_relaxed);
+                _freeTail.store(tail + 1, std::memory_order_release);
+                return &_records[idx];
+            }
+            if (overflowPolicy() == RxOverflowPolicy::DropOldest) {
+                uint8_t idx;
+                if (claimReady(idx)) {
+                    _overwritten.fetch_add(1, std::memory_order_relaxed);
+                    return &_records[idx];
+                }
+            }
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        /// Producer: publish a record obtained from acquire()
+        void commit(T *record) {
+            uint32_t head = _readyHead.load(std::memory_order_relaxed);
+            _readySlots[head & MASK].store(indexOf(record), std::memory_order_relaxed);
+            _readyHead.store(head + 1, std::memory_order_release);
+            _pushed.fetch_add(1, std::memory_order_relaxed);
+
+            uint32_t depth = head + 1 - _readyTail.load(std::memory_order_relaxed);
+            if (depth > _highWater.load(std::memory_order_relaxed))
+                _highWater.store(depth, std::memory_order_relaxed);
+        }
+
+        /// Consumer: oldest ready record, or nullptr when empty. Give it back with release()
+        T *pop() {
+            uint8_t idx;
+            if (!claimReady(idx)) return nullptr;
+            _popped.fetch_add(1, std::memory_order_relaxed);
+            return &_records[idx];
+        }
+
+        /// Consumer: return a record obtained from pop() to the pool
+        void release(T *record) {
+            uint32_t head = _freeHead.load(std::memory_order_relaxed);
+            _freeSlots[head & MASK].store(indexOf(record), std::memory_order_relaxed);
+            _freeHead.store(head + 1, std::memory_order_release);
+        }
+
+        size_t depth() const {
+            return _readyHead.load(std::memory_order_acquire) - _readyTail.load(std::memory_order_acquire);
+        }
+
+        RxRingStats stats() const {
+            return {_pushed.load(std::memory_order_relaxed), _popped.load(std::memory_order_relaxed),
+                    _dropped.load(std::memory_order_relaxed), _overwritten.load(std::memory_order_relaxed),
+                    _highWater.load(std::memory_order_relaxed)};
+        }
+
+        void resetStats() {
+            _pushed.store(0, std::memory_order_relaxed);
+            _popped.store(0, std::memory_order_relaxed);
+            _dropped.store(0, std::memory_order_relaxed);
+            _overwritten.store(0, std::memory_order_relaxed);
+            _highWater.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr uint32_t MASK = N - 1;
+
+        uint8_t indexOf(const T *record) const { return static_cast<uint8_t>(record - _records); }
+
+        // Take the oldest ready index; safe against the other side doing the same
+        bool claimReady(uint8_t &idx) {
+            uint32_t tail = _readyTail.load(std::memory_order_acquire);
+            do {
+                if (tail == _readyHead.load(std::memory_order_acquire)) return false;
+                idx = _readySlots[tail & MASK].load(std::memory_order_relaxed);
+            } while (!_readyTail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel,
+                                                       std::memory_order_acquire));
+            return true;
+        }
+
+        T _records[N]{};
+
+        std::atomic<uint8_t> _readySlots[N]{};
+        std::atomic<uint32_t> _readyHead{0};
+        std::atomic<uint32_t> _readyTail{0};
+
+        std::atomic<uint8_t> _freeSlots[N]{};
+        std::atomic<uint32_t> _freeHead{0};
+        std::atomic<uint32_t> _freeTail{0};
+
+        std::atomic<RxOverflowPolicy> _policy;
+
+        std::atomic<uint32_t> _pushed{0};
+        std::atomic<uint32_t> _popped{0};
+        std::atomic<uint32_t> _dropped{0};
+        std::atomic<uint32_t> _overwritten{0};
+        std::atomic<uint32_t> _highWater{0};
+    };
+}
+
+#endif // IOHC_RX_RING_H
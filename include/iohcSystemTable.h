@@ -17,9 +17,10 @@
 #ifndef IOHC_SYSTEMTABLE_H
 #define IOHC_SYSTEMTABLE_H
 
-#include <map>
 #include <string>
+#include <vector>
 #include <iohcObject.h>
+#include <iohcDeviceIndex.h>
 
 #define IOHC_SYS_TABLE  "/sysTable.json"
 
@@ -32,7 +33,7 @@
 namespace IOHC {
     class iohcSystemTable {
         public:
-            using Objects = std::map<std::string, iohcObject *>;
+            using Objects = std::vector<iohcObject *>;     ///< Slots of the shared device index
 
             static iohcSystemTable *getInstance();
             virtual ~iohcSystemTable() = default;
@@ -40,6 +41,7 @@ namespace IOHC {
             bool addObject(address node, address backbone, uint8_t actuator[2], uint8_t manufacturer, uint8_t flags);
             bool addObject(iohcObject *obj);
             bool addObject(std::string key, std::string serialized);
+            iohcObject *find(const address node);
 
             bool empty();
             uint8_t size();
@@ -53,6 +55,7 @@ namespace IOHC {
         private:
             iohcSystemTable();
             bool load();
+            bool insert(const uint8_t *node, iohcObject *obj);
             bool changed = false;
 
             static iohcSystemTable *_iohcSystemTable;
@@ -0,0 +1,182 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_TOPIC_ROUTER_H
+#define IOHC_TOPIC_ROUTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define TOPIC_ROUTER_MAX_PARAMS     4       // Captures per topic: one per + and one for a trailing #
+
+/*
+    MQTT topic router: filters are compiled once into a trie of topic levels, an incoming topic walks it in a single
+    pass and comes out with its handler and the levels matched by the wildcards.
+      - "+" matches exactly one level, "#" the remaining levels (and the parent level itself), as in MQTT
+      - a literal level is preferred over "+", "+" over "#"; a dead end backtracks to the next candidate
+      - topics starting with '$' are not matched by a wildcard in the first level
+    Captures point into the topic given to match(), which must outlive them. Matching does not allocate.
+    Built before use and read-only afterwards, so concurrent match() calls are safe.
+*/
+namespace IOHC {
+    struct TopicParam {
+        const char *data;
+        size_t length;
+
+        std::string str() const { return std::string(data, length); }
+        bool operator==(const char *literal) const {
+            return strlen(literal) == length && !memcmp(data, literal, length);
+        }
+    };
+
+    template <typename Handler>
+    class iohcTopicRouter {
+    public:
+        struct Match {
+            Handler handler;
+            uint8_t count;                              ///< Captures in params, in topic order
+            TopicParam params[TOPIC_ROUTER_MAX_PARAMS];
+        };
+
+        iohcTopicRouter() { _nodes.emplace_back(); }
+
+        /// false when the filter is invalid (wildcard mixed with text, "#" not last, too many wildcards) or taken
+        bool add(const char *filter, Handler handler) {
+            const char *end = filter + strlen(filter);
+            if (filter == end) return false;
+            uint32_t node = 0;
+            uint8_t wildcards = 0;
+            for (const char *level = filter;;) {
+                const char *levelEnd = static_cast<const char *>(memchr(level, '/', end - level));
+                if (!levelEnd) levelEnd = end;
+                const size_t length = levelEnd - level;
+                const bool plus = length == 1 && *level == '+';
+                const bool hash = length == 1 && *level == '#';
+                if (!plus && !hash && (memchr(level, '+', length) || memchr(level, '#', length))) return false;
+                if ((plus || hash) && ++wildcards > TOPIC_ROUTER_MAX_PARAMS) return false;
+                if (hash) {
+                    if (levelEnd != end || _nodes[node].hasHash) return false;
+                    _nodes[node].hasHash = true;
+                    _nodes[node].hashHandler = handler;
+                    _routes++;
+                    return true;
+                }
+                node = plus ? plusChild(node) : literalChild(node, level, length);
+                if (levelEnd == end) break;
+                level = levelEnd + 1;
+            }
+            if (_nodes[node].terminal) return false;
+            _nodes[node].terminal = true;
+            _nodes[node].handler = handler;
+            _routes++;
+            return true;
+        }
+
+        bool match(const char *topic, size_t length, Match &out) const {
+            out.count = 0;
+            if (!length) return false;
+            return matchLevel(0, topic, topic + length, false, true, out);
+        }
+
+        bool match(const std::string &topic, Match &out) const {
+            return match(topic.data(), topic.size(), out);
+        }
+
+        size_t routes() const { return _routes; }
+        size_t nodes() const { return _nodes.size(); }
+
+    private:
+        struct Node {
+            std::string level;                  ///< Literal text of the level leading here
+            std::vector<uint32_t> children;     ///< Literal children
+            int32_t plus = -1;                  ///< "+" child
+            bool terminal = false;
+            bool hasHash = false;
+            Handler handler{};
+            Handler hashHandler{};
+        };
+
+        uint32_t literalChild(uint32_t node, const char *level, size_t length) {
+            for (uint32_t child : _nodes[node].children) {
+                const std::string &text = _nodes[child].level;
+                if (text.size() == length && !memcmp(text.data(), level, length)) return child;
+            }
+            const uint32_t child = _nodes.size();
+            _nodes.emplace_back();
+            _nodes[child].level.assign(level, length);
+            _nodes[node].children.push_back(child);
+            return child;
+        }
+
+        uint32_t plusChild(uint32_t node) {
+            if (_nodes[node].plus < 0) {
+                _nodes[node].plus = static_cast<int32_t>(_nodes.size());
+                _nodes.emplace_back();
+            }
+            return _nodes[node].plus;
+        }
+
+        /// level starts the next topic level; done once the last level was consumed
+        bool matchLevel(uint32_t index, const char *level, const char *end, bool done, bool first, Match &out) const {
+            const Node &node = _nodes[index];
+            if (done) {
+                if (node.terminal) {
+                    out.handler = node.handler;
+                    return true;
+                }
+                // "a/#" also matches "a"
+                if (node.hasHash && out.count < TOPIC_ROUTER_MAX_PARAMS) {
+                    out.params[out.count++] = {end, 0};
+                    out.handler = node.hashHandler;
+                    return true;
+                }
+                return false;
+            }
+            const char *levelEnd = static_cast<const char *>(memchr(level, '/', end - level));
+            const bool last = !levelEnd;
+            if (last) levelEnd = end;
+            const char *next = last ? end : levelEnd + 1;
+            const size_t length = levelEnd - level;
+
+            for (uint32_t child : node.children) {
+                const std::string &text = _nodes[child].level;
+                if (text.size() == length && !memcmp(text.data(), level, length) &&
+                    matchLevel(child, next, end, last, false, out))
+                    return true;
+            }
+            if (first && length && *level == '$') return false;
+            if (node.plus >= 0 && out.count < TOPIC_ROUTER_MAX_PARAMS) {
+                out.params[out.count++] = {level, length};
+                if (matchLevel(node.plus, next, end, last, false, out)) return true;
+                out.count--;
+            }
+            if (node.hasHash && out.count < TOPIC_ROUTER_MAX_PARAMS) {
+                out.params[out.count++] = {level, static_cast<size_t>(end - level)};
+                out.handler = node.hashHandler;
+                return true;
+            }
+            return false;
+        }
+
+        std::vector<Node> _nodes;   ///< Root first
+        size_t _routes = 0;
+    };
+}
+
+#endif // IOHC_TOPIC_ROUTER_H
@@ -0,0 +1,320 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_TX_QUEUE_H
+#define IOHC_TX_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <Delegate.h>
+
+#ifndef IOHC_TX_QUEUE_DEPTH
+#define IOHC_TX_QUEUE_DEPTH     32      // Batches waiting for the radio, all priorities together
+#endif
+
+/*
+    Thread-safe queue of TX batches in front of the radio. Any task may push; the radio pops when it is free.
+    Highest priority first, FIFO inside a priority. A batch whose deadline has passed is never sent:
+    pop() hands it to the onExpired callback instead. Counters are kept per source.
+    A batch may carry a start time (iohcPacket::delayed, or an absolute time): it stays queued until then and
+    batches ready earlier go ahead of it, unless their estimated duration would make it start late.
+    Every batch ends with a report: sent (complete() once off air), expired (in pop()) or aborted (complete()
+    for a batch that never made it to the radio). drainCompleted() runs the batch callbacks and hands the packets
+    back to their owner, outside of any lock so that a callback may queue the next batch.
+*/
+namespace IOHC {
+    enum class TxPriority : uint8_t {
+        Urgent,         ///< Time-critical answers: challenge replies, acknowledgements
+        Normal,         ///< User commands
+        Background,     ///< Discovery and scan bursts
+        Count
+    };
+
+    enum class TxSource : uint8_t {
+        Other,
+        Remote1W,
+        Device2W,
+        Response2W,
+        Pairing,
+        Discovery,
+        Count
+    };
+
+    inline const char *txSourceToString(TxSource source) {
+        switch (source) {
+            case TxSource::Remote1W: return "remote1W";
+            case TxSource::Device2W: return "device2W";
+            case TxSource::Response2W: return "response2W";
+            case TxSource::Pairing: return "pairing";
+            case TxSource::Discovery: return "discovery";
+            default: return "other";
+        }
+    }
+
+    enum class TxStatus : uint8_t {
+        Sent,           ///< Every frame went on air
+        Expired,        ///< Deadline passed while queued
+        Aborted         ///< Never queued or dropped before reaching the radio
+    };
+
+    inline const char *txStatusToString(TxStatus status) {
+        switch (status) {
+            case TxStatus::Sent: return "sent";
+            case TxStatus::Expired: return "expired";
+            default: return "aborted";
+        }
+    }
+
+    struct TxReport {
+        TxStatus status;
+        TxSource source;
+        uint8_t frames;         ///< Packets in the batch
+        uint64_t queuedUs;
+        uint64_t startedUs;     ///< First frame on air, 0: never sent
+        uint64_t doneUs;
+    };
+
+    using TxDoneDelegate = Delegate<void(const TxReport &report)>;
+
+    struct TxSourceStats {
+        uint32_t queued;        ///< Batches accepted
+        uint32_t sent;          ///< Batches handed to the radio
+        uint32_t expired;       ///< Deadline passed while waiting
+        uint32_t rejected;      ///< Queue full
+        uint32_t depth;         ///< Batches waiting now
+        uint32_t maxDepth;
+        uint64_t totalWaitUs;   ///< Queue time of the sent batches, counted from their start time if any
+        uint32_t maxWaitUs;
+        uint32_t scheduled;         ///< Sent batches that had a start time
+        uint64_t totalStartErrorUs; ///< Actual minus requested start time
+        uint32_t maxStartErrorUs;
+        uint32_t aborted;           ///< Reported aborted, queue full included
+    };
+
+    template <typename Packet>
+    struct TxBatch {
+        std::vector<Packet *> packets;
+        TxPriority priority = TxPriority::Normal;
+        TxSource source = TxSource::Other;
+        uint64_t queuedUs = 0;
+        uint64_t deadlineUs = 0;    ///< 0: no deadline
+        uint64_t startUs = 0;       ///< Not sent before this time, 0: as soon as possible
+        uint32_t durationUs = 0;    ///< Expected time the radio is busy with the batch, 0: unknown
+        uint64_t startedUs = 0;     ///< Set by whoever puts it on air
+        TxDoneDelegate onDone = nullptr;
+    };
+
+    template <typename Packet>
+    class iohcTxQueue {
+    public:
+        /// Takes the packets out of the vector. Returns false (packets left in place) if the queue is full
+        bool push(std::vector<Packet *> &packets, TxPriority priority, TxSource source, uint64_t nowUs,
+                  uint64_t deadlineUs = 0, uint64_t startUs = 0, uint32_t durationUs = 0,
+                  TxDoneDelegate onDone = nullptr) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            TxSourceStats &stats = _stats[index(source)];
+            if (_size >= IOHC_TX_QUEUE_DEPTH) {
+                stats.rejected++;
+                return false;
+            }
+            TxBatch<Packet> batch;
+            batch.packets = std::move(packets);
+            packets.clear();
+            batch.priority = priority;
+            batch.source = source;
+            batch.queuedUs = nowUs;
+            batch.deadlineUs = deadlineUs;
+            batch.startUs = startUs > nowUs ? startUs : 0;
+            batch.durationUs = durationUs;
+            batch.onDone = std::move(onDone);
+            _queues[index(priority)].push_back(std::move(batch));
+            _size++;
+            stats.queued++;
+            if (++stats.depth > stats.maxDepth) stats.maxDepth = stats.depth;
+            return true;
+        }
+
+        /// Next batch to send now, dropping expired ones. onExpired(TxBatch&) is called outside of the lock, the
+        /// expired batches then wait for drainCompleted()
+        template <typename OnExpired>
+        bool pop(TxBatch<Packet> &out, uint64_t nowUs, OnExpired onExpired) {
+            std::vector<TxBatch<Packet>> expired;
+            bool found;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                dropExpired(nowUs, expired);
+                found = take(out, nowUs);
+            }
+            for (auto &batch : expired) {
+                onExpired(batch);
+                finish(std::move(batch), TxStatus::Expired, nowUs);
+            }
+            return found;
+        }
+
+        bool pop(TxBatch<Packet> &out, uint64_t nowUs) {
+            return pop(out, nowUs, [](TxBatch<Packet> &) {});
+        }
+
+        /// Batch off air (Sent), or refused before reaching the radio (Aborted). Its report waits for drainCompleted()
+        void complete(TxBatch<Packet> &&batch, TxStatus status, uint64_t nowUs) {
+            if (status == TxStatus::Aborted) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stats[index(batch.source)].aborted++;
+            }
+            finish(std::move(batch), status, nowUs);
+        }
+
+        /// Runs the callbacks of the finished batches, then gives their packets to dispose(Packet *).
+        /// Call with no lock held: a callback may push. Returns the number of batches reported
+        template <typename Dispose>
+        size_t drainCompleted(Dispose dispose) {
+            std::vector<Finished> finished;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_finished.empty()) return 0;
+                finished.swap(_finished);
+            }
+            for (auto &done : finished) {
+                if (done.onDone) done.onDone(done.report);
+                for (Packet *packet : done.packets) dispose(packet);
+            }
+            return finished.size();
+        }
+
+        /// Batches waiting for drainCompleted()
+        size_t completed() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _finished.size();
+        }
+
+        /// Earliest start time still in the future, 0 if none: when pop() may have something new to return
+        uint64_t nextStartUs(uint64_t nowUs) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return nextStart(nowUs, TxPriority::Background);
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _size;
+        }
+
+        TxSourceStats stats(TxSource source) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats[index(source)];
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &stats : _stats) {
+                uint32_t depth = stats.depth;
+                stats = {};
+                stats.depth = depth;
+            }
+        }
+
+    private:
+        struct Finished {
+            TxReport report;
+            TxDoneDelegate onDone;
+            std::vector<Packet *> packets;
+        };
+
+        template <typename E>
+        static constexpr size_t index(E e) { return static_cast<size_t>(e); }
+
+        void finish(TxBatch<Packet> &&batch, TxStatus status, uint64_t nowUs) {
+            Finished done;
+            done.report = {status, batch.source, static_cast<uint8_t>(batch.packets.size()), batch.queuedUs,
+                           status == TxStatus::Sent ? batch.startedUs : 0, nowUs};
+            done.onDone = std::move(batch.onDone);
+            done.packets = std::move(batch.packets);
+            std::lock_guard<std::mutex> lock(_mutex);
+            _finished.push_back(std::move(done));
+        }
+
+        void dropExpired(uint64_t nowUs, std::vector<TxBatch<Packet>> &expired) {
+            for (auto &queue : _queues)
+                for (auto it = queue.begin(); it != queue.end();) {
+                    if (!it->deadlineUs || nowUs <= it->deadlineUs) {
+                        ++it;
+                        continue;
+                    }
+                    TxSourceStats &stats = _stats[index(it->source)];
+                    stats.depth--;
+                    stats.expired++;
+                    expired.push_back(std::move(*it));
+                    it = queue.erase(it);
+                    _size--;
+                }
+        }
+
+        // Earliest future start among the batches of this priority or higher
+        uint64_t nextStart(uint64_t nowUs, TxPriority lowest) const {
+            uint64_t next = 0;
+            for (size_t p = 0; p <= index(lowest); ++p)
+                for (const auto &batch : _queues[p])
+                    if (batch.startUs > nowUs && (!next || batch.startUs < next))
+                        next = batch.startUs;
+            return next;
+        }
+
+        // First batch due in the highest priority that has one, provided it ends before a scheduled batch
+        // of the same or higher priority has to start
+        bool take(TxBatch<Packet> &out, uint64_t nowUs) {
+            for (size_t p = 0; p < index(TxPriority::Count); ++p) {
+                auto &queue = _queues[p];
+                auto it = queue.begin();
+                while (it != queue.end() && it->startUs > nowUs) ++it;
+                if (it == queue.end()) continue;
+                uint64_t next = nextStart(nowUs, static_cast<TxPriority>(p));
+                if (next && it->durationUs && nowUs + it->durationUs > next) continue;
+
+                out = std::move(*it);
+                queue.erase(it);
+                _size--;
+                TxSourceStats &stats = _stats[index(out.source)];
+                stats.depth--;
+                stats.sent++;
+                uint64_t from = out.queuedUs;
+                if (out.startUs) {
+                    uint32_t error = static_cast<uint32_t>(nowUs - out.startUs);
+                    stats.scheduled++;
+                    stats.totalStartErrorUs += error;
+                    if (error > stats.maxStartErrorUs) stats.maxStartErrorUs = error;
+                    from = out.startUs;
+                }
+                uint32_t wait = static_cast<uint32_t>(nowUs - from);
+                stats.totalWaitUs += wait;
+                if (wait > stats.maxWaitUs) stats.maxWaitUs = wait;
+                return true;
+            }
+            return false;
+        }
+
+        mutable std::mutex _mutex;
+        std::deque<TxBatch<Packet>> _queues[static_cast<size_t>(TxPriority::Count)];
+        size_t _size = 0;
+        TxSourceStats _stats[static_cast<size_t>(TxSource::Count)]{};
+        std::vector<Finished> _finished;
+    };
+}
+
+#endif // IOHC_TX_QUEUE_H
@@ -0,0 +1,180 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_TX_SEQUENCER_H
+#define IOHC_TX_SEQUENCER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define IOHC_BITRATE                38400   // bit/s, FSK
+#define TX_WATCHDOG_MARGIN_US       20000   // PacketSent considered lost this long after the expected end of frame
+
+/*
+    Event-driven TX state machine: each PacketSent schedules the next transmission exactly gapUs after the end
+    of the previous one, instead of a periodic ticker polling for TXDONE.
+      Idle -> Transmitting -> (PacketSent) -> Gap -> (timer) -> Transmitting ... -> (last PacketSent) -> Idle
+    While Transmitting, the timer acts as a watchdog in case the PacketSent interrupt is missed.
+    All hardware access goes through Driver, so the sequence runs unchanged against a simulated radio:
+      TxSlot slot(size_t frame, bool first)     repeat count, gaps and expected airtime of a frame, of its very
+                                                first transmission of the batch when first is set
+      void transmit(size_t frame, bool first)   load the FIFO and start TX; first is the very first frame of the batch
+      void arm(uint32_t delayUs)                one-shot timer calling onTimer(), replaces any pending one
+      void listen()                             radio idle between two frames
+      void finish()                             batch done, back to RX
+    Callers serialize onPacketSent()/onTimer()/start(); the sequencer itself does not lock.
+*/
+namespace IOHC {
+    /// Time on air of one frame: preamble bytes, 3 sync bytes, payload and CRC; io-homecontrol adds start/stop bits to each data byte
+    constexpr uint32_t iohcAirtimeUs(uint16_t preambleLen, uint8_t frameLen) {
+        return static_cast<uint32_t>((preambleLen * 8ULL + (3 + frameLen + 2) * 10ULL) * 1000000ULL / IOHC_BITRATE);
+    }
+
+    struct TxSlot {
+        uint8_t repeat;         ///< Extra transmissions after the first one
+        uint32_t gapUs;         ///< Silence between the end of a transmission and the start of the next
+        uint32_t airtimeUs;     ///< Expected duration of one transmission, for the watchdog
+        uint32_t leadUs;        ///< Minimum silence before the first transmission of this frame (not frame 0)
+    };
+
+    struct TxSeqStats {
+        uint32_t batches;       ///< start() calls accepted
+        uint32_t frames;        ///< Transmissions started
+        uint32_t timeouts;      ///< PacketSent never came, the watchdog moved on
+        uint32_t gaps;          ///< Inter-frame gaps measured
+        uint32_t minGapUs;
+        uint32_t maxGapUs;
+        uint64_t totalGapUs;
+        uint32_t maxLateUs;     ///< Worst achieved gap minus requested gap
+    };
+
+    template <typename Driver>
+    class iohcTxSequencer {
+    public:
+        explicit iohcTxSequencer(Driver &driver) : _driver(driver) { resetStats(); }
+
+        bool busy() const { return _state != State::Idle; }
+        size_t frame() const { return _frame; }
+
+        /// Send frames [0, count). Returns false if a batch is already running
+        bool start(size_t count, uint64_t nowUs) {
+            if (busy() || count == 0) return false;
+            _count = count;
+            _frame = 0;
+            _sent = 0;
+            _stats.batches++;
+            transmit(nowUs, true);
+            return true;
+        }
+
+        /// End of the current transmission, from the DIO0 PacketSent interrupt; endUs is the time stamp taken in the ISR
+        void onPacketSent(uint64_t endUs, uint64_t nowUs) {
+            if (_state != State::Transmitting) return;
+            _lastEndUs = endUs;
+            next(nowUs);
+        }
+
+        /// Timer armed through Driver::arm(). Late callbacks of a replaced timer are ignored
+        void onTimer(uint64_t nowUs) {
+            if (_state == State::Idle || nowUs < _dueUs) return;
+            if (_state == State::Transmitting) {
+                // Missed PacketSent: assume the frame ended when it should have
+                _stats.timeouts++;
+                _lastEndUs = _startUs + _airtimeUs;
+                next(nowUs);
+                return;
+            }
+            transmit(nowUs, false);
+        }
+
+        /// Drop the rest of the batch
+        void abort() {
+            if (!busy()) return;
+            _state = State::Idle;
+            _driver.finish();
+        }
+
+        const TxSeqStats &stats() const { return _stats; }
+        void resetStats() {
+            _stats = {};
+            _stats.minGapUs = UINT32_MAX;
+        }
+
+    private:
+        enum class State : uint8_t { Idle, Transmitting, Gap };
+
+        void transmit(uint64_t nowUs, bool first) {
+            TxSlot slot = _driver.slot(_frame, first);
+            if (!first) {
+                uint32_t gap = static_cast<uint32_t>(nowUs - _lastEndUs);
+                _stats.gaps++;
+                _stats.totalGapUs += gap;
+                if (gap < _stats.minGapUs) _stats.minGapUs = gap;
+                if (gap > _stats.maxGapUs) _stats.maxGapUs = gap;
+                if (gap > _gapUs && gap - _gapUs > _stats.maxLateUs) _stats.maxLateUs = gap - _gapUs;
+            }
+            _state = State::Transmitting;
+            _startUs = nowUs;
+            _airtimeUs = slot.airtimeUs;
+            _stats.frames++;
+            _driver.transmit(_frame, first);
+            arm(nowUs, slot.airtimeUs + TX_WATCHDOG_MARGIN_US);
+        }
+
+        void next(uint64_t nowUs) {
+            TxSlot slot = _driver.slot(_frame, false);
+            _gapUs = slot.gapUs;
+            if (++_sent > slot.repeat) {
+                _sent = 0;
+                if (++_frame >= _count) {
+                    _state = State::Idle;
+                    _driver.finish();
+                    return;
+                }
+                uint32_t lead = _driver.slot(_frame, false).leadUs;
+                if (lead > _gapUs) _gapUs = lead;
+            }
+            // Measured from the end of frame, not from now: absorbs the interrupt and task latency
+            uint64_t due = _lastEndUs + _gapUs;
+            if (due <= nowUs) {
+                transmit(nowUs, false);
+                return;
+            }
+            _state = State::Gap;
+            _driver.listen();
+            arm(nowUs, static_cast<uint32_t>(due - nowUs));
+        }
+
+        void arm(uint64_t nowUs, uint32_t delayUs) {
+            _dueUs = nowUs + delayUs;
+            _driver.arm(delayUs);
+        }
+
+        Driver &_driver;
+        State _state = State::Idle;
+        size_t _count = 0;
+        size_t _frame = 0;
+        uint16_t _sent = 0;
+        uint32_t _gapUs = 0;
+        uint32_t _airtimeUs = 0;
+        uint64_t _startUs = 0;
+        uint64_t _lastEndUs = 0;
+        uint64_t _dueUs = 0;
+        TxSeqStats _stats{};
+    };
+}
+
+#endif // IOHC_TX_SEQUENCER_H
@@ -0,0 +1,216 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_WAKE_TRACKER_H
+#define IOHC_WAKE_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <iohcTxSequencer.h>
+
+#define LONG_PREAMBLE_MS        1920    // Preamble length (bytes) waking up a device in low power mode
+#define SHORT_PREAMBLE_MS       40      // Preamble length (bytes) for a device already listening
+#ifndef WAKE_MAX_DEVICES
+#define WAKE_MAX_DEVICES        32      // Least recently heard device is replaced when full
+#endif
+#ifndef WAKE_AWAKE_WINDOW_US
+#define WAKE_AWAKE_WINDOW_US    1000000 // A device keeps listening this long after its last frame
+#endif
+#define WAKE_REPLY_TIMEOUT_US   250000  // No frame from the target this long after a short preamble: missed
+#define WAKE_LPM_FLAG           0x20    // CtrlByte2.LPM
+
+/*
+    Per-device wake state, to pick the shortest preamble a device will hear.
+    Fed by every frame received from a device (it is listening right after talking, and CtrlByte2.LPM tells it
+    sleeps in between) and by the power save mode announced in the discovery answer (DeviceCapabilities).
+    For the first frame of a unicast batch:
+      - heard within WAKE_AWAKE_WINDOW_US, or always listening (no power save): short preamble
+      - known to sleep and not heard recently: long preamble
+      - unknown: what the caller asked for
+    A short preamble that got no answer within WAKE_REPLY_TIMEOUT_US is a miss, noticed on the next frame to that
+    device: it gets the long preamble until it is heard again.
+*/
+namespace IOHC {
+    enum class WakePower : uint8_t {
+        Unknown,
+        AlwaysOn,       ///< Power save mode off, the receiver is always on
+        LowPower        ///< Sleeps between exchanges, needs the long preamble to wake up
+    };
+
+    /// DeviceCapabilities::multiInfo bits 1-0: 0 = always alive
+    inline WakePower wakePowerFromMultiInfo(uint8_t multiInfo) {
+        return (multiInfo & 0x03) ? WakePower::LowPower : WakePower::AlwaysOn;
+    }
+
+    struct WakeStats {
+        uint32_t shortPreambles;
+        uint32_t longPreambles;
+        uint32_t shortened;     ///< Long asked, short used
+        uint32_t lengthened;    ///< Short asked, long used
+        uint32_t misses;        ///< Short preamble without answer
+        uint32_t evicted;
+        uint64_t savedUs;       ///< Airtime not spent on long preambles
+        uint64_t spentUs;       ///< Airtime added by lengthened preambles
+    };
+
+    class iohcWakeTracker {
+    public:
+        /// Airtime difference between the long and the short preamble
+        static constexpr uint32_t longExtraUs() {
+            return iohcAirtimeUs(LONG_PREAMBLE_MS, 0) - iohcAirtimeUs(SHORT_PREAMBLE_MS, 0);
+        }
+
+        void setPower(const uint8_t *address, WakePower power) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            entry(address).power = power;
+        }
+
+        /// Any frame received from source
+        void onReceived(const uint8_t *source, uint8_t ctrlByte2, uint64_t nowUs) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Device &device = entry(source);
+            device.heardUs = nowUs ? nowUs : 1;
+            device.pendingUs = 0;
+            device.fallback = false;
+            if ((ctrlByte2 & WAKE_LPM_FLAG) && device.power == WakePower::Unknown)
+                device.power = WakePower::LowPower;
+        }
+
+        /// Preamble of the first frame sent to target now; expectsReply arms the miss detection
+        bool shortPreamble(const uint8_t *target, bool requestedShort, bool expectsReply, uint64_t nowUs) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Device *device = find(target);
+            if (device && device->pendingUs && nowUs - device->pendingUs > WAKE_REPLY_TIMEOUT_US) {
+                device->pendingUs = 0;
+                device->fallback = true;
+                _stats.misses++;
+            }
+
+            bool useShort = pick(device, requestedShort, nowUs);
+
+            if (useShort) {
+                _stats.shortPreambles++;
+                if (!requestedShort) {
+                    _stats.shortened++;
+                    _stats.savedUs += longExtraUs();
+                }
+                if (expectsReply) {
+                    if (!device) device = &entry(target);
+                    device->pendingUs = nowUs ? nowUs : 1;
+                }
+            } else {
+                _stats.longPreambles++;
+                if (requestedShort) {
+                    _stats.lengthened++;
+                    _stats.spentUs += longExtraUs();
+                }
+                if (device) device->pendingUs = 0;
+            }
+            return useShort;
+        }
+
+        /// What shortPreamble() would pick now, counting and arming nothing: airtime estimate of a queued batch
+        bool expectsShort(const uint8_t *target, bool requestedShort, uint64_t nowUs) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto &device : _devices)
+                if (device.used && !memcmp(device.address, target, 3)) return pick(&device, requestedShort, nowUs);
+            return requestedShort;
+        }
+
+        WakePower power(const uint8_t *address) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto &device : _devices)
+                if (device.used && !memcmp(device.address, address, 3)) return device.power;
+            return WakePower::Unknown;
+        }
+
+        size_t devices() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            size_t count = 0;
+            for (const auto &device : _devices)
+                if (device.used) count++;
+            return count;
+        }
+
+        WakeStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _stats;
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats = {};
+        }
+
+    private:
+        struct Device {
+            uint8_t address[3];
+            bool used;
+            bool fallback;          ///< Missed a short preamble, long until heard again
+            WakePower power;
+            uint32_t lastUse;       ///< Use counter value, for replacement
+            uint64_t heardUs;       ///< Last frame received, 0: never
+            uint64_t pendingUs;     ///< Short preamble sent and answer awaited, 0: none
+        };
+
+        /// A short preamble still unanswered past WAKE_REPLY_TIMEOUT_US counts as missed
+        static bool pick(const Device *device, bool requestedShort, uint64_t nowUs) {
+            if (!device) return requestedShort;
+            if (device->fallback || (device->pendingUs && nowUs - device->pendingUs > WAKE_REPLY_TIMEOUT_US))
+                return false;
+            bool awake = device->heardUs && nowUs - device->heardUs < WAKE_AWAKE_WINDOW_US;
+            if (awake || device->power == WakePower::AlwaysOn) return true;
+            if (device->power == WakePower::LowPower) return false;
+            return requestedShort;
+        }
+
+        Device *find(const uint8_t *address) {
+            for (auto &device : _devices)
+                if (device.used && !memcmp(device.address, address, 3)) {
+                    device.lastUse = ++_uses;
+                    return &device;
+                }
+            return nullptr;
+        }
+
+        Device &entry(const uint8_t *address) {
+            if (Device *device = find(address)) return *device;
+            Device *oldest = &_devices[0];
+            for (auto &device : _devices) {
+                if (!device.used) {
+                    oldest = &device;
+                    break;
+                }
+                if (device.lastUse < oldest->lastUse) oldest = &device;
+            }
+            if (oldest->used) _stats.evicted++;
+            *oldest = {};
+            memcpy(oldest->address, address, 3);
+            oldest->used = true;
+            oldest->lastUse = ++_uses;
+            return *oldest;
+        }
+
+        mutable std::mutex _mutex;
+        Device _devices[WAKE_MAX_DEVICES]{};
+        uint32_t _uses = 0;
+        WakeStats _stats{};
+    };
+}
+
+#endif // IOHC_WAKE_TRACKER_H
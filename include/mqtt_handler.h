@@ -10,13 +10,32 @@
 
 #include <AsyncMqttClient.h>
 #include <ArduinoJson.h>
+#include <iohcMqttQueue.h>
+#include <iohcDiscoveryCache.h>
+#include <iohcCommandQueue.h>
+
+#define MQTT_QUEUE_BATCH        8       // Publishes before the publisher task yields to the TCP task
+#define MQTT_PUBLISH_RETRY_MS   20      // Wait after a publish refused by the client, or while congested
+#define DISCOVERY_PROBE_MS      500     // Wait for the retained frame sensor config telling the broker kept discovery
+#define MQTT_DISCOVERY_WAIT     pdMS_TO_TICKS(2000)    // Longest wait for room before each device's discovery
+#define MQTT_DRAIN_WAIT         pdMS_TO_TICKS(10000)   // Longest wait for the discovery pass to reach the broker
 
 extern AsyncMqttClient mqttClient;
 extern TimerHandle_t mqttReconnectTimer;
 extern TimerHandle_t heartbeatTimer;
+extern IOHC::iohcMqttQueue mqttQueue;
+extern IOHC::iohcDiscoveryCache discoveryCache;
 extern const char AVAILABILITY_TOPIC[];
 
 void initMqtt();
+/// Queues a message for the publisher task, with the policy of its topic; false when dropped.
+/// published runs on the publisher task once the client accepted the message
+bool mqttPublish(const char *topic, const char *payload, size_t length,
+                 IOHC::iohcMqttQueue::Message::Published published = nullptr);
+bool mqttPublish(const std::string &topic, const std::string &payload,
+                 IOHC::iohcMqttQueue::Message::Published published = nullptr);
+/// Waits up to wait ticks while the queue is congested; false when still congested
+bool mqttWaitForRoom(TickType_t wait);
 void connectToMqtt();
 static void publishIohcFrameDiscovery();
 void onMqttConnect(bool sessionPresent);
@@ -29,7 +48,9 @@ void publishTravelTimeDiscovery(const std::string &id, const std::string &name,
                                 const std::string &key, uint32_t travelTime);
 void handleMqttConnect();
 void publishHeartbeat(TimerHandle_t timer);
-void mqttFuncHandler(const char *cmd);
+void mqttFuncHandler(const char *topic, const char *data);
+/// Result hook of the MQTT commands, called by the command worker
+void mqttCommandDone(const IOHC::Command &command, bool acknowledged);
 void publishCoverState(const std::string &id, const char *state);
 void publishCoverPosition(const std::string &id, float position);
 void removeDiscovery(const std::string &id);
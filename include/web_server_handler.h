@@ -8,11 +8,22 @@
 class ESPAsyncWebServer;
 
 #if defined(WEBSERVER)
+#include <iohcCommandQueue.h>
+#include <iohcJsonSnapshot.h>
+
 void setupWebServer();
 void loopWebServer(); // If any loop processing is needed for the web server
 void broadcastLog(const String &msg);
 void broadcastDevicePosition(const String &id, int position);
 void broadcastLastAddress(const String &addr);
+/// Result hook of the /api/command and /api/action commands, called by the command worker
+void webCommandDone(const IOHC::Command &command, bool acknowledged);
+/// Cached bodies of GET /api/devices, /api/remotes and /api/mqtt
+extern IOHC::iohcJsonSnapshot devicesSnapshot;
+extern IOHC::iohcJsonSnapshot remotesSnapshot;
+#if defined(MQTT)
+extern IOHC::iohcJsonSnapshot mqttSnapshot;
+#endif
 #else
 inline void setupWebServer() {}
 inline void loopWebServer() {}
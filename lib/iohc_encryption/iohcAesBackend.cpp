@@ -0,0 +1,225 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#if !defined(ESP32) && !defined(ESP8266)
+
+#include <iohcAesBackend.h>
+#include <crypto2Wutils.h>
+#include <atomic>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define IOHC_AES_NI 1
+    #include <wmmintrin.h>
+#endif
+
+namespace iohcCrypto {
+    namespace {
+        constexpr uint8_t rotl8(uint8_t x, int n) {
+            return static_cast<uint8_t>((x << n) | (x >> (8 - n)));
+        }
+
+        constexpr uint8_t xtime(uint8_t x) {
+            return static_cast<uint8_t>((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+        }
+
+        struct AesTables {
+            uint8_t sbox[256];
+            uint32_t te[4][256];
+        };
+
+        // S-box from the multiplicative inverse walk (p runs over 3^i, q over its inverse), then the T-tables
+        constexpr AesTables makeAesTables() {
+            AesTables tables{};
+            uint8_t p = 1, q = 1;
+            do {
+                p = static_cast<uint8_t>(p ^ xtime(p));
+                q ^= static_cast<uint8_t>(q << 1);
+                q ^= static_cast<uint8_t>(q << 2);
+                q ^= static_cast<uint8_t>(q << 4);
+                if (q & 0x80) q ^= 0x09;
+                tables.sbox[p] = q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63;
+            } while (p != 1);
+            tables.sbox[0] = 0x63;
+
+            for (int i = 0; i < 256; i++) {
+                uint8_t s = tables.sbox[i];
+                uint8_t s2 = xtime(s);
+                uint8_t s3 = s2 ^ s;
+                uint32_t t = static_cast<uint32_t>(s2) << 24 | static_cast<uint32_t>(s) << 16 |
+                             static_cast<uint32_t>(s) << 8 | s3;
+                for (int k = 0; k < 4; k++) tables.te[k][i] = k ? t >> (8 * k) | t << (32 - 8 * k) : t;
+            }
+            return tables;
+        }
+
+        constexpr AesTables aesTables = makeAesTables();
+        static_assert(aesTables.sbox[0x00] == 0x63 && aesTables.sbox[0x53] == 0xed && aesTables.sbox[0xff] == 0x16,
+                      "AES S-box");
+
+        inline uint32_t load32(const uint8_t *p) {
+            return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+                   static_cast<uint32_t>(p[2]) << 8 | p[3];
+        }
+
+        inline void store32(uint8_t *p, uint32_t v) {
+            p[0] = v >> 24;
+            p[1] = v >> 16;
+            p[2] = v >> 8;
+            p[3] = v;
+        }
+
+        void encryptReference(const AesSchedule &schedule, uint8_t (*blocks)[16], size_t count) {
+            for (size_t i = 0; i < count; i++) AES_ECB_encrypt(&schedule.bytes, blocks[i]);
+        }
+
+        void encryptTTable(const AesSchedule &schedule, uint8_t (*blocks)[16], size_t count) {
+            const auto &te = aesTables.te;
+            const auto &sbox = aesTables.sbox;
+            const uint32_t *rk = schedule.words;
+            for (size_t b = 0; b < count; b++) {
+                uint8_t *block = blocks[b];
+                uint32_t s0 = load32(block) ^ rk[0];
+                uint32_t s1 = load32(block + 4) ^ rk[1];
+                uint32_t s2 = load32(block + 8) ^ rk[2];
+                uint32_t s3 = load32(block + 12) ^ rk[3];
+                for (int round = 1; round < 10; round++) {
+                    const uint32_t *k = rk + 4 * round;
+                    uint32_t t0 = te[0][s0 >> 24] ^ te[1][(s1 >> 16) & 0xff] ^ te[2][(s2 >> 8) & 0xff] ^ te[3][s3 & 0xff] ^ k[0];
+                    uint32_t t1 = te[0][s1 >> 24] ^ te[1][(s2 >> 16) & 0xff] ^ te[2][(s3 >> 8) & 0xff] ^ te[3][s0 & 0xff] ^ k[1];
+                    uint32_t t2 = te[0][s2 >> 24] ^ te[1][(s3 >> 16) & 0xff] ^ te[2][(s0 >> 8) & 0xff] ^ te[3][s1 & 0xff] ^ k[2];
+                    uint32_t t3 = te[0][s3 >> 24] ^ te[1][(s0 >> 16) & 0xff] ^ te[2][(s1 >> 8) & 0xff] ^ te[3][s2 & 0xff] ^ k[3];
+                    s0 = t0;
+                    s1 = t1;
+                    s2 = t2;
+                    s3 = t3;
+                }
+                // Last round: no MixColumns, plain S-box
+                auto last = [&](uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t k) {
+                    return (static_cast<uint32_t>(sbox[a >> 24]) << 24 | static_cast<uint32_t>(sbox[(b >> 16) & 0xff]) << 16 |
+                            static_cast<uint32_t>(sbox[(c >> 8) & 0xff]) << 8 | sbox[d & 0xff]) ^ k;
+                };
+                store32(block, last(s0, s1, s2, s3, rk[40]));
+                store32(block + 4, last(s1, s2, s3, s0, rk[41]));
+                store32(block + 8, last(s2, s3, s0, s1, rk[42]));
+                store32(block + 12, last(s3, s0, s1, s2, rk[43]));
+            }
+        }
+
+#if defined(IOHC_AES_NI)
+        __attribute__((target("aes,sse2")))
+        void encryptAesNi(const AesSchedule &schedule, uint8_t (*blocks)[16], size_t count) {
+            __m128i rk[11];
+            for (int i = 0; i < 11; i++)
+                rk[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(schedule.bytes.RoundKey + 16 * i));
+
+            size_t b = 0;
+            // Four independent blocks keep the AES unit busy
+            for (; b + 4 <= count; b += 4) {
+                __m128i s[4];
+                for (int j = 0; j < 4; j++)
+                    s[j] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks[b + j])), rk[0]);
+                for (int round = 1; round < 10; round++)
+                    for (int j = 0; j < 4; j++) s[j] = _mm_aesenc_si128(s[j], rk[round]);
+                for (int j = 0; j < 4; j++)
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(blocks[b + j]), _mm_aesenclast_si128(s[j], rk[10]));
+            }
+            for (; b < count; b++) {
+                __m128i s = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks[b])), rk[0]);
+                for (int round = 1; round < 10; round++) s = _mm_aesenc_si128(s, rk[round]);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(blocks[b]), _mm_aesenclast_si128(s, rk[10]));
+            }
+        }
+#endif
+
+        typedef void (*EncryptFn)(const AesSchedule &, uint8_t (*)[16], size_t);
+
+        EncryptFn encryptFor(AesBackend backend) {
+            switch (backend) {
+#if defined(IOHC_AES_NI)
+                case AesBackend::AesNi:
+                    return encryptAesNi;
+#endif
+                case AesBackend::TTable:
+                    return encryptTTable;
+                default:
+                    return encryptReference;
+            }
+        }
+
+        AesBackend bestBackend() {
+            return aesBackendAvailable(AesBackend::AesNi) ? AesBackend::AesNi : AesBackend::TTable;
+        }
+
+        struct Selection {
+            std::atomic<AesBackend> backend;
+            std::atomic<EncryptFn> encrypt;
+        };
+
+        Selection &selection() {
+            static Selection selected{{bestBackend()}, {encryptFor(bestBackend())}};
+            return selected;
+        }
+    }
+
+    void aesExpandKey(const uint8_t *key, AesSchedule &schedule) {
+        AES_init_ctx(&schedule.bytes, key);
+        for (int i = 0; i < 44; i++) schedule.words[i] = load32(schedule.bytes.RoundKey + 4 * i);
+    }
+
+    void aesEncrypt(const AesSchedule &schedule, uint8_t (*blocks)[16], size_t count) {
+        selection().encrypt.load(std::memory_order_relaxed)(schedule, blocks, count);
+    }
+
+    AesBackend aesBackend() {
+        return selection().backend.load(std::memory_order_relaxed);
+    }
+
+    bool aesBackendAvailable(AesBackend backend) {
+        switch (backend) {
+            case AesBackend::Reference:
+            case AesBackend::TTable:
+                return true;
+            case AesBackend::AesNi:
+#if defined(IOHC_AES_NI)
+                return __builtin_cpu_supports("aes");
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    bool aesUseBackend(AesBackend backend) {
+        if (!aesBackendAvailable(backend)) return false;
+        selection().encrypt.store(encryptFor(backend), std::memory_order_relaxed);
+        selection().backend.store(backend, std::memory_order_relaxed);
+        return true;
+    }
+
+    const char *aesBackendName(AesBackend backend) {
+        switch (backend) {
+            case AesBackend::Reference:
+                return "reference";
+            case AesBackend::TTable:
+                return "t-table";
+            case AesBackend::AesNi:
+                return "aes-ni";
+        }
+        return "?";
+    }
+}
+
+#endif
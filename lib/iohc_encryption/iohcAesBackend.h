@@ -0,0 +1,60 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_AES_BACKEND_H
+#define IOHC_AES_BACKEND_H
+
+#if !defined(ESP32) && !defined(ESP8266)
+
+#include <cstddef>
+#include <cstdint>
+#include <Aes.h>
+
+/*
+    AES-128 block encryption for host builds, where the firmware targets use mbedtls or the ESP8266 Crypto library.
+    The byte-wise tiny-AES cipher makes replaying or fuzzing captures CPU-bound, so there are three bit-identical
+    backends:
+    - Reference: tiny-AES, as used before
+    - TTable: four 1 KB tables computed at compile time, one lookup per byte and round
+    - AesNi: the x86 AES instructions, four blocks interleaved; picked at startup when the CPU has them
+    One schedule serves them all. iohcAesCache expands keys with aesExpandKey() and encrypts with aesEncrypt().
+*/
+namespace iohcCrypto {
+    enum class AesBackend : uint8_t {
+        Reference,
+        TTable,
+        AesNi,
+    };
+
+    struct AesSchedule {
+        AES_ctx bytes;          ///< Round keys as bytes, the tiny-AES and AES-NI layout
+        uint32_t words[44];     ///< The same round keys as big endian words, for the T-tables
+    };
+
+    void aesExpandKey(const uint8_t *key, AesSchedule &schedule);
+    /// ECB-encrypts count blocks in place
+    void aesEncrypt(const AesSchedule &schedule, uint8_t (*blocks)[16], size_t count);
+
+    AesBackend aesBackend();
+    bool aesBackendAvailable(AesBackend backend);
+    /// Switches every later encryption to backend; false (and no change) when this CPU cannot run it
+    bool aesUseBackend(AesBackend backend);
+    const char *aesBackendName(AesBackend backend);
+}
+
+#endif
+
+#endif // IOHC_AES_BACKEND_H
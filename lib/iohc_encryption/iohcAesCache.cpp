@@ -0,0 +1,117 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <iohcAesCache.h>
+#include <cstring>
+
+namespace iohcCrypto {
+    iohcAesCache::iohcAesCache() {
+        for (auto &entry : _entries) {
+            entry.valid = false;
+            entry.lastUse = 0;
+#if defined(ESP32)
+            mbedtls_aes_init(&entry.schedule);
+#endif
+        }
+    }
+
+    iohcAesCache::~iohcAesCache() {
+        clear();
+#if defined(ESP32)
+        for (auto &entry : _entries) mbedtls_aes_free(&entry.schedule);
+#endif
+    }
+
+    iohcAesCache &iohcAesCache::instance() {
+        static iohcAesCache cache;
+        return cache;
+    }
+
+    iohcAesCache::Entry &iohcAesCache::lookup(const uint8_t *key) {
+        Entry *victim = &_entries[0];
+        for (auto &entry : _entries) {
+            if (entry.valid && memcmp(entry.key, key, IOHC_AES_BLOCK) == 0) {
+                _stats.hits++;
+                entry.lastUse = ++_clock;
+                return entry;
+            }
+            // Free slots first, then the least recently used
+            if (victim->valid && (!entry.valid || entry.lastUse < victim->lastUse)) victim = &entry;
+        }
+
+        _stats.misses++;
+        if (victim->valid) _stats.evictions++;
+        memcpy(victim->key, key, IOHC_AES_BLOCK);
+#if defined(ESP8266)
+        victim->schedule.setKey(key, IOHC_AES_BLOCK);
+#elif defined(ESP32)
+        mbedtls_aes_setkey_enc(&victim->schedule, key, 128);
+#else
+        aesExpandKey(key, victim->schedule);
+#endif
+        victim->valid = true;
+        victim->lastUse = ++_clock;
+        return *victim;
+    }
+
+    void iohcAesCache::encryptBlock(Entry &entry, const uint8_t *in, uint8_t *out) {
+#if defined(ESP8266)
+        entry.schedule.encryptBlock(out, in);
+#elif defined(ESP32)
+        mbedtls_aes_crypt_ecb(&entry.schedule, MBEDTLS_AES_ENCRYPT, in, out);
+#else
+        uint8_t (*block)[IOHC_AES_BLOCK] = reinterpret_cast<uint8_t (*)[IOHC_AES_BLOCK]>(out);
+        if (out != in) memcpy(out, in, IOHC_AES_BLOCK);
+        aesEncrypt(entry.schedule, block, 1);
+#endif
+    }
+
+    void iohcAesCache::encrypt(const uint8_t *key, uint8_t (*blocks)[IOHC_AES_BLOCK], size_t count) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Entry &entry = lookup(key);
+#if defined(ESP8266) || defined(ESP32)
+        for (size_t i = 0; i < count; i++) encryptBlock(entry, blocks[i], blocks[i]);
+#else
+        aesEncrypt(entry.schedule, blocks, count);
+#endif
+    }
+
+    void iohcAesCache::encrypt(const uint8_t *key, const uint8_t *in, uint8_t *out) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        encryptBlock(lookup(key), in, out);
+    }
+
+    AesCacheStats iohcAesCache::stats() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+    void iohcAesCache::clear() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &entry : _entries) {
+            memset(entry.key, 0, IOHC_AES_BLOCK);
+#if defined(ESP8266)
+            entry.schedule.clear();
+#elif defined(ESP32)
+            mbedtls_aes_free(&entry.schedule);
+            mbedtls_aes_init(&entry.schedule);
+#else
+            memset(&entry.schedule, 0, sizeof(entry.schedule));
+#endif
+            entry.valid = false;
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_AES_CACHE_H
+#define IOHC_AES_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#if defined(ESP8266)
+    #include <Crypto.h>
+    #include <AES.h>
+#elif defined(ESP32)
+    #include "mbedtls/aes.h"
+#else
+    #include <iohcAesBackend.h>
+#endif
+
+#ifndef IOHC_AES_CACHE_SIZE
+#define IOHC_AES_CACHE_SIZE     4       // Expanded keys kept: system key, transfer key and a couple of 1W remotes
+#endif
+
+#define IOHC_AES_BLOCK          16
+
+/*
+    Least recently used set of expanded AES-128 encryption keys. Every MAC and key transfer encrypts a single block,
+    so expanding the key used to cost as much as the encryption itself; the schedule is now only computed the first
+    time a key is seen, or when it comes back after being evicted. Entries are matched on the 16 key bytes, so a key
+    changed in place (a new system key after pairing) simply misses.
+    All calls are thread-safe; the lock is held for the whole encryption of a request.
+*/
+namespace iohcCrypto {
+    struct AesCacheStats {
+        uint32_t hits;
+        uint32_t misses;        ///< Key schedules expanded
+        uint32_t evictions;     ///< Misses that replaced a valid entry
+    };
+
+    class iohcAesCache {
+    public:
+        iohcAesCache();
+        ~iohcAesCache();
+
+        iohcAesCache(const iohcAesCache &) = delete;
+        iohcAesCache &operator=(const iohcAesCache &) = delete;
+
+        /// Shared by every MAC and key transfer of the gateway
+        static iohcAesCache &instance();
+
+        /// ECB-encrypts count consecutive blocks in place with the same key
+        void encrypt(const uint8_t *key, uint8_t (*blocks)[IOHC_AES_BLOCK], size_t count = 1);
+        void encrypt(const uint8_t *key, const uint8_t *in, uint8_t *out);
+
+        AesCacheStats stats() const;
+        /// Forgets every key, wiping the schedules
+        void clear();
+
+    private:
+        struct Entry {
+            uint8_t key[IOHC_AES_BLOCK];
+            uint32_t lastUse;
+            bool valid;
+#if defined(ESP8266)
+            AES128 schedule;
+#elif defined(ESP32)
+            mbedtls_aes_context schedule;
+#else
+            AesSchedule schedule;
+#endif
+        };
+
+        Entry &lookup(const uint8_t *key);
+        static void encryptBlock(Entry &entry, const uint8_t *in, uint8_t *out);
+
+        Entry _entries[IOHC_AES_CACHE_SIZE];
+        uint32_t _clock = 0;
+        AesCacheStats _stats{};
+        mutable std::mutex _mutex;
+    };
+}
+
+#endif // IOHC_AES_CACHE_H
@@ -0,0 +1,104 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_CRC_H
+#define IOHC_CRC_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define CRC_POLYNOMIAL_CCITT    0x8408
+
+#define IOHC_CRC_BITWISE        0       // One bit at a time, no table
+#define IOHC_CRC_TABLE          1       // One byte per lookup, 512 bytes of table
+#define IOHC_CRC_SLICE4         2       // Four bytes per round, 2 KB of tables
+
+#ifndef IOHC_CRC_KERNEL
+#define IOHC_CRC_KERNEL         IOHC_CRC_TABLE  // Slice4 shortens the lookup chain for 1.5 KB more of table
+#endif
+
+/*
+    CRC-16/KERMIT (reflected CCITT polynomial 0x8408, initial value 0) closing every io-homecontrol frame, in three
+    bit-identical kernels. The tables are computed at compile time; IOHC_CRC_KERNEL picks the one behind
+    iohcCrypto::computeCrc() and radioPacketComputeCrc(). The CRC of a frame followed by its two CRC bytes (low
+    byte first) is 0.
+*/
+namespace iohcCrypto {
+    struct CrcTables {
+        uint16_t t[4][256];
+    };
+
+    constexpr CrcTables makeCrcTables() {
+        CrcTables tables{};
+        for (uint16_t b = 0; b < 256; b++) {
+            uint16_t crc = b;
+            for (int i = 0; i < 8; i++) crc = (crc & 1) ? (crc >> 1) ^ CRC_POLYNOMIAL_CCITT : crc >> 1;
+            tables.t[0][b] = crc;
+        }
+        for (int k = 1; k < 4; k++)
+            for (uint16_t b = 0; b < 256; b++)
+                tables.t[k][b] = (tables.t[k - 1][b] >> 8) ^ tables.t[0][tables.t[k - 1][b] & 0xFF];
+        return tables;
+    }
+
+    inline constexpr CrcTables crcTables = makeCrcTables();
+
+    constexpr uint16_t crc16BitwiseByte(uint8_t data, uint16_t crc) {
+        crc ^= data;
+        for (int i = 0; i < 8; ++i) {
+            unsigned int remainder = (crc & 1) ? CRC_POLYNOMIAL_CCITT : 0;
+            crc = (crc >> 1) ^ remainder;
+        }
+        return crc;
+    }
+
+    constexpr uint16_t crc16TableByte(uint8_t data, uint16_t crc) {
+        return (crc >> 8) ^ crcTables.t[0][(crc ^ data) & 0xFF];
+    }
+
+    constexpr uint16_t crc16Bitwise(const uint8_t *data, size_t len, uint16_t crc = 0) {
+        for (size_t i = 0; i < len; i++) crc = crc16BitwiseByte(data[i], crc);
+        return crc;
+    }
+
+    constexpr uint16_t crc16Table(const uint8_t *data, size_t len, uint16_t crc = 0) {
+        for (size_t i = 0; i < len; i++) crc = crc16TableByte(data[i], crc);
+        return crc;
+    }
+
+    /// The CRC only spans the first two bytes of each round: they are folded in, the other two go through as is
+    constexpr uint16_t crc16Slice4(const uint8_t *data, size_t len, uint16_t crc = 0) {
+        const auto &t = crcTables.t;
+        while (len >= 4) {
+            crc = t[3][(data[0] ^ crc) & 0xFF] ^ t[2][data[1] ^ (crc >> 8)] ^ t[1][data[2]] ^ t[0][data[3]];
+            data += 4;
+            len -= 4;
+        }
+        return crc16Table(data, len, crc);
+    }
+
+    constexpr uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0) {
+#if IOHC_CRC_KERNEL == IOHC_CRC_SLICE4
+        return crc16Slice4(data, len, crc);
+#elif IOHC_CRC_KERNEL == IOHC_CRC_TABLE
+        return crc16Table(data, len, crc);
+#else
+        return crc16Bitwise(data, len, crc);
+#endif
+    }
+}
+
+#endif // IOHC_CRC_H
@@ -15,8 +15,10 @@
  */
 
 #include <iohcCryptoHelpers.h>
+#include <iohcAesCache.h>
 #include <crypto2Wutils.h>
 #include <Aes.h>
+#include <algorithm>
 #include <cstring>
 // #include <Arduino.h> 
 /*
@@ -47,23 +49,12 @@ std::string bytesToHexString(const uint8_t *byteString, uint8_t len) {
 }
 
 namespace iohcCrypto {
-    std::string transfer_key = "34c3466ed88f4e8e16aa473949884373";
-
-
-#if defined(ESP8266)
-    AES128 aes128;
-    CTR<AES128> ctraes128;
-#elif defined(ESP32)
-    mbedtls_aes_context aes;
-#endif
-    
     uint16_t computeCrc(uint8_t data, uint16_t crc = 0) {
-        crc ^= data;
-        for (int i = 0; i < 8; ++i) {
-            unsigned int remainder = (crc & 1) ? CRC_POLYNOMIAL_CCITT : 0;
-            crc = (crc >> 1) ^ remainder;
-        }
-        return crc;
+#if IOHC_CRC_KERNEL == IOHC_CRC_BITWISE
+        return crc16BitwiseByte(data, crc);
+#else
+        return crc16TableByte(data, crc);
+#endif
     }
 
     /*
@@ -71,12 +62,7 @@ namespace iohcCrypto {
     Used for whole io-homecontrol frames integrity check
     */
     uint16_t radioPacketComputeCrc(uint8_t *buffer, uint8_t bufferLength) {
-        uint16_t crc = 0;
-
-        for (uint8_t i=0; i<bufferLength; i++)
-            crc = computeCrc(buffer[i], crc);
-
-        return crc;
+        return crc16(buffer, bufferLength);
     }
 
     /*
@@ -84,12 +70,7 @@ namespace iohcCrypto {
     Used for whole io-homecontrol frames integrity check
     */
     uint16_t radioPacketComputeCrc(std::vector<uint8_t>& buffer) {
-        uint16_t crc = 0;
-
-        for (uint8_t buf : buffer)
-            crc = computeCrc(buf, crc);
-
-        return crc;
+        return crc16(buffer.data(), buffer.size());
     }
 
     std::tuple<uint8_t, uint8_t> computeChecksum(uint8_t frame_byte, uint8_t chksum1, uint8_t chksum2) {
@@ -104,43 +85,37 @@ namespace iohcCrypto {
         return std::make_tuple(chksum2^0x55, ((tmpchksum<<1)^0x5b)&0xff);
     }
 
-    std::vector<uint8_t> constructInitialValue(const std::vector<uint8_t>& frame_data, const uint8_t *challenge = nullptr, const uint8_t *sequence_number = nullptr) {
+    bool buildInitialValue(uint8_t *iv, const uint8_t *frame, size_t length, const uint8_t *challenge, const uint8_t *sequence_number) {
         if (!challenge && !sequence_number) {
             printf("Cannot create initial value: no mode selected\n");
-            return {};
+            return false;
         }
 
-        std::vector<uint8_t> initial_value(16, 0);
-        initial_value[8] = 0;
-        initial_value[9] = 0;
-        size_t i = 0;
-        while (i < frame_data.size()) {
-            std::tie(initial_value[8], initial_value[9]) = computeChecksum(frame_data[i], initial_value[8], initial_value[9]);
+        iv[8] = 0;
+        iv[9] = 0;
+        for (size_t i = 0; i < length; i++) {
+            std::tie(iv[8], iv[9]) = computeChecksum(frame[i], iv[8], iv[9]);
             if (i < 8)
-                initial_value[i] = frame_data[i];
-            i++;
+                iv[i] = frame[i];
         }
-        
-        // Debug: show checksum calculation
-        // Serial.printf("[constructIV] Frame data %d bytes, Checksum: %02X%02X\n", 
-        //              frame_data.size(), initial_value[8], initial_value[9]);
-
-        if (i < 8)
-            for (size_t j = i; j < 8; j++)
-                initial_value[j] = 0x55;
+        for (size_t j = length; j < 8; j++)
+            iv[j] = 0x55;
 
-        if (!challenge && sequence_number) {
-            for (i = 12; i < 16; i++)
-                initial_value[i] = 0x55;
-
-            initial_value[10] = sequence_number[0];
-            initial_value[11] = sequence_number[1];
-        }
-        else if (challenge) {
-            for (i = 10; i < 16; i++)
-                initial_value[i] = challenge[i - 10];
+        if (!challenge) {
+            iv[10] = sequence_number[0];
+            iv[11] = sequence_number[1];
+            memset(iv + 12, 0x55, 4);
         }
+        else
+            memcpy(iv + 10, challenge, 6);
 
+        return true;
+    }
+
+    std::vector<uint8_t> constructInitialValue(const std::vector<uint8_t>& frame_data, const uint8_t *challenge = nullptr, const uint8_t *sequence_number = nullptr) {
+        std::vector<uint8_t> initial_value(16, 0);
+        if (!buildInitialValue(initial_value.data(), frame_data.data(), frame_data.size(), challenge, sequence_number))
+            return {};
         return initial_value;
     }
 
@@ -150,35 +125,42 @@ namespace iohcCrypto {
     - Controller key in clear
     - frame data starting from Command byte
 */
-    void create_1W_hmac(uint8_t *hmac, const uint8_t *seq_number, uint8_t *controller_key, const std::vector<uint8_t>& frame_data) {
-        std::vector<uint8_t> iv;
-        #if defined(HELTEC)
-            mbedtls_aes_init(&aes);
-        #endif
-
-        iv = constructInitialValue(frame_data, nullptr, seq_number);
+    void create_1W_hmac(uint8_t *hmac, const uint8_t *seq_number, const uint8_t *controller_key, const uint8_t *frame, size_t length) {
+        uint8_t iv[16];
+        buildInitialValue(iv, frame, length, nullptr, seq_number);
+        iohcAesCache::instance().encrypt(controller_key, iv, hmac);
+    }
 
-        #if defined(ESP8266)
-            aes128.setKey(controller_key, 16);
-            aes128.encryptBlock(hmac, iv.data());
-        #elif defined(ESP32)
-            mbedtls_aes_setkey_enc( &aes, controller_key, 128 );
-           
-//        for (uint8_t a=0; a<16; a++){
-//            hmac[a] = 0;
-//        }
-        mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, iv.data(), hmac);
-//        mbedtls_aes_free( &aes );
-        #else
-            // Native build using Aes.h
-            AES_ctx ctx;
-            AES_init_ctx(&ctx, controller_key);
-            uint8_t encrypted[16];
-            memcpy(encrypted, iv.data(), 16);
-            AES_ECB_encrypt(&ctx, encrypted);
-            memcpy(hmac, encrypted, 16);
-        #endif        
+    void create_1W_hmac(uint8_t *hmac, const uint8_t *seq_number, uint8_t *controller_key, const std::vector<uint8_t>& frame_data) {
+        create_1W_hmac(hmac, seq_number, controller_key, frame_data.data(), frame_data.size());
+    }
 
+/*
+    MACs a whole burst with one key lookup. Consecutive repeats of a frame (same bytes, same sequence number) are
+    only encrypted once.
+*/
+    void create_1W_hmacs(const uint8_t *controller_key, const Hmac1WJob *jobs, size_t count) {
+        constexpr size_t chunk = 8;
+        uint8_t blocks[chunk][16];
+        uint8_t block[chunk];
+
+        for (size_t done = 0; done < count;) {
+            size_t end = std::min(count, done + chunk);
+            size_t n = 0;
+            for (size_t i = done; i < end; i++) {
+                const Hmac1WJob &job = jobs[i];
+                const Hmac1WJob &prev = jobs[i ? i - 1 : 0];
+                bool repeat = i > done && prev.length == job.length && !memcmp(prev.sequence, job.sequence, 2) &&
+                              !memcmp(prev.frame, job.frame, job.length);
+                if (!repeat)
+                    buildInitialValue(blocks[n++], job.frame, job.length, nullptr, job.sequence);
+                block[i - done] = n - 1;
+            }
+            iohcAesCache::instance().encrypt(controller_key, blocks, n);
+            for (size_t i = done; i < end; i++)
+                memcpy(jobs[i].mac, blocks[block[i - done]], HMAC_1W_LENGTH);
+            done = end;
+        }
     }
 
 /*
@@ -187,64 +169,32 @@ namespace iohcCrypto {
     @param hmac Output buffer for 6-byte MAC
     @param challenge 6-byte challenge from CMD 0x3C
     @param system_key 16-byte AES system key
-    @param frame_data Frame payload data (command and parameters)
+    @param frame Frame payload data (command and parameters)
+    @param length Frame payload length
 */
-    void create_2W_hmac(uint8_t *hmac, const uint8_t *challenge, uint8_t *system_key, const std::vector<uint8_t>& frame_data) {
-        std::vector<uint8_t> iv;
-        #if defined(HELTEC)
-            mbedtls_aes_init(&aes);
-        #endif
-
+    void create_2W_hmac(uint8_t *hmac, const uint8_t *challenge, const uint8_t *system_key, const uint8_t *frame, size_t length) {
         // Construct the initial value using challenge (not sequence number)
-        iv = constructInitialValue(frame_data, challenge, nullptr);
+        uint8_t iv[16];
+        buildInitialValue(iv, frame, length, challenge, nullptr);
 
-        // Debug: print the constructed IV
-        // Serial.print("[create_2W_hmac] IV: ");
-        // for (uint8_t byte : iv) {
-        //     Serial.printf("%02X", byte);
-        // }
-        // Serial.println();
-
-        #if defined(ESP8266)
-            aes128.setKey(system_key, 16);
-            aes128.encryptBlock(hmac, iv.data());
-        #elif defined(ESP32)
-            mbedtls_aes_setkey_enc(&aes, system_key, 128);
-            uint8_t encrypted[16];
-            mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, iv.data(), encrypted);
-            // Copy first 6 bytes as MAC
-            memcpy(hmac, encrypted, 6);
-        #else
-            // Native build using Aes.h
-            AES_ctx ctx;
-            AES_init_ctx(&ctx, system_key);
-            uint8_t encrypted[16];
-            memcpy(encrypted, iv.data(), 16);
-            AES_ECB_encrypt(&ctx, encrypted);
-            memcpy(hmac, encrypted, 6);
-        #endif
+        uint8_t encrypted[16];
+        iohcAesCache::instance().encrypt(system_key, iv, encrypted);
+        // Copy first 6 bytes as MAC
+        memcpy(hmac, encrypted, 6);
+    }
 
-        // Debug: print the generated MAC
-        // Serial.printf("[create_2W_hmac] MAC: %02X%02X%02X%02X%02X%02X\n",
-        //               hmac[0], hmac[1], hmac[2], hmac[3], hmac[4], hmac[5]);
+    void create_2W_hmac(uint8_t *hmac, const uint8_t *challenge, uint8_t *system_key, const std::vector<uint8_t>& frame_data) {
+        create_2W_hmac(hmac, challenge, system_key, frame_data.data(), frame_data.size());
     }
 
 /*
     Encrypt (or decrypt if called with encrypted) the transmitted key using as input:
     - Node address
     - Key in clear (or encrypted to decrypt)
+    The first block of CTR/CFB with the node address as IV: the encrypted IV XORed with the key.
 */
     void encrypt_1W_key(const uint8_t *node_address, uint8_t *key) {
-        #if defined(ESP32)
-            mbedtls_aes_init(&aes);
-        #endif
-
-        uint8_t btransfer[16];
-        uint8_t captured[16] = {};
-
-        hexStringToBytes(transfer_key, btransfer);
-
-        std::vector<uint8_t> iv(16, 0);
+        uint8_t iv[16];
         for (int i = 0; i < 13; i += 3) {
             iv[i] = node_address[0];
             iv[i + 1] = node_address[1];
@@ -252,36 +202,15 @@ namespace iohcCrypto {
         }
         iv[15] = node_address[0];
 
-    /*  
-        uint8_t captured[16] = {0};
-        aes128.setKey((uint8_t *)btransfer, 16);
-        aes128.encryptBlock(captured, iv.data());
-
+        iohcAesCache::instance().encrypt(transfert_key, iv, iv);
         for (int i = 0; i < 16; ++i)
-            key[i] ^= captured[i];
-    */
-        #if defined(ESP8266)
-    //  Use CTR encryption instead of AES. It includes xor with the key
-            ctraes128.setKey(btransfer, 16);
-            ctraes128.setIV(iv.data(), 16);
-            ctraes128.setCounterSize(4);
-            ctraes128.encrypt(key, key, 16);
-        #elif defined(ESP32)
-            size_t iv_offset = 0;
-            mbedtls_aes_setkey_enc( &aes, (uint8_t *)btransfer, 128 );
-            mbedtls_aes_crypt_cfb128(&aes, MBEDTLS_AES_ENCRYPT, 16, &iv_offset, iv.data(), (uint8_t *)key, captured);
-            for (int i = 0; i < 16; ++i)
-                key[i] = captured[i];
-            mbedtls_aes_free( &aes );
-        #else
-            // Native build using Aes.h
-            AES_ctx ctx;
-            AES_init_ctx(&ctx, btransfer);
-            uint8_t encrypted_iv[16];
-            memcpy(encrypted_iv, iv.data(), 16);
-            AES_ECB_encrypt(&ctx, encrypted_iv);
-            for (int i = 0; i < 16; ++i)
-                key[i] ^= encrypted_iv[i];
-        #endif
+            key[i] ^= iv[i];
     }
-}
\ No newline at end of file
+
+/*
+    Encrypts one block with a cached key schedule, for the key transfers built outside of this file
+*/
+    void encrypt_block(const uint8_t *key, const uint8_t *in, uint8_t *out) {
+        iohcAesCache::instance().encrypt(key, in, out);
+    }
+}
@@ -30,7 +30,9 @@
     #include "mbedtls/aes.h"        // AES functions
 #endif
 
-#define CRC_POLYNOMIAL_CCITT    0x8408
+#include <iohcCrc.h>
+
+#define HMAC_1W_LENGTH          6       // MAC bytes carried by a 1W frame
 
 uint8_t hexStringToBytes(std::string hexString, uint8_t *byteString);
 std::string bytesToHexString(const uint8_t *byteString, uint8_t len);
@@ -40,7 +42,24 @@ namespace iohcCrypto {
     uint16_t radioPacketComputeCrc(uint8_t *buffer, uint8_t bufferLength);
     uint16_t radioPacketComputeCrc(std::vector<uint8_t>& buffer);
     void encrypt_1W_key(const uint8_t *node_address, uint8_t *key);
+    void encrypt_block(const uint8_t *key, const uint8_t *in, uint8_t *out);
+
+    /// 16-byte initial value of a MAC: sequence_number for 1W, challenge for 2W; false when both are missing
+    bool buildInitialValue(uint8_t *iv, const uint8_t *frame, size_t length, const uint8_t *challenge, const uint8_t *sequence_number);
+
+    /// hmac receives the whole 16-byte block, the frame carries the first HMAC_1W_LENGTH
+    void create_1W_hmac(uint8_t *hmac, const uint8_t *seq_number, const uint8_t *controller_key, const uint8_t *frame, size_t length);
     void create_1W_hmac(uint8_t *hmac, const uint8_t *seq_number, uint8_t *controller_key, const std::vector<uint8_t>& frame_data);
+    void create_2W_hmac(uint8_t *hmac, const uint8_t *challenge, const uint8_t *system_key, const uint8_t *frame, size_t length);
     void create_2W_hmac(uint8_t *hmac, const uint8_t *challenge, uint8_t *system_key, const std::vector<uint8_t>& frame_data);
+
+    /// One frame of a 1W burst: from the command byte, its sequence number, and where its MAC goes
+    struct Hmac1WJob {
+        const uint8_t *frame;
+        size_t length;
+        const uint8_t *sequence;
+        uint8_t *mac;           ///< HMAC_1W_LENGTH bytes
+    };
+    void create_1W_hmacs(const uint8_t *controller_key, const Hmac1WJob *jobs, size_t count);
 }
 #endif
\ No newline at end of file
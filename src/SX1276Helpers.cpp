@@ -62,6 +62,22 @@ namespace Radio {
         SPI.endTransaction();
     }
 
+    namespace {
+        struct ChipBus {
+            static uint8_t readByte(uint8_t regAddr) { return Radio::readByte(regAddr); }
+            static void readBytes(uint8_t regAddr, uint8_t *out, uint8_t len) { Radio::readBytes(regAddr, out, len); }
+            static void writeBytes(uint8_t regAddr, uint8_t *in, uint8_t len) { Radio::writeBytes(regAddr, in, len); }
+        };
+        ChipBus chipBus;
+
+        // Configuration registers written on every transition; writeBytes() keeps it in sync
+#if defined(SX1276_SHADOW_VERIFY)
+        RegisterShadow<ChipBus> shadow(chipBus, true);
+#else
+        RegisterShadow<ChipBus> shadow(chipBus);
+#endif
+    }
+
 /**
  * The function `initHardware` initializes the hardware for SPI communication with a radio chip, checks
  * the availability of the radio, configures SPI settings, and puts the radio chip in standby mode.
@@ -102,6 +118,7 @@ namespace Radio {
         digitalWrite(RADIO_RESET, HIGH);
         digitalWrite(RADIO_NSS, HIGH);
         delayMicroseconds(BOARD_READY_AFTER_POR);
+        shadow.invalidate();
 
         // SPI.beginTransaction(Radio::SpiSettings);
         // SPI.endTransaction();
@@ -114,8 +131,7 @@ namespace Radio {
     }
 
 void setPreambleLength(uint16_t preambleLen) {
-    writeByte(REG_PREAMBLEMSB, (preambleLen >> 8) & 0xFF);
-    writeByte(REG_PREAMBLELSB, preambleLen & 0xFF);
+    setPreamble(shadow, preambleLen);
     // ets_printf("Radio: Preamble length set to %u symbols\n", preambleLen);
 }
 
@@ -286,22 +302,19 @@ void setPreambleLength(uint16_t preambleLen) {
     //     SetChannel( initialFreq );
     // }
     void IRAM_ATTR setStandby() {
-        writeByte(REG_OPMODE, (readByte(REG_OPMODE) & RF_OPMODE_MASK) | RF_OPMODE_STANDBY);
+        enterStandby(shadow);
     }
 
     void IRAM_ATTR setTx() {
         // Uncommon and incompatible settings
-        // Enabling Sync word - Size must be set to SYNCSIZE_2 (0x01 in header file)
-        writeByte(REG_SYNCCONFIG, (readByte(REG_SYNCCONFIG) & RF_SYNCCONFIG_SYNCSIZE_MASK) | RF_SYNCCONFIG_SYNCSIZE_2);
-        writeByte(REG_OPMODE, (readByte(REG_OPMODE) & RF_OPMODE_MASK) | RF_OPMODE_TRANSMITTER);
+        enterTx(shadow);
 
         TxReady;
     }
 
     void IRAM_ATTR setRx() {
         // Uncommon and incompatible settings
-        writeByte(REG_SYNCCONFIG, (readByte(REG_SYNCCONFIG) & RF_SYNCCONFIG_SYNCSIZE_MASK) | RF_SYNCCONFIG_SYNCSIZE_3);
-        writeByte(REG_OPMODE, (readByte(REG_OPMODE) & RF_OPMODE_MASK) | RF_OPMODE_RECEIVER);
+        enterRx(shadow);
 
         RxReady;
         /*
@@ -341,10 +354,10 @@ void setPreambleLength(uint16_t preambleLen) {
     //   flags &= ~0xFF; // Efface tous les drapeaux
     //   writeByte(REG_IRQFLAGS1, flags);
     // }
+    // The former readWord/writeWord version always ended up writing 0x0000; same effect in one write-only burst
     void IRAM_ATTR clearFlags() {
-        uint16_t flags = readWord(REG_IRQFLAGS1);
-        flags &= ~0xFFFF; // Efface tous les drapeaux
-        writeWord(REG_IRQFLAGS1, flags);
+        uint8_t out[2] = {0x00, 0x00};
+        writeBytes(REG_IRQFLAGS1, out, sizeof(out));
     }
 
     bool IRAM_ATTR preambleDetected() {
@@ -386,6 +399,7 @@ void setPreambleLength(uint16_t preambleLen) {
             SPI.write(in[idx]); // Send data
         }
         SPI_endTransaction();
+        shadow.track(regAddr, in, len);
 
         if (check) {
             SPI_beginTransaction();
@@ -403,6 +417,30 @@ void setPreambleLength(uint16_t preambleLen) {
         return true;
     }
 
+/**
+ * The function `readFrame` reads a complete received frame from the FIFO using a burst read.
+ *
+ * @param out Destination buffer
+ * @param maxLen Size of the destination buffer, extra bytes are discarded
+ * @return Number of bytes stored in out
+ */
+    uint8_t IRAM_ATTR readFrame(uint8_t *out, uint8_t maxLen) {
+        ChipBus bus;
+        return readFrame(bus, out, maxLen);
+    }
+
+    const ShadowStats &shadowStats() {
+        return shadow.stats();
+    }
+
+    void setShadowVerify(bool verify) {
+        shadow.setVerify(verify);
+    }
+
+    uint8_t verifyShadow() {
+        return shadow.verifyAll();
+    }
+
     uint16_t IRAM_ATTR readWord(uint8_t regAddr) {
         uint8_t lowByte = readByte(regAddr);
         uint8_t highByte = readByte(regAddr + 1);
@@ -415,7 +453,7 @@ void setPreambleLength(uint16_t preambleLen) {
     }
 
     bool IRAM_ATTR inStdbyOrSleep() {
-        uint8_t data = readByte(REG_OPMODE);
+        uint8_t data = shadow.read(REG_OPMODE);
         data &= ~RF_OPMODE_MASK;
         if ((data == RF_OPMODE_SLEEP) || (data == RF_OPMODE_STANDBY))
             return true;
@@ -423,6 +461,14 @@ void setPreambleLength(uint16_t preambleLen) {
         return false;
     }
 
+/**
+ * Writes a precomputed carrier word (REG_FRFMSB..LSB) in one burst, skipped if already tuned.
+ * With fast hopping on, the LSB write retunes the PLL without leaving RX.
+ */
+    void IRAM_ATTR setFrequencyWord(const uint8_t *frf) {
+        shadow.writeBurst(REG_FRFMSB, frf, 3);
+    }
+
     bool IRAM_ATTR setCarrier(Carrier param, uint32_t value) {
         uint32_t tmpVal;
         uint8_t out[4];
@@ -440,7 +486,7 @@ void setPreambleLength(uint16_t preambleLen) {
                 out[0] = (tmpVal & 0x00ff0000) >> 16;
                 out[1] = (tmpVal & 0x0000ff00) >> 8;
                 out[2] = (tmpVal & 0x000000ff); // If Radio is active writing LSB triggers frequency change
-                writeBytes(REG_FRFMSB, out, 3);
+                shadow.writeBurst(REG_FRFMSB, out, 3);
                 break;
             case Carrier::Bandwidth:
                 bw = bwRegs(value);
@@ -43,7 +43,8 @@ namespace TimersUS {
         _timerConfig.skip_unhandled_events = true;//false; //true;
         _timerConfig.name = "TickerMsESP32";
         if (_timer) {
-            ESP_ERROR_CHECK(esp_timer_stop(_timer));
+            // A one-shot timer that already fired is no longer active and cannot be stopped
+            if (esp_timer_is_active(_timer)) ESP_ERROR_CHECK(esp_timer_stop(_timer));
             ESP_ERROR_CHECK(esp_timer_delete(_timer));
         }
         ESP_ERROR_CHECK(esp_timer_create(&_timerConfig, &_timer));
@@ -86,7 +87,7 @@ namespace TimersUS {
         _timerConfig.name = "TickerUsESP32";
 
         if (_timer) {
-            ESP_ERROR_CHECK(esp_timer_stop(_timer));
+            if (esp_timer_is_active(_timer)) ESP_ERROR_CHECK(esp_timer_stop(_timer));
             ESP_ERROR_CHECK(esp_timer_delete(_timer));
         }
 
@@ -101,7 +102,7 @@ namespace TimersUS {
 
     void TickerUsESP32::detach() {
         if (_timer) {
-            ESP_ERROR_CHECK(esp_timer_stop(_timer));
+            if (esp_timer_is_active(_timer)) ESP_ERROR_CHECK(esp_timer_stop(_timer));
             ESP_ERROR_CHECK(esp_timer_delete(_timer));
             _timer = nullptr;
         }
@@ -21,12 +21,16 @@
 #include <iohcPairingController.h>
 #include <iohcRemoteMap.h>
 #include <iohcPacket.h>
+#include <iohcFrame.h>
+#include <iohcJsonArena.h>
 #include <interact.h>
 #include <wifi_helper.h>
 #include <oled_display.h>
 #include <iohcCryptoHelpers.h>
 #include <iohc2WCommands.h>
 #include <cstdlib>
+#include <esp_timer.h>
+#include <freertos/queue.h>
 #include <user_config.h>
 #if defined(MQTT)
 #include <mqtt_handler.h>
@@ -63,22 +67,11 @@ bool sendChallengeResponseForControl(Device2W* device, const uint8_t* originalCo
     iohcCrypto::create_2W_hmac(mac, device->lastChallenge, device->systemKey, frame_data);
     
     // Create CMD 0x3D packet
-    iohcPacket* packet = new iohcPacket();
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->payload.packet.header.CtrlByte1.asByte += 6;
-    memcpy(packet->payload.buffer + 9, mac, 6);
-    packet->buffer_length = 6 + 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
-    
+    iohcPacket* packet = iohcRadio::allocPacket();
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::challengeAnswer(packet->payload.buffer, myAddr, device->nodeAddress, mac)
+                                .finish();
     
-    packet->payload.packet.header.cmd = 0x3D;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -100,22 +93,9 @@ bool sendChallengeResponseForControl(Device2W* device, const uint8_t* originalCo
 }
 */
 
-// Pre-allocate command handlers instead of using malloc to avoid heap fragmentation
-_cmdEntry _cmdHandlerStorage[MAXCMDS];
-_cmdEntry* _cmdHandler[MAXCMDS];
-uint8_t lastEntry = 0;
-
-
-void tokenize(std::string const &str, const char delim, Tokens &out) {
-  std::stringstream ss(str);
-  std::string s;
-  while (std::getline(ss, s, delim)) {
-    out.push_back(s);
-  }
-}
-
-
 namespace Cmd {
+IOHC::iohcCommandTable commands;
+IOHC::iohcCommandQueue commandQueue;
 bool verbosity = true;
 bool pairMode = false;
 bool scanMode = false;
@@ -127,6 +107,13 @@ TimerHandle_t consoleTimer;
 static char _rxbuffer[512];
 static uint8_t _len = 0;
 static uint8_t _avail = 0;
+static TaskHandle_t s_commandWorkerTask = nullptr;
+// TX reports of the buttons, by ticket: a late one of a command that timed out is told apart from the current one
+struct OnAir {
+  uint32_t ticket;
+  int64_t startedUs;    // First frame on air, 0: not sent
+};
+static QueueHandle_t s_commandOnAir = nullptr;
 /**
  * The function `createCommands()` initializes and adds various command handlers for controlling
  * different devices and functionalities.
@@ -248,7 +235,23 @@ void createCommands() {
         uint32_t t = strtoul(cmd->at(2).c_str(), nullptr, 10);
         IOHC::iohcRemote1W::getInstance()->setTravelTime(cmd->at(1), t);
     });
+    Cmd::addHandler((char *) "stats1W", (char *) "1W precomputed frames and press-to-queue latency [reset]", [](Tokens *cmd)-> void {
+        IOHC::iohcFrameTemplates &templates = IOHC::iohcRemote1W::getInstance()->templates();
+        if (cmd->size() > 1 && cmd->at(1) == "reset") {
+            templates.resetStats();
+            return;
+        }
+        IOHC::FrameTemplateStats stats = templates.stats();
+        Serial.printf("ready %u built %u invalidated %u hits %u misses %u\n", (unsigned)templates.ready(), stats.built,
+                      stats.invalidated, stats.hits, stats.misses);
+        for (const auto &[name, h] : {std::make_pair("hit", &stats.hit), std::make_pair("miss", &stats.miss)}) {
+            if (!h->count) continue;
+            Serial.printf("%-4s %u presses min %uus avg %uus p50 <%uus p99 <%uus max %uus\n", name, h->count, h->minUs,
+                          h->meanUs(), h->percentileUs(50), h->percentileUs(99), h->maxUs);
+        }
+    });
     Cmd::addHandler((char *) "list1W", (char *) "List 1W devices", [](Tokens *cmd)-> void {
+        auto guard = IOHC::iohcRemote1W::getInstance()->lock();
         const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
         for (const auto &r : remotes) {
             Serial.printf("%s: %s %u %s\n",
@@ -372,6 +375,220 @@ void createCommands() {
     Cmd::addHandler((char *) "send", (char *) "Send packet from cmd line",
                     [](Tokens *cmd)-> void { txUserBuffer(cmd); });
 */
+    Cmd::addHandler((char *) "rxStats", (char *) "RX pool counters, newest|oldest sets overflow policy", [](Tokens *cmd)-> void {
+        if (cmd->size() > 1) {
+            if (cmd->at(1) == "newest")
+                IOHC::iohcRadio::setRxOverflowPolicy(IOHC::RxOverflowPolicy::DropNewest);
+            else if (cmd->at(1) == "oldest")
+                IOHC::iohcRadio::setRxOverflowPolicy(IOHC::RxOverflowPolicy::DropOldest);
+            else {
+                Serial.println("Usage: rxStats [newest|oldest]");
+                return;
+            }
+        }
+        IOHC::RxRingStats stats = IOHC::iohcRadio::rxStats();
+        Serial.printf("RX pool %u records, overflow drops %s\n", IOHC_RX_POOL_SIZE,
+                      IOHC::iohcRadio::rxOverflowPolicy() == IOHC::RxOverflowPolicy::DropNewest ? "newest" : "oldest");
+        Serial.printf("pushed %u popped %u dropped %u overwritten %u highWater %u\n",
+                      stats.pushed, stats.popped, stats.dropped, stats.overwritten, stats.highWater);
+    });
+    Cmd::addHandler((char *) "rxFilter", (char *) "Early RX filter counters, sniff|drop|promisc|reset", [](Tokens *cmd)-> void {
+        IOHC::iohcRxFilter &filter = IOHC::iohcRadio::rxFilter();
+        if (cmd->size() > 1) {
+            if (cmd->at(1) == "sniff" || cmd->at(1) == "drop") {
+                filter.setOthers(cmd->at(1) == "sniff" ? IOHC::RxVerdict::Sniff : IOHC::RxVerdict::Drop);
+                filter.setPromiscuous(false);
+            } else if (cmd->at(1) == "promisc")
+                filter.setPromiscuous(true);
+            else if (cmd->at(1) == "reset")
+                filter.resetStats();
+            else {
+                Serial.println("Usage: rxFilter [sniff|drop|promisc|reset]");
+                return;
+            }
+        }
+        IOHC::RxFilterStats stats = filter.stats();
+        Serial.printf("RX filter %s, frames for other controllers: %s\n", filter.promiscuous() ? "promiscuous" : "active",
+                      filter.others() == IOHC::RxVerdict::Sniff ? "sniff" : "drop");
+        Serial.printf("kept %u sniffed %u dropped %u (malformed %u)\n", stats.kept, stats.sniffed, stats.dropped,
+                      stats.malformed);
+    });
+    Cmd::addHandler((char *) "rxDedupe", (char *) "RX repeat suppression, reset|<1W ms> <2W ms>", [](Tokens *cmd)-> void {
+        IOHC::iohcRxDedupe &dedupe = IOHC::iohcRadio::rxDedupe();
+        uint32_t window1W, window2W;
+        if (cmd->size() > 2 && IOHC::commandArg::toU32(cmd->at(1), window1W) &&
+            IOHC::commandArg::toU32(cmd->at(2), window2W))
+            dedupe.setWindows(window1W, window2W);
+        else if (cmd->size() == 2 && cmd->at(1) == "reset")
+            dedupe.resetStats();
+        else if (cmd->size() > 1) {
+            Serial.println("Usage: rxDedupe [reset|<1W ms> <2W ms>]");
+            return;
+        }
+        IOHC::RxDedupeStats stats = dedupe.stats();
+        Serial.printf("windows 1W %ums 2W %ums\n", dedupe.window1WMs(), dedupe.window2WMs());
+        Serial.printf("unique %u repeats 1W %u 2W %u evicted %u\n", stats.unique, stats.repeats1W, stats.repeats2W,
+                      stats.evicted);
+    });
+    Cmd::addHandler((char *) "deviceIndex", (char *) "Devices per kind in the address/description index", [](Tokens *cmd)-> void {
+        IOHC::iohcDeviceIndex &index = IOHC::iohcDeviceIndex::instance();
+        IOHC::DeviceIndexStats stats = index.stats();
+        Serial.printf("1W %u 2W %u sysTable %u remoteMap %u\n", index.size(IOHC::DeviceKind::Remote1W),
+                      index.size(IOHC::DeviceKind::Device2W), index.size(IOHC::DeviceKind::SystemObject),
+                      index.size(IOHC::DeviceKind::RemoteMap));
+        Serial.printf("addresses %u/%u names %u/%u longest probe %u\n", stats.addresses, stats.addressCapacity,
+                      stats.names, stats.nameCapacity, stats.longestProbe);
+    });
+    Cmd::addHandler((char *) "linkStats", (char *) "RSSI/FEI/LNA histograms per channel and source [reset]", [](Tokens *cmd)-> void {
+        IOHC::iohcLinkStats &link = IOHC::iohcRadio::linkStats();
+        if (cmd->size() > 1 && cmd->at(1) == "reset") {
+            link.reset();
+            return;
+        }
+        auto print = [](const char *label, const IOHC::LinkHistogram &h) {
+            Serial.printf("%s frames %u rssi avg %.1f min %.1f max %.1f dBm fei avg %d Hz\n", label, h.frames,
+                          h.rssiMeanDbm(), h.rssiMinX2 / 2.0f, h.rssiMaxX2 / 2.0f, h.feiMeanHz());
+            Serial.printf("  rssi %d dBm +5:", LINK_RSSI_FLOOR_DBM);
+            for (uint32_t count : h.rssi) Serial.printf(" %u", count);
+            Serial.printf("\n  fei %d kHz +2:", -LINK_FEI_BUCKETS);
+            for (uint32_t count : h.fei) Serial.printf(" %u", count);
+            Serial.printf("\n  lna G1..G6:");
+            for (uint32_t count : h.lna) Serial.printf(" %u", count);
+            Serial.printf("\n");
+        };
+        IOHC::LinkChannel channels[LINK_MAX_CHANNELS];
+        size_t count = link.channels(channels, LINK_MAX_CHANNELS);
+        Serial.printf("%u frames, %u sources evicted\n", link.frames(), link.evicted());
+        char label[24];
+        for (size_t i = 0; i < count; i++) {
+            snprintf(label, sizeof(label), "%u Hz", channels[i].frequency);
+            print(label, channels[i].histogram);
+        }
+        static IOHC::LinkSource sources[LINK_MAX_SOURCES];
+        count = link.sources(sources, LINK_MAX_SOURCES);
+        for (size_t i = 0; i < count; i++) {
+            snprintf(label, sizeof(label), "%06X", sources[i].address);
+            print(label, sources[i].histogram);
+        }
+    });
+    Cmd::addHandler((char *) "wakeStats", (char *) "Preamble choices from device wake state [reset]", [](Tokens *cmd)-> void {
+        IOHC::iohcWakeTracker &tracker = IOHC::iohcRadio::wakeTracker();
+        if (cmd->size() > 1 && cmd->at(1) == "reset") {
+            tracker.resetStats();
+            return;
+        }
+        IOHC::WakeStats stats = tracker.stats();
+        Serial.printf("%u devices tracked, evicted %u\n", (unsigned)tracker.devices(), stats.evicted);
+        Serial.printf("short %u long %u shortened %u lengthened %u misses %u\n", stats.shortPreambles,
+                      stats.longPreambles, stats.shortened, stats.lengthened, stats.misses);
+        Serial.printf("airtime saved %llu ms, added %llu ms\n", stats.savedUs / 1000, stats.spentUs / 1000);
+    });
+    Cmd::addHandler((char *) "txStats", (char *) "TX sequencer, inter-frame gaps and TX queue per source", [](Tokens *cmd)-> void {
+        const IOHC::TxSeqStats &stats = IOHC::iohcRadio::getInstance()->txStats();
+        Serial.printf("batches %u frames %u timeouts %u\n", stats.batches, stats.frames, stats.timeouts);
+        if (stats.gaps)
+            Serial.printf("gaps %u min %uus avg %uus max %uus worst late %uus\n", stats.gaps, stats.minGapUs,
+                          static_cast<uint32_t>(stats.totalGapUs / stats.gaps), stats.maxGapUs, stats.maxLateUs);
+        IOHC::PacketPoolStats pool = IOHC::iohcRadio::txPool().stats();
+        Serial.printf("packet pool in use %u/%u high water %u exhausted %u\n", pool.inUse,
+                      static_cast<uint32_t>(IOHC::TxPacketPool::capacity()), pool.highWater, pool.exhausted);
+        for (uint8_t i = 0; i < static_cast<uint8_t>(IOHC::TxSource::Count); i++) {
+            auto source = static_cast<IOHC::TxSource>(i);
+            IOHC::TxSourceStats queue = IOHC::iohcRadio::getInstance()->txQueueStats(source);
+            if (!queue.queued && !queue.rejected) continue;
+            Serial.printf("%-10s queued %u sent %u expired %u rejected %u aborted %u depth %u/%u wait avg %uus max %uus\n",
+                          IOHC::txSourceToString(source), queue.queued, queue.sent, queue.expired, queue.rejected,
+                          queue.aborted,
+                          queue.depth, queue.maxDepth,
+                          queue.sent ? static_cast<uint32_t>(queue.totalWaitUs / queue.sent) : 0, queue.maxWaitUs);
+            if (queue.scheduled)
+                Serial.printf("%-10s scheduled %u start error avg %uus max %uus\n", "", queue.scheduled,
+                              static_cast<uint32_t>(queue.totalStartErrorUs / queue.scheduled), queue.maxStartErrorUs);
+        }
+    });
+    Cmd::addHandler((char *) "hopStats", (char *) "Channel hopping dwell, preambles and aborts per channel", [](Tokens *cmd)-> void {
+        IOHC::iohcRadio *radio = IOHC::iohcRadio::getInstance();
+        if (radio->hopChannels() < 2) {
+            Serial.println("Channel hopping disabled (MAX_FREQS 1)");
+            return;
+        }
+        const IOHC::HopStats &hop = radio->hopStats();
+        Serial.printf("hops %u postponed %u timer late max %uus\n", hop.hops, hop.postponed, hop.maxLateUs);
+        for (uint8_t i = 0; i < radio->hopChannels(); i++) {
+            const IOHC::HopChannelStats &stats = radio->hopStats(i);
+            Serial.printf("%u Hz dwell %uus (avg %uus over %u) preambles %u frames %u holds %u aborts %u\n",
+                          radio->scanFrequency(i), stats.dwellUs,
+                          stats.dwells ? static_cast<uint32_t>(stats.totalDwellUs / stats.dwells) : 0, stats.dwells,
+                          stats.preambles, stats.frames, stats.holds, stats.preambleAborts);
+        }
+    });
+    Cmd::addHandler((char *) "regCache", (char *) "Register shadow counters [on|off|check]", [](Tokens *cmd)-> void {
+        if (cmd->size() > 1) {
+            if (cmd->at(1) == "on" || cmd->at(1) == "off")
+                Radio::setShadowVerify(cmd->at(1) == "on");
+            else if (cmd->at(1) == "check")
+                Serial.printf("%u register(s) out of sync\n", Radio::verifyShadow());
+            else {
+                Serial.println("Usage: regCache [on|off|check]");
+                return;
+            }
+        }
+        const Radio::ShadowStats &stats = Radio::shadowStats();
+        Serial.printf("writes %u skipped %u readsAvoided %u mismatches %u\n",
+                      stats.writes, stats.skipped, stats.readsAvoided, stats.mismatches);
+    });
+    Cmd::addHandler((char *) "jsonArena", (char *) "Per-task JSON arenas: peak use and heap fallbacks", [](Tokens *cmd)-> void {
+        const bool reset = cmd->size() > 1 && cmd->at(1) == "reset";
+        size_t i = 0;
+        IOHC::iohcJsonArena::each([&](IOHC::iohcJsonArena &arena) {
+            if (reset) {
+                arena.resetStats();
+                return;
+            }
+            IOHC::JsonArenaStats stats = arena.stats();
+            Serial.printf("arena %u scopes %u allocations %u fallbacks %u peak %u/%u\n", (unsigned)i++, stats.scopes,
+                          stats.allocations, stats.fallbacks, stats.peak, (unsigned)arena.capacity());
+        });
+    });
+    Cmd::addHandler((char *) "commandQueue", (char *) "MQTT and web API commands: coalescing, results, latency", [](Tokens *cmd)-> void {
+        if (cmd->size() > 1 && cmd->at(1) == "reset") {
+            commandQueue.resetStats();
+            return;
+        }
+        IOHC::CommandQueueStats stats = commandQueue.stats();
+        Serial.printf("depth %u/%u max %u queued %u coalesced %u rejected %u\n", (unsigned)commandQueue.size(),
+                      COMMAND_QUEUE_DEPTH, stats.maxDepth, stats.queued, stats.coalesced, stats.rejected);
+        Serial.printf("executed %u acknowledged %u failed %u\n", stats.executed, stats.acknowledged, stats.failed);
+        auto latency = [](const char *name, const IOHC::LatencyHistogram &h) {
+            if (h.count)
+                Serial.printf("%s min %uus avg %uus p50 <%uus p99 <%uus max %uus\n", name, h.minUs, h.meanUs(),
+                              h.percentileUs(50), h.percentileUs(99), h.maxUs);
+        };
+        latency("ingress to worker", stats.waitLatency);
+        latency("ingress to air", stats.airLatency);
+    });
+#if defined(WEBSERVER)
+    Cmd::addHandler((char *) "apiCache", (char *) "Cached /api snapshots: 304s, hits, rebuilds, bytes saved", [](Tokens *cmd)-> void {
+        const bool reset = cmd->size() > 1 && cmd->at(1) == "reset";
+        auto show = [reset](const char *name, IOHC::iohcJsonSnapshot &snapshot) {
+            if (reset) {
+                snapshot.resetStats();
+                return;
+            }
+            IOHC::SnapshotStats stats = snapshot.stats();
+            const uint32_t cached = stats.notModified + stats.hits;
+            Serial.printf("%s requests %u notModified %u hits %u builds %u sent %llu saved %llu hit rate %u%%\n", name,
+                          stats.requests, stats.notModified, stats.hits, stats.builds,
+                          (unsigned long long)stats.bytesSent, (unsigned long long)stats.bytesSaved,
+                          stats.requests ? (unsigned)(100ull * cached / stats.requests) : 0);
+        };
+        show("/api/devices", devicesSnapshot);
+        show("/api/remotes", remotesSnapshot);
+#if defined(MQTT)
+        show("/api/mqtt", mqttSnapshot);
+#endif
+    });
+#endif
     Cmd::addHandler((char *) "ls", (char *) "List filesystem", [](Tokens *cmd)-> void { listFS(); });
     Cmd::addHandler((char *) "cat", (char *) "Print file content", [](Tokens *cmd)-> void { cat(cmd->at(1).c_str()); });
     Cmd::addHandler((char *) "rm", (char *) "Remove file", [](Tokens *cmd)-> void { rm(cmd->at(1).c_str()); });
@@ -430,6 +647,37 @@ void createCommands() {
         if (mqttStatus == ConnState::Connected)
             handleMqttConnect();
     });
+    Cmd::addHandler((char *) "discoveryStats", (char *) "Incremental HA discovery: configs published and skipped", [](Tokens *cmd)-> void {
+        if (cmd->size() > 1 && cmd->at(1) == "reset") {
+            discoveryCache.resetStats();
+            return;
+        }
+        if (cmd->size() > 1 && cmd->at(1) == "force") {
+            discoveryCache.invalidate();
+            if (mqttStatus == ConnState::Connected)
+                handleMqttConnect();
+            return;
+        }
+        IOHC::DiscoveryStats stats = discoveryCache.stats();
+        Serial.printf("configs %u passes %u published %u unchanged %u cleared %u last pass %ums\n",
+                      (unsigned)discoveryCache.size(), stats.passes, stats.published, stats.unchanged, stats.cleared,
+                      stats.lastPassMs);
+    });
+    Cmd::addHandler((char *) "mqttQueue", (char *) "MQTT outbound queue and publisher counters", [](Tokens *cmd)-> void {
+        if (cmd->size() > 1 && cmd->at(1) == "reset") {
+            mqttQueue.resetStats();
+            return;
+        }
+        IOHC::MqttQueueStats stats = mqttQueue.stats();
+        Serial.printf("depth %u/%u max %u%s congestions %u\n", (unsigned)mqttQueue.size(), MQTT_QUEUE_DEPTH,
+                      stats.maxDepth, mqttQueue.congested() ? " congested" : "", stats.congestions);
+        Serial.printf("queued %u coalesced %u dropped %u evicted %u skipped %u published %u retries %u\n", stats.queued,
+                      stats.coalesced, stats.dropped, stats.evicted, stats.skipped, stats.published, stats.retries);
+        const IOHC::LatencyHistogram &h = stats.latency;
+        if (h.count)
+            Serial.printf("latency min %uus avg %uus p50 <%uus p99 <%uus max %uus\n", h.minUs, h.meanUs(),
+                          h.percentileUs(50), h.percentileUs(99), h.maxUs);
+    });
 #endif
 /*
     Cmd::addHandler((char *) "list2W", (char *) "List received packets", [](Tokens *cmd)-> void {
@@ -444,6 +692,12 @@ void createCommands() {
     Cmd::addHandler((char *) "discover2A", (char *) "discover2A", [](Tokens *cmd)-> void {
         IOHC::iohcOtherDevice2W::getInstance()->cmd(IOHC::Other2WButton::discover2A, nullptr);
     });
+    Cmd::addHandler((char *) "help", (char *) "This command", [](Tokens *cmd)-> void {
+        Serial.printf("\nRegistered commands:\n");
+        for (size_t idx = 0; idx < commands.size(); ++idx)
+            Serial.printf("- %s\t%s\n", commands[idx].name, commands[idx].description);
+        Serial.printf("\n");
+    });
 /*
     Cmd::addHandler((char *) "fake0", (char *) "fake0", [](Tokens *cmd)-> void {
         IOHC::iohcCozyDevice2W::getInstance()->cmd(IOHC::DeviceButton::fake0, nullptr);
@@ -489,26 +743,10 @@ void createCommands() {
 }
 
 bool addHandler(char *cmd, char *description, void (*handler)(Tokens*)) {
-  for (uint8_t idx = 0; idx < MAXCMDS; ++idx) {
-    if (_cmdHandler[idx] != nullptr) {
-    } else {
-      // Use pre-allocated storage instead of malloc to avoid heap fragmentation
-      _cmdHandler[idx] = &_cmdHandlerStorage[idx];
-      memset(_cmdHandler[idx], 0, sizeof(struct _cmdEntry));
-      strncpy(_cmdHandler[idx]->cmd, cmd,
-              strlen(cmd) < sizeof(_cmdHandler[idx]->cmd) ? strlen(cmd)
-                                                          : sizeof(_cmdHandler[idx]->cmd) - 1);
-      strncpy(_cmdHandler[idx]->description, description,
-              strlen(cmd) < sizeof(_cmdHandler[idx]->description)
-                  ? strlen(description)
-                  : sizeof(_cmdHandler[idx]->description) - 1);
-      _cmdHandler[idx]->handler = handler;
-
-      if (idx > lastEntry)
-        lastEntry = idx;
-      return true;
-    }
-  }
+  // Statically allocated table, no heap fragmentation
+  if (commands.add(cmd, description, handler))
+    return true;
+  Serial.printf("*> Command %s not in the command table or already registered <*\n", cmd);
   return false;
 }
 
@@ -530,36 +768,112 @@ char *cmdReceived(bool echo) {
 }
 
 void cmdFuncHandler() {
-  constexpr char delim = ' ';
-  Tokens segments;
-
   char *cmd = cmdReceived(true);
   if (!cmd)
     return;
-  if (!strlen(cmd))
-    return;
+  if (commands.dispatch(cmd) == IOHC::CommandResult::Unknown)
+    Serial.printf("*> Unknown <*\n");
+}
 
-  tokenize(cmd, delim, segments);
-  if (strcmp((char *)"help", segments[0].c_str()) == 0) {
-    Serial.printf("\nRegistered commands:\n");
-    for (uint8_t idx = 0; idx <= lastEntry; ++idx) {
-      if (_cmdHandler[idx] == nullptr)
-        continue;
-      Serial.printf("- %s\t%s\n", _cmdHandler[idx]->cmd, _cmdHandler[idx]->description);
-    }
-    Serial.printf("- %s\t%s\n\n", (char *)"help", (char *)"This command");
-    Serial.printf("\n");
-    return;
+IOHC::iohcCommandQueue::Push submit(const IOHC::Command &command, uint32_t *ticket) {
+  const IOHC::iohcCommandQueue::Push pushed = commandQueue.push(command, esp_timer_get_time(), ticket);
+  if (pushed != IOHC::iohcCommandQueue::Push::Rejected && s_commandWorkerTask)
+    xTaskNotifyGive(s_commandWorkerTask);
+  return pushed;
+}
+
+// The 1W remote of a command, nullptr when removed meanwhile; under the remotes lock
+static const IOHC::iohcRemote1W::remote *remoteOf(const IOHC::Command &command) {
+  const IOHC::address node = {static_cast<uint8_t>(command.device >> 16), static_cast<uint8_t>(command.device >> 8),
+                              static_cast<uint8_t>(command.device)};
+  return IOHC::iohcRemote1W::getInstance()->find(node);
+}
+
+// Remote button, then the TX report of its frames: acknowledged once they went on air
+static bool runButton(const IOHC::Command &command, int64_t *airUs) {
+  const uint32_t ticket = command.ticket;
+  {
+    auto guard = IOHC::iohcRemote1W::getInstance()->lock();
+    const IOHC::iohcRemote1W::remote *r = remoteOf(command);
+    if (!r)
+      return false;
+    Tokens t;
+    t.push_back(std::to_string(command.value));
+    t.push_back(r->description);
+    if (!IOHC::iohcRemote1W::getInstance()->cmd(static_cast<IOHC::RemoteButton>(command.button), &t, [ticket](const IOHC::TxReport &report) {
+          const OnAir onAir = {ticket, report.status == IOHC::TxStatus::Sent ? report.startedUs : 0};
+          xQueueSend(s_commandOnAir, &onAir, 0);
+        }))
+      return false;
   }
-  for (uint8_t idx = 0; idx <= lastEntry; ++idx) {
-    if (_cmdHandler[idx] == nullptr)
+  // Late reports of earlier commands may be pending, skip them within what is left of the timeout
+  const TickType_t start = xTaskGetTickCount();
+  const TickType_t timeout = pdMS_TO_TICKS(COMMAND_AIR_TIMEOUT_MS);
+  OnAir onAir;
+  for (TickType_t elapsed = 0; elapsed < timeout; elapsed = xTaskGetTickCount() - start) {
+    if (xQueueReceive(s_commandOnAir, &onAir, timeout - elapsed) != pdTRUE)
+      break;
+    if (onAir.ticket != ticket)
       continue;
-    if (strcmp(_cmdHandler[idx]->cmd, segments[0].c_str()) == 0) {
-      _cmdHandler[idx]->handler(&segments);
-      return;
+    *airUs = onAir.startedUs;
+    return *airUs != 0;
+  }
+  return false;
+}
+
+static bool runCommand(const IOHC::Command &command, int64_t *airUs) {
+  switch (command.kind) {
+  case IOHC::CommandKind::Button:
+    return runButton(command, airUs);
+  case IOHC::CommandKind::TravelTime: {
+    auto guard = IOHC::iohcRemote1W::getInstance()->lock();
+    const IOHC::iohcRemote1W::remote *r = remoteOf(command);
+    return r && IOHC::iohcRemote1W::getInstance()->setTravelTime(r->description, command.value);
+  }
+  case IOHC::CommandKind::Line:
+    return commands.dispatch(command.text, ' ', command.argument.empty() ? nullptr : &command.argument) ==
+           IOHC::CommandResult::Done;
+  case IOHC::CommandKind::Topic:
+    return commands.dispatchTopic(command.text, command.argument) == IOHC::CommandResult::Done;
+  }
+  return false;
+}
+
+static void reportCommand(const IOHC::Command &command, bool acknowledged) {
+  switch (command.source) {
+  case IOHC::CommandSource::Mqtt:
+#if defined(MQTT)
+    mqttCommandDone(command, acknowledged);
+#endif
+    break;
+  case IOHC::CommandSource::Web:
+#if defined(WEBSERVER)
+    webCommandDone(command, acknowledged);
+#endif
+    break;
+  }
+}
+
+// NVS, the remotes file and the radio for the MQTT and web commands, off the TCP task, one command at a time
+static void commandWorkerTask(void * /*arg*/) {
+  IOHC::Command command;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+    while (commandQueue.pop(command, esp_timer_get_time())) {
+      int64_t airUs = 0;
+      const bool acknowledged = runCommand(command, &airUs);
+      commandQueue.done(command, acknowledged, airUs);
+      reportCommand(command, acknowledged);
     }
   }
-  Serial.printf("*> Unknown <*\n");
+}
+
+void startCommandWorker() {
+  if (s_commandWorkerTask)
+    return;
+  s_commandOnAir = xQueueCreate(COMMAND_ON_AIR_DEPTH, sizeof(OnAir));
+  xTaskCreatePinnedToCore(commandWorkerTask, "commandWorker", 8192, nullptr, 2, &s_commandWorkerTask,
+                          tskNO_AFFINITY);
 }
 
 void init() {
@@ -16,6 +16,7 @@
 
 #include <iohc2WCommands.h>
 #include <iohcDevice2W.h>
+#include <iohcFrame.h>
 #include <iohcPairingController.h>
 #include <iohcPacket.h>
 #include <iohcRadio.h>
@@ -211,37 +212,17 @@ void on2W(Tokens *cmd) {
         
         // ON/OFF plug control: CMD 0x00 with 6-byte payload (from TaHoma logs)
         // Format: 01 e7 00 00 00 00 for ON, 01 e7 c8 00 00 00 for OFF
-        iohcPacket* packet = new iohcPacket();
-        
-        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) + 5;
-        packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-        packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-        packet->buffer_length = 15;
-        
-        packet->payload.packet.header.CtrlByte2.asByte = 0;
+        iohcPacket* packet = iohcRadio::allocPacket();
         
     address myAddr = CONTROLLER_ADDRESS;
-        memcpy(packet->payload.packet.header.source, myAddr, 3);
-        memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
-        
-        packet->payload.packet.header.cmd = 0x00;
-        packet->payload.buffer[9] = 0x01;   // Originator type
-        packet->payload.buffer[10] = 0xe7;   // ACEI (actuator class/event identifier)
-        packet->payload.buffer[11] = 0x00;  // Main parameter (0x00 = ON)
-        packet->payload.buffer[12] = 0x00;  // Functional param 1
-        packet->payload.buffer[13] = 0x00;  // Functional param 2
-        packet->payload.buffer[14] = 0x00;  // Functional param 3
+        // Originator 01, ACEI e7, main parameter 0x0000 = ON, functional params 0
+        packet->buffer_length = iohcFrames::execute(packet->payload.buffer, myAddr, device->nodeAddress,
+                                                    0x01, 0xe7, 0x0000).finish();
         
         // Store command for later MAC calculation
         device->lastCommandByte = 0x00;  // CMD byte
         device->lastCommandLen = 6;
-        device->lastCommand[0] = 0x01;
-        device->lastCommand[1] = 0xe7;
-        device->lastCommand[2] = 0x00;  // ON = 0x00
-        device->lastCommand[3] = 0x00;
-        device->lastCommand[4] = 0x00;
-        device->lastCommand[5] = 0x00;
+        memcpy(device->lastCommand, packet->payload.buffer + 9, 6);
         
         packet->frequency = CHANNEL2;
         packet->repeatTime = 25;
@@ -251,7 +232,7 @@ void on2W(Tokens *cmd) {
         
         std::vector<iohcPacket*> packets;
         packets.push_back(packet);
-        radioInstance->send(packets);
+        radioInstance->send(packets, IOHC::TxPriority::Normal, IOHC::TxSource::Device2W);
         
         Serial.printf("Sent ON command to device %s\n", device->addressStr.c_str());
         Serial.println("Device will challenge - authentication is automatic");
@@ -279,37 +260,17 @@ void off2W(Tokens *cmd) {
         
         // ON/OFF plug control: CMD 0x00 with 6-byte payload (from TaHoma logs)
         // Format: 01 e7 00 00 00 00 for ON, 01 e7 c8 00 00 00 for OFF
-        iohcPacket* packet = new iohcPacket();
-        
-        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) + 5;
-        packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-        packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-        packet->buffer_length = 15;
-        
-        packet->payload.packet.header.CtrlByte2.asByte = 0;
+        iohcPacket* packet = iohcRadio::allocPacket();
         
     address myAddr = CONTROLLER_ADDRESS;
-        memcpy(packet->payload.packet.header.source, myAddr, 3);
-        memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
-        
-        packet->payload.packet.header.cmd = 0x00;
-        packet->payload.buffer[9] = 0x01;   // Originator type
-        packet->payload.buffer[10] = 0xe7;   // ACEI (actuator class/event identifier)
-        packet->payload.buffer[11] = 0xc8;  // Main parameter (0xc8 = OFF)
-        packet->payload.buffer[12] = 0x00;  // Functional param 1
-        packet->payload.buffer[13] = 0x00;  // Functional param 2
-        packet->payload.buffer[14] = 0x00;  // Functional param 3
+        // Originator 01, ACEI e7, main parameter 0xc800 = OFF, functional params 0
+        packet->buffer_length = iohcFrames::execute(packet->payload.buffer, myAddr, device->nodeAddress,
+                                                    0x01, 0xe7, 0xC800).finish();
         
         // Store command for later MAC calculation
         device->lastCommandByte = 0x00;  // CMD byte
         device->lastCommandLen = 6;
-        device->lastCommand[0] = 0x01;
-        device->lastCommand[1] = 0xe7;
-        device->lastCommand[2] = 0xc8;  // OFF = 0xc8
-        device->lastCommand[3] = 0x00;
-        device->lastCommand[4] = 0x00;
-        device->lastCommand[5] = 0x00;
+        memcpy(device->lastCommand, packet->payload.buffer + 9, 6);
         
         packet->frequency = CHANNEL2;
         packet->repeatTime = 25;
@@ -319,7 +280,7 @@ void off2W(Tokens *cmd) {
         
         std::vector<iohcPacket*> packets;
         packets.push_back(packet);
-        radioInstance->send(packets);
+        radioInstance->send(packets, IOHC::TxPriority::Normal, IOHC::TxSource::Device2W);
         
         Serial.printf("Sent OFF command to device %s\n", device->addressStr.c_str());
         Serial.println("Device will challenge - authentication is automatic");
@@ -346,24 +307,10 @@ void status2W(Tokens *cmd) {
         }
         
         // Send CMD 0x03 with payload 030000 to query status
-        iohcPacket* packet = new iohcPacket();
-        
-        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) + 2;
-        packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-        packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-        packet->buffer_length = 12;
-        
-        packet->payload.packet.header.CtrlByte2.asByte = 0;
+        iohcPacket* packet = iohcRadio::allocPacket();
         
     address myAddr = CONTROLLER_ADDRESS;
-        memcpy(packet->payload.packet.header.source, myAddr, 3);
-        memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
-        
-        packet->payload.packet.header.cmd = 0x03;
-        packet->payload.buffer[9] = 0x03;
-        packet->payload.buffer[10] = 0x00;
-        packet->payload.buffer[11] = 0x00;
+        packet->buffer_length = iohcFrames::getStatus(packet->payload.buffer, myAddr, device->nodeAddress).finish();
         
         packet->frequency = CHANNEL2;
         packet->repeatTime = 25;
@@ -373,7 +320,7 @@ void status2W(Tokens *cmd) {
         
         std::vector<iohcPacket*> packets;
         packets.push_back(packet);
-        radioInstance->send(packets);
+        radioInstance->send(packets, IOHC::TxPriority::Normal, IOHC::TxSource::Device2W);
         
         Serial.printf("Sent status query to device %s (check logs for CMD 0x04 response)\n", device->addressStr.c_str());
 }
@@ -407,29 +354,13 @@ void test2W(Tokens *cmd) {
         
         int dataLen = (cmd->size() > 6) ? 6 : 3;
         
-        iohcPacket* packet = new iohcPacket();
-        
-        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) + dataLen - 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-        packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-        packet->buffer_length = 9 + dataLen;
-        
-        packet->payload.packet.header.CtrlByte2.asByte = 0;
+        iohcPacket* packet = iohcRadio::allocPacket();
         
     address myAddr = CONTROLLER_ADDRESS;
-        memcpy(packet->payload.packet.header.source, myAddr, 3);
-        memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
-        
-        packet->payload.packet.header.cmd = cmdByte;
-        packet->payload.buffer[9] = byte1;
-        packet->payload.buffer[10] = byte2;
-        packet->payload.buffer[11] = byte3;
-        if (dataLen == 6) {
-            packet->payload.buffer[12] = byte4;
-            packet->payload.buffer[13] = byte5;
-            packet->payload.buffer[14] = byte6;
-        }
+        const uint8_t data[6] = {byte1, byte2, byte3, byte4, byte5, byte6};
+        iohcFrameBuilder frame = iohcFrames::request(packet->payload.buffer, static_cast<FrameCmd>(cmdByte), myAddr,
+                                                     device->nodeAddress);
+        packet->buffer_length = frame.bytes(data, dataLen).finish();
         
         packet->frequency = CHANNEL2;
         packet->repeatTime = 25;
@@ -439,7 +370,7 @@ void test2W(Tokens *cmd) {
         
         std::vector<iohcPacket*> packets;
         packets.push_back(packet);
-        radioInstance->send(packets);
+        radioInstance->send(packets, IOHC::TxPriority::Normal, IOHC::TxSource::Device2W);
         
         if (dataLen == 6) {
             Serial.printf("Sent CMD 0x%02X with payload %02X %02X %02X %02X %02X %02X to device %s\n", 
@@ -16,11 +16,14 @@
 
 #include "iohc2WResponseHandler.h"
 #include "iohcDevice2W.h"
+#include "iohcFrame.h"
 #include "iohcCryptoHelpers.h"
 #include "crypto2Wutils.h"
 #include "Aes.h"
 #include <Arduino.h>
 #include "user_config.h"
+#include <algorithm>
+#include <cstring>
 
 IOHC2WResponseHandler* IOHC2WResponseHandler::_instance = nullptr;
 
@@ -49,8 +52,9 @@ bool IOHC2WResponseHandler::handleChallenge(IOHC::iohcPacket* iohc) {
     
     Serial.println("� Received CMD 0x3C Challenge Request");
     // Store the challenge
-    if (iohc->payload.buffer[8] >= 6) {  // Check payload length
-        devMgr->storeChallenge(device->nodeAddress, &iohc->payload.buffer[9], 6);
+    IOHC::iohcChallengeView request(iohc->payload.buffer, iohc->buffer_length);
+    if (request.valid()) {  // 6 bytes of challenge
+        devMgr->storeChallenge(device->nodeAddress, request.challenge(), 6);
         Serial.printf("� Received challenge from device %s: %02X%02X%02X%02X%02X%02X\n",
                      device->addressStr.c_str(),
                      device->lastChallenge[0], device->lastChallenge[1], 
@@ -76,39 +80,28 @@ bool IOHC2WResponseHandler::handleChallenge(IOHC::iohcPacket* iohc) {
             // Build frame data for CMD 0x3D authentication
             // According to linklayer.md: "The initial value is always created using data from the requesting command"
             // So frame_data should be the ORIGINAL command (e.g., CMD 0x00 for on/off), not CMD 0x3D!
-            std::vector<uint8_t> frame_data;
-            frame_data.push_back(device->lastCommandByte);  // Original command byte (e.g., 0x00)
+            uint8_t frame_data[1 + sizeof(device->lastCommand)];
+            size_t frame_len = 1 + std::min<size_t>(device->lastCommandLen, sizeof(device->lastCommand));
+            frame_data[0] = device->lastCommandByte;  // Original command byte (e.g., 0x00)
             // Add the command payload (data after CMD byte)
-            for (int i = 0; i < device->lastCommandLen; i++) {
-                frame_data.push_back(device->lastCommand[i]);
-            }
+            memcpy(frame_data + 1, device->lastCommand, frame_len - 1);
             
             // Debug: Show frame data
             Serial.print("[Auth] Frame Data (original command): ");
-            for (uint8_t byte : frame_data) {
-                Serial.printf("%02X", byte);
+            for (size_t i = 0; i < frame_len; i++) {
+                Serial.printf("%02X", frame_data[i]);
             }
             Serial.println();
             
             // Calculate MAC
             uint8_t mac[6];
-            iohcCrypto::create_2W_hmac(mac, device->lastChallenge, device->systemKey, frame_data);
+            iohcCrypto::create_2W_hmac(mac, device->lastChallenge, device->systemKey, frame_data, frame_len);
             
             // Create and send CMD 0x3D packet
-            IOHC::iohcPacket* packet = new IOHC::iohcPacket();
-            packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(IOHC::_header) + 5;
-            packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-            packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-            packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-            packet->buffer_length = 15;
-            packet->payload.packet.header.CtrlByte2.asByte = 0;
-            
+            IOHC::iohcPacket* packet = IOHC::iohcRadio::allocPacket();
             address myAddr = CONTROLLER_ADDRESS;
-            memcpy(packet->payload.packet.header.source, myAddr, 3);
-            memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
-            
-            packet->payload.packet.header.cmd = 0x3D;
-            memcpy(packet->payload.buffer + 9, mac, 6);
+            packet->buffer_length = IOHC::iohcFrames::challengeAnswer(packet->payload.buffer, myAddr,
+                                                                      device->nodeAddress, mac).finish();
             
             packet->frequency = CHANNEL2;
             packet->repeatTime = 25;
@@ -118,7 +111,7 @@ bool IOHC2WResponseHandler::handleChallenge(IOHC::iohcPacket* iohc) {
             
             std::vector<IOHC::iohcPacket*> packets;
             packets.push_back(packet);
-            _radioInstance->send(packets);
+            _radioInstance->send(packets, IOHC::TxPriority::Urgent, IOHC::TxSource::Response2W);
             
         
             Serial.printf("✅ Sent CMD 0x3D authentication (MAC: %02X%02X%02X%02X%02X%02X)\n",
@@ -15,6 +15,7 @@
  */
 
 #include <iohcCozyDevice2W.h>
+#include <iohcFrame.h>
 #include <LittleFS.h>
 #include <iohcCryptoHelpers.h>
 #include <ArduinoJson.h>
@@ -42,17 +43,9 @@ namespace IOHC {
         digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
         IOHC::relStamp = esp_timer_get_time();
 
-        // Common Flags
-        // 8 if protocol version is 0 else 10
-        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-        packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-        packet->payload.packet.header.CtrlByte2.asByte = 0;
-
-        packet->payload.packet.header.CtrlByte1.asByte += toSend.size();
-        memcpy(packet->payload.buffer + 9, toSend.data(), toSend.size());
-        packet->buffer_length = toSend.size() + 9;
+        // Common Flags: start frame, command and addresses set by the caller
+        iohcFrameBuilder frame(packet->payload.buffer, 0x00);
+        packet->buffer_length = frame.bytes(toSend.data(), toSend.size()).finish();
 
         packet->frequency = CHANNEL2;
         packet->repeatTime = 25;
@@ -85,7 +78,7 @@ namespace IOHC {
                 std::vector<uint8_t> toSend = {};
 
                 packets2send.clear();
-                auto* packet = new iohcPacket;
+                auto* packet = iohcRadio::allocPacket();
                 forgePacket(packet, toSend);
 
                 packet->payload.packet.header.cmd = iohcDevice::SEND_ASK_CHALLENGE_0x31;
@@ -100,14 +93,14 @@ namespace IOHC {
 
                 packets2send.push_back(packet);
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
                 break;
             }
             case DeviceButton::powerOn: {
                 std::vector<uint8_t> toSend = {0x0C, 0x60, 0x01, 0x2C};
 
                 packets2send.clear();
-                auto* packet = new iohcPacket;
+                auto* packet = iohcRadio::allocPacket();
                 forgePacket(packet, toSend);
 
                 packet->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
@@ -121,7 +114,7 @@ namespace IOHC {
 
                 packets2send.push_back(packet);
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
 
                 break;
             }
@@ -136,7 +129,7 @@ namespace IOHC {
                 else addr = std::stoi(data->at(2));
 
                 packets2send.clear();
-                auto* packet = new iohcPacket;
+                auto* packet = iohcRadio::allocPacket();
                 forgePacket(packet, toSend);
 
                 packet->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
@@ -152,7 +145,7 @@ namespace IOHC {
 
                 packets2send.push_back(packet);
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
                 //                mqttClient.publish("iown/Frame", 0, false, message.c_str(), messageSize);
 
                 break;
@@ -175,7 +168,7 @@ namespace IOHC {
 
                 packets2send.clear();
                 for (const auto &addr: addresses) {
-                    packets2send.push_back(new iohcPacket);
+                    packets2send.push_back(iohcRadio::allocPacket());
                     forgePacket(packets2send.back(), toSend);
 
                     packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
@@ -192,7 +185,7 @@ namespace IOHC {
                 packets2send[1]->delayed = 250;
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
 
                 break;
             }
@@ -204,7 +197,7 @@ namespace IOHC {
                 if (strcasecmp(dat, "off") == 0) toSend[4] = 0x00;
 
                 packets2send.clear();
-                packets2send.push_back(new iohcPacket);
+                packets2send.push_back(iohcRadio::allocPacket());
                 forgePacket(packets2send.back(), toSend);
 
                 packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
@@ -217,7 +210,7 @@ namespace IOHC {
                 memcpy(packets2send.back()->payload.packet.header.target, master_to, 3);
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
                 break;
             }
             case DeviceButton::setWindow: {
@@ -232,7 +225,7 @@ namespace IOHC {
                 else addr = std::stoi(data->at(2));
 
                 packets2send.clear();
-                packets2send.push_back(new iohcPacket);
+                packets2send.push_back(iohcRadio::allocPacket());
                 forgePacket(packets2send.back(), toSend);
 
                 packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
@@ -247,7 +240,7 @@ namespace IOHC {
                 packets2send.back()->delayed = 50;
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
                 break;
             }
             case DeviceButton::midnight: {
@@ -256,7 +249,7 @@ namespace IOHC {
                 //, 0x2b, 0x05, 0x00, 0x0f, 0x04, 0x0c, 0xe7, 0x07};
 
                 packets2send.clear();
-                packets2send.push_back(new iohcPacket);
+                packets2send.push_back(iohcRadio::allocPacket());
                 forgePacket(packets2send.back(), toSend);
 
                 packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
@@ -269,7 +262,7 @@ namespace IOHC {
                 memcpy(packets2send.back()->payload.packet.header.target, master_to, 3);
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
 
                 break;
             }
@@ -1,5 +1,6 @@
 #include "iohcDevice2W.h"
 #include "iohcPacket.h"
+#include "iohcRadio.h"
 #include "fileSystemHelpers.h"
 #include "log_buffer.h"
 #include <ArduinoJson.h>
@@ -291,78 +292,89 @@ bool Device2W::fromJson(const String& addressKey, const String& jsonStr) {
 
 // Device2WManager implementation
 
+void Device2WManager::insert(Device2W* device) {
+    iohcDeviceIndex& index = iohcDeviceIndex::instance();
+    uint32_t slot = index.find(DeviceKind::Device2W, device->nodeAddress);
+    if (slot < devices.size()) {
+        delete devices[slot];
+        devices[slot] = device;
+        return;
+    }
+    devices.push_back(device);
+    index.put(DeviceKind::Device2W, device->nodeAddress, devices.size() - 1);
+}
+
 Device2W* Device2WManager::addDevice(const address& addr) {
-    char addrStr[7];
-    snprintf(addrStr, sizeof(addrStr), "%02x%02x%02x", addr[0], addr[1], addr[2]);
-    String addrKey = String(addrStr);
-    
     // Check if already exists
-    auto it = devices.find(addrKey);
-    if (it != devices.end()) {
-        return it->second;
+    if (Device2W* existing = getDevice(addr)) {
+        return existing;
     }
     
     // Create new device
     Device2W* device = new Device2W(addr);
-    devices[addrKey] = device;
+    insert(device);
     
-    addLogMessage(("Added 2W device: " + addrKey).c_str());
+    addLogMessage(("Added 2W device: " + device->addressStr).c_str());
     return device;
 }
 
 Device2W* Device2WManager::getDevice(const address& addr) {
-    char addrStr[7];
-    snprintf(addrStr, sizeof(addrStr), "%02x%02x%02x", addr[0], addr[1], addr[2]);
-    return getDevice(String(addrStr));
+    uint32_t slot = iohcDeviceIndex::instance().find(DeviceKind::Device2W, addr);
+    return slot < devices.size() ? devices[slot] : nullptr;
 }
 
 Device2W* Device2WManager::getDevice(const String& addrStr) {
-    auto it = devices.find(addrStr);
-    if (it != devices.end()) {
-        return it->second;
+    address addr;
+    if (!iohcDeviceIndex::parseAddress(addrStr.c_str(), addrStr.length(), addr)) {
+        return nullptr;
     }
-    return nullptr;
+    return getDevice(addr);
 }
 
 bool Device2WManager::removeDevice(const address& addr) {
-    char addrStr[7];
-    snprintf(addrStr, sizeof(addrStr), "%02x%02x%02x", addr[0], addr[1], addr[2]);
-    return removeDevice(String(addrStr));
+    iohcDeviceIndex& index = iohcDeviceIndex::instance();
+    uint32_t slot = index.find(DeviceKind::Device2W, addr);
+    if (slot >= devices.size()) {
+        return false;
+    }
+    addLogMessage(("Removed 2W device: " + devices[slot]->addressStr).c_str());
+    delete devices[slot];
+    index.erase(DeviceKind::Device2W, addr);
+    // The last device takes the freed slot
+    if (slot != devices.size() - 1) {
+        devices[slot] = devices.back();
+        index.put(DeviceKind::Device2W, devices[slot]->nodeAddress, slot);
+    }
+    devices.pop_back();
+    return true;
 }
 
 bool Device2WManager::removeDevice(const String& addrStr) {
-    auto it = devices.find(addrStr);
-    if (it != devices.end()) {
-        delete it->second;
-        devices.erase(it);
-        addLogMessage(("Removed 2W device: " + addrStr).c_str());
-        return true;
-    }
-    return false;
+    address addr;
+    if (!iohcDeviceIndex::parseAddress(addrStr.c_str(), addrStr.length(), addr)) {
+        return false;
+    }
+    return removeDevice(addr);
 }
 
 std::vector<Device2W*> Device2WManager::getAllDevices() {
-    std::vector<Device2W*> result;
-    for (auto& pair : devices) {
-        result.push_back(pair.second);
-    }
-    return result;
+    return devices;
 }
 
 std::vector<Device2W*> Device2WManager::getDevicesByState(PairingState state) {
     std::vector<Device2W*> result;
-    for (auto& pair : devices) {
-        if (pair.second->pairingState == state) {
-            result.push_back(pair.second);
+    for (Device2W* device : devices) {
+        if (device->pairingState == state) {
+            result.push_back(device);
         }
     }
     return result;
 }
 
 Device2W* Device2WManager::findDeviceInPairing() {
-    for (auto& pair : devices) {
-        if (pair.second->isPairing()) {
-            return pair.second;
+    for (Device2W* device : devices) {
+        if (device->isPairing()) {
+            return device;
         }
     }
     return nullptr;
@@ -391,14 +403,20 @@ bool Device2WManager::loadFromFile() {
     
     // Parse each device
     int count = 0;
-    for (JsonPair kv : doc.as<JsonObject>()) {
+    JsonObject root = doc.as<JsonObject>();
+    iohcDeviceIndex::instance().reserve(root.size());
+    for (JsonPair kv : root) {
         String addrKey = kv.key().c_str();
         String deviceJson;
         serializeJson(kv.value(), deviceJson);
         
         Device2W* device = new Device2W();
         if (device->fromJson(addrKey, deviceJson)) {
-            devices[addrKey] = device;
+            insert(device);
+            // Power save mode is only known once the discovery answer was received
+            if (device->capabilities.nodeType)
+                iohcRadio::wakeTracker().setPower(device->nodeAddress,
+                                                  wakePowerFromMultiInfo(device->capabilities.multiInfo));
             count++;
         } else {
             delete device;
@@ -412,11 +430,11 @@ bool Device2WManager::loadFromFile() {
 bool Device2WManager::saveToFile() {
     JsonDocument doc;
     
-    for (auto& pair : devices) {
-        String deviceJson = pair.second->toJson();
+    for (Device2W* device : devices) {
+        String deviceJson = device->toJson();
         JsonDocument deviceDoc;
         deserializeJson(deviceDoc, deviceJson);
-        doc[pair.first] = deviceDoc;
+        doc[device->addressStr] = deviceDoc;
     }
     
     fs::File f = LittleFS.open(jsonFilePath.c_str(), "w");
@@ -492,6 +510,7 @@ bool Device2WManager::updateFromDiscoveryAnswer(const address& addr, const uint8
     device->capabilities.rfSupport = (multiInfo & 0x08) == 0;               // bit 3 (inverted: 0=Yes, 1=No)
     device->capabilities.ioMembership = (multiInfo & 0x04) == 0;            // bit 2 (inverted: 0=Yes, 1=No)
     device->capabilities.powerSaveMode = multiInfo & 0x03;                  // bits 1-0
+    iohcRadio::wakeTracker().setPower(addr, wakePowerFromMultiInfo(multiInfo));
     
     device->touch();
     
@@ -612,17 +631,18 @@ bool Device2WManager::storeSessionKey(const address& addr, const uint8_t* key, s
 void Device2WManager::removeTimedOutDevices() {
     std::vector<String> toRemove;
     
-    for (auto& pair : devices) {
-        if (pair.second->hasPairingTimedOut()) {
-            pair.second->pairingState = PairingState::PAIRING_FAILED;
-            addLogMessage(("Pairing timeout for " + pair.first).c_str());
+    for (Device2W* device : devices) {
+        if (device->hasPairingTimedOut()) {
+            device->pairingState = PairingState::PAIRING_FAILED;
+            addLogMessage(("Pairing timeout for " + device->addressStr).c_str());
         }
     }
 }
 
 void Device2WManager::clear() {
-    for (auto& pair : devices) {
-        delete pair.second;
+    for (Device2W* device : devices) {
+        delete device;
     }
     devices.clear();
+    iohcDeviceIndex::instance().clear(DeviceKind::Device2W);
 }
@@ -15,6 +15,7 @@
  */
 
 #include <iohcOtherDevice2W.h>
+#include <iohcFrame.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <iohcCryptoHelpers.h>
@@ -44,25 +45,16 @@ namespace IOHC {
         digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
         IOHC::relStamp = esp_timer_get_time();
 
-        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-
-        packet->payload.packet.header.cmd = 0x28; // 2W Discovery command (not 0x2A which is for remotes)
-        // Common Flags
-        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-        packet->payload.packet.header.CtrlByte2.asByte = 0;
-        packet->payload.packet.header.CtrlByte2.asStruct.Prio = 1;
-        packet->payload.packet.header.CtrlByte2.asStruct.LPM = 0;
-
         // Broadcast Target
         u_int16_t bcast = typn;
         //            uint16_t bcast = /*(_type.at(typn)<<6)*/(typn)<<6 + 0b111111;
-        packet->payload.packet.header.target[0] = 0x00;
-        packet->payload.packet.header.target[1] = bcast >> 8;
-        packet->payload.packet.header.target[2] = bcast & 0x00ff;
+        const uint8_t broadcast[3] = {0x00, static_cast<uint8_t>(bcast >> 8), static_cast<uint8_t>(bcast & 0x00ff)};
 
-        packet->payload.packet.header.CtrlByte1.asByte += toSend.size();
-        memcpy(packet->payload.buffer + 9, toSend.data(), toSend.size());
-        packet->buffer_length = toSend.size() + 9;
+        // 2W Discovery command (not 0x2A which is for remotes)
+        // Common Flags: Prio, start frame set by the caller
+        iohcFrameBuilder frame(packet->payload.buffer, FrameCmd::Discover);
+        frame.to(broadcast).first(false).priority().bytes(toSend.data(), toSend.size());
+        packet->buffer_length = frame.finish();
 
         packet->frequency = CHANNEL2;
         packet->repeatTime = 50;
@@ -82,7 +74,7 @@ namespace IOHC {
             case Other2WButton::discovery: {
                 // Send 2W discovery broadcast (CMD 0x28) to address 0x00003B
                 // Based on analysis: "FROM AA9BFA TO 00003B CMD 28 DATA(00)"
-                packets2send.push_back(new iohcPacket);
+                packets2send.push_back(iohcRadio::allocPacket());
 
                 std::vector<uint8_t> toSend = {}; // NO payload data for discovery
                 forgePacket(packets2send.back(), toSend, 0x003B); // 0x003B = 2W broadcast address
@@ -96,7 +88,7 @@ namespace IOHC {
                 memcpy(packets2send.back()->payload.packet.header.source, fake_gateway, 3);
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Background, TxSource::Discovery);
                 break;
             }
             case Other2WButton::getName: {
@@ -113,7 +105,7 @@ namespace IOHC {
                 // uint8_t target[3] = {0x08, 0x42, 0xE3};
                 // toSend[3] = custom;
 
-                packets2send.push_back(new iohcPacket);
+                packets2send.push_back(iohcRadio::allocPacket());
                 forgePacket(packets2send.back(), toSend, 0);
                 packets2send.back()->payload.packet.header.cmd = SEND_GET_NAME_0x50;
                 // memorizeSend.memorizedData = toSend;
@@ -130,7 +122,7 @@ namespace IOHC {
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 // packets2send.back()->delayed = 501;
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
                 break;
             }
             case Other2WButton::custom: {
@@ -152,7 +144,7 @@ namespace IOHC {
                     address to_1 = {0x05, 0x4e, 0x17}; //{0x31, 0x58, 0x24}; //
 
 //                    packets2send.clear();
-                    packets2send.push_back(new iohcPacket);
+                    packets2send.push_back(iohcRadio::allocPacket());
                     forgePacket(packets2send.back(), toSend);
 
                     packets2send.back()->payload.packet.header.cmd = 0x00; //SEND_WRITE_PRIVATE_0x20;
@@ -170,7 +162,7 @@ namespace IOHC {
                     packets2send.back()->delayed = 250; // Give enough time for the answer
                 }
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
                 break;
             }
             case Other2WButton::custom60: {
@@ -184,7 +176,7 @@ namespace IOHC {
                 toSend[3] = custom; //custom;
 
 //                packets2send.clear();
-                packets2send.push_back(new iohcPacket);
+                packets2send.push_back(iohcRadio::allocPacket());
                 forgePacket(packets2send.back(), toSend);
 
                 packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
@@ -201,7 +193,7 @@ namespace IOHC {
 
                 packets2send.back()->delayed = 250;
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
                 break;
             }
             case Other2WButton::discover28: {
@@ -213,7 +205,7 @@ namespace IOHC {
 //                packets2send.clear();
                 size_t i = 0;
                 for (i = 0; i < 10; i++) {
-                    packets2send.push_back(new iohcPacket);
+                    packets2send.push_back(iohcRadio::allocPacket());
                     forgePacket(packets2send[i], toSend);
 
                     packets2send[i]->payload.packet.header.cmd = iohcDevice::SEND_DISCOVER_0x28;
@@ -232,7 +224,7 @@ namespace IOHC {
                     packets2send[i]->delayed = 250; // Give enough time for the answer
                 }
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Background, TxSource::Discovery);
                 break;
             }
             case Other2WButton::discover2A: {
@@ -256,7 +248,7 @@ namespace IOHC {
 
 //                packets2send.clear();
                 for (size_t i = 0; i < 2; i++) {
-                    packets2send.push_back(new iohcPacket);
+                    packets2send.push_back(iohcRadio::allocPacket());
 
                     if (i > 20) {
                         std::vector<uint8_t> toSend = {0x00};
@@ -299,7 +291,7 @@ namespace IOHC {
                 }
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Background, TxSource::Discovery);
 
                 break;
             }
@@ -324,7 +316,7 @@ namespace IOHC {
 //                packets2send.clear();
                 size_t i = 0;
                 for (i = 0; i < 15; i++) {
-                    packets2send.push_back(new iohcPacket);
+                    packets2send.push_back(iohcRadio::allocPacket());
                     forgePacket(packets2send.back(), toSend);
 
                     packets2send.back()->payload.packet.header.cmd = 0x00;
@@ -344,7 +336,7 @@ namespace IOHC {
                     packets2send.back()->repeatTime = 250; // Slow down discover loop
                 }
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
 
                 break;
             }
@@ -352,7 +344,7 @@ namespace IOHC {
                 std::vector<uint8_t> toSend = {};
 
 //                packets2send.clear();
-                packets2send.push_back(new iohcPacket);
+                packets2send.push_back(iohcRadio::allocPacket());
                 forgePacket(packets2send.back(), toSend);
 
                 packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_KEY_TRANSFERT_ACK_0x33;
@@ -365,7 +357,7 @@ namespace IOHC {
                 memcpy(packets2send.back()->payload.packet.header.target, master_from, 3);
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
                 break;
             }
             case Other2WButton::checkCmd: {
@@ -427,7 +419,7 @@ namespace IOHC {
                         if (command.first == 0x60 || command.first == 0x82)
                             toSend.assign(special12, special12 + 21);
 
-                        packets2send.push_back(new iohcPacket);
+                        packets2send.push_back(iohcRadio::allocPacket());
                         forgePacket(packets2send.back(), toSend);
                         packets2send.back()->payload.packet.header.cmd = command.first;
                         memorizeOther2W.memorizedCmd = packets2send.back()->payload.packet.header.cmd;
@@ -453,7 +445,7 @@ namespace IOHC {
                 Serial.printf("valid %u\n", counter);
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 
-                _radioInstance->send(packets2send);
+                _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Device2W);
 
                 break;
             }
@@ -617,7 +609,7 @@ namespace IOHC {
             
             // Send discovery broadcast
             instance->packets2send.clear();
-            instance->packets2send.push_back(new iohcPacket);
+            instance->packets2send.push_back(iohcRadio::allocPacket());
 
             std::vector<uint8_t> toSend = {}; // NO payload data for discovery
             instance->forgePacket(instance->packets2send.back(), toSend, 0x003B); // 0x003B = 2W broadcast address
@@ -631,7 +623,7 @@ namespace IOHC {
             memcpy(instance->packets2send.back()->payload.packet.header.source, fake_gateway, 3);
 
             digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-            instance->_radioInstance->send(instance->packets2send);
+            instance->_radioInstance->send(instance->packets2send, TxPriority::Background, TxSource::Discovery, 1000); // Superseded by the next broadcast
             
             instance->discoveryCount++;
             Serial.printf("📡 Discovery broadcast sent (%lu/%d seconds)\n", instance->discoveryCount, 60);
@@ -1,5 +1,6 @@
 #include "iohcPairingController.h"
 #include "iohcPacket.h"
+#include "iohcFrame.h"
 #include "iohcRadio.h"
 #include "iohcCryptoHelpers.h"
 #include "crypto2Wutils.h"
@@ -680,30 +681,15 @@ void PairingController::process() {
 
 bool PairingController::sendPairingBroadcast() {
     // CMD 0x28 - Discovery/Pairing (matches TaHoma Box, no payload)
-    iohcPacket* packet = new iohcPacket();
+    iohcPacket* packet = iohcRadio::allocPacket();
     
-    // Set up packet structure
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 1;  // Both start and end frame!
-    // No payload data - CMD 0x28 has no data (unlike CMD 0x2A)
-    packet->buffer_length = 9;  // Just header, no payload
-    
-    // CtrlByte2: Set LPM and Prio flags like discover28
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
-    packet->payload.packet.header.CtrlByte2.asStruct.LPM = 1;   // Low Power Mode flag
-    packet->payload.packet.header.CtrlByte2.asStruct.Prio = 1;  // Priority flag
-    
-    // Source: controller address
+    // Controller to the 2W broadcast address (CMD 0x28 MUST be broadcast, not targeted), no payload
+    // CtrlByte2: LPM and Prio flags like discover28
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    
-    // Target: 2W broadcast address (CMD 0x28 MUST be broadcast, not targeted)
     address broadcast2W = {0x00, 0x00, 0x3B};
-    memcpy(packet->payload.packet.header.target, broadcast2W, 3);
+    packet->buffer_length = iohcFrames::discover(packet->payload.buffer, myAddr, broadcast2W).lowPower().priority()
+                                .finish();
     
-    packet->payload.packet.header.cmd = 0x28;  // CMD 0x28 like TaHoma Box
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;  // No hardware repeats - we'll resend in process()
@@ -732,26 +718,11 @@ bool PairingController::sendPairingBroadcast() {
 
 bool PairingController::sendAliveCheck(Device2W* device) {
     // CMD 0x2C - Actuator Alive Check (no payload)
-    iohcPacket* packet = new iohcPacket();
-    
-    // Set up packet structure (no payload)
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->payload.packet.header.CtrlByte1.asByte += 0;  // No payload
-    packet->buffer_length = 9;  // Just header
+    iohcPacket* packet = iohcRadio::allocPacket();
     
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
-    
-    // Source: controller address
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    
-    // Target: specific device address
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::aliveCheck(packet->payload.buffer, myAddr, device->nodeAddress).finish();
     
-    packet->payload.packet.header.cmd = 0x2C;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -775,33 +746,17 @@ bool PairingController::sendAliveCheck(Device2W* device) {
 bool PairingController::send2ABroadcast() {
     // CMD 0x2A - Pairing Broadcast (12-byte payload)
     // From log: DATA(12) 01386e3c72c82ef848407773
-    iohcPacket* packet = new iohcPacket();
+    iohcPacket* packet = iohcRadio::allocPacket();
     
     // Use the 12-byte payload from the log
     uint8_t payload[12] = {0x01, 0x38, 0x6E, 0x3C, 0x72, 0xC8, 
                            0x2E, 0xF8, 0x48, 0x40, 0x77, 0x73};
     
-    // Set up packet structure
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 1;  // Both start and end
-    packet->payload.packet.header.CtrlByte1.asByte += 12;
-    memcpy(packet->payload.buffer + 9, payload, 12);
-    packet->buffer_length = 12 + 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
-    packet->payload.packet.header.CtrlByte2.asStruct.LPM = 1;  // Low Power Mode flag from log
-    
-    // Source: controller address
+    // Controller to the 2W broadcast address, single frame with the LPM flag as in the log
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    
-    // Target: 2W broadcast address
     address broadcast2W = {0x00, 0x00, 0x3B};
-    memcpy(packet->payload.packet.header.target, broadcast2W, 3);
+    packet->buffer_length = iohcFrames::discoverRemote(packet->payload.buffer, myAddr, broadcast2W, payload).finish();
     
-    packet->payload.packet.header.cmd = 0x2A;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -820,29 +775,14 @@ bool PairingController::sendLearningMode(Device2W* device) {
     // CMD 0x2E - 1W Learning mode (1-byte payload: 0x02)
     // NOTE: This is NOT used in the new pairing sequence!
     // Kept for backward compatibility only.
-    iohcPacket* packet = new iohcPacket();
+    iohcPacket* packet = iohcRadio::allocPacket();
     
     uint8_t payload = 0x02;
     
-    // Set up packet structure
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->payload.packet.header.CtrlByte1.asByte += 1;
-    packet->payload.buffer[9] = payload;
-    packet->buffer_length = 1 + 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
-    
-    // Source: controller address
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    
-    // Target: specific device address
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::learningMode(packet->payload.buffer, myAddr, device->nodeAddress, payload)
+                                .finish();
     
-    packet->payload.packet.header.cmd = 0x2E;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -866,26 +806,12 @@ bool PairingController::sendLearningMode(Device2W* device) {
 
 bool PairingController::sendPriorityAddressRequest(Device2W* device) {
     // CMD 0x36 - Priority Address Request (no payload)
-    iohcPacket* packet = new iohcPacket();
+    iohcPacket* packet = iohcRadio::allocPacket();
     
-    // Set up packet structure (no payload)
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->buffer_length = 9;  // Header only, no payload
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
-    packet->payload.packet.header.CtrlByte2.asStruct.Prio = 1;  // Set priority flag
-    
-    // Source: controller address
+    // Priority flag set by the builder
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
+    packet->buffer_length = iohcFrames::addressRequest(packet->payload.buffer, myAddr, device->nodeAddress).finish();
     
-    // Target: specific device address
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
-    
-    packet->payload.packet.header.cmd = 0x36;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -907,7 +833,7 @@ bool PairingController::sendPriorityAddressRequest(Device2W* device) {
 
 bool PairingController::sendChallengeToPair(Device2W* device) {
     // CMD 0x3C - Send Challenge Request to device (6-byte challenge)
-    iohcPacket* packet = new iohcPacket();
+    iohcPacket* packet = iohcRadio::allocPacket();
     
     // Generate random 6-byte challenge
     for (int i = 0; i < 6; i++) {
@@ -915,25 +841,11 @@ bool PairingController::sendChallengeToPair(Device2W* device) {
     }
     hasChallenge = true;
     
-    // Set up packet structure
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->payload.packet.header.CtrlByte1.asByte += 6;
-    memcpy(packet->payload.buffer + 9, deviceChallenge, 6);
-    packet->buffer_length = 6 + 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
-    
-    // Source: controller address
+    // Sent in the middle of the exchange started by CMD 0x36: neither start nor end frame
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    
-    // Target: specific device address
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::challengeRequest(packet->payload.buffer, myAddr, device->nodeAddress,
+                                                         deviceChallenge).finish();
     
-    packet->payload.packet.header.cmd = 0x3C;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -965,22 +877,12 @@ bool PairingController::sendAskChallenge(Device2W* device) {
     
     addLogMessage("🔑 Sending CMD 0x31 (Ask Challenge) to initiate Push key exchange");
     
-    iohcPacket* packet = new iohcPacket();
-    
-    // Set up packet structure - CMD 0x31 has no payload
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->buffer_length = 9;  // Header only, no payload
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
+    iohcPacket* packet = iohcRadio::allocPacket();
     
+    // CMD 0x31 has no payload
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::askChallenge(packet->payload.buffer, myAddr, device->nodeAddress).finish();
     
-    packet->payload.packet.header.cmd = 0x31;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -1014,24 +916,12 @@ bool PairingController::sendForceKeyExchange(Device2W* device) {
              deviceChallenge[3], deviceChallenge[4], deviceChallenge[5]);
     addLogMessage(challengeMsg);
     
-    iohcPacket* packet = new iohcPacket();
-    
-    // Set up packet structure  
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->payload.packet.header.CtrlByte1.asByte += 6;
-    memcpy(packet->payload.buffer + 9, deviceChallenge, 6);
-    packet->buffer_length = 6 + 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
+    iohcPacket* packet = iohcRadio::allocPacket();
     
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::launchKeyTransfer(packet->payload.buffer, myAddr, device->nodeAddress,
+                                                          deviceChallenge).finish();
     
-    packet->payload.packet.header.cmd = 0x38;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -1063,7 +953,7 @@ bool PairingController::sendChallengeResponse(Device2W* device) {
         // Continue with simple copy for pairing process
     }
     
-    iohcPacket* packet = new iohcPacket();
+    iohcPacket* packet = iohcRadio::allocPacket();
     
     // Generate response using proper crypto if we have the system key
     uint8_t response[6];
@@ -1072,15 +962,14 @@ bool PairingController::sendChallengeResponse(Device2W* device) {
         // Create frame data for MAC calculation
         // According to linklayer.md: "The initial value is always created using data from the requesting command"
         // This means we use the command that triggered the challenge (e.g., 0x32 for key transfer, 0x36 for address request)
-        std::vector<uint8_t> frame_data;
-        frame_data.push_back(commandBeingAuthenticated);  // Command that is being authenticated
+        uint8_t frame_data[1] = {commandBeingAuthenticated};  // Command that is being authenticated
         
         char cmdMsg[64];
         snprintf(cmdMsg, sizeof(cmdMsg), "Authenticating CMD 0x%02X with challenge", commandBeingAuthenticated);
         addLogMessage(cmdMsg);
         
         // Generate MAC using 2W HMAC algorithm
-        iohcCrypto::create_2W_hmac(response, deviceChallenge, systemKey2W, frame_data);
+        iohcCrypto::create_2W_hmac(response, deviceChallenge, systemKey2W, frame_data, sizeof(frame_data));
         addLogMessage("✅ Generated proper CMD 0x3D MAC using system key");
     } else {
         // Fallback for pairing when we don't have key yet
@@ -1088,25 +977,11 @@ bool PairingController::sendChallengeResponse(Device2W* device) {
         addLogMessage("⚠️  Using simple challenge copy (pairing mode)");
     }
     
-    // Set up packet structure
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->payload.packet.header.CtrlByte1.asByte += 6;
-    memcpy(packet->payload.buffer + 9, response, 6);
-    packet->buffer_length = 6 + 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
-    
-    // Source: controller address
+    // Answers the device challenge, in the middle of the exchange
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
+    packet->buffer_length = iohcFrames::challengeAnswer(packet->payload.buffer, myAddr, device->nodeAddress,
+                                                        response).finish();
     
-    // Target: specific device
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
-    
-    packet->payload.packet.header.cmd = 0x3D;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -1141,7 +1016,7 @@ bool PairingController::sendChallenge(Device2W* device) {
         challenge.push_back(random(0, 256));
     }
     
-    iohcPacket* packet = new iohcPacket();
+    iohcPacket* packet = iohcRadio::allocPacket();
     
     // Set up packet structure  
     packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
@@ -1220,20 +1095,13 @@ bool PairingController::sendKeyTransfer(Device2W* device) {
     // According to protocol: "Controller creates an initial value based on last frame and the specified challenge"
     // The "last frame" is the CMD 0x31 (Ask Challenge) that preceded receiving CMD 0x3C
     // NOT the current CMD 0x32 being sent!
-    std::vector<uint8_t> frame_data;
-    frame_data.push_back(0x31);  // CMD 0x31 (previous command sent before challenge)
-    // Note: Padding to 8 bytes with 0x55 is handled inside constructInitialValue
-    
-    // Convert challenge to vector for constructInitialValue
-    std::vector<uint8_t> challenge_vec(6);
-    for (int i = 0; i < 6; i++) {
-        challenge_vec[i] = deviceChallenge[i];
-    }
+    const uint8_t frame_data[1] = {0x31};  // CMD 0x31 (previous command sent before challenge)
+    // Note: Padding to 8 bytes with 0x55 is handled inside buildInitialValue
     
     // Step 1: Generate Initial Value (IV) according to 2W protocol
     // IV structure: [frame_data (8 bytes), checksum (2 bytes), challenge (6 bytes)]
     uint8_t initial_value[16];
-    constructInitialValue(frame_data, initial_value, frame_data.size(), challenge_vec, nullptr);
+    iohcCrypto::buildInitialValue(initial_value, frame_data, sizeof(frame_data), deviceChallenge, nullptr);
     
     // Debug: Print generated IV
     char ivMsg[128];
@@ -1246,11 +1114,8 @@ bool PairingController::sendKeyTransfer(Device2W* device) {
     addLogMessage(ivMsg);
     
     // Step 2: Encrypt IV with transfer key using AES-128 ECB
-    AES_ctx ctx;
-    AES_init_ctx(&ctx, transfert_key);
     uint8_t encrypted_iv[16];
-    memcpy(encrypted_iv, initial_value, 16);
-    AES_ECB_encrypt(&ctx, encrypted_iv);
+    iohcCrypto::encrypt_block(transfert_key, initial_value, encrypted_iv);
     
     // Debug: Print encrypted IV
     char encIvMsg[128];
@@ -1264,7 +1129,7 @@ bool PairingController::sendKeyTransfer(Device2W* device) {
     
     // Step 3: XOR system key with encrypted IV to get encrypted key payload
     // This is the key that will be sent in CMD 0x32
-    std::vector<uint8_t> keyData(16);
+    uint8_t keyData[16];
     for (int i = 0; i < 16; i++) {
         keyData[i] = systemKey2W[i] ^ encrypted_iv[i];
     }
@@ -1280,24 +1145,13 @@ bool PairingController::sendKeyTransfer(Device2W* device) {
     addLogMessage(keyMsg);
     
     // Build packet with encrypted key
-    iohcPacket* packet = new iohcPacket();
-    
-    // Set up packet structure
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->payload.packet.header.CtrlByte1.asByte += keyData.size();
-    memcpy(packet->payload.buffer + 9, keyData.data(), keyData.size());
-    packet->buffer_length = keyData.size() + 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
+    iohcPacket* packet = iohcRadio::allocPacket();
     
+    // Sent right after CMD 0x31, in the middle of the exchange
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::keyTransfer(packet->payload.buffer, myAddr, device->nodeAddress, keyData)
+                                .finish();
     
-    packet->payload.packet.header.cmd = 0x32;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -1310,7 +1164,6 @@ bool PairingController::sendKeyTransfer(Device2W* device) {
     
     ets_printf("[Pairing] Calling sendPacket() for CMD 0x32...\n");
     bool sent = sendPacket(packet);
-    // DON'T delete - radio needs packet until transmission completes
     
     if (sent) {
         ets_printf("[Pairing] sendPacket() returned SUCCESS for CMD 0x32\n");
@@ -1326,23 +1179,11 @@ bool PairingController::sendKeyTransfer(Device2W* device) {
 
 bool PairingController::requestName(Device2W* device) {
     // CMD 0x50 - Get Name (no parameters)
-    std::vector<uint8_t> toSend = {};
-    
-    iohcPacket* packet = new iohcPacket();
-    
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->buffer_length = 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
+    iohcPacket* packet = iohcRadio::allocPacket();
     
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::getName(packet->payload.buffer, myAddr, device->nodeAddress).finish();
     
-    packet->payload.packet.header.cmd = 0x50;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -1350,7 +1191,6 @@ bool PairingController::requestName(Device2W* device) {
     packet->shortPreamble = true;  // Use SHORT preamble for active pairing session
     
     bool sent = sendPacket(packet);
-    // DON'T delete - radio needs packet until transmission completes
     
     if (sent) {
         addLogMessage("Requested name (CMD 0x50)");
@@ -1362,23 +1202,11 @@ bool PairingController::requestName(Device2W* device) {
 
 bool PairingController::requestGeneralInfo1(Device2W* device) {
     // CMD 0x54 - Get General Info 1 (no parameters)
-    std::vector<uint8_t> toSend = {};
-    
-    iohcPacket* packet = new iohcPacket();
-    
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->buffer_length = 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
+    iohcPacket* packet = iohcRadio::allocPacket();
     
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::getGeneralInfo1(packet->payload.buffer, myAddr, device->nodeAddress).finish();
     
-    packet->payload.packet.header.cmd = 0x54;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -1386,7 +1214,6 @@ bool PairingController::requestGeneralInfo1(Device2W* device) {
     packet->shortPreamble = true;  // Use SHORT preamble for active pairing session
     
     bool sent = sendPacket(packet);
-    // DON'T delete - radio needs packet until transmission completes
     
     if (sent) {
         addLogMessage("Requested General Info 1 (CMD 0x54)");
@@ -1397,23 +1224,11 @@ bool PairingController::requestGeneralInfo1(Device2W* device) {
 
 bool PairingController::requestGeneralInfo2(Device2W* device) {
     // CMD 0x56 - Get General Info 2 (no parameters)
-    std::vector<uint8_t> toSend = {};
-    
-    iohcPacket* packet = new iohcPacket();
-    
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->buffer_length = 9;
-    
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
+    iohcPacket* packet = iohcRadio::allocPacket();
     
     address myAddr = CONTROLLER_ADDRESS;
-    memcpy(packet->payload.packet.header.source, myAddr, 3);
-    memcpy(packet->payload.packet.header.target, device->nodeAddress, 3);
+    packet->buffer_length = iohcFrames::getGeneralInfo2(packet->payload.buffer, myAddr, device->nodeAddress).finish();
     
-    packet->payload.packet.header.cmd = 0x56;
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
     packet->repeat = 0;
@@ -1421,7 +1236,6 @@ bool PairingController::requestGeneralInfo2(Device2W* device) {
     packet->shortPreamble = true;  // Use SHORT preamble for active pairing session
     
     bool sent = sendPacket(packet);
-    // DON'T delete - radio needs packet until transmission completes
     
     if (sent) {
         addLogMessage("Requested General Info 2 (CMD 0x56)");
@@ -1432,42 +1246,22 @@ bool PairingController::requestGeneralInfo2(Device2W* device) {
 bool PairingController::sendPacket(iohcPacket* packet) {
     if (!radio) {
         addLogMessage("ERROR: Radio not initialized!");
-        delete packet;  // Clean up since we won't send it
+        iohcRadio::txPool().dispose(packet);  // Clean up since we won't send it
         return false;
     }
     
-    // Check if radio is busy transmitting
-    // Allow sending during RX and PAYLOAD states (PAYLOAD transitions to RX quickly)
-    if (radio->radioState == iohcRadio::RadioState::TX ||
-        radio->radioState == iohcRadio::RadioState::PREAMBLE) {
-        ets_printf("PairingController: Radio busy transmitting (state=%d), will retry.\n", 
-                   (int)radio->radioState);
-        delete packet;
+    // Radio->send expects a vector; the radio owns the packet from here on and frees it once sent
+    std::vector<iohcPacket*> packets;
+    packets.push_back(packet);
+    
+    // Queued ahead of user commands and scans if the radio is busy
+    if (!radio->send(packets, TxPriority::Urgent, TxSource::Pairing)) {
+        ets_printf("PairingController: TX queue full, will retry.\n");
         // Set lastStepTime to add delay before retry
         lastStepTime = millis();
         return false;  // Caller should not change pairing state
     }
-    
-    // IMPORTANT: Do NOT delete lastSentPacket here!
-    // The radio may still be using it internally
-    // Let it be cleaned up on next successful send or when pairing completes
-    // This prevents memory corruption when radio is processing packets
-    
-    // Radio->send expects a vector
-    std::vector<iohcPacket*> packets;
-    packets.push_back(packet);
-    
-    // CRITICAL: Do NOT delete lastSentPacket even after sending!
-    // The radio holds a pointer and may read from it asynchronously.
-    // Memory will be cleaned up when pairing completes or on next boot.
-    // Small memory leak but prevents corruption.
-    
-    // Store pointer to track this packet
-    lastSentPacket = packet;
-    
-    // Send packet to radio
-    radio->send(packets);
-    
+
     return true;
 }
 
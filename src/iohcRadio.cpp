@@ -15,14 +15,13 @@
  */
 
 #include <esp32-hal-gpio.h>
+#include <algorithm>
 #include <map>
 #include "esp_log.h"
 
 #include <iohcRadio.h>
 #include <utility>
 #include <log_buffer.h>
-#define LONG_PREAMBLE_MS 1920
-#define SHORT_PREAMBLE_MS 40
 
 TaskHandle_t IOHC::iohcRadio::txTaskHandle = nullptr;
 
@@ -33,36 +32,74 @@ namespace IOHC {
     volatile bool iohcRadio::send_lock = false;
     volatile iohcRadio::RadioState iohcRadio::radioState = iohcRadio::RadioState::IDLE;
     volatile bool iohcRadio::txComplete = false;
+    volatile bool iohcRadio::hopDue = false;
+    volatile bool iohcRadio::txTimerDue = false;
+    volatile bool iohcRadio::scheduleDue = false;
+    volatile uint64_t iohcRadio::packetSentStamp = 0;
     
-    // RX callback queue and task handles
-    QueueHandle_t iohcRadio::rxCallbackQueue = nullptr;
+    // RX pool and callback task handle
+    RxFrameRing iohcRadio::rxRing;
+    iohcLinkStats iohcRadio::_linkStats;
+    iohcRxFilter iohcRadio::_rxFilter;
+    iohcRxDedupe iohcRadio::_rxDedupe;
+    iohcWakeTracker iohcRadio::_wakeTracker;
+    TxPacketPool iohcRadio::_txPool;
     TaskHandle_t iohcRadio::rxCallbackTaskHandle = nullptr;
 
     TaskHandle_t handle_interrupt;
     /**
      * RX Callback Task - Processes received packets in a separate thread
      * This prevents blocking the radio interrupt handler when executing callbacks
+     * Frames are taken from the RX pool and copied in a single reused packet: callbacks never keep it
+     * Sniffed frames, addressed to other controllers, are logged without reaching the callbacks
+     * Repeats of a frame heard within the dedupe window are neither logged nor passed on
      */
     void iohcRadio::rxCallbackTask(void *pvParameters) {
         iohcRadio *radio = static_cast<iohcRadio *>(pvParameters);
-        iohcPacket *rxPacket = nullptr;
-        
+        iohcPacket rxPacket;
+        iohcPacket txPacket;
+
         while (true) {
-            // Wait for a packet to be queued
-            if (xQueueReceive(rxCallbackQueue, &rxPacket, portMAX_DELAY) == pdTRUE) {
-                if (rxPacket != nullptr) {
-                    // Decode and log the received packet
-                    rxPacket->decode(true);
-                    addLogMessage(String(rxPacket->decodeToString(true).c_str()));
-                    
-                    // Call the user's RX callback
-                    if (radio->rxCB) {
-                        radio->rxCB(rxPacket);
-                    }
-                    
-                    // Clean up the packet
-                    delete rxPacket;
-                    rxPacket = nullptr;
+            // Wait for the radio task to signal new frames, or a batch started
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+            // Decoding and printing take milliseconds, kept out of txMutex and the timer callbacks
+            if (radio->takeTxLog(txPacket))
+                ets_printf("%s\n", txPacket.decodeToString(true).c_str());
+
+            while (RxRecord *record = rxRing.pop()) {
+                rxPacket = iohcPacket();
+                memcpy(rxPacket.payload.buffer, record->buffer, record->length);
+                rxPacket.buffer_length = record->length;
+                rxPacket.frequency = record->frequency;
+                rxPacket.rssi = record->link.rssiDbm();
+                rxPacket.snr = record->link.snrDb();
+                rxPacket.afc = record->link.afcHz();
+                rxPacket.lna = record->link.lnaAttenuationDb();
+                _linkStats.record(record->link, record->frequency, record->buffer, record->length);
+                if (record->length >= RX_HEADER_LEN)
+                    _wakeTracker.onReceived(record->buffer + 5, record->buffer[1], esp_timer_get_time());
+                const bool sniffed = record->verdict == RxVerdict::Sniff;
+                const bool repeat = _rxDedupe.isRepeat(record->buffer, record->length,
+                                                       static_cast<uint32_t>(esp_timer_get_time() / 1000));
+                rxRing.release(record);
+
+                // Copies of a frame already handled: counted in the link statistics only
+                if (repeat) continue;
+
+                // Frames for other controllers are only logged
+                if (sniffed) {
+                    addLogMessage(String(rxPacket.decodeToString(false).c_str()));
+                    continue;
+                }
+
+                // Decode and log the received packet
+                rxPacket.decode(true);
+                addLogMessage(String(rxPacket.decodeToString(true).c_str()));
+
+                // Call the user's RX callback
+                if (radio->rxCB) {
+                    radio->rxCB(&rxPacket);
                 }
             }
         }
@@ -83,7 +120,8 @@ namespace IOHC {
             thread_notification = ulTaskNotifyTake(pdTRUE, xMaxBlockTime/*xNoDelay*/); // Attendre la notification
             if (thread_notification &&
                 (iohcRadio::radioState == iohcRadio::RadioState::PAYLOAD ||
-                 iohcRadio::radioState == iohcRadio::RadioState::PREAMBLE)) {
+                 iohcRadio::radioState == iohcRadio::RadioState::PREAMBLE || iohcRadio::hopDue ||
+                 iohcRadio::txTimerDue || iohcRadio::scheduleDue)) {
                 iohcRadio::tickerCounter((iohcRadio *) pvParameters);
             }
         }
@@ -102,6 +140,7 @@ namespace IOHC {
 
 
         if (payload) {
+            iohcRadio::packetSentStamp = esp_timer_get_time();
             // When in TX state DIO0 is mapped to PacketSent, otherwise it
             // signals PayloadReady. Use the current radio state to disambiguate
             // without touching SPI from the ISR.
@@ -172,6 +211,8 @@ namespace IOHC {
         Radio::setCarrier(Radio::Carrier::Bandwidth, 250);
         Radio::setCarrier(Radio::Carrier::Modulation, Radio::Modulation::FSK);
 
+        txMutex = xSemaphoreCreateMutex();
+
         // Attach interrupts to Preamble detected and end of packet sent/received
         /* TODO this is wrongly named and/or assigned, but work like that*/
         //        printf("Starting TickTimer Handler...\n");
@@ -197,21 +238,13 @@ namespace IOHC {
             return;
         }
         
-        // Create RX callback queue and task
+        // Create RX callback task, fed by the preallocated RX pool
         printf("Starting RX Callback Handler...\n");
-        rxCallbackQueue = xQueueCreate(10, sizeof(iohcPacket*)); // Queue for 10 packets
-        if (rxCallbackQueue == nullptr) {
-            printf("ERROR: Can't create RX callback queue\n");
-            return;
-        }
-        
         task_code = xTaskCreatePinnedToCore(rxCallbackTask, "rx_callback_task", 8192,
                                            this, 3, // Priority 3 (lower than interrupt handler)
                                            &rxCallbackTaskHandle, xPortGetCoreID());
         if (task_code != pdPASS) {
             printf("ERROR: Can't create RX callback task %d\n", task_code);
-            vQueueDelete(rxCallbackQueue);
-            rxCallbackQueue = nullptr;
             return;
         }
     }
@@ -262,6 +295,29 @@ namespace IOHC {
         Radio::setCarrier(Radio::Carrier::Frequency, scan_freqs[0]); //868950000);
         // Radio::calibrate();
         Radio::setRx();
+        // With more than one channel, the hopper takes over from here: scanTimeUs is the mean dwell per channel
+        if (hopper.configure(scan_freqs, num_freqs, this->scanTimeUs))
+            hopper.start(esp_timer_get_time());
+    }
+
+/**
+ * Dwell timer of the channel hopper. SPI and hopper state belong to the interrupt task: only wake it up.
+ */
+    void iohcRadio::onHopTimer(void *arg) {
+        hopDue = true;
+        xTaskNotifyGive(handle_interrupt);
+    }
+
+    void iohcRadio::HopDriver::tune(const uint8_t frf[3]) {
+        Radio::setFrequencyWord(frf);
+    }
+
+    void iohcRadio::HopDriver::arm(uint32_t delayUs) {
+        radio->Hopper.once_us(delayUs, &iohcRadio::onHopTimer, radio);
+    }
+
+    bool iohcRadio::HopDriver::idle() const {
+        return radioState == RadioState::RX && !radio->txSequencer.busy();
     }
 
 /**
@@ -278,7 +334,21 @@ namespace IOHC {
  */
     void IRAM_ATTR iohcRadio::tickerCounter(iohcRadio *radio) {
         // Not need to put in IRAM as we reuse task for µs instead ISR
+        if (txTimerDue) {
+            txTimerDue = false;
+            radio->onTxTimerDue();
+        }
+        if (scheduleDue) {
+            scheduleDue = false;
+            radio->onScheduleDue();
+        }
 #if defined(RADIO_SX127X)
+        if (hopDue) {
+            hopDue = false;
+            radio->hopper.onTimer(esp_timer_get_time());
+        }
+        if (radioState != iohcRadio::RadioState::PAYLOAD && radioState != iohcRadio::RadioState::PREAMBLE) return;
+
         Radio::readBytes(REG_IRQFLAGS1, _flags, sizeof(_flags));
 
         // If Int of PayLoad
@@ -287,7 +357,7 @@ namespace IOHC {
             if (_flags[0] & RF_IRQFLAGS1_TXREADY) {
                 radio->sent(radio->iohc);
                 Radio::clearFlags();
-                if (radioState != iohcRadio::RadioState::TX) {
+                if (!radio->onPacketSent()) {
                     Radio::setRx();
                     radio->setRadioState(iohcRadio::RadioState::RX);
                 }
@@ -295,7 +365,8 @@ namespace IOHC {
                 return;
             }
             // if in RX mode?
-            radio->receive(false);
+            radio->receive();
+            radio->hopper.onFrame(esp_timer_get_time());
             Radio::clearFlags();
             radio->tickCounter = 0;
             radio->preCounter = 0;
@@ -305,6 +376,7 @@ namespace IOHC {
         if (radioState == iohcRadio::RadioState::PREAMBLE) {
             radio->tickCounter = 0;
             radio->preCounter = radio->preCounter + 1;
+            radio->hopper.onPreamble(esp_timer_get_time());
             //radio->preCounter += 1;
 
             //            if (_flags[0] & RF_IRQFLAGS1_SYNCADDRESSMATCH) radio->preCounter = 0;
@@ -313,24 +385,10 @@ namespace IOHC {
                 // Avoid hanging on a too long preamble detect
                 Radio::clearFlags();
                 radio->preCounter = 0;
+                radio->hopper.onPreambleLost();
             }
         }
-
-        if (radioState != iohcRadio::RadioState::RX) return;
-
-        //if (++radio->tickCounter * SM_GRANULARITY_US < radio->scanTimeUs) return;
-        radio->tickCounter = radio->tickCounter + 1;
-        if (radio->tickCounter * SM_GRANULARITY_US < radio->scanTimeUs) return;
-
-        radio->tickCounter = 0;
-
-        if (radio->num_freqs == 1) return;
-
-        radio->currentFreqIdx += 1;
-        if (radio->currentFreqIdx >= radio->num_freqs)
-            radio->currentFreqIdx = 0;
-
-        Radio::setCarrier(Radio::Carrier::Frequency, radio->scan_freqs[radio->currentFreqIdx]);
+        // Channel changes are driven by the hopper's dwell timer, see onHopTimer()
 
 #elif defined(CC1101)
         if (__g_preamble){
@@ -371,138 +429,258 @@ namespace IOHC {
     }
     */
 
-void iohcRadio::send(std::vector<iohcPacket *> &iohcTx) {
-    if (radioState == RadioState::TX) {
-        ets_printf("TX: Already transmitting. Ignoring send()\n");
-        return;
+/**
+ * Queues a batch of packets; it goes out right away if the radio is free, otherwise as soon as the
+ * batches of higher or same priority queued before it are sent. When the first packet has `delayed`
+ * set, the batch starts that many ms after this call, for answers expected inside a response window.
+ * A batch still waiting deadlineMs after this call is dropped.
+ * The radio takes the packets over in every case: they are disposed of (see allocPacket()) once the
+ * batch is sent, expired or aborted, right after onDone got its report. Returns false when the batch
+ * was aborted because the queue is full.
+ */
+bool iohcRadio::send(std::vector<iohcPacket *> &iohcTx, TxPriority priority, TxSource source, uint32_t deadlineMs,
+                     TxDoneDelegate onDone) {
+    if (iohcTx.empty()) return false;
+    uint64_t startUs = iohcTx[0]->delayed ? esp_timer_get_time() + iohcTx[0]->delayed * 1000ULL : 0;
+    return enqueue(iohcTx, startUs, priority, source, deadlineMs, onDone);
+}
+
+/**
+ * Same as send(), but the batch starts at startUs (esp_timer time base); `delayed` of the first packet is ignored.
+ */
+bool iohcRadio::sendAt(std::vector<iohcPacket *> &iohcTx, uint64_t startUs, TxPriority priority, TxSource source,
+                       uint32_t deadlineMs, TxDoneDelegate onDone) {
+    if (iohcTx.empty()) return false;
+    return enqueue(iohcTx, startUs, priority, source, deadlineMs, onDone);
+}
+
+// Time the radio is busy with a batch, so that it is not started when it would delay a scheduled one
+static uint32_t batchDurationUs(const std::vector<iohcPacket *> &packets, bool firstShortPreamble) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < packets.size(); i++) {
+        const iohcPacket *packet = packets[i];
+        if (i) total += std::max(packets[i - 1]->repeatTime, packet->delayed) * 1000;
+        total += packet->repeat * packet->repeatTime * 1000;
+        total += (packet->repeat + 1) * iohcAirtimeUs(SHORT_PREAMBLE_MS, packet->buffer_length);
     }
-    packets2send = std::move(iohcTx);
-    txCounter = 0;
-    iohc = packets2send[txCounter];
+    if (!firstShortPreamble)
+        total += iohcAirtimeUs(LONG_PREAMBLE_MS, 0) - iohcAirtimeUs(SHORT_PREAMBLE_MS, 0);
+    return total;
+}
 
-    ets_printf("%s\n", iohc->decodeToString(true).c_str());
+bool iohcRadio::enqueue(std::vector<iohcPacket *> &iohcTx, uint64_t startUs, TxPriority priority, TxSource source,
+                        uint32_t deadlineMs, TxDoneDelegate &onDone) {
+    uint64_t now = esp_timer_get_time();
+    uint32_t duration = batchDurationUs(iohcTx, expectedPreamble(iohcTx[0], now));
+    if (!txQueue.push(iohcTx, priority, source, now, deadlineMs ? now + deadlineMs * 1000ULL : 0, startUs, duration,
+                      onDone)) {
+        ets_printf("TX: Queue full, %s batch rejected\n", txSourceToString(source));
+        TxBatch<iohcPacket> rejected;
+        rejected.packets = std::move(iohcTx);
+        iohcTx.clear();
+        rejected.source = source;
+        rejected.queuedUs = now;
+        rejected.onDone = std::move(onDone);
+        txQueue.complete(std::move(rejected), TxStatus::Aborted, now);
+        reportCompleted();
+        return false;
+    }
 
-    // ets_printf("TX: Preparing %d packet(s)\n", packets2send.size());
-    setRadioState(RadioState::TX);
+    xSemaphoreTake(txMutex, portMAX_DELAY);
+    if (!txSequencer.busy())
+        dispatchNext();
+    xSemaphoreGive(txMutex);
+    reportCompleted();
+    return true;
+}
 
-    // 🟢 Set preamble length based on packet flag
-    if (iohc->shortPreamble) {
-        Radio::setPreambleLength(SHORT_PREAMBLE_MS);
-        // ets_printf("TX: Using SHORT preamble (%d ms) - active session\n", SHORT_PREAMBLE_MS);
-    } else {
-        Radio::setPreambleLength(LONG_PREAMBLE_MS);
-        // ets_printf("TX: Using LONG preamble (%d ms)\n", LONG_PREAMBLE_MS);
+/**
+ * Reports of the batches finished since the last call, then their packets go back to the pool (or the heap).
+ * Called with txMutex released: a callback may send() the next batch.
+ */
+void iohcRadio::reportCompleted() {
+    txQueue.drainCompleted([](iohcPacket *packet) { _txPool.dispose(packet); });
+}
+
+/**
+ * Starts the next batch due. Called with txMutex held, when the sequencer is idle.
+ * If only delayed batches are left, the radio stays in RX and the scheduler timer is armed for the earliest.
+ */
+bool iohcRadio::dispatchNext() {
+    TxBatch<iohcPacket> batch;
+    auto onExpired = [](TxBatch<iohcPacket> &expired) {
+        ets_printf("TX: %s batch expired after %llu us in queue\n", txSourceToString(expired.source),
+                   esp_timer_get_time() - expired.queuedUs);
+    };
+    uint64_t now = esp_timer_get_time();
+    if (!txQueue.pop(batch, now, onExpired)) {
+        uint64_t next = txQueue.nextStartUs(now);
+        if (next)
+            Scheduler.once_us(static_cast<uint32_t>(next - now), &iohcRadio::onScheduleTimer, this);
+        return false;
     }
 
-    // Send first packet immediately
-    Radio::setStandby();
-    Radio::clearFlags();
-    Radio::writeBytes(REG_FIFO, iohc->payload.buffer, iohc->buffer_length);
-    Radio::setTx();
-    //packetStamp = esp_timer_get_time();
-    //iohc->decode(true); //false);
-    //IOHC::lastSendCmd = iohc->payload.packet.header.cmd;
+    packets2send = std::move(batch.packets);
+    txActive = std::move(batch);
+    txActive.startedUs = now;
+    iohc = packets2send[0];
+    firstShortPreamble = choosePreamble(iohc, now);
 
-    // ets_printf("TX: Sent first packet at %llu us\n", esp_timer_get_time());
+    setRadioState(RadioState::TX);
+    // First packet goes out now, each PacketSent then schedules the next repeat or packet
+    bool started = txSequencer.start(packets2send.size(), esp_timer_get_time());
+    // Logged by the RX callback task: decoding and printing take milliseconds
+    txLog = *packets2send[0];
+    txLogPending = true;
+    if (rxCallbackTaskHandle) xTaskNotifyGive(rxCallbackTaskHandle);
+    if (batch.startUs)
+        ets_printf("TX: %s batch started %llu us after its scheduled time\n", txSourceToString(batch.source),
+                   now - batch.startUs);
+    return started;
+}
 
-    if (iohc->repeat > 0) iohc->repeat--;
+// Unicast 2W frames: the wake tracker picks their preamble
+static bool wakeTracked(const iohcPacket *packet) {
+    const auto &header = packet->payload.packet.header;
+    return packet->buffer_length >= RX_HEADER_LEN && !header.CtrlByte1.asStruct.Protocol &&
+           !iohcRxFilter::isBroadcast(header.target);
+}
+
+/**
+ * Preamble of the first frame of a batch. Unicast 2W frames get the shortest one the target will hear,
+ * from its tracked wake state; broadcasts and 1W frames keep what the caller asked for.
+ */
+bool iohcRadio::choosePreamble(const iohcPacket *packet, uint64_t nowUs) {
+    const auto &header = packet->payload.packet.header;
+    if (!wakeTracked(packet))
+        return packet->shortPreamble;
+    bool expectsReply = header.CtrlByte1.asStruct.StartFrame && !header.CtrlByte1.asStruct.EndFrame;
+    return _wakeTracker.shortPreamble(header.target, packet->shortPreamble, expectsReply, nowUs);
+}
 
-    // Start ticker for repeats (short preamble)
-    // Detach first to ensure any previous ticker is stopped
-    Sender.detach();
-    Sender.attach_ms(iohc->repeatTime, &iohcRadio::onTxTicker, (void*)this);
+/**
+ * What choosePreamble() would pick now, for the duration of a batch being queued; the choice itself is made when
+ * the batch starts.
+ */
+bool iohcRadio::expectedPreamble(const iohcPacket *packet, uint64_t nowUs) {
+    if (!wakeTracked(packet))
+        return packet->shortPreamble;
+    return _wakeTracker.expectsShort(packet->payload.packet.header.target, packet->shortPreamble, nowUs);
 }
 
+/**
+ * Copies the frame of the last batch started into out, once. False when there is none to log.
+ */
+bool iohcRadio::takeTxLog(iohcPacket &out) {
+    if (!txLogPending) return false;    // Most wake-ups are received frames
+    xSemaphoreTake(txMutex, portMAX_DELAY);
+    const bool pending = txLogPending;
+    if (pending) out = txLog;
+    txLogPending = false;
+    xSemaphoreGive(txMutex);
+    return pending;
+}
 
- 
-void iohcRadio::onTxTicker(void *arg) {
-    iohcRadio *radio = (iohcRadio *)arg;
-
-    // 🩵 Fallback: Check IRQFLAGS2 (0x3F) for PacketSent in FSK mode
-    uint8_t irqFlags2 = Radio::readByte(0x3F); // REG_IRQFLAGS2
-    if (irqFlags2 & 0x08) { // Bit 3 == PacketSent (TXDONE in FSK)
-        ets_printf("FSK: Detected PacketSent (TXDONE) via register (ISR missed?)\n");
-        Radio::writeByte(0x3F, 0x08); // Clear PacketSent bit
-        iohcRadio::txComplete = true;
-    }
+/**
+ * Start time of a delayed batch reached. Like the other esp_timer callbacks, it only wakes the interrupt task up:
+ * waiting for txMutex here would hold up every timer of the esp_timer task.
+ */
+void iohcRadio::onScheduleTimer(void *arg) {
+    scheduleDue = true;
+    xTaskNotifyGive(handle_interrupt);
+}
 
-    // 🛑 Check if all packets are sent
-    if (radio->txCounter >= radio->packets2send.size()) {
-        ets_printf("TX: All packets sent. Stopping Ticker.\n");
-        radio->Sender.detach();
-        radio->iohc = nullptr;  // Prevent reading stale packet data
-        radio->packets2send.clear();
-        Radio::setRx();
-        radio->setRadioState(RadioState::RX);
-        return;
-    }
+/**
+ * Timer armed by the TX sequencer: end of an inter-frame gap, or PacketSent watchdog. Handled by the interrupt task.
+ */
+void iohcRadio::onTxTimer(void *arg) {
+    txTimerDue = true;
+    xTaskNotifyGive(handle_interrupt);
+}
 
-    // ⏳ Wait for TXDONE
-    if (!radio->txComplete) {
-        // ets_printf("TX: Waiting for TXDONE... (state=%s)\n", radioStateToString(radio->radioState));
-        return;
-    }
+/**
+ * Delayed batch due, in the interrupt task. A batch still running is left alone: its end dispatches the next one.
+ */
+void iohcRadio::onScheduleDue() {
+    xSemaphoreTake(txMutex, portMAX_DELAY);
+    if (!txSequencer.busy())
+        dispatchNext();
+    xSemaphoreGive(txMutex);
+    reportCompleted();
+}
 
-    // ✅ TXDONE received
-    radio->txComplete = false;
-    ESP_LOGD("RADIO", "TXDONE flag set, ready to send repeat or next packet.\n");
+/**
+ * TX sequencer timer, in the interrupt task.
+ */
+void iohcRadio::onTxTimerDue() {
+    xSemaphoreTake(txMutex, portMAX_DELAY);
+    txSequencer.onTimer(esp_timer_get_time());
+    xSemaphoreGive(txMutex);
+    reportCompleted();
+}
 
-    // 🛡️ Safety check: If iohc is null, we're done (ticker fired after cleanup)
-    if (radio->iohc == nullptr) {
-        ets_printf("TX: iohc is null (already cleaned up). Ignoring ticker callback.\n");
-        return;
-    }
+/**
+ * Forwards DIO0 PacketSent to the TX sequencer. Returns false if no batch is being sent.
+ */
+bool iohcRadio::onPacketSent() {
+    xSemaphoreTake(txMutex, portMAX_DELAY);
+    bool busy = txSequencer.busy();
+    if (busy)
+        txSequencer.onPacketSent(packetSentStamp, esp_timer_get_time());
+    xSemaphoreGive(txMutex);
+    reportCompleted();
+    return busy;
+}
 
-    // 🛡️ Validate iohc points to a packet in packets2send
-    // REMOVED: This validation was causing race conditions with RX path
-    // The RX path uses a different 'iohc' variable (local in receive())
-    // Don't validate or clear radio->iohc here - it's TX state only
+TxSlot iohcRadio::TxDriver::slot(size_t frame, bool first) const {
+    const iohcPacket *packet = radio->packets2send[frame];
+    // Same preamble as transmit(): only the very first transmission of the batch may have the long one
+    uint16_t preamble = first && !radio->firstShortPreamble ? LONG_PREAMBLE_MS : SHORT_PREAMBLE_MS;
+    return {packet->repeat, static_cast<uint32_t>(packet->repeatTime * 1000),
+            iohcAirtimeUs(preamble, packet->buffer_length), static_cast<uint32_t>(packet->delayed * 1000)};
+}
 
-    // �🔁 Repeat logic
-    if (radio->iohc->repeat > 0) {
-        radio->iohc->repeat--;
-        ets_printf("TX: Repeating current packet CMD=0x%02X (%d repeats left)\n", 
-                   radio->iohc->payload.packet.header.cmd, radio->iohc->repeat);
-    } else {
-        radio->txCounter++;
-        if (radio->txCounter < radio->packets2send.size()) {
-            radio->iohc = radio->packets2send[radio->txCounter];
-            ets_printf("TX: Moving to next packet %d/%d CMD=0x%02X (repeat=%d)\n",
-                       radio->txCounter + 1,
-                       radio->packets2send.size(),
-                       radio->iohc->payload.packet.header.cmd,
-                       radio->iohc->repeat);
-        }
-    }
+void iohcRadio::TxDriver::transmit(size_t frame, bool first) {
+    iohcPacket *packet = radio->packets2send[frame];
+    radio->iohc = packet;
 
-    // 👇 Only go RX after all packets
-    if (radio->txCounter >= radio->packets2send.size()) {
-        // ets_printf("TX: All repeats done. Switching to RX\n");
-        radio->Sender.detach();
-        radio->iohc = nullptr;  // Prevent reading stale packet data
-        radio->packets2send.clear();  // Clear queue to prevent stale packets
-        Radio::setRx();
-        radio->setRadioState(RadioState::RX);
-        return;
-    } else {
-        //Radio::setRx();
-        radio->setRadioState(RadioState::TX); // Stay TX until done
+    // The hopper may have left RX on another channel; no SPI when already there
+    if (packet->frequency) {
+        uint32_t word = iohcFrfWord(packet->frequency);
+        const uint8_t frf[3] = {static_cast<uint8_t>(word >> 16), static_cast<uint8_t>(word >> 8), static_cast<uint8_t>(word)};
+        Radio::setFrequencyWord(frf);
     }
-
-    // 📡 Send next packet (short preamble)
-    Radio::setPreambleLength(SHORT_PREAMBLE_MS);
+    // Long preamble only to wake devices up on the first frame, repeats follow closely
+    Radio::setPreambleLength(first && !radio->firstShortPreamble ? LONG_PREAMBLE_MS : SHORT_PREAMBLE_MS);
     Radio::setStandby();
     Radio::clearFlags();
-    Radio::writeBytes(REG_FIFO, radio->iohc->payload.buffer, radio->iohc->buffer_length);
+    Radio::writeBytes(REG_FIFO, packet->payload.buffer, packet->buffer_length);
     Radio::setTx();
-    //packetStamp = esp_timer_get_time();
-    //radio->iohc->decode(true); //false);
-    //IOHC::lastSendCmd = radio->iohc->payload.packet.header.cmd;
+    setRadioState(RadioState::TX);
+}
 
-    ets_printf("TX: Sent packet %d/%d at %llu us\n",
-               radio->txCounter + 1,
-               radio->packets2send.size(),
-               esp_timer_get_time());
+void iohcRadio::TxDriver::arm(uint32_t delayUs) {
+    radio->Sender.once_us(delayUs, &iohcRadio::onTxTimer, radio);
+}
+
+void iohcRadio::TxDriver::listen() {
+    // Listen between frames, but keep the radio marked busy: no frequency hop in the middle of a batch
+    Radio::setRx();
+    setRadioState(RadioState::TX);
+}
+
+void iohcRadio::TxDriver::finish() {
+    radio->Sender.detach();
+    radio->iohc = nullptr;  // Prevent reading stale packet data
+    // Packets are disposed of once txMutex is released, after the batch callback
+    radio->txActive.packets = std::move(radio->packets2send);
+    radio->packets2send.clear();
+    radio->txQueue.complete(std::move(radio->txActive), TxStatus::Sent, esp_timer_get_time());
+    // Back-to-back: the next queued batch starts without going through RX
+    if (radio->dispatchNext()) return;
+    radio->hopper.retune();
+    Radio::setRx();
+    setRadioState(RadioState::RX);
 }
 
 
@@ -668,45 +846,41 @@ void IRAM_ATTR iohcRadio::packetSender(iohcRadio *radio) {
 /**
  * The `iohcRadio::receive` function in C++ toggles an LED, reads radio data, processes it, and
  * triggers a callback function.
- * 
- * @param stats The `stats` parameter in the `iohcRadio::receive` function is a boolean parameter that
- * is used to determine whether to gather additional statistics during the radio reception process. If
- * `stats` is set to `true`, the function will collect and process additional information such as RSSI
- * (Received Signal
+ * Link metrics (LNA, RSSI, AFC, FEI) are captured on every frame with one register burst before the FIFO is read.
+ * Frames dropped by the early filter (iohcRxFilter) never reach the RX callback task.
  * 
  * @return The function `iohcRadio::receive` is returning a boolean value `true`.
  */
-    bool IRAM_ATTR iohcRadio::receive(bool stats = false) {
+    bool IRAM_ATTR iohcRadio::receive() {
         digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
         // bool frmErr = false;
-        // CRITICAL FIX: Use local variable for RX packet, not member variable
+        // CRITICAL FIX: Use a pool record for RX, not the member variable
         // The member variable 'iohc' is used by TX path and gets overwritten if send() is called from RX callback
-        iohcPacket* rxPacket = new iohcPacket;
-        rxPacket->buffer_length = 0;
-        rxPacket->frequency = scan_freqs[currentFreqIdx];
+        // When the pool is exhausted the FIFO is still drained, into a scratch record, and the frame is dropped
+        // A record holding a frame rejected by the filter is kept for the next frame instead of going through the pool
+        static RxRecord scratch;
+        static RxRecord *held = nullptr;
+        RxRecord *rxRecord = held ? held : rxRing.acquire();
+        held = nullptr;
+        const bool dropped = rxRecord == nullptr;
+        if (dropped)
+            rxRecord = &scratch;
+        rxRecord->length = 0;
+        rxRecord->frequency = hopper.frequency();
+        rxRecord->link = {};
 
         _g_payload_millis = esp_timer_get_time();
         packetStamp = _g_payload_millis;
 #if defined(RADIO_SX127X)
-        if (stats) {
-            rxPacket->rssi = static_cast<float>(Radio::readByte(REG_RSSIVALUE)) / -2.0f;
-            int16_t thres = Radio::readByte(REG_RSSITHRESH);
-            rxPacket->snr = rxPacket->rssi > thres ? 0 : (thres - rxPacket->rssi);
-            //            rxPacket->lna = RF96lnaMap[ (Radio::readByte(REG_LNA) >> 5) & 0x7 ];
-            int16_t f = (uint16_t) Radio::readByte(REG_AFCMSB);
-            f = (f << 8) | (uint16_t) Radio::readByte(REG_AFCLSB);
-            //            rxPacket->afc = f * (32000000.0 / 524288.0); // static_cast<float>(1 << 19));
-            rxPacket->afc = /*(int32_t)*/f * 61.0;
-            //            rxPacket->rssiAt = micros();
-        }
+        uint8_t regs[LINK_BURST_LEN];
+        Radio::readBytes(REG_LNA, regs, sizeof(regs));
+        rxRecord->link = linkSampleFromBurst(regs);
 #elif defined(CC1101)
         __g_preamble = false;
 
         uint8_t tmprssi=Radio::SPIgetRegValue(REG_RSSI);
-        if (tmprssi>=128)
-            rxPacket->rssi = (float)((tmprssi-256)/2)-74;
-        else
-            rxPacket->rssi = (float)(tmprssi/2)-74;
+        int16_t rssiDbm = tmprssi >= 128 ? (tmprssi - 256) / 2 - 74 : tmprssi / 2 - 74;
+        rxRecord->link.rssi = static_cast<uint8_t>(-rssiDbm * 2);
 
         uint8_t bytesInFIFO = Radio::SPIgetRegValue(REG_RXBYTES, 6, 0);
         size_t readBytes = 0;
@@ -715,9 +889,7 @@ void IRAM_ATTR iohcRadio::packetSender(iohcRadio *radio) {
 
 #if defined(RADIO_SX127X)
 
-        while (Radio::dataAvail()) {
-            rxPacket->payload.buffer[rxPacket->buffer_length++] = Radio::readByte(REG_FIFO);
-        }
+        rxRecord->length = Radio::readFrame(rxRecord->buffer, MAX_FRAME_LEN);
 
 #elif defined(CC1101)
         uint8_t lenghtFrameCoded = 0xFF;
@@ -758,9 +930,9 @@ void IRAM_ATTR iohcRadio::packetSender(iohcRadio *radio) {
         if (lenghtFrameCoded<255){
             int8_t lenFuncDecodeFrame = Radio::decodeFrame(tmpBuffer, lenghtFrameCoded);
             if (lenFuncDecodeFrame>0 && lenFuncDecodeFrame<=MAX_FRAME_LEN){
-                if (iohcUtils::radioPacketComputeCrc(tmpBuffer, lenFuncDecodeFrame) == 0 ){
-                    rxPacket->buffer_length = lenFuncDecodeFrame;
-                    memcpy(rxPacket->payload.buffer, tmpBuffer, lenFuncDecodeFrame);  // volcamos el resultado al array de origen
+                if (iohcCrypto::radioPacketComputeCrc(tmpBuffer, lenFuncDecodeFrame) == 0 ){
+                    rxRecord->length = lenFuncDecodeFrame;
+                    memcpy(rxRecord->buffer, tmpBuffer, lenFuncDecodeFrame);  // volcamos el resultado al array de origen
                     frmErr=false;
                 }
             }
@@ -777,24 +949,19 @@ void IRAM_ATTR iohcRadio::packetSender(iohcRadio *radio) {
 
 #endif
         
-        // Queue the packet for processing in separate task
-        if (rxPacket != nullptr && rxCallbackQueue != nullptr) {
-            // Try to send to queue (non-blocking from ISR context)
-            if (xQueueSend(rxCallbackQueue, &rxPacket, 0) != pdTRUE) {
-                // Queue is full, drop the packet
-                Serial.println("[WARNING] RX callback queue full, dropping packet");
-                delete rxPacket;
-            }
-            // rxPacket will be deleted by the callback task
-        } else {
-            if (rxPacket != nullptr) {
-                Serial.println("[ERROR] RX callback queue not initialized!");
-                delete rxPacket;
-            } else {
-                Serial.println("[ERROR] rxPacket is NULL!");
-            }
+        // Early verdict from the header alone, before anything is decoded or formatted
+        rxRecord->verdict = _rxFilter.classify(rxRecord->buffer, rxRecord->length);
+        if (rxRecord->verdict == RxVerdict::Drop) {
+            if (!dropped)
+                held = rxRecord;
         }
-        
+        // Hand the record to the callback task; a dropped frame is only counted by the ring
+        else if (!dropped) {
+            rxRing.commit(rxRecord);
+            if (rxCallbackTaskHandle)
+                xTaskNotifyGive(rxCallbackTaskHandle);
+        }
+
         digitalWrite(RX_LED, false);
         return true;
     }
@@ -40,7 +40,8 @@ namespace IOHC {
     static void positionTickerCallback() {
         iohcRemote1W *inst = iohcRemote1W::getInstance();
         if (inst) {
-            inst->updatePositions();
+            // Timer task, shared with the radio: skip this tick rather than wait for a command saving the remotes
+            inst->updatePositions(std::try_to_lock);
         }
     }
 
@@ -64,6 +65,18 @@ namespace IOHC {
         }
     }
 
+    /// Actions sent as a precomputed frame, Action1W::Count for the others
+    static Action1W toAction1W(RemoteButton cmd) {
+        switch (cmd) {
+            case RemoteButton::Open: return Action1W::Open;
+            case RemoteButton::Close: return Action1W::Close;
+            case RemoteButton::Stop: return Action1W::Stop;
+            case RemoteButton::Vent: return Action1W::Vent;
+            case RemoteButton::ForceOpen: return Action1W::ForceOpen;
+            default: return Action1W::Count;
+        }
+    }
+
     iohcRemote1W::iohcRemote1W() = default;
 
     iohcRemote1W* iohcRemote1W::getInstance() {
@@ -98,24 +111,62 @@ namespace IOHC {
         
     }
 
-    std::vector<uint8_t> frame;
+    /*
+        Queues the template of action for the remote's current sequence number (built here if not ready), then spends
+        that number. NVS is written once the frame is queued, while the radio sends it.
+        False when no template could be had: nothing queued or spent, onDone untouched for the caller to build the frame.
+    */
+    bool iohcRemote1W::sendPrecomputed(remote &r, Action1W action, int64_t pressedUs, TxDoneDelegate &onDone) {
+        auto* packet = iohcRadio::allocPacket();
+        // Channel and repeats; the frame itself comes from the template
+        IOHC::iohcRemote1W::forgePacket(packet, r.type[0]);
+        bool hit = false;
+        packet->buffer_length = _templates.take(r.node, r.key, r.type[0], r.sequence, action, packet->payload.buffer, &hit);
+        if (!packet->buffer_length) {
+            iohcRadio::txPool().dispose(packet);
+            return false;
+        }
+        r.sequence += 1;
 
-    void iohcRemote1W::cmd(RemoteButton cmd, Tokens* data) {
-        if (data->size() == 1) {return; }
-        std::string description = data->at(1).c_str();
+        packets2send.clear();
+        packets2send.push_back(packet);
+        const bool queued = transmit(onDone);
+        _templates.recordLatency(hit, static_cast<uint32_t>(esp_timer_get_time() - pressedUs));
 
-        auto it = std::find_if( remotes.begin(), remotes.end(),  [&] ( const remote &r  ) {
-                 return description == r.description;
-              } );
+        sequenceSpent(r);
+        return queued;
+    }
 
-        // auto&[node, sequence, key, type, manufacturer, description] = *it;
-        remote& r = *it;
-        bool found = true;
-        if (it == remotes.end()) {
+    void iohcRemote1W::sequenceSpent(const remote &r) {
+        nvs_write_sequence(r.node, r.sequence);
+        if (!r.type.empty()) _templates.track(r.node, r.key, r.type[0], r.sequence);
+    }
+
+    bool iohcRemote1W::transmit(TxDoneDelegate &onDone) {
+        if (packets2send.empty()) return false;
+        _radioInstance->send(packets2send, TxPriority::Normal, TxSource::Remote1W, 0, std::move(onDone));
+        return true;
+    }
+
+    void iohcRemote1W::idle() {
+        // The templates hold their own copy of what they need, remotes is not touched here
+        _templates.precompute(1);
+    }
+
+    bool iohcRemote1W::cmd(RemoteButton cmd, Tokens* data, TxDoneDelegate onDone) {
+        std::lock_guard<std::recursive_mutex> guard(_mutex);
+        int64_t pressedUs = esp_timer_get_time();
+        bool sent = false;
+        if (data->size() == 1) {return false; }
+        std::string description = data->at(1).c_str();
+
+        remote *it = findByDescription(description);
+        bool found = it != nullptr;
+        if (!found) {
             printf("ERROR %s NOT IN JSON", description.c_str());
-            found = false;
-            // return;
+            return false;
         }
+        remote& r = *it;
         r.positionTracker.update();
 /*
         int value = 0;
@@ -158,7 +209,7 @@ namespace IOHC {
 //                for (auto&r: remotes) {
                 if (!found) break;
 
-                    auto* packet = new iohcPacket;
+                    auto* packet = iohcRadio::allocPacket();
                     IOHC::iohcRemote1W::forgePacket(packet, r.type[0]);
                     // Packet length
                     packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x2e);
@@ -175,11 +226,10 @@ namespace IOHC {
                     packet->payload.packet.msg.p0x2e.sequence[0] = r.sequence >> 8;
                     packet->payload.packet.msg.p0x2e.sequence[1] = r.sequence & 0x00ff;
                     r.sequence += 1;
-                    nvs_write_sequence(r.node, r.sequence);
+                    sequenceSpent(r);
                     // hmac
-                    frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + 2);
                     uint8_t hmac[16];
-                    iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x2e.sequence, r.key, frame);
+                    iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x2e.sequence, r.key, &packet->payload.packet.header.cmd, 2);
 
                     for (uint8_t i = 0; i < 6; i++)
                         packet->payload.packet.msg.p0x2e.hmac[i] = hmac[i];
@@ -190,7 +240,7 @@ namespace IOHC {
                     // if (typn) packet->payload.packet.header.CtrlByte2.asStruct.LPM = 0; //TODO only first is LPM
                     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 //                }
-                _radioInstance->send(packets2send);
+                sent = transmit(onDone);
                 display1WAction(r.node, remoteButtonToString(cmd), "TX", r.name.c_str());
 
                 Serial.printf("%s position: %.0f%%\n", r.name.c_str(), r.positionTracker.getPosition());
@@ -210,7 +260,7 @@ namespace IOHC {
                 if (!found) break;
 
 
-                    auto* packet = new iohcPacket;
+                    auto* packet = iohcRadio::allocPacket();
                     IOHC::iohcRemote1W::forgePacket(packet, r.type[0]);
                     // Packet length
                     //                    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
@@ -228,11 +278,10 @@ namespace IOHC {
                     packet->payload.packet.msg.p0x2e.sequence[0] = r.sequence >> 8;
                     packet->payload.packet.msg.p0x2e.sequence[1] = r.sequence & 0x00ff;
                     r.sequence += 1;
-                    nvs_write_sequence(r.node, r.sequence);
+                    sequenceSpent(r);
                     // hmac
                     uint8_t hmac[16];
-                    frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + 2);
-                    iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x2e.sequence, r.key, frame);
+                    iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x2e.sequence, r.key, &packet->payload.packet.header.cmd, 2);
                     for (uint8_t i = 0; i < 6; i++)
                         packet->payload.packet.msg.p0x2e.hmac[i] = hmac[i];
 
@@ -241,7 +290,7 @@ namespace IOHC {
                     packets2send.push_back(packet);
                     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 //                }
-                _radioInstance->send(packets2send);
+                sent = transmit(onDone);
                 //printf("\n");
                 display1WAction(r.node, remoteButtonToString(cmd), "TX", r.name.c_str());
 
@@ -261,7 +310,7 @@ namespace IOHC {
 //                for (auto&r: remotes) {
                 if (!found) break;
 
-                    auto* packet = new iohcPacket;
+                    auto* packet = iohcRadio::allocPacket();
                     IOHC::iohcRemote1W::forgePacket(packet, r.type[0]);
                     // Packet length
                     packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x30);
@@ -286,14 +335,14 @@ namespace IOHC {
                     packet->payload.packet.msg.p0x30.sequence[0] = r.sequence >> 8;
                     packet->payload.packet.msg.p0x30.sequence[1] = r.sequence & 0x00ff;
                     r.sequence += 1;
-                    nvs_write_sequence(r.node, r.sequence);
+                    sequenceSpent(r);
 
                     packet->buffer_length = packet->payload.packet.header.CtrlByte1.asStruct.MsgLen + 1;
 
                     packets2send.push_back(packet);
                     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 //                }
-                _radioInstance->send(packets2send);
+                sent = transmit(onDone);
                 display1WAction(r.node, remoteButtonToString(cmd), "TX", r.name.c_str());
                 Serial.printf("%s position: %.0f%%\n", r.name.c_str(), r.positionTracker.getPosition());
 #if defined(SSD1306_DISPLAY)
@@ -308,7 +357,19 @@ namespace IOHC {
 //                for (auto&r: remotes) {
                 if (!found) break;
 
-                    auto* packet = new iohcPacket;
+                if (Action1W action = toAction1W(cmd);
+                    action != Action1W::Count && sendPrecomputed(r, action, pressedUs, onDone)) {
+                    sent = true;
+                    applyAction(r, cmd);
+                    display1WAction(r.node, remoteButtonToString(cmd), "TX", r.name.c_str());
+                    Serial.printf("%s position: %.0f%%\n", r.name.c_str(), r.positionTracker.getPosition());
+#if defined(SSD1306_DISPLAY)
+                    display1WPosition(r.node, r.positionTracker.getPosition(), r.name.c_str());
+#endif
+                    break;
+                }
+
+                    auto* packet = iohcRadio::allocPacket();
                     IOHC::iohcRemote1W::forgePacket(packet, r.type[0]);
                     // Packet length
                     // packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00);
@@ -321,63 +382,21 @@ namespace IOHC {
                     //Acei packet->payload.packet.msg.p0x00.acei;
                     setAcei(packet->payload.packet.msg.p0x00_14.acei, 0x43); //0xE7); //0x61);
                     switch (cmd) {
-                        // Switch for Main Parameter of cmd 0x00: Open/Close/Stop/Ventilation
+                        // Switch for Main Parameter of cmd 0x00
                         case RemoteButton::Open:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0x00;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
-                            r.positionTracker.startOpening();
-                            r.movement = remote::Movement::Opening;
-                            r.targetPosition = 100.0f;
-#if defined(MQTT)
-                            {
-                                std::string id = bytesToHexString(r.node, sizeof(r.node));
-                                publishCoverState(id, "OPENING");
-                                publishCoverPosition(id, r.positionTracker.getPosition());
-                                r.lastPublishedState = "OPENING";
-                                r.lastPublishedPosition = r.positionTracker.getPosition();
-                            }
-#endif
-                            break;
                         case RemoteButton::Close:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0xc8;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
-                            r.positionTracker.startClosing();
-                            r.movement = remote::Movement::Closing;
-                            r.targetPosition = 0.0f;
-#if defined(MQTT)
-                            {
-                                std::string id = bytesToHexString(r.node, sizeof(r.node));
-                                publishCoverState(id, "CLOSING");
-                                publishCoverPosition(id, r.positionTracker.getPosition());
-                                r.lastPublishedState = "CLOSING";
-                                r.lastPublishedPosition = r.positionTracker.getPosition();
-                            }
-#endif
-                            break;
                         case RemoteButton::Stop:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0xd2;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
-                            r.positionTracker.stop();
-                            r.movement = remote::Movement::Idle;
-                            r.targetPosition = r.positionTracker.getPosition();
-#if defined(MQTT)
-                            {
-                                std::string id = bytesToHexString(r.node, sizeof(r.node));
-                                publishCoverState(id, "STOP");
-                                publishCoverPosition(id, r.positionTracker.getPosition());
-                                r.lastPublishedState = "STOP";
-                                r.lastPublishedPosition = r.positionTracker.getPosition();
-                            }
-#endif
-                            break;
                         case RemoteButton::Vent:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0xd8;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x03;
-                            break;
-                        case RemoteButton::ForceOpen:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0x64;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
+                        case RemoteButton::ForceOpen: {
+                            // Precomputed above; built here only when no template could be had, same frame
+                            const uint16_t main = action1WMain(toAction1W(cmd));
+                            packet->payload.packet.msg.p0x00_14.main[0] = main >> 8;
+                            packet->payload.packet.msg.p0x00_14.main[1] = main & 0xFF;
+                            packet->payload.packet.msg.p0x00_14.fp1 = 0x00;
+                            packet->payload.packet.msg.p0x00_14.fp2 = 0x00;
+                            applyAction(r, cmd);
                             break;
+                        }
                         case RemoteButton::Position: {
                             int index = (data->size() > 2) ? 2 : 0;
                             int percent = atoi(data->at(index).c_str());
@@ -556,7 +575,8 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
                         break;
                     }
                         default: // If reaching default here, then cmd is not recognized, then return
-                            return;
+                            iohcRadio::txPool().dispose(packet);
+                            return false;
                     }
                     /*
                                         if (r.type == 6) { // Vert
@@ -585,8 +605,7 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
                         packet->payload.packet.msg.p0x01_13.sequence[0] = r.sequence >> 8;
                         packet->payload.packet.msg.p0x01_13.sequence[1] = r.sequence & 0x00ff;
                         uint8_t toAdd = 5 + 1; // OK
-                        frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + toAdd);
-                        iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x01_13.sequence, r.key, frame);
+                        iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x01_13.sequence, r.key, &packet->payload.packet.header.cmd, toAdd);
                         for (uint8_t i = 0; i < 6; i++) {
                             packet->payload.packet.msg.p0x01_13.hmac[i] = hmac[i];
                         }
@@ -600,8 +619,7 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
                         packet->payload.packet.msg.p0x00_16.sequence[0] = r.sequence >> 8;
                         packet->payload.packet.msg.p0x00_16.sequence[1] = r.sequence & 0x00ff;
                         uint8_t toAdd = 8 + 1;
-                        frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + toAdd);
-                        iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x00_16.sequence, r.key, frame);
+                        iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x00_16.sequence, r.key, &packet->payload.packet.header.cmd, toAdd);
                         for (uint8_t i = 0; i < 6; i++) {
                             packet->payload.packet.msg.p0x00_16.hmac[i] = hmac[i];
                         }
@@ -612,8 +630,7 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
                         packet->payload.packet.msg.p0x00_14.sequence[0] = r.sequence >> 8;
                         packet->payload.packet.msg.p0x00_14.sequence[1] = r.sequence & 0x00ff;
                         uint8_t toAdd =  6 + 1; //OK
-                        frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + toAdd);
-                        iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x00_14.sequence, r.key, frame);
+                        iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x00_14.sequence, r.key, &packet->payload.packet.header.cmd, toAdd);
                         for (uint8_t i = 0; i < 6; i++) {
                             packet->payload.packet.msg.p0x00_14.hmac[i] = hmac[i];
                         }
@@ -627,7 +644,7 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
                                         }
                     */
                     r.sequence += 1;
-                    nvs_write_sequence(r.node, r.sequence);
+                    sequenceSpent(r);
                     // hmac
                     // uint8_t hmac[16];
                     // frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + 7 + toAdd);
@@ -641,7 +658,7 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
                     packets2send.push_back(packet);
                     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 }
-                _radioInstance->send(packets2send);
+                sent = transmit(onDone);
                 display1WAction(r.node, remoteButtonToString(cmd), "TX", r.name.c_str());
                 Serial.printf("%s position: %.0f%%\n", r.name.c_str(), r.positionTracker.getPosition());
 #if defined(SSD1306_DISPLAY)
@@ -651,16 +668,41 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
 //            }
         }
         this->save(); // Save sequence number
+        return sent;
+    }
+
+    iohcRemote1W::remote *iohcRemote1W::find(const address node) {
+        uint32_t slot = iohcDeviceIndex::instance().find(DeviceKind::Remote1W, node);
+        return slot < remotes.size() ? &remotes[slot] : nullptr;
+    }
+
+    iohcRemote1W::remote *iohcRemote1W::findByDescription(const std::string &description) {
+        uint32_t slot = iohcDeviceIndex::instance().findName(DeviceKind::Remote1W, description, [&](uint32_t s) {
+            return s < remotes.size() && remotes[s].description == description;
+        });
+        return slot != DEVICE_INDEX_NONE ? &remotes[slot] : nullptr;
+    }
+
+    void iohcRemote1W::reindex() {
+        iohcDeviceIndex &index = iohcDeviceIndex::instance();
+        index.clear(DeviceKind::Remote1W);
+        for (uint32_t slot = 0; slot < remotes.size(); slot++) {
+            index.put(DeviceKind::Remote1W, remotes[slot].node, slot);
+            index.putName(DeviceKind::Remote1W, remotes[slot].description, slot);
+        }
     }
 
    bool iohcRemote1W::load() {
+        std::lock_guard<std::recursive_mutex> guard(_mutex);
         _radioInstance = iohcRadio::getInstance();
+        // The version moves once the remotes are in place, a snapshot built meanwhile is not cached as the new one
         remotes.clear();
 
         if (LittleFS.exists(IOHC_1W_REMOTE))
             Serial.printf("Loading 1W remote settings from %s\n", IOHC_1W_REMOTE);
         else {
             Serial.printf("*1W remote not available\n");
+            _version++;
             return false;
         }
 
@@ -672,6 +714,7 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
         if (error) {
             Serial.print("Failed to parse JSON: ");
             Serial.println(error.c_str());
+            _version++;
             return false;
         }
         f.close();
@@ -744,8 +787,11 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
             }
             r.positionTracker.setTravelTime(r.travelTime);
 
+            if (!r.type.empty()) _templates.track(r.node, r.key, r.type[0], r.sequence);
             remotes.push_back(r);
         }
+        reindex();
+        _version++;
 
         Serial.printf("Loaded %d x 1W remotes\n", remotes.size()); // _type.size());
         // Ensure JSON reflects the latest sequence values and persist defaults
@@ -756,6 +802,8 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
         return true;
     }
    bool iohcRemote1W::save() {
+        std::lock_guard<std::recursive_mutex> guard(_mutex);
+        _version++;
         fs::File f = LittleFS.open(IOHC_1W_REMOTE, "w+");
         JsonDocument doc;
         for (const auto&r: remotes) {
@@ -800,6 +848,7 @@ const std::vector<iohcRemote1W::remote>& iohcRemote1W::getRemotes() const {
 }
 
     bool iohcRemote1W::addRemote(const std::string &name) {
+        std::lock_guard<std::recursive_mutex> guard(_mutex);
         remote r{};
 
         // Generate unique address
@@ -807,9 +856,7 @@ const std::vector<iohcRemote1W::remote>& iohcRemote1W::getRemotes() const {
         while (!unique) {
             for (uint8_t i = 0; i < sizeof(r.node); i++)
                 r.node[i] = esp_random() & 0xff;
-            unique = std::none_of(remotes.begin(), remotes.end(), [&](const remote &e){
-                return memcmp(e.node, r.node, sizeof(r.node)) == 0;
-            });
+            unique = find(r.node) == nullptr;
         }
 
         // Generate random key
@@ -830,14 +877,15 @@ const std::vector<iohcRemote1W::remote>& iohcRemote1W::getRemotes() const {
             desc.clear();
             for (int i = 0; i < 4; ++i)
                 desc.push_back(letters[esp_random() % 26]);
-        } while (std::any_of(remotes.begin(), remotes.end(), [&](const remote &e){
-            return e.description == desc;
-        }));
+        } while (findByDescription(desc));
         r.description = desc;
 
         r.positionTracker.setTravelTime(r.travelTime);
         remotes.push_back(r);
+        iohcDeviceIndex::instance().put(DeviceKind::Remote1W, r.node, remotes.size() - 1);
+        iohcDeviceIndex::instance().putName(DeviceKind::Remote1W, r.description, remotes.size() - 1);
         nvs_write_sequence(r.node, r.sequence);
+        _templates.track(r.node, r.key, r.type[0], r.sequence);
         save();
 #if defined(MQTT)
         if (mqttClient.connected()) {
@@ -857,10 +905,9 @@ const std::vector<iohcRemote1W::remote>& iohcRemote1W::getRemotes() const {
     }
 
     bool iohcRemote1W::removeRemote(const std::string &description) {
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const remote &e) {
-            return e.description == description;
-        });
-        if (it == remotes.end()) {
+        std::lock_guard<std::recursive_mutex> guard(_mutex);
+        remote *it = findByDescription(description);
+        if (!it) {
             Serial.printf("Device %s not found\n", description.c_str());
             return false;
         }
@@ -878,19 +925,19 @@ const std::vector<iohcRemote1W::remote>& iohcRemote1W::getRemotes() const {
             mqttClient.unsubscribe(("iown/" + id + "/add").c_str());
             mqttClient.unsubscribe(("iown/" + id + "/remove").c_str());
             mqttClient.unsubscribe(("iown/" + id + "/travel_time/set").c_str());
-            mqttClient.publish(("iown/" + id + "/travel_time").c_str(), 0, true, "", 0);
         }
 #endif
-        remotes.erase(it);
+        _templates.forget(it->node);
+        remotes.erase(remotes.begin() + (it - remotes.data()));
+        reindex();
         save();
         return true;
     }
 
     bool iohcRemote1W::renameRemote(const std::string &description, const std::string &name) {
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const remote &e) {
-            return e.description == description;
-        });
-        if (it == remotes.end()) {
+        std::lock_guard<std::recursive_mutex> guard(_mutex);
+        remote *it = findByDescription(description);
+        if (!it) {
             Serial.printf("Device %s not found\n", description.c_str());
             return false;
         }
@@ -908,16 +955,18 @@ const std::vector<iohcRemote1W::remote>& iohcRemote1W::getRemotes() const {
     }
 
     void iohcRemote1W::handleRemoteAction(RemoteButton cmd, const std::string &description) {
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const remote &e) {
-            return e.description == description;
-        });
-        if (it == remotes.end()) {
+        std::lock_guard<std::recursive_mutex> guard(_mutex);
+        remote *it = findByDescription(description);
+        if (!it) {
             Serial.printf("Device %s not found\n", description.c_str());
             return;
         }
         remote &r = *it;
         r.positionTracker.update();
+        applyAction(r, cmd);
+    }
 
+    void iohcRemote1W::applyAction(remote &r, RemoteButton cmd) {
         switch (cmd) {
             case RemoteButton::Open:
                 r.positionTracker.startOpening();
@@ -967,10 +1016,9 @@ const std::vector<iohcRemote1W::remote>& iohcRemote1W::getRemotes() const {
     }
 
     bool iohcRemote1W::setTravelTime(const std::string &description, uint32_t travelTime) {
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const remote &e) {
-            return e.description == description;
-        });
-        if (it == remotes.end()) {
+        std::lock_guard<std::recursive_mutex> guard(_mutex);
+        remote *it = findByDescription(description);
+        if (!it) {
             Serial.printf("Device %s not found\n", description.c_str());
             return false;
         }
@@ -980,7 +1028,13 @@ const std::vector<iohcRemote1W::remote>& iohcRemote1W::getRemotes() const {
         return true;
     }
 
+    void iohcRemote1W::updatePositions(std::try_to_lock_t) {
+        std::unique_lock<std::recursive_mutex> guard(_mutex, std::try_to_lock);
+        if (guard.owns_lock()) updatePositions();
+    }
+
     void iohcRemote1W::updatePositions() {
+        std::lock_guard<std::recursive_mutex> guard(_mutex);
         for (auto &r : remotes) {
             r.positionTracker.update();
 
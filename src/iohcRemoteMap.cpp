@@ -10,14 +10,13 @@ namespace IOHC {
     iohcRemoteMap* iohcRemoteMap::_instance = nullptr;
 
     static std::string resolveDevice(const std::string &device) {
-        const auto &remotes = iohcRemote1W::getInstance()->getRemotes();
-        for (const auto &r : remotes) {
-            std::string id = bytesToHexString(r.node, sizeof(r.node));
-            if (device == id || device == r.description) {
-                return r.description;
-            }
-        }
-        return device;
+        iohcRemote1W *remote1W = iohcRemote1W::getInstance();
+        auto guard = remote1W->lock();
+        address node;
+        const iohcRemote1W::remote *r = nullptr;
+        if (iohcDeviceIndex::parseAddress(device, node)) r = remote1W->find(node);
+        if (!r) r = remote1W->findByDescription(device);
+        return r ? r->description : device;
     }
 
     iohcRemoteMap* iohcRemoteMap::getInstance() {
@@ -31,9 +30,11 @@ namespace IOHC {
     iohcRemoteMap::iohcRemoteMap() = default;
 
     bool iohcRemoteMap::load() {
+        // The version moves once the entries are in place, a snapshot built meanwhile is not cached as the new one
         _entries.clear();
         if (!LittleFS.exists(REMOTE_MAP_FILE)) {
             Serial.printf("*remote map not available\n");
+            _version++;
             return false;
         }
         fs::File f = LittleFS.open(REMOTE_MAP_FILE, "r");
@@ -43,6 +44,7 @@ namespace IOHC {
         if (error) {
             Serial.print("Failed to parse JSON: ");
             Serial.println(error.c_str());
+            _version++;
             return false;
         }
         for (JsonPair kv : doc.as<JsonObject>()) {
@@ -56,16 +58,26 @@ namespace IOHC {
             }
             _entries.push_back(e);
         }
+        reindex();
+        _version++;
         Serial.printf("Loaded %d remotes map\n", _entries.size());
         return true;
     }
 
     const iohcRemoteMap::entry* iohcRemoteMap::find(const address node) const {
-        for (const auto &e : _entries) {
-            if (memcmp(e.node, node, sizeof(address)) == 0)
-                return &e;
-        }
-        return nullptr;
+        uint32_t slot = iohcDeviceIndex::instance().find(DeviceKind::RemoteMap, node);
+        return slot < _entries.size() ? &_entries[slot] : nullptr;
+    }
+
+    iohcRemoteMap::entry* iohcRemoteMap::find(const address node) {
+        return const_cast<entry *>(static_cast<const iohcRemoteMap *>(this)->find(node));
+    }
+
+    void iohcRemoteMap::reindex() {
+        iohcDeviceIndex &index = iohcDeviceIndex::instance();
+        index.clear(DeviceKind::RemoteMap);
+        for (uint32_t slot = 0; slot < _entries.size(); slot++)
+            index.put(DeviceKind::RemoteMap, _entries[slot].node, slot);
     }
 
     const std::vector<iohcRemoteMap::entry>& iohcRemoteMap::getEntries() const {
@@ -73,6 +85,7 @@ namespace IOHC {
     }
 
     bool iohcRemoteMap::save() {
+        _version++;
         fs::File f = LittleFS.open(REMOTE_MAP_FILE, "w");
         if (!f) {
             Serial.println("Failed to open remote map for writing");
@@ -101,50 +114,49 @@ namespace IOHC {
         memcpy(e.node, node, sizeof(address));
         e.name = name;
         _entries.push_back(e);
+        iohcDeviceIndex::instance().put(DeviceKind::RemoteMap, node, _entries.size() - 1);
         return save();
     }
 
     bool iohcRemoteMap::linkDevice(const address node, const std::string &device) {
         std::string desc = resolveDevice(device);
-        for (auto &e : _entries) {
-            if (memcmp(e.node, node, sizeof(address)) == 0) {
-                if (std::find(e.devices.begin(), e.devices.end(), desc) == e.devices.end()) {
-                    e.devices.push_back(desc);
-                    return save();
-                }
-                Serial.println("Device already linked");
-                return false;
-            }
+        entry *e = find(node);
+        if (!e) {
+            Serial.println("Remote not found");
+            return false;
+        }
+        if (std::find(e->devices.begin(), e->devices.end(), desc) == e->devices.end()) {
+            e->devices.push_back(desc);
+            return save();
         }
-        Serial.println("Remote not found");
+        Serial.println("Device already linked");
         return false;
     }
 
     bool iohcRemoteMap::unlinkDevice(const address node, const std::string &device) {
         std::string desc = resolveDevice(device);
-        for (auto &e : _entries) {
-            if (memcmp(e.node, node, sizeof(address)) == 0) {
-                auto it = std::find(e.devices.begin(), e.devices.end(), desc);
-                if (it != e.devices.end()) {
-                    e.devices.erase(it);
-                    return save();
-                }
-                Serial.println("Device not found");
-                return false;
-            }
+        entry *e = find(node);
+        if (!e) {
+            Serial.println("Remote not found");
+            return false;
+        }
+        auto it = std::find(e->devices.begin(), e->devices.end(), desc);
+        if (it != e->devices.end()) {
+            e->devices.erase(it);
+            return save();
         }
-        Serial.println("Remote not found");
+        Serial.println("Device not found");
         return false;
     }
 
     bool iohcRemoteMap::remove(const address node) {
-        auto it = std::find_if(_entries.begin(), _entries.end(),
-                               [&](const entry &e) { return memcmp(e.node, node, sizeof(address)) == 0; });
-        if (it == _entries.end()) {
+        entry *e = find(node);
+        if (!e) {
             Serial.println("Remote not found");
             return false;
         }
-        _entries.erase(it);
+        _entries.erase(_entries.begin() + (e - _entries.data()));
+        reindex();
         return save();
     }
 }
@@ -31,30 +31,49 @@ namespace IOHC {
         return _iohcSystemTable;
     }
 
+    bool iohcSystemTable::insert(const uint8_t *node, iohcObject *obj) {
+        iohcDeviceIndex &index = iohcDeviceIndex::instance();
+        uint32_t slot = index.find(DeviceKind::SystemObject, node);
+        if (slot < _objects.size()) {
+            if (_objects[slot] != obj) delete _objects[slot];
+            _objects[slot] = obj;
+            return false;
+        }
+        _objects.push_back(obj);
+        index.put(DeviceKind::SystemObject, node, _objects.size() - 1);
+        return true;
+    }
+
     bool iohcSystemTable::addObject(address node, address backbone, uint8_t actuator[2], uint8_t manufacturer, uint8_t flags) {
         changed = true;
-        std::string s0 = bytesToHexString(node, 3);
         auto *tmp = new iohcObject (node, backbone, actuator, manufacturer, flags);
-        bool inserted = _objects.insert_or_assign(s0, tmp).second;
+        bool inserted = insert(node, tmp);
         this->save();
         return inserted;
     }
 
     bool iohcSystemTable::addObject(iohcObject *obj) {
         changed = true;
-        std::string s0 = bytesToHexString(reinterpret_cast<uint8_t *>(obj->getNode()), 3);
-        bool inserted = _objects.insert_or_assign(s0, obj).second;
+        bool inserted = insert(*obj->getNode(), obj);
         this->save();
         return inserted;
     }
 
     bool iohcSystemTable::addObject(std::string node_id, std::string serialized)  {
         auto *tmp = new iohcObject (std::move(serialized));
-        bool inserted = _objects.insert_or_assign(node_id, tmp).second;
+        address node;
+        if (!iohcDeviceIndex::parseAddress(node_id, node))
+            memcpy(node, *tmp->getNode(), sizeof(address));
+        bool inserted = insert(node, tmp);
         this->save();
         return inserted;
     }
 
+    iohcObject *iohcSystemTable::find(const address node) {
+        uint32_t slot = iohcDeviceIndex::instance().find(DeviceKind::SystemObject, node);
+        return slot < _objects.size() ? _objects[slot] : nullptr;
+    }
+
     bool iohcSystemTable::empty() {
         return(_objects.empty());
     }
@@ -64,7 +83,8 @@ namespace IOHC {
     }
 
     void iohcSystemTable::clear() {
-        return(_objects.clear());
+        _objects.clear();
+        iohcDeviceIndex::instance().clear(DeviceKind::SystemObject);
     }
 
     inline iohcSystemTable::Objects::iterator iohcSystemTable::begin() {
@@ -106,10 +126,10 @@ namespace IOHC {
         fs::File f = LittleFS.open(IOHC_SYS_TABLE, "a+");
         /*Dynamic*/JsonDocument doc; //(2048);
 
-        for (auto [fst, snd] : _objects) {
-            auto jobj = doc[fst].to<JsonObject>();
+        for (auto *obj : _objects) {
+            auto jobj = doc[bytesToHexString(*obj->getNode(), sizeof(address))].to<JsonObject>();
 
-            jobj["values"] = snd->serialize();
+            jobj["values"] = obj->serialize();
         }
         serializeJson(doc, f);
         f.close();
@@ -120,14 +140,14 @@ namespace IOHC {
 
     void iohcSystemTable::dump1W()  {
         Serial.printf("********************** 1W sysTable objects ***********************\n");
-        for (auto entry : _objects)
-            entry.second->dump1W();
+        for (auto *obj : _objects)
+            obj->dump1W();
         Serial.printf("\n");
     }
     void iohcSystemTable::dump2W()  {
         Serial.printf("********************** 2W sysTable objects ***********************\n");
-        for (auto entry : _objects)
-            entry.second->dump2W();
+        for (auto *obj : _objects)
+            obj->dump2W();
         Serial.printf("\n");
     }
 }
\ No newline at end of file
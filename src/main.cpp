@@ -21,10 +21,12 @@
 #include <crypto2Wutils.h>
 #include <iohcCryptoHelpers.h>
 #include <iohcRadio.h>
+#include <iohcFrame.h>
 
 #include <iohcSystemTable.h>
 #include <fileSystemHelpers.h>
 #include <ArduinoJson.h>
+#include <iohcJsonArena.h>
 #include <iohcRemote1W.h>
 #include <iohcCozyDevice2W.h>
 #include <iohcOtherDevice2W.h>
@@ -138,6 +140,8 @@ void setup() {
     remote1W = IOHC::iohcRemote1W::getInstance();
 
     radioInstance = IOHC::iohcRadio::getInstance();
+    const uint8_t controllerAddress[] = CONTROLLER_ADDRESS;
+    IOHC::iohcRadio::rxFilter().addAddress(controllerAddress);
     radioInstance->start(MAX_FREQS, frequencies, 0, msgRcvd, publishMsg); //msgArchive); //, msgRcvd);
 
     sysTable = IOHC::iohcSystemTable::getInstance();
@@ -164,6 +168,7 @@ void setup() {
     //   AES_init_ctx(&ctx, transfert_key); // PreInit AES for cozy (1W use original version) TODO
 
     Cmd::createCommands();
+    Cmd::startCommandWorker();
 
     // Initialize network services after devices are ready
     initWifi();
@@ -199,17 +204,9 @@ void IRAM_ATTR forgePacket(iohcPacket* packet, const std::vector<uint8_t> &toSen
     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
     IOHC::packetStamp = esp_timer_get_time();
 
-    // Common Flags
-    // 8 if protocol version is 0 else 10
-    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-    packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-    packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-    packet->payload.packet.header.CtrlByte1.asByte += toSend.size();
-    memcpy(packet->payload.buffer + 9, toSend.data(), toSend.size());
-    packet->buffer_length = toSend.size() + 9;
-
-    packet->payload.packet.header.CtrlByte2.asByte = 0;
+    // Common Flags: start frame, command and addresses set by the caller
+    iohcFrameBuilder frame(packet->payload.buffer, 0x00);
+    packet->buffer_length = frame.bytes(toSend.data(), toSend.size()).finish();
 
     packet->frequency = CHANNEL2;
     packet->repeatTime = 25;
@@ -223,20 +220,16 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
     bool isTargetedToMe = (memcmp(iohc->payload.packet.header.target, myAddress, 3) == 0);
     
     // Check for various broadcast patterns
-    bool isBroadcast = (iohc->payload.packet.header.target[0] == 0xFF && 
-                        iohc->payload.packet.header.target[1] == 0xFF && 
-                        iohc->payload.packet.header.target[2] == 0xFF) ||
-                       (iohc->payload.packet.header.target[0] == 0x00 &&
-                        iohc->payload.packet.header.target[1] == 0x00 &&
-                        iohc->payload.packet.header.target[2] >= 0x3B && 
-                        iohc->payload.packet.header.target[2] <= 0x3F);
+    bool isBroadcast = IOHC::iohcRxFilter::isBroadcast(iohc->payload.packet.header.target);
     
     // Ignore messages not targeted to this controller (unless broadcast)
+    // The radio filter already dropped them unless it is promiscuous
     if (!isTargetedToMe && !isBroadcast) {
         return false;
     }
     
-    JsonDocument doc;
+    IOHC::JsonScratch scratch;
+    JsonDocument doc(scratch.allocator());
     doc["type"] = "Unk";
     memcpy(IOHC::lastFromAddress, iohc->payload.packet.header.source, sizeof(IOHC::lastFromAddress));
 #if defined(WEBSERVER)
@@ -247,19 +240,16 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
                          sizeof(iohc->payload.packet.header.source))
             .c_str();
     String deviceName = "Unknown device";
-    const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-    auto rit = std::find_if(
-        remotes.begin(), remotes.end(), [&](const auto &r) {
-          return memcmp(r.node, iohc->payload.packet.header.source,
-                        sizeof(r.node)) == 0;
-        });
-    if (rit != remotes.end()) {
+    auto remotesGuard = IOHC::iohcRemote1W::getInstance()->lock();
+    if (const auto *rit = IOHC::iohcRemote1W::getInstance()->find(
+            iohc->payload.packet.header.source)) {
       deviceName = rit->name.c_str();
     } else if (remoteMap) {
       const auto *entry = remoteMap->find(iohc->payload.packet.header.source);
       if (entry)
         deviceName = entry->name.c_str();
     }
+    remotesGuard.unlock();
     // Log the received command with device information
     addLogMessage("Command received from " + deviceId + " CMD 0x" +
                   String(iohc->payload.packet.header.cmd, HEX).c_str());
@@ -314,7 +304,7 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
             };
 
             packets2send.clear();
-            auto* packet = new iohcPacket;
+            auto* packet = iohcRadio::allocPacket();
             forgePacket(packet, toSend);
 
             packet->payload.packet.header.cmd = IOHC::iohcDevice::SEND_DISCOVER_ANSWER_0x29;
@@ -369,7 +359,7 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
             std::vector<uint8_t> toSend = {}; // SEND_DISCOVER_ACTUATOR_0x2C
 
             packets2send.clear();
-            packets2send.push_back(new IOHC::iohcPacket);
+            packets2send.push_back(IOHC::iohcRadio::allocPacket());
             forgePacket(packets2send.back(), toSend);
 
             // packets2send.back()->payload.packet.header.cmd = 0x38;
@@ -400,7 +390,7 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
             std::vector<uint8_t> toSend = {};
 
             packets2send.clear();
-            packets2send.push_back(new IOHC::iohcPacket);
+            packets2send.push_back(IOHC::iohcRadio::allocPacket());
             forgePacket(packets2send.back(), toSend);
 
             packets2send.back()->payload.packet.header.cmd = IOHC::iohcDevice::SEND_DISCOVER_ACTUATOR_ACK_0x2D;
@@ -452,7 +442,7 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
             toSend.assign(encrypted_key, encrypted_key + 16);
 
             packets2send.clear();
-            packets2send.push_back(new IOHC::iohcPacket);
+            packets2send.push_back(IOHC::iohcRadio::allocPacket());
             forgePacket(packets2send.back(), toSend);
 
             packets2send.back()->payload.packet.header.cmd = IOHC::iohcDevice::SEND_KEY_TRANSFERT_0x32;
@@ -514,7 +504,7 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
                 IVdata.insert(IVdata.begin(), cozyDevice2W->memorizeSend.memorizedCmd);
 
                 packets2send.clear();
-                packets2send.push_back(new IOHC::iohcPacket);
+                packets2send.push_back(IOHC::iohcRadio::allocPacket());
 
                 packets2send.back()->payload.packet.header.cmd = IOHC::iohcDevice::SEND_CHALLENGE_ANSWER_0x3D;
 
@@ -608,7 +598,7 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
             toSend.resize(16);
             
             packets2send.clear();
-            packets2send.push_back(new IOHC::iohcPacket);
+            packets2send.push_back(IOHC::iohcRadio::allocPacket());
             forgePacket(packets2send.back(), toSend);
 
             packets2send.back()->payload.packet.header.cmd = 0x51;
@@ -678,9 +668,8 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
         case 0x39: {
             if (keyCap[0] == 0) break;
             uint8_t hmac[16];
-            std::vector<uint8_t> frame(&iohc->payload.packet.header.cmd, &iohc->payload.packet.header.cmd + 2);
             // frame = {0x39, 0x00}; //
-            iohcCrypto::create_1W_hmac(hmac, iohc->payload.packet.msg.p0x39.sequence, keyCap, frame);
+            iohcCrypto::create_1W_hmac(hmac, iohc->payload.packet.msg.p0x39.sequence, keyCap, &iohc->payload.packet.header.cmd, 2);
             printf("MAC: ");
             for (uint8_t idx = 0; idx < 6; idx++)
                 printf("%2.2X", hmac[idx]);
@@ -713,7 +702,15 @@ bool msgRcvd(IOHC::iohcPacket *iohc) {
  * @return The function `publishMsg` is returning `false`.
  */
 bool publishMsg(IOHC::iohcPacket *iohc) {
-    JsonDocument doc;
+#if defined(MQTT)
+    // The publisher is behind, drop the frame before building its JSON rather than queueing it
+    if (mqttQueue.congested()) {
+        mqttQueue.skipped();
+        return false;
+    }
+#endif
+    IOHC::JsonScratch scratch;
+    JsonDocument doc(scratch.allocator());
 
     doc["type"] = "Cozy";
     doc["from"] = bytesToHexString(iohc->payload.packet.header.target, 3);
@@ -744,11 +741,14 @@ bool publishMsg(IOHC::iohcPacket *iohc) {
         doc["action"] = action;
     }
 
-    std::string message;
-    size_t messageSize = serializeJson(doc, message);
+    // Serialized on the arena too, the queue copies it
+    size_t messageSize = measureJson(doc);
+    char *message = scratch.buffer(messageSize + 1);
+    if (!message) return false;
+    serializeJson(doc, message, messageSize + 1);
 #if defined(MQTT)
-    mqttClient.publish("iown/Frame", 1, false, message.c_str(), messageSize);
-    mqttClient.publish((mqtt_discovery_topic + "/sensor/iohc_frame/state").c_str(), 0, false, message.c_str(), messageSize);
+    mqttPublish("iown/Frame", message, messageSize);
+    mqttPublish((mqtt_discovery_topic + "/sensor/iohc_frame/state").c_str(), message, messageSize);
 #endif
     return false;
 }
@@ -811,7 +811,7 @@ void txUserBuffer(Tokens *cmd) {
     }
     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
     if (!packets2send[0])
-        packets2send[0] = new IOHC::iohcPacket;
+        packets2send[0] = IOHC::iohcRadio::allocPacket();
 
     if (cmd->size() == 3)
         packets2send[0]->frequency = frequencies[atoi(cmd->at(2).c_str()) - 1];
@@ -836,6 +836,9 @@ void loop() {
         pairingController->process();
     }
     
+    // Ready the 1W frames of the next button presses
+    IOHC::iohcRemote1W::getInstance()->idle();
+
     // Check for pairing timeouts
     static uint32_t lastTimeoutCheck = 0;
     if (millis() - lastTimeoutCheck > 10000) { // Check every 10 seconds
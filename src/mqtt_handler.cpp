@@ -3,6 +3,7 @@
 #if defined(MQTT)
 
 #include <iohcRemote1W.h>
+#include <iohcTopicRouter.h>
 #include <iohcCryptoHelpers.h>
 #include <AsyncMqttClient.h>
 #include <ArduinoJson.h>
@@ -13,13 +14,78 @@
 #include <WiFi.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <esp_timer.h>
+#include <LittleFS.h>
 #include <nvs_helpers.h>
 
 AsyncMqttClient mqttClient;
 TimerHandle_t mqttReconnectTimer;
 TimerHandle_t heartbeatTimer;
+IOHC::iohcMqttQueue mqttQueue;
 const char AVAILABILITY_TOPIC[] = "iown/status";
 static const char GATEWAY_ID[] = "MyOpenIO";
+static TaskHandle_t s_mqttPublisherTask = nullptr;
+IOHC::iohcDiscoveryCache discoveryCache;
+static IOHC::DiscoveryPacer discoveryPacer;
+static int64_t s_mqttConnectedUs = 0;
+static volatile bool s_retainedConfigSeen = false;
+
+static void loadDiscoveryCache();
+
+bool mqttWaitForRoom(TickType_t wait) {
+    const TickType_t start = xTaskGetTickCount();
+    while (mqttQueue.congested()) {
+        if (xTaskGetTickCount() - start >= wait) return false;
+        vTaskDelay(pdMS_TO_TICKS(MQTT_PUBLISH_RETRY_MS));
+    }
+    return true;
+}
+
+// Waits up to wait ticks for the publisher to empty the queue; false when not drained or disconnected
+static bool mqttWaitForDrain(TickType_t wait) {
+    const TickType_t start = xTaskGetTickCount();
+    while (!mqttQueue.empty()) {
+        if (!mqttClient.connected() || xTaskGetTickCount() - start >= wait) return false;
+        vTaskDelay(pdMS_TO_TICKS(MQTT_PUBLISH_RETRY_MS));
+    }
+    return true;
+}
+
+bool mqttPublish(const char *topic, const char *payload, size_t length,
+                 IOHC::iohcMqttQueue::Message::Published published) {
+    const bool queued = mqttQueue.push(topic, payload, length, esp_timer_get_time(), published) !=
+                        IOHC::iohcMqttQueue::Push::Dropped;
+    if (s_mqttPublisherTask) xTaskNotifyGive(s_mqttPublisherTask);
+    return queued;
+}
+
+bool mqttPublish(const std::string &topic, const std::string &payload,
+                 IOHC::iohcMqttQueue::Message::Published published) {
+    return mqttPublish(topic.c_str(), payload.data(), payload.size(), published);
+}
+
+// The only task publishing: drains the queue while connected, a few messages at a time
+static void mqttPublisherTask(void * /*arg*/) {
+    IOHC::iohcMqttQueue::Message message;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        uint8_t batch = 0;
+        while (mqttClient.connected() && mqttQueue.peek(message)) {
+            // 0: no room in the client's TCP buffer, try again once it sent some
+            if (!mqttClient.publish(message.topic.c_str(), message.policy.qos, message.policy.retain,
+                                    message.payload.data(), message.payload.size())) {
+                mqttQueue.retried();
+                vTaskDelay(pdMS_TO_TICKS(MQTT_PUBLISH_RETRY_MS));
+                continue;
+            }
+            mqttQueue.pop(message, esp_timer_get_time());
+            if (++batch == MQTT_QUEUE_BATCH) {
+                batch = 0;
+                vTaskDelay(1);
+            }
+        }
+    }
+}
 
 void initMqtt() {
     if (!nvs_read_string(NVS_KEY_MQTT_SERVER, mqtt_server)) {
@@ -51,6 +117,15 @@ void initMqtt() {
         }
     }
 
+    // Everything but the frames is retained state, only its last value matters
+    mqttQueue.setDefaultPolicy({0, true, true});
+    mqttQueue.setPolicy("iown/Frame", {1, false, false});
+    mqttQueue.setPolicy("+/sensor/iohc_frame/state", {0, false, true});
+    loadDiscoveryCache();
+    if (!s_mqttPublisherTask)
+        xTaskCreatePinnedToCore(mqttPublisherTask, "mqttPublisher", 4096, nullptr, 2, &s_mqttPublisherTask,
+                                tskNO_AFFINITY);
+
     mqttClient.setWill(AVAILABILITY_TOPIC, 0, true, "offline");
     mqttClient.setClientId("iown");
     mqttClient.setCredentials(mqtt_user.c_str(), mqtt_password.c_str());
@@ -66,138 +141,167 @@ void initMqtt() {
     }
 }
 
+// The cache follows what the client accepted, a config only queued when the connection dropped is not recorded
+static void configPublished(const IOHC::iohcMqttQueue::Message &sent) {
+    if (sent.payload.empty())
+        discoveryCache.forget(sent.topic);
+    else
+        discoveryCache.published(sent.topic, sent.payload.data(), sent.payload.size());
+}
+
+// Retained discovery message: skipped when the broker already has this payload, paced otherwise
+static void publishConfig(const std::string &topic, const std::string &payload) {
+    if (!discoveryCache.changed(topic, payload.data(), payload.size())) return;
+    const uint32_t waitUs = discoveryPacer.acquire(esp_timer_get_time());
+    if (waitUs) vTaskDelay(pdMS_TO_TICKS(waitUs / 1000) + 1);
+    mqttPublish(topic, payload, configPublished);
+}
+
+// Abbreviated Home Assistant keys, "~" stands for the device's iown/<id> base topic
+static void addDevice(JsonDocument &doc, const std::string &id, const std::string &name, const std::string &key) {
+    JsonObject device = doc["dev"].to<JsonObject>();
+    device["ids"] = id;
+    device["name"] = name;
+    device["mf"] = "Somfy";
+    device["mdl"] = "IO Blind Bridge";
+    device["sw"] = "1.0.0";
+    device["sn"] = key;
+    device["via_device"] = GATEWAY_ID;
+}
+
 static void publishButtonDiscovery(const std::string &id, const std::string &name,
                                    const std::string &action, const std::string &key) {
     JsonDocument doc;
+    doc["~"] = "iown/" + id;
     doc["name"] = name + " " + action;
-    doc["unique_id"] = id + "_" + action;
-    doc["command_topic"] = "iown/" + id + "/" + action;
-
-    JsonObject device = doc["device"].to<JsonObject>();
-    device["identifiers"] = id;
-    device["name"] = name;
-    device["manufacturer"] = "Somfy";
-    device["model"] = "IO Blind Bridge";
-    device["sw_version"] = "1.0.0";
-    device["serial_number"] = key;
-    device["via_device"] = GATEWAY_ID;
+    doc["uniq_id"] = id + "_" + action;
+    doc["cmd_t"] = "~/" + action;
+    addDevice(doc, id, name, key);
 
     std::string payload;
-    size_t len = serializeJson(doc, payload);
-
-    std::string topic = mqtt_discovery_topic + "/button/" + id + "_" + action + "/config";
-    mqttClient.publish(topic.c_str(), 0, true, payload.c_str(), len);
+    serializeJson(doc, payload);
+    publishConfig(mqtt_discovery_topic + "/button/" + id + "_" + action + "/config", payload);
 }
 
 void publishTravelTimeDiscovery(const std::string &id, const std::string &name,
                                 const std::string &key, uint32_t travelTime) {
     JsonDocument doc;
+    doc["~"] = "iown/" + id;
     doc["name"] = name + " travel time";
-    doc["unique_id"] = id + "_travel_time";
-    doc["command_topic"] = "iown/" + id + "/travel_time/set";
-    doc["state_topic"] = "iown/" + id + "/travel_time";
-    doc["unit_of_measurement"] = "s";
+    doc["uniq_id"] = id + "_travel_time";
+    doc["cmd_t"] = "~/travel_time/set";
+    doc["stat_t"] = "~/travel_time";
+    doc["unit_of_meas"] = "s";
     doc["min"] = 0;
     doc["max"] = 60;
     doc["step"] = 1;
-
-    JsonObject device = doc["device"].to<JsonObject>();
-    device["identifiers"] = id;
-    device["name"] = name;
-    device["manufacturer"] = "Somfy";
-    device["model"] = "IO Blind Bridge";
-    device["sw_version"] = "1.0.0";
-    device["serial_number"] = key;
-    device["via_device"] = GATEWAY_ID;
+    addDevice(doc, id, name, key);
 
     std::string payload;
-    size_t len = serializeJson(doc, payload);
-
-    std::string topic = mqtt_discovery_topic + "/number/" + id + "_travel_time/config";
-    mqttClient.publish(topic.c_str(), 0, true, payload.c_str(), len);
+    serializeJson(doc, payload);
+    publishConfig(mqtt_discovery_topic + "/number/" + id + "_travel_time/config", payload);
 
-    // publish current value
-    std::string stateTopic = "iown/" + id + "/travel_time";
-    std::string value = std::to_string(travelTime);
-    mqttClient.publish(stateTopic.c_str(), 0, true, value.c_str());
+    // publish current value, every time: the CLI and the command worker change it without the cache
+    mqttPublish("iown/" + id + "/travel_time", std::to_string(travelTime));
 }
 
 void publishDiscovery(const std::string &id, const std::string &name, const std::string &key) {
     JsonDocument doc;
+    doc["~"] = "iown/" + id;
     doc["name"] = name;
-    doc["unique_id"] = id;
-    doc["command_topic"] = "iown/" + id + "/set";
-    doc["state_topic"] = "iown/" + id + "/state";
-    doc["position_topic"] = "iown/" + id + "/position";
-    doc["set_position_topic"] = "iown/" + id + "/position/set";
-    doc["availability_topic"] = AVAILABILITY_TOPIC;
-    doc["payload_available"] = "online";
-    doc["payload_not_available"] = "offline";
-    doc["payload_open"] = "OPEN";
-    doc["payload_close"] = "CLOSE";
-    doc["payload_stop"] = "STOP";
-    doc["state_closed"] = "CLOSE";
-    doc["state_open"] = "OPEN";
-    doc["state_closing"] = "CLOSING";
-    doc["state_opening"] = "OPENING";
-    doc["state_stopped"] = "STOP";
-    doc["device_class"] = "blind";
-    doc["expire_after"] = 120;
-    doc["optimistic"] = false;
-    doc["retain"] = true;
+    doc["uniq_id"] = id;
+    doc["cmd_t"] = "~/set";
+    doc["stat_t"] = "~/state";
+    doc["pos_t"] = "~/position";
+    doc["set_pos_t"] = "~/position/set";
+    doc["avty_t"] = AVAILABILITY_TOPIC;
+    doc["pl_avail"] = "online";
+    doc["pl_not_avail"] = "offline";
+    doc["pl_open"] = "OPEN";
+    doc["pl_cls"] = "CLOSE";
+    doc["pl_stop"] = "STOP";
+    doc["stat_clsd"] = "CLOSE";
+    doc["stat_open"] = "OPEN";
+    doc["stat_closing"] = "CLOSING";
+    doc["stat_opening"] = "OPENING";
+    doc["stat_stopped"] = "STOP";
+    doc["dev_cla"] = "blind";
+    doc["exp_aft"] = 120;
+    doc["opt"] = false;
+    doc["ret"] = true;
     doc["qos"] = 0;
-
-    JsonObject device = doc["device"].to<JsonObject>();
-    device["identifiers"] = id;
-    device["name"] = name;
-    device["manufacturer"] = "Somfy";
-    device["model"] = "IO Blind Bridge";
-    device["sw_version"] = "1.0.0";
-    device["serial_number"] = key;
-    device["via_device"] = GATEWAY_ID;
+    addDevice(doc, id, name, key);
 
     std::string payload;
-    size_t len = serializeJson(doc, payload);
-
-    std::string topic = mqtt_discovery_topic + "/cover/" + id + "/config";
-    mqttClient.publish(topic.c_str(), 0, true, payload.c_str(), len);
+    serializeJson(doc, payload);
+    publishConfig(mqtt_discovery_topic + "/cover/" + id + "/config", payload);
 
     publishButtonDiscovery(id, name, "pair", key);
     publishButtonDiscovery(id, name, "add", key);
     publishButtonDiscovery(id, name, "remove", key);
 }
 
-void removeDiscovery(const std::string &id) {
-    std::string topic = mqtt_discovery_topic + "/cover/" + id + "/config";
-    mqttClient.publish(topic.c_str(), 0, true, "", 0);
-
-    auto removeButton = [&](const std::string &action) {
-        std::string t = mqtt_discovery_topic + "/button/" + id + "_" + action + "/config";
-        mqttClient.publish(t.c_str(), 0, true, "", 0);
-    };
-
-    removeButton("pair");
-    removeButton("add");
-    removeButton("remove");
+static void clearConfig(const std::string &topic) {
+    mqttPublish(topic, "", configPublished);
+}
 
-    std::string t = mqtt_discovery_topic + "/number/" + id + "_travel_time/config";
-    mqttClient.publish(t.c_str(), 0, true, "", 0);
+void removeDiscovery(const std::string &id) {
+    clearConfig(mqtt_discovery_topic + "/cover/" + id + "/config");
+    clearConfig(mqtt_discovery_topic + "/button/" + id + "_pair/config");
+    clearConfig(mqtt_discovery_topic + "/button/" + id + "_add/config");
+    clearConfig(mqtt_discovery_topic + "/button/" + id + "_remove/config");
+    clearConfig(mqtt_discovery_topic + "/number/" + id + "_travel_time/config");
+    mqttPublish("iown/" + id + "/travel_time", "");
 }
 
 void publishHeartbeat(TimerHandle_t) {
-    mqttClient.publish(AVAILABILITY_TOPIC, 0, true, "online");
+    mqttPublish(AVAILABILITY_TOPIC, "online");
 }
 
 void publishCoverState(const std::string &id, const char *state) {
     std::string topic = "iown/" + id + "/state";
-    mqttClient.publish(topic.c_str(), 0, true, state);
+    mqttPublish(topic, state);
 }
 
 void publishCoverPosition(const std::string &id, float position) {
     char buf[8];
     snprintf(buf, sizeof(buf), "%.0f", position);
     std::string topic = "iown/" + id + "/position";
-    mqttClient.publish(topic.c_str(), 0, true, buf);
+    mqttPublish(topic, buf);
+}
+
+static std::string frameConfigTopic() {
+    return mqtt_discovery_topic + "/sensor/iohc_frame/config";
+}
+
+static void loadDiscoveryCache() {
+    if (!LittleFS.exists(DISCOVERY_FILE)) return;
+    fs::File f = LittleFS.open(DISCOVERY_FILE, "r");
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, f);
+    f.close();
+    if (error) {
+        Serial.printf("Failed to parse %s: %s\n", DISCOVERY_FILE, error.c_str());
+        return;
+    }
+    for (JsonPair kv : doc.as<JsonObject>()) {
+        // Only */config topics are cached; older files also listed the travel time states
+        const std::string topic = kv.key().c_str();
+        if (topic.size() < 7 || topic.compare(topic.size() - 7, 7, "/config") != 0) continue;
+        discoveryCache.restore(topic, strtoull(kv.value().as<const char *>(), nullptr, 16));
+    }
+}
+
+static void saveDiscoveryCache() {
+    JsonDocument doc;
+    discoveryCache.store([&doc](const std::string &topic, uint64_t digest) {
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(digest));
+        doc[topic] = hex;
+    });
+    fs::File f = LittleFS.open(DISCOVERY_FILE, "w+");
+    serializeJson(doc, f);
+    f.close();
 }
 
 // ==== BELANGRIJK: scheduler die het zware werk in een eigen task zet ====
@@ -222,27 +326,53 @@ static void mqttPostConnectTask(void* /*arg*/) {
 }
 
 static void handleMqttConnectImpl() {
+    // The gateway's own retained config comes back on subscribe when the broker kept its retained messages;
+    // without it (first start, new or wiped broker) every config is published again
+    const TickType_t start = xTaskGetTickCount();
+    while (!s_retainedConfigSeen && xTaskGetTickCount() - start < pdMS_TO_TICKS(DISCOVERY_PROBE_MS))
+        vTaskDelay(pdMS_TO_TICKS(MQTT_PUBLISH_RETRY_MS));
+    mqttClient.unsubscribe(frameConfigTopic().c_str());
+    if (!s_retainedConfigSeen) discoveryCache.invalidate();
+
+    discoveryCache.begin(mqtt_server);
     // Discovery van de ‘frame’ sensor eerst, zodat state pub direct een entity heeft
     publishIohcFrameDiscovery();
-    const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-    for (const auto &r : remotes) {
-        std::string id = bytesToHexString(r.node, sizeof(r.node));
-        std::string key = bytesToHexString(r.key, sizeof(r.key));
-        std::string name = r.name.empty() ? r.description : r.name;
-        publishDiscovery(id, name, key);
-        publishTravelTimeDiscovery(id, name, key, r.travelTime);
+    // Copied under the remotes lock, the pass waits for the publisher and must not hold up the commands
+    struct Discovered {
+        std::string id, key, name;
+        uint32_t travelTime;
+    };
+    std::vector<Discovered> discovered;
+    {
+        auto guard = IOHC::iohcRemote1W::getInstance()->lock();
+        for (const auto &r : IOHC::iohcRemote1W::getInstance()->getRemotes())
+            discovered.push_back({bytesToHexString(r.node, sizeof(r.node)), bytesToHexString(r.key, sizeof(r.key)),
+                                  r.name.empty() ? r.description : r.name, r.travelTime});
+    }
+    for (const auto &r : discovered) {
+        // Discovery has no value to lose, let the publisher catch up instead of evicting frames
+        mqttWaitForRoom(MQTT_DISCOVERY_WAIT);
+        publishDiscovery(r.id, r.name, r.key);
+        publishTravelTimeDiscovery(r.id, r.name, r.key, r.travelTime);
         //std::string t = "iown/" + id + "/set";
         //mqttClient.subscribe(t.c_str(), 0);
         //mqttClient.subscribe(("iown/" + id + "/pair").c_str(), 0);
         //mqttClient.subscribe(("iown/" + id + "/add").c_str(), 0);
         //mqttClient.subscribe(("iown/" + id + "/remove").c_str(), 0);
         //mqttClient.subscribe(("iown/" + id + "/travel_time/set").c_str(), 0);
-        vTaskDelay(pdMS_TO_TICKS(200)); // throttle per device
     }
+    // Configs of remotes removed while offline, or under a previous discovery prefix
+    for (const auto &topic : discoveryCache.end((esp_timer_get_time() - s_mqttConnectedUs) / 1000))
+        mqttPublish(topic, "");
+
     if (!heartbeatTimer)
         heartbeatTimer = xTimerCreate("hb", pdMS_TO_TICKS(60000), pdTRUE, nullptr, publishHeartbeat);
     xTimerStart(heartbeatTimer, 0);
     publishHeartbeat(nullptr);
+
+    // Digests are recorded as the publisher gets the configs out; saved once all of them are through.
+    // Not drained in time: what made it so far is saved by the next pass
+    if (mqttWaitForDrain(MQTT_DRAIN_WAIT) && discoveryCache.dirty()) saveDiscoveryCache();
 }
 
 void connectToMqtt() {
@@ -273,6 +403,10 @@ void onMqttConnect(bool sessionPresent) {
     Serial.println("Connected to MQTT.");
     mqttStatus = ConnState::Connected;
     updateDisplayStatus();
+    if (s_mqttPublisherTask) xTaskNotifyGive(s_mqttPublisherTask);
+    s_mqttConnectedUs = esp_timer_get_time();
+    s_retainedConfigSeen = false;
+    mqttClient.subscribe(frameConfigTopic().c_str(), 0);
 
     //mqttClient.subscribe("iown/powerOn", 0);
     //mqttClient.subscribe("iown/setPresence", 0);
@@ -309,214 +443,203 @@ void onMqttDisconnect(AsyncMqttClientDisconnectReason reason) {
 
 static void publishIohcFrameDiscovery() {
     JsonDocument configDoc;
+    configDoc["~"] = mqtt_discovery_topic + "/sensor/iohc_frame";
     configDoc["name"] = "IOHC Frame";
-    configDoc["state_topic"] = mqtt_discovery_topic + "/sensor/iohc_frame/state";
-    configDoc["unique_id"] = "iohc_frame";
-    configDoc["json_attributes_topic"] = mqtt_discovery_topic + "/sensor/iohc_frame/state";
+    configDoc["stat_t"] = "~/state";
+    configDoc["uniq_id"] = "iohc_frame";
+    configDoc["json_attr_t"] = "~/state";
 
-    JsonObject device = configDoc["device"].to<JsonObject>();
-    device["identifiers"] = GATEWAY_ID;
+    JsonObject device = configDoc["dev"].to<JsonObject>();
+    device["ids"] = GATEWAY_ID;
     device["name"] = "My Open IO Gateway";
-    device["manufacturer"] = "Somfy";
-    device["model"] = "IO Blind Bridge";
-    device["sw_version"] = "1.0.0";
+    device["mf"] = "Somfy";
+    device["mdl"] = "IO Blind Bridge";
+    device["sw"] = "1.0.0";
 
     std::string cfg;
-    size_t cfgLen = serializeJson(configDoc, cfg);
-    mqttClient.publish((mqtt_discovery_topic + "/sensor/iohc_frame/config").c_str(),
-                       0, true, cfg.c_str(), cfgLen);
-}
-
-
-void mqttFuncHandler(const char *cmd) {
-    constexpr char delim = ' ';
-    Tokens segments;
-    tokenize(cmd + 5, delim, segments);
-    Serial.printf("Search for %s\t", segments[0].c_str());
-    for (uint8_t idx = 0; idx <= lastEntry; ++idx) {
-        if (_cmdHandler[idx] == nullptr) continue;
-        if (segments[0].find(_cmdHandler[idx]->cmd) != std::string::npos) {
-            Serial.printf(" %s %s (%s)\n", _cmdHandler[idx]->cmd,
-                          segments.size() > 1 ? segments[1].c_str() : "No param",
-                          _cmdHandler[idx]->description);
-            _cmdHandler[idx]->handler(&segments);
-            return;
-        }
-    }
-    Serial.printf("*> MQTT Unknown %s <*\n", segments[0].c_str());
+    serializeJson(configDoc, cfg);
+    publishConfig(frameConfigTopic(), cfg);
 }
 
-void onMqttMessage(char *topic, char *payload, AsyncMqttClientMessageProperties properties,
-                   size_t len, size_t index, size_t total) {
-    if (!topic || !payload || len == 0) return;
-
-    // Safe copy of payload
-    char buf[len + 1];
-    memcpy(buf, payload, len);
-    buf[len] = '\0';
-
-    Serial.printf("Received MQTT %s %s %d\n", topic, buf, len);
-
-    std::string topicStr(topic);
-    std::string payloadStr(buf);
+// iown/<command> topics go to the command worker like the device commands
+void mqttFuncHandler(const char *topic, const char *data) {
+    Serial.printf("Search for %s\t", topic);
+    IOHC::Command command;
+    command.kind = IOHC::CommandKind::Topic;
+    command.text = topic;
+    command.argument = data ? data : "";
+    if (Cmd::submit(command) == IOHC::iohcCommandQueue::Push::Rejected)
+        mqttCommandDone(command, false);
+}
 
-    if (topicStr.rfind("iown/", 0) == 0 && topicStr.find("/travel_time/set", 5) != std::string::npos) {
-        std::string id = topicStr.substr(5, topicStr.find("/travel_time/set", 5) - 5);
-        std::transform(id.begin(), id.end(), id.begin(), ::tolower);
-        const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const auto &r) {
-            return bytesToHexString(r.node, sizeof(r.node)) == id;
-        });
-        if (it != remotes.end()) {
-            uint32_t tt = strtoul(payloadStr.c_str(), nullptr, 10);
-            if (tt > 0) {
-                IOHC::iohcRemote1W::getInstance()->setTravelTime(it->description, tt);
-                std::string stateTopic = "iown/" + id + "/travel_time";
-                std::string val = std::to_string(tt);
-                mqttClient.publish(stateTopic.c_str(), 0, true, val.c_str());
-            }
-            mqttClient.publish(topicStr.c_str(), 0, true, "", 0);
-        }
+// What Home Assistant is told once the worker ran a command, or when it was rejected
+void mqttCommandDone(const IOHC::Command &command, bool acknowledged) {
+    if (command.kind == IOHC::CommandKind::Topic || command.kind == IOHC::CommandKind::Line) {
+        if (!acknowledged) Serial.printf("*> MQTT Unknown %s <*\n", command.text.c_str());
         return;
     }
-
-    if (topicStr.rfind("iown/", 0) == 0 && topicStr.find("/position/set", 5) != std::string::npos) {
-        std::string id = topicStr.substr(5, topicStr.find("/position/set", 5) - 5);
-        std::transform(id.begin(), id.end(), id.begin(), ::tolower);
-        const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const auto &r) {
-            return bytesToHexString(r.node, sizeof(r.node)) == id;
-        });
-        if (it != remotes.end()) {
-            int openVal = atoi(payloadStr.c_str());
-            openVal = std::clamp(openVal, 0, 100);
-            int closeVal = 100 - openVal;
-            Tokens t;
-            t.push_back(std::to_string(closeVal));
-            t.push_back(it->description);
-            IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::Absolute, &t);
-            std::string stateTopic = "iown/" + id + "/state";
-            const char *state = (openVal >= 99) ? "OPEN" : (openVal <= 1 ? "CLOSE" : "STOP");
-            mqttClient.publish(stateTopic.c_str(), 0, true, state);
-            std::string posTopic = "iown/" + id + "/position";
-            std::string openStr = std::to_string(openVal);
-            mqttClient.publish(posTopic.c_str(), 0, true, openStr.c_str());
-            mqttClient.publish(topicStr.c_str(), 0, true, "", 0);
-        }
+    char id[7];
+    snprintf(id, sizeof(id), "%06x", static_cast<unsigned>(command.device));
+    if (!acknowledged) {
+        Serial.printf("*> MQTT command for %s not sent <*\n", id);
+        // The slider goes back to where the cover is
+        const IOHC::address node = {static_cast<uint8_t>(command.device >> 16),
+                                    static_cast<uint8_t>(command.device >> 8), static_cast<uint8_t>(command.device)};
+        auto guard = IOHC::iohcRemote1W::getInstance()->lock();
+        if (const auto *r = IOHC::iohcRemote1W::getInstance()->find(node))
+            publishCoverPosition(id, r->positionTracker.getPosition());
         return;
     }
-
-    if (topicStr.rfind("iown/", 0) == 0 && topicStr.find("/absolute/set", 5) != std::string::npos) {
-        std::string id = topicStr.substr(5, topicStr.find("/absolute/set", 5) - 5);
-        std::transform(id.begin(), id.end(), id.begin(), ::tolower);
-        const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const auto &r) {
-            return bytesToHexString(r.node, sizeof(r.node)) == id;
-        });
-        if (it != remotes.end()) {
-            Tokens t;
-            t.push_back(payloadStr);
-            t.push_back(it->description);
-            IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::Absolute, &t);
-            std::string stateTopic = "iown/" + id + "/state";
-            int val = atoi(payloadStr.c_str());
-            int openVal = 100 - std::clamp(val, 0, 100);
-            const char *state = (openVal >= 99) ? "OPEN" : (openVal <= 1 ? "CLOSE" : "STOP");
-            mqttClient.publish(stateTopic.c_str(), 0, true, state);
-            std::string posTopic = "iown/" + id + "/position";
-            std::string openStr = std::to_string(openVal);
-            mqttClient.publish(posTopic.c_str(), 0, true, openStr.c_str());
-            mqttClient.publish(topicStr.c_str(), 0, true, "", 0);
-        }
+    if (command.kind == IOHC::CommandKind::TravelTime) {
+        mqttPublish("iown/" + std::string(id) + "/travel_time", std::to_string(command.value));
         return;
     }
-
-    if (topicStr.rfind("iown/", 0) == 0 && topicStr.find("/set", 5) != std::string::npos) {
-        std::string id = topicStr.substr(5, topicStr.find("/set", 5) - 5);
-        std::transform(id.begin(), id.end(), id.begin(), ::tolower);
-        const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const auto &r) {
-            return bytesToHexString(r.node, sizeof(r.node)) == id;
-        });
-        if (it != remotes.end()) {
-            Tokens t;
-            std::transform(payloadStr.begin(), payloadStr.end(), payloadStr.begin(), ::tolower);
-            t.push_back(payloadStr);
-            t.push_back(it->description);
-            std::string stateTopic = "iown/" + id + "/state";
-
-            if (payloadStr == "open") {
-                IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::Open, &t);
-                mqttClient.publish(stateTopic.c_str(), 0, true, "OPEN");
-            } else if (payloadStr == "close") {
-                IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::Close, &t);
-                mqttClient.publish(stateTopic.c_str(), 0, true, "CLOSE");
-            } else if (payloadStr == "stop") {
-                IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::Stop, &t);
-                mqttClient.publish(stateTopic.c_str(), 0, true, "STOP");
-            } else if (payloadStr == "vent") {
-                IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::Vent, &t);
-            } else if (payloadStr == "force") {
-                IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::ForceOpen, &t);
-            } else {
-                Serial.printf("*> MQTT Unknown %s <*\n", payloadStr.c_str());
-            }
-            // Clear retained set message
-            mqttClient.publish(topicStr.c_str(), 0, true, "", 0);
-        } else {
-            Serial.printf("*> MQTT Unknown device %s <*\n", id.c_str());
+    switch (static_cast<IOHC::RemoteButton>(command.button)) {
+        case IOHC::RemoteButton::Open:
+            publishCoverState(id, "OPEN");
+            break;
+        case IOHC::RemoteButton::Close:
+            publishCoverState(id, "CLOSE");
+            break;
+        case IOHC::RemoteButton::Stop:
+            publishCoverState(id, "STOP");
+            break;
+        case IOHC::RemoteButton::Absolute: {
+            const int openVal = 100 - command.value;
+            publishCoverState(id, (openVal >= 99) ? "OPEN" : (openVal <= 1 ? "CLOSE" : "STOP"));
+            publishCoverPosition(id, openVal);
+            break;
         }
+        default:
+            break;
+    }
+}
+
+// Device topics: iown/<remote address>/<command>, the remote already resolved by onMqttMessage
+using DeviceTopicHandler = void (*)(const std::string &topic, const std::string &id, IOHC::iohcRemote1W::remote &r,
+                                    std::string &payload);
+
+// Queues a command for r and clears the retained set message; the state follows from mqttCommandDone
+static void submitCommand(const std::string &topic, IOHC::iohcRemote1W::remote &r, IOHC::Command &command) {
+    command.source = IOHC::CommandSource::Mqtt;
+    command.device = IOHC::deviceKey(r.node);
+    if (Cmd::submit(command) == IOHC::iohcCommandQueue::Push::Rejected)
+        mqttCommandDone(command, false);
+    mqttPublish(topic, "");
+}
+
+static void onTravelTimeSet(const std::string &topic, const std::string &id, IOHC::iohcRemote1W::remote &r,
+                            std::string &payload) {
+    uint32_t tt = strtoul(payload.c_str(), nullptr, 10);
+    if (tt == 0) {
+        mqttPublish(topic, "");
         return;
     }
+    IOHC::Command command;
+    command.kind = IOHC::CommandKind::TravelTime;
+    command.value = static_cast<int32_t>(tt);
+    submitCommand(topic, r, command);
+}
 
-    if (topicStr.rfind("iown/", 0) == 0 && topicStr.find("/pair", 5) != std::string::npos) {
-        std::string id = topicStr.substr(5, topicStr.find("/pair", 5) - 5);
-        std::transform(id.begin(), id.end(), id.begin(), ::tolower);
-        const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const auto &r) {
-            return bytesToHexString(r.node, sizeof(r.node)) == id;
-        });
-        if (it != remotes.end()) {
-            Tokens t;
-            t.push_back("pair");
-            t.push_back(it->description);
-            IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::Pair, &t);
-            mqttClient.publish(topicStr.c_str(), 0, true, "", 0);
-        }
+// Absolute position, percent closed; only the newest one waiting for the remote is sent
+static void submitPosition(const std::string &topic, IOHC::iohcRemote1W::remote &r, int closed) {
+    IOHC::Command command;
+    command.button = static_cast<uint8_t>(IOHC::RemoteButton::Absolute);
+    command.value = std::clamp(closed, 0, 100);
+    command.coalesce = true;
+    submitCommand(topic, r, command);
+}
+
+static void onPositionSet(const std::string &topic, const std::string &id, IOHC::iohcRemote1W::remote &r,
+                          std::string &payload) {
+    submitPosition(topic, r, 100 - std::clamp(atoi(payload.c_str()), 0, 100));
+}
+
+static void onAbsoluteSet(const std::string &topic, const std::string &id, IOHC::iohcRemote1W::remote &r,
+                          std::string &payload) {
+    submitPosition(topic, r, atoi(payload.c_str()));
+}
+
+static void onSet(const std::string &topic, const std::string &id, IOHC::iohcRemote1W::remote &r,
+                  std::string &payload) {
+    std::transform(payload.begin(), payload.end(), payload.begin(), ::tolower);
+    IOHC::RemoteButton button;
+    if (payload == "open") {
+        button = IOHC::RemoteButton::Open;
+    } else if (payload == "close") {
+        button = IOHC::RemoteButton::Close;
+    } else if (payload == "stop") {
+        button = IOHC::RemoteButton::Stop;
+    } else if (payload == "vent") {
+        button = IOHC::RemoteButton::Vent;
+    } else if (payload == "force") {
+        button = IOHC::RemoteButton::ForceOpen;
+    } else {
+        Serial.printf("*> MQTT Unknown %s <*\n", payload.c_str());
+        // Clear retained set message
+        mqttPublish(topic, "");
         return;
     }
+    IOHC::Command command;
+    command.button = static_cast<uint8_t>(button);
+    submitCommand(topic, r, command);
+}
 
-    if (topicStr.rfind("iown/", 0) == 0 && topicStr.find("/add", 5) != std::string::npos) {
-        std::string id = topicStr.substr(5, topicStr.find("/add", 5) - 5);
-        std::transform(id.begin(), id.end(), id.begin(), ::tolower);
-        const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const auto &r) {
-            return bytesToHexString(r.node, sizeof(r.node)) == id;
-        });
-        if (it != remotes.end()) {
-            Tokens t;
-            t.push_back("add");
-            t.push_back(it->description);
-            IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::Add, &t);
-            mqttClient.publish(topicStr.c_str(), 0, true, "", 0);
-        }
+template <IOHC::RemoteButton button>
+static void onButton(const std::string &topic, const std::string &id, IOHC::iohcRemote1W::remote &r,
+                     std::string &payload) {
+    IOHC::Command command;
+    command.button = static_cast<uint8_t>(button);
+    submitCommand(topic, r, command);
+}
+
+static const IOHC::iohcTopicRouter<DeviceTopicHandler> &deviceTopics() {
+    static const IOHC::iohcTopicRouter<DeviceTopicHandler> router = [] {
+        IOHC::iohcTopicRouter<DeviceTopicHandler> r;
+        r.add("iown/+/set", onSet);
+        r.add("iown/+/position/set", onPositionSet);
+        r.add("iown/+/absolute/set", onAbsoluteSet);
+        r.add("iown/+/travel_time/set", onTravelTimeSet);
+        r.add("iown/+/pair", onButton<IOHC::RemoteButton::Pair>);
+        r.add("iown/+/add", onButton<IOHC::RemoteButton::Add>);
+        r.add("iown/+/remove", onButton<IOHC::RemoteButton::Remove>);
+        return r;
+    }();
+    return router;
+}
+
+void onMqttMessage(char *topic, char *payload, AsyncMqttClientMessageProperties properties,
+                   size_t len, size_t index, size_t total) {
+    if (!topic || !payload || len == 0) return;
+    if (properties.retain && frameConfigTopic() == topic) {
+        s_retainedConfigSeen = true;
         return;
     }
 
-    if (topicStr.rfind("iown/", 0) == 0 && topicStr.find("/remove", 5) != std::string::npos) {
-        std::string id = topicStr.substr(5, topicStr.find("/remove", 5) - 5);
+    // Safe copy of payload
+    char buf[len + 1];
+    memcpy(buf, payload, len);
+    buf[len] = '\0';
+
+    Serial.printf("Received MQTT %s %s %d\n", topic, buf, len);
+
+    // Topic to handler and remote in one pass: the router, then the shared device index
+    IOHC::iohcTopicRouter<DeviceTopicHandler>::Match route;
+    if (deviceTopics().match(topic, strlen(topic), route)) {
+        std::string id = route.params[0].str();
         std::transform(id.begin(), id.end(), id.begin(), ::tolower);
-        const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const auto &r) {
-            return bytesToHexString(r.node, sizeof(r.node)) == id;
-        });
-        if (it != remotes.end()) {
-            Tokens t;
-            t.push_back("remove");
-            t.push_back(it->description);
-            IOHC::iohcRemote1W::getInstance()->cmd(IOHC::RemoteButton::Remove, &t);
-            mqttClient.publish(topicStr.c_str(), 0, true, "", 0);
+        IOHC::address node;
+        IOHC::iohcRemote1W::remote *r = nullptr;
+        auto guard = IOHC::iohcRemote1W::getInstance()->lock();
+        if (IOHC::iohcDeviceIndex::parseAddress(id, node))
+            r = IOHC::iohcRemote1W::getInstance()->find(node);
+        if (!r) {
+            Serial.printf("*> MQTT Unknown device %s <*\n", id.c_str());
+            return;
         }
+        std::string topicStr(topic);
+        std::string payloadStr(buf);
+        route.handler(topicStr, id, *r, payloadStr);
         return;
     }
 
@@ -526,13 +649,6 @@ void onMqttMessage(char *topic, char *payload, AsyncMqttClientMessageProperties
         return;
     }
 
-    const char *data = doc["_data"];
-    size_t bufferSize = strlen(topic) + (data ? strlen(data) : 0) + 7;
-    char message[bufferSize];
-    if (!data)
-        snprintf(message, sizeof(message), "MQTT %s", topic);
-    else
-        snprintf(message, sizeof(message), "MQTT %s %s", topic, data);
-    mqttFuncHandler(message);
+    mqttFuncHandler(topic, doc["_data"].as<const char *>());
 }
 #endif // MQTT
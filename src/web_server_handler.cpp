@@ -8,9 +8,12 @@
 #include <Update.h>
 #include <interact.h>
 #include <iohcCryptoHelpers.h>
+#include <iohcJsonArena.h>
+#include <iohcJsonSnapshot.h>
 #include <iohcRemote1W.h>
 #include <iohcRemoteMap.h>
 #include <iohcPacket.h>
+#include <iohcRadio.h>
 #include <log_buffer.h>
 #include <mqtt_handler.h>
 #include <nvs_helpers.h>
@@ -22,6 +25,34 @@
 // If you use WebServer.h, the setup and request handling will be different.
 AsyncWebServer server(80); // Create AsyncWebServer object on port 80
 AsyncWebSocket ws("/ws");
+IOHC::iohcJsonSnapshot devicesSnapshot;
+IOHC::iohcJsonSnapshot remotesSnapshot;
+#if defined(MQTT)
+IOHC::iohcJsonSnapshot mqttSnapshot;
+#endif
+
+// Serializes doc on the calling task's arena and hands it to send(text, length)
+template <typename Send>
+static void sendSerialized(IOHC::JsonScratch &scratch, const JsonDocument &doc, Send &&send) {
+  const size_t length = measureJson(doc);
+  char *text = scratch.buffer(length + 1);
+  if (!text)
+    return;
+  serializeJson(doc, text, length + 1);
+  send(text, length);
+}
+
+// Streams doc straight into the response buffer
+static void sendJson(AsyncWebServerRequest *request, const JsonDocument &doc, int code = 200) {
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  if (!response) {
+    request->send(500, "text/plain", "OOM");
+    return;
+  }
+  response->setCode(code);
+  serializeJson(doc, *response);
+  request->send(response);
+}
 
 static void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                       AwsEventType type, void *arg, uint8_t *data,
@@ -31,61 +62,62 @@ static void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
     IOHC::iohcRemote1W::getInstance()->updatePositions();
 
     // Build a compact init message containing only device information
-    DynamicJsonDocument doc(1024);
-    doc["type"] = "init";
-
-    JsonArray devices = doc.createNestedArray("devices");
-    const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-    for (const auto &r : remotes) {
-      JsonObject d = devices.createNestedObject();
-      d["id"] = bytesToHexString(r.node, sizeof(r.node)).c_str();
-      d["name"] = r.name.c_str();
-      d["position"] = r.positionTracker.getPosition();
+    {
+      IOHC::JsonScratch scratch;
+      JsonDocument doc(scratch.allocator());
+      doc["type"] = "init";
+
+      JsonArray devices = doc["devices"].to<JsonArray>();
+      auto guard = IOHC::iohcRemote1W::getInstance()->lock();
+      const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
+      for (const auto &r : remotes) {
+        JsonObject d = devices.add<JsonObject>();
+        d["id"] = bytesToHexString(r.node, sizeof(r.node)).c_str();
+        d["name"] = r.name.c_str();
+        d["position"] = r.positionTracker.getPosition();
+      }
+      sendSerialized(scratch, doc, [client](const char *text, size_t length) { client->text(text, length); });
     }
 
-    String payload;
-    serializeJson(doc, payload);
-    client->text(payload);
-
     // Stream cached log messages individually to avoid a large JSON payload
     auto logMsgs = getLogMessages();
     for (const auto &m : logMsgs) {
-      DynamicJsonDocument logDoc(128);
+      IOHC::JsonScratch scratch;
+      JsonDocument logDoc(scratch.allocator());
       logDoc["type"] = "log";
       logDoc["message"] = m;
-      String logPayload;
-      serializeJson(logDoc, logPayload);
-      client->text(logPayload);
+      sendSerialized(scratch, logDoc, [client](const char *text, size_t length) { client->text(text, length); });
     }
   }
 }
 
+static void wsTextAll(IOHC::JsonScratch &scratch, const JsonDocument &doc) {
+  sendSerialized(scratch, doc, [](const char *text, size_t length) { ws.textAll(text, length); });
+}
+
 void broadcastLog(const String &msg) {
-  DynamicJsonDocument doc(128);
+  IOHC::JsonScratch scratch;
+  JsonDocument doc(scratch.allocator());
   doc["type"] = "log";
   doc["message"] = msg;
-  String payload;
-  serializeJson(doc, payload);
-  ws.textAll(payload);
+  wsTextAll(scratch, doc);
 }
 
 void broadcastDevicePosition(const String &id, int position) {
-  DynamicJsonDocument doc(128);
+  IOHC::JsonScratch scratch;
+  JsonDocument doc(scratch.allocator());
   doc["type"] = "position";
   doc["id"] = id;
   doc["position"] = position;
-  String payload;
-  serializeJson(doc, payload);
-  ws.textAll(payload);
+  wsTextAll(scratch, doc);
 }
 
 void broadcastLastAddress(const String &addr) {
-  DynamicJsonDocument doc(64);
+  IOHC::JsonScratch scratch;
+  JsonDocument doc(scratch.allocator());
   doc["type"] = "lastaddr";
   doc["address"] = addr;
-  String payload;
-  serializeJson(doc, payload);
-  ws.textAll(payload);
+  wsTextAll(scratch, doc);
 }
 
 // Structure describing a device entry returned to the web UI
@@ -94,58 +126,94 @@ struct Device {
   String name;
 };
 
-void handleApiDevices(AsyncWebServerRequest *request) {
-  // Update device positions before returning them to the web client
-  IOHC::iohcRemote1W::getInstance()->updatePositions();
+// Serializes doc into the body a snapshot keeps, sized once
+static void serializeBody(const JsonDocument &doc, std::string &body) {
+  body.reserve(measureJson(doc));
+  serializeJson(doc, body);
+}
 
-  AsyncJsonResponse *response = new AsyncJsonResponse();
+// The snapshot's body with its ETag, or 304 when the client already has it; clients revalidate on every poll
+template <typename Build>
+static void sendSnapshot(AsyncWebServerRequest *request, IOHC::iohcJsonSnapshot &snapshot, uint64_t key,
+                         Build &&build) {
+  const AsyncWebHeader *header = request->getHeader("If-None-Match");
+  IOHC::iohcJsonSnapshot::Reply reply =
+      snapshot.serve(key, header ? header->value().c_str() : nullptr, build);
+  if (reply.notModified) {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("ETag", reply.etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+    return;
+  }
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
   if (!response) {
-    request->send(500, "text/plain", "Out of memory");
+    request->send(500, "text/plain", "OOM");
     return;
   }
-  JsonArray root = response->getRoot().to<JsonArray>();
+  response->addHeader("ETag", reply.etag);
+  response->addHeader("Cache-Control", "no-cache");
+  response->write(reinterpret_cast<const uint8_t *>(reply.body->data()), reply.body->size());
+  request->send(response);
+}
+
+void handleApiDevices(AsyncWebServerRequest *request) {
+  // Update device positions before returning them to the web client
+  IOHC::iohcRemote1W::getInstance()->updatePositions();
 
+  // The remotes file version, and the positions moving on their own; the list is held until the body is built
+  auto guard = IOHC::iohcRemote1W::getInstance()->lock();
   const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
+  const uint32_t version = IOHC::iohcRemote1W::getInstance()->version();
+  uint64_t key = IOHC::iohcJsonSnapshot::digest(&version, sizeof(version));
   for (const auto &r : remotes) {
-    JsonObject deviceObj = root.add<JsonObject>();
-    deviceObj["id"] = bytesToHexString(r.node, sizeof(r.node)).c_str();
-    deviceObj["name"] = r.name.c_str();
-    deviceObj["description"] = r.description.c_str();
-    deviceObj["position"] = r.positionTracker.getPosition();
-    deviceObj["travel_time"] = r.travelTime;
+    const float position = r.positionTracker.getPosition();
+    key = IOHC::iohcJsonSnapshot::digest(&position, sizeof(position), key);
   }
 
-  // Provide a generic command interface as last entry
-  // JsonObject cmdObj = root.add<JsonObject>();
-  // cmdObj["id"] = "cmd_if";
-  // cmdObj["name"] = "Command Interface";
+  sendSnapshot(request, devicesSnapshot, key, [&remotes](std::string &body) {
+    IOHC::JsonScratch scratch;
+    JsonDocument reply(scratch.allocator());
+    JsonArray root = reply.to<JsonArray>();
+    for (const auto &r : remotes) {
+      JsonObject deviceObj = root.add<JsonObject>();
+      deviceObj["id"] = bytesToHexString(r.node, sizeof(r.node)).c_str();
+      deviceObj["name"] = r.name.c_str();
+      deviceObj["description"] = r.description.c_str();
+      deviceObj["position"] = r.positionTracker.getPosition();
+      deviceObj["travel_time"] = r.travelTime;
+    }
 
-  response->setLength();
-  request->send(response);
+    // Provide a generic command interface as last entry
+    // JsonObject cmdObj = root.add<JsonObject>();
+    // cmdObj["id"] = "cmd_if";
+    // cmdObj["name"] = "Command Interface";
+
+    serializeBody(reply, body);
+  });
   // log_i("Sent device list"); // Requires a logging library
 }
 
 void handleApiRemotes(AsyncWebServerRequest *request) {
-  AsyncJsonResponse *response = new AsyncJsonResponse();
-  if (!response) {
-    request->send(500, "text/plain", "Out of memory");
-    return;
-  }
-  JsonArray root = response->getRoot().to<JsonArray>();
-
-  const auto &entries = IOHC::iohcRemoteMap::getInstance()->getEntries();
-  for (const auto &e : entries) {
-    JsonObject obj = root.add<JsonObject>();
-    obj["id"] = bytesToHexString(e.node, sizeof(e.node)).c_str();
-    obj["name"] = e.name.c_str();
-    JsonArray devs = obj.createNestedArray("devices");
-    for (const auto &d : e.devices) {
-      devs.add(d.c_str());
+  const uint32_t version = IOHC::iohcRemoteMap::getInstance()->version();
+  sendSnapshot(request, remotesSnapshot, version, [](std::string &body) {
+    IOHC::JsonScratch scratch;
+    JsonDocument reply(scratch.allocator());
+    JsonArray root = reply.to<JsonArray>();
+
+    const auto &entries = IOHC::iohcRemoteMap::getInstance()->getEntries();
+    for (const auto &e : entries) {
+      JsonObject obj = root.add<JsonObject>();
+      obj["id"] = bytesToHexString(e.node, sizeof(e.node)).c_str();
+      obj["name"] = e.name.c_str();
+      JsonArray devs = obj.createNestedArray("devices");
+      for (const auto &d : e.devices) {
+        devs.add(d.c_str());
+      }
     }
-  }
 
-  response->setLength();
-  request->send(response);
+    serializeBody(reply, body);
+  });
 }
 
 void handleDownloadDevices(AsyncWebServerRequest *request) {
@@ -207,6 +275,62 @@ void handleUploadRemotesFile(AsyncWebServerRequest *request, String filename,
   }
 }
 
+// Hands command to the command worker: 202 with its ticket, 503 when the queue is full
+static void sendQueued(AsyncWebServerRequest *request, const IOHC::Command &command, const String &label) {
+  uint32_t ticket = 0;
+  if (Cmd::submit(command, &ticket) == IOHC::iohcCommandQueue::Push::Rejected) {
+    addLogMessage(label + " rejected, command queue full");
+    request->send(503, "application/json",
+                  "{\"success\":false, \"message\":\"Command queue full\"}");
+    return;
+  }
+  IOHC::JsonScratch scratch;
+  JsonDocument reply(scratch.allocator());
+  JsonObject root = reply.to<JsonObject>();
+  root["success"] = true;
+  root["message"] = label + " queued";
+  root["ticket"] = ticket;
+  sendJson(request, reply, 202);
+}
+
+static const char *actionName(IOHC::RemoteButton button) {
+  switch (button) {
+  case IOHC::RemoteButton::Open:
+    return "open";
+  case IOHC::RemoteButton::Close:
+    return "close";
+  case IOHC::RemoteButton::Stop:
+    return "stop";
+  default:
+    return "command";
+  }
+}
+
+// Result of a web command, run by the command worker: the log and the position shown in the UI
+void webCommandDone(const IOHC::Command &command, bool acknowledged) {
+  String message = "#" + String(command.ticket) + " ";
+  if (command.kind == IOHC::CommandKind::Line) {
+    addLogMessage(message + (acknowledged ? "Command executed" : "Unknown command"));
+    return;
+  }
+  const IOHC::address node = {static_cast<uint8_t>(command.device >> 16), static_cast<uint8_t>(command.device >> 8),
+                              static_cast<uint8_t>(command.device)};
+  auto guard = IOHC::iohcRemote1W::getInstance()->lock();
+  const IOHC::iohcRemote1W::remote *r = IOHC::iohcRemote1W::getInstance()->find(node);
+  if (!r) {
+    addLogMessage(message + "Device removed, action not sent");
+    return;
+  }
+  const String id = bytesToHexString(r->node, sizeof(r->node)).c_str();
+  const char *action = actionName(static_cast<IOHC::RemoteButton>(command.button));
+  if (!acknowledged) {
+    addLogMessage(message + "Action " + action + " to " + r->name.c_str() + " not sent");
+    return;
+  }
+  broadcastDevicePosition(id, static_cast<int>(r->positionTracker.getPosition()));
+  addLogMessage(message + "Action " + action + " sent to " + r->name.c_str());
+}
+
 void handleApiCommand(AsyncWebServerRequest *request, JsonVariant &json) {
   if (request->method() != HTTP_POST) {
     request->send(405, "text/plain", "Method Not Allowed");
@@ -229,59 +353,42 @@ void handleApiCommand(AsyncWebServerRequest *request, JsonVariant &json) {
     return;
   }
 
-  Tokens segments;
-  tokenize(command.c_str(), ' ', segments);
-  if (segments.empty()) {
+  std::string_view word;
+  if (!IOHC::iohcCommandTable::split(command.c_str(), ' ', &word, 1)) {
     request->send(400, "application/json",
                   "{\"success\":false, \"message\":\"Invalid command\"}");
     return;
   }
+  if (!Cmd::commands.find(word)) {
+    request->send(400, "application/json",
+                  "{\"success\":false, \"message\":\"Unknown command\"}");
+    return;
+  }
 
+  std::string description;
+  IOHC::address node;
   deviceId.toLowerCase();
   if (!deviceId.isEmpty()) {
-    const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-    auto it = std::find_if(remotes.begin(), remotes.end(), [&](const auto &r) {
-      return bytesToHexString(r.node, sizeof(r.node)) == deviceId.c_str();
-    });
-    if (it == remotes.end()) {
+    auto guard = IOHC::iohcRemote1W::getInstance()->lock();
+    const IOHC::iohcRemote1W::remote *it = nullptr;
+    if (IOHC::iohcDeviceIndex::parseAddress(deviceId.c_str(), deviceId.length(), node))
+      it = IOHC::iohcRemote1W::getInstance()->find(node);
+    if (!it) {
       request->send(400, "application/json",
                     "{\"success\":false, \"message\":\"Unknown device\"}");
       return;
     }
-    segments.insert(segments.begin() + 1, it->description);
-  }
-
-  bool success = false;
-  String message;
-  for (uint8_t idx = 0; idx <= lastEntry; ++idx) {
-    if (_cmdHandler[idx] == nullptr)
-      continue;
-    if (strcmp(_cmdHandler[idx]->cmd, segments[0].c_str()) == 0) {
-      _cmdHandler[idx]->handler(&segments);
-      success = true;
-      break;
-    }
-  }
-
-  if (success)
-    message = "Command executed";
-  else
-    message = "Unknown command";
-
-  addLogMessage(message);
-
-  AsyncJsonResponse *response = new AsyncJsonResponse();
-  if (!response) {
-    request->send(500, "application/json",
-                  "{\"success\":false,\"message\":\"OOM\"}");
-    return;
+    description = it->description;
   }
-  JsonObject root = response->getRoot().to<JsonObject>();
-  root["success"] = success;
-  root["message"] = message;
 
-  response->setLength();
-  request->send(response);
+  IOHC::Command queued;
+  queued.kind = IOHC::CommandKind::Line;
+  queued.source = IOHC::CommandSource::Web;
+  queued.text = command.c_str();
+  queued.argument = description;
+  if (!deviceId.isEmpty())
+    queued.device = IOHC::deviceKey(node);
+  sendQueued(request, queued, "Command " + command);
 }
 
 void handleApiAction(AsyncWebServerRequest *request, JsonVariant &json) {
@@ -310,14 +417,19 @@ void handleApiAction(AsyncWebServerRequest *request, JsonVariant &json) {
     return;
   }
 
-  const auto &remotes = IOHC::iohcRemote1W::getInstance()->getRemotes();
-  auto it = std::find_if(remotes.begin(), remotes.end(), [&](const auto &r) {
-    return bytesToHexString(r.node, sizeof(r.node)) == deviceId.c_str();
-  });
-  if (it == remotes.end()) {
-    request->send(400, "application/json",
-                  "{\"success\":false, \"message\":\"Unknown device\"}");
-    return;
+  IOHC::address node;
+  std::string name;
+  {
+    auto guard = IOHC::iohcRemote1W::getInstance()->lock();
+    const IOHC::iohcRemote1W::remote *it = nullptr;
+    if (IOHC::iohcDeviceIndex::parseAddress(deviceId.c_str(), deviceId.length(), node))
+      it = IOHC::iohcRemote1W::getInstance()->find(node);
+    if (!it) {
+      request->send(400, "application/json",
+                    "{\"success\":false, \"message\":\"Unknown device\"}");
+      return;
+    }
+    name = it->name;
   }
 
   IOHC::RemoteButton btn;
@@ -333,71 +445,96 @@ void handleApiAction(AsyncWebServerRequest *request, JsonVariant &json) {
     return;
   }
 
-  Tokens t;
-  t.push_back(action.c_str());
-  t.push_back(it->description);
-  IOHC::iohcRemote1W::getInstance()->cmd(btn, &t);
-  broadcastDevicePosition(deviceId,
-                          static_cast<int>(it->positionTracker.getPosition()));
-
-  String msg = "Action " + action + " sent to " + String(it->name.c_str());
-  addLogMessage(msg);
-
-  AsyncJsonResponse *response = new AsyncJsonResponse();
-  if (!response) {
-    request->send(500, "application/json",
-                  "{\"success\":false, \"message\":\"OOM\"}");
-    return;
-  }
-  JsonObject root = response->getRoot().to<JsonObject>();
-  root["success"] = true;
-  root["message"] = msg;
-
-  response->setLength();
-  request->send(response);
+  IOHC::Command queued;
+  queued.source = IOHC::CommandSource::Web;
+  queued.button = static_cast<uint8_t>(btn);
+  queued.device = IOHC::deviceKey(node);
+  sendQueued(request, queued, "Action " + action + " for " + String(name.c_str()));
 }
 
 void handleApiLogs(AsyncWebServerRequest *request) {
-  AsyncJsonResponse *response = new AsyncJsonResponse();
-  if (!response) {
-    request->send(500, "text/plain", "OOM");
-    return;
-  }
-  JsonArray root = response->getRoot().to<JsonArray>();
+  IOHC::JsonScratch scratch;
+  JsonDocument reply(scratch.allocator());
+  JsonArray root = reply.to<JsonArray>();
   auto logs = getLogMessages();
   for (const auto &msg : logs) {
     root.add(msg);
   }
-  response->setLength();
-  request->send(response);
+  sendJson(request, reply);
 }
 
 void handleApiLastAddr(AsyncWebServerRequest *request) {
-  AsyncJsonResponse *response = new AsyncJsonResponse();
-  if (!response) {
-    request->send(500, "text/plain", "OOM");
-    return;
-  }
-  JsonObject root = response->getRoot().to<JsonObject>();
+  IOHC::JsonScratch scratch;
+  JsonDocument reply(scratch.allocator());
+  JsonObject root = reply.to<JsonObject>();
   root["address"] = bytesToHexString(IOHC::lastFromAddress, sizeof(IOHC::lastFromAddress)).c_str();
-  response->setLength();
-  request->send(response);
+  sendJson(request, reply);
+}
+
+static void addLinkHistogram(JsonObject obj, const IOHC::LinkHistogram &h) {
+  obj["frames"] = h.frames;
+  obj["rssiAvg"] = h.rssiMeanDbm();
+  obj["rssiMin"] = h.rssiMinX2 / 2.0f;
+  obj["rssiMax"] = h.rssiMaxX2 / 2.0f;
+  obj["feiAvg"] = h.feiMeanHz();
+  JsonArray rssi = obj["rssi"].to<JsonArray>();
+  for (uint32_t count : h.rssi) rssi.add(count);
+  JsonArray fei = obj["fei"].to<JsonArray>();
+  for (uint32_t count : h.fei) fei.add(count);
+  JsonArray lna = obj["lna"].to<JsonArray>();
+  for (uint32_t count : h.lna) lna.add(count);
+}
+
+// Link metrics histograms. Buckets: rssi 5 dB from rssiFloor, fei 2 kHz from feiFloor, lna G1..G6
+void handleApiLink(AsyncWebServerRequest *request) {
+  // Histograms of every source, more than an arena: default allocator
+  JsonDocument reply;
+  IOHC::iohcLinkStats &link = IOHC::iohcRadio::linkStats();
+  JsonObject root = reply.to<JsonObject>();
+  root["frames"] = link.frames();
+  root["evicted"] = link.evicted();
+  root["rssiFloor"] = LINK_RSSI_FLOOR_DBM;
+  root["feiFloor"] = -LINK_FEI_BUCKETS * 1000;
+
+  IOHC::LinkChannel channels[LINK_MAX_CHANNELS];
+  size_t count = link.channels(channels, LINK_MAX_CHANNELS);
+  JsonArray channelArray = root["channels"].to<JsonArray>();
+  for (size_t i = 0; i < count; i++) {
+    JsonObject obj = channelArray.add<JsonObject>();
+    obj["frequency"] = channels[i].frequency;
+    addLinkHistogram(obj, channels[i].histogram);
+  }
+
+  static IOHC::LinkSource sources[LINK_MAX_SOURCES];
+  count = link.sources(sources, LINK_MAX_SOURCES);
+  JsonArray sourceArray = root["sources"].to<JsonArray>();
+  char address[7];
+  for (size_t i = 0; i < count; i++) {
+    JsonObject obj = sourceArray.add<JsonObject>();
+    snprintf(address, sizeof(address), "%06X", sources[i].address);
+    obj["address"] = address;
+    addLinkHistogram(obj, sources[i].histogram);
+  }
+  sendJson(request, reply);
 }
 
 #if defined(MQTT)
 void handleApiMqttGet(AsyncWebServerRequest *request) {
-  AsyncJsonResponse *response = new AsyncJsonResponse();
-  if (!response) {
-    request->send(500, "text/plain", "OOM");
-    return;
-  }
-  JsonObject root = response->getRoot().to<JsonObject>();
-  root["server"] = mqtt_server.c_str();
-  root["user"] = mqtt_user.c_str();
-  root["password"] = mqtt_password.c_str();
-  root["discovery"] = mqtt_discovery_topic.c_str();
-  response->setLength();
-  request->send(response);
+  // Settings are changed from the CLI too: the key is their digest rather than a version
+  uint64_t key = IOHC::iohcJsonSnapshot::digest(mqtt_server.c_str(), mqtt_server.size() + 1);
+  key = IOHC::iohcJsonSnapshot::digest(mqtt_user.c_str(), mqtt_user.size() + 1, key);
+  key = IOHC::iohcJsonSnapshot::digest(mqtt_password.c_str(), mqtt_password.size() + 1, key);
+  key = IOHC::iohcJsonSnapshot::digest(mqtt_discovery_topic.c_str(), mqtt_discovery_topic.size() + 1, key);
+  sendSnapshot(request, mqttSnapshot, key, [](std::string &body) {
+    IOHC::JsonScratch scratch;
+    JsonDocument reply(scratch.allocator());
+    JsonObject root = reply.to<JsonObject>();
+    root["server"] = mqtt_server.c_str();
+    root["user"] = mqtt_user.c_str();
+    root["password"] = mqtt_password.c_str();
+    root["discovery"] = mqtt_discovery_topic.c_str();
+    serializeBody(reply, body);
+  });
 }
 
 void handleApiMqttSet(AsyncWebServerRequest *request, JsonVariant &json) {
@@ -452,17 +589,12 @@ void handleApiMqttSet(AsyncWebServerRequest *request, JsonVariant &json) {
     handleMqttConnect();
   }
 
-  AsyncJsonResponse *response = new AsyncJsonResponse();
-  if (!response) {
-    request->send(500, "application/json",
-                  "{\"success\":false,\"message\":\"OOM\"}");
-    return;
-  }
-  JsonObject root = response->getRoot().to<JsonObject>();
+  IOHC::JsonScratch scratch;
+  JsonDocument reply(scratch.allocator());
+  JsonObject root = reply.to<JsonObject>();
   root["success"] = true;
   root["message"] = "MQTT configuration updated";
-  response->setLength();
-  request->send(response);
+  sendJson(request, reply);
 }
 #endif
 
@@ -548,6 +680,7 @@ void setupWebServer() {
   server.on("/api/remotes", HTTP_GET, handleApiRemotes);
   server.on("/api/logs", HTTP_GET, handleApiLogs);
   server.on("/api/lastaddr", HTTP_GET, handleApiLastAddr);
+  server.on("/api/link", HTTP_GET, handleApiLink);
 #if defined(MQTT)
   server.on("/api/mqtt", HTTP_GET, handleApiMqttGet);
 #endif
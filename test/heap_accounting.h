@@ -0,0 +1,44 @@
+#ifndef TEST_HEAP_ACCOUNTING_H
+#define TEST_HEAP_ACCOUNTING_H
+
+// Heap accounting for the host tests: every allocation and free made by the process while counting is on.
+// Replaces the global operator new and delete, include it from the test file only.
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+static std::atomic<bool> counting{false};
+static std::atomic<long> allocations{0};
+static std::atomic<long> frees{0};
+
+void *operator new(size_t size) {
+    if (counting) allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+// Not inlined: GCC would see free() called on what operator new returned (-Wmismatched-new-delete)
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    if (p && counting) frees++;
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+#endif // TEST_HEAP_ACCOUNTING_H
@@ -0,0 +1,164 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <iohcAesBackend.h>
+#include <iohcCryptoHelpers.h>
+
+using namespace iohcCrypto;
+
+static const AesBackend backends[] = {AesBackend::Reference, AesBackend::TTable, AesBackend::AesNi};
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+// FIPS-197 appendix C.1
+void test_fips197() {
+    const uint8_t key[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                             0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+    AesSchedule schedule;
+    aesExpandKey(key, schedule);
+    // Last round key, FIPS-197 appendix A.1 style
+    TEST_ASSERT_EQUAL_HEX32(0x13111d7f, schedule.words[40]);
+    TEST_ASSERT_EQUAL_HEX32(0xe3944a17, schedule.words[41]);
+    TEST_ASSERT_EQUAL_HEX32(0xf307a78b, schedule.words[42]);
+    TEST_ASSERT_EQUAL_HEX32(0x4d2b30c5, schedule.words[43]);
+
+    for (AesBackend backend : backends) {
+        if (!aesUseBackend(backend)) {
+            printf("  %s not available\n", aesBackendName(backend));
+            continue;
+        }
+        uint8_t block[1][16];
+        hexStringToBytes("00112233445566778899aabbccddeeff", block[0]);
+        aesEncrypt(schedule, block, 1);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE("69c4e0d86a7b0430d8cdb78070b4c55a", bytesToHexString(block[0], 16).c_str(),
+                                         aesBackendName(backend));
+    }
+}
+
+// The test_native vectors, through the MAC functions, on every backend
+void test_native_vectors() {
+    const uint8_t node_address[3] = {0xab, 0xcd, 0xef};
+    const uint8_t sequence_number[2] = {0x12, 0x34};
+    const uint8_t challenge[6] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc};
+    const uint8_t controller_key[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                                        0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16};
+    const uint8_t push32[17] = {0x32, 0xf8, 0x49, 0x58, 0x4f, 0xfc, 0xfc, 0x44, 0x2b,
+                                0x1e, 0x97, 0xe4, 0xc3, 0x8d, 0xf7, 0xb1, 0x43};
+
+    for (AesBackend backend : backends) {
+        if (!aesUseBackend(backend)) continue;
+        const char *name = aesBackendName(backend);
+
+        uint8_t frame30[17] = {0x30};
+        memcpy(frame30 + 1, controller_key, 16);
+        encrypt_1W_key(node_address, frame30 + 1);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE("7e60491f976adf653db0ed785e49a201", bytesToHexString(frame30 + 1, 16).c_str(), name);
+
+        uint8_t hmac[16];
+        create_1W_hmac(hmac, sequence_number, controller_key, frame30, sizeof(frame30));
+        TEST_ASSERT_EQUAL_STRING_MESSAGE("19e81ec43d5e", bytesToHexString(hmac, 6).c_str(), name);
+
+        create_2W_hmac(hmac, challenge, controller_key, push32, sizeof(push32));
+        TEST_ASSERT_EQUAL_STRING_MESSAGE("8dc9d40dc7a4", bytesToHexString(hmac, 6).c_str(), name);
+    }
+}
+
+// Random keys and runs of blocks: every backend matches the reference, whatever the count
+void test_backends_agree() {
+    srand(0xae5);
+    for (int round = 0; round < 500; round++) {
+        uint8_t key[16];
+        for (auto &b : key) b = rand();
+        AesSchedule schedule;
+        aesExpandKey(key, schedule);
+
+        size_t count = 1 + rand() % 11;
+        uint8_t input[11][16];
+        for (size_t i = 0; i < count; i++)
+            for (auto &b : input[i]) b = rand();
+
+        uint8_t expected[11][16];
+        memcpy(expected, input, sizeof(input));
+        aesUseBackend(AesBackend::Reference);
+        aesEncrypt(schedule, expected, count);
+
+        for (AesBackend backend : backends) {
+            if (!aesUseBackend(backend)) continue;
+            uint8_t blocks[11][16];
+            memcpy(blocks, input, sizeof(input));
+            aesEncrypt(schedule, blocks, count);
+            TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected, blocks, 16 * count, aesBackendName(backend));
+        }
+    }
+}
+
+void test_selection() {
+    TEST_ASSERT_TRUE(aesBackendAvailable(AesBackend::Reference));
+    TEST_ASSERT_TRUE(aesBackendAvailable(AesBackend::TTable));
+    TEST_ASSERT_TRUE(aesUseBackend(AesBackend::TTable));
+    TEST_ASSERT_EQUAL(AesBackend::TTable, aesBackend());
+    if (!aesBackendAvailable(AesBackend::AesNi)) {
+        TEST_ASSERT_FALSE(aesUseBackend(AesBackend::AesNi));
+        TEST_ASSERT_EQUAL(AesBackend::TTable, aesBackend());
+    }
+}
+
+void test_benchmark() {
+    const size_t blocks = 4096;
+    const int rounds = 20;
+    std::vector<uint8_t> buffer(blocks * 16);
+    for (auto &b : buffer) b = rand();
+    auto *data = reinterpret_cast<uint8_t (*)[16]>(buffer.data());
+
+    uint8_t key[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                       0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16};
+    AesSchedule schedule;
+    aesExpandKey(key, schedule);
+
+    for (AesBackend backend : backends) {
+        if (!aesUseBackend(backend)) continue;
+        // One block at a time, as a MAC does, then whole runs
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++)
+            for (size_t i = 0; i < blocks; i++) aesEncrypt(schedule, data + i, 1);
+        double single = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) aesEncrypt(schedule, data, blocks);
+        double bulk = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        double n = double(blocks) * rounds;
+        printf("  %-9s %7.1f ns/block single, %6.1f ns/block bulk, %8.1f MB/s\n", aesBackendName(backend), single / n,
+               bulk / n, n * 16 / bulk * 1e3);
+    }
+
+    aesUseBackend(aesBackendAvailable(AesBackend::AesNi) ? AesBackend::AesNi : AesBackend::TTable);
+    const uint8_t sequence_number[2] = {0x12, 0x34};
+    uint8_t frame[9] = {0x00, 0x01, 0x43, 0x00, 0x00, 0x80, 0xd3, 0x00, 0x00};
+    uint8_t hmac[16];
+    const int macs = 200000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < macs; i++) {
+        frame[8] = i;
+        create_1W_hmac(hmac, sequence_number, key, frame, sizeof(frame));
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("  1W MAC with %s: %.1f ns, %.0f MACs/s\n", aesBackendName(aesBackend()), ns / macs, macs / ns * 1e9);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fips197);
+    RUN_TEST(test_native_vectors);
+    RUN_TEST(test_backends_agree);
+    RUN_TEST(test_selection);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
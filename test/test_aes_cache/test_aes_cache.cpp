@@ -0,0 +1,254 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <vector>
+#include <iohcCryptoHelpers.h>
+#include <iohcAesCache.h>
+#include <crypto2Wutils.h>
+#include "../heap_accounting.h"
+
+using namespace iohcCrypto;
+
+// Vectors from test_native
+static const uint8_t node_address[3] = {0xab, 0xcd, 0xef};
+static const uint8_t sequence_number[2] = {0x12, 0x34};
+static uint8_t controller_key[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                                     0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16};
+static const uint8_t challenge[6] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc};
+static uint8_t pull_system_key[16] = {0xab, 0xcd, 0xef, 0x01, 0x02, 0x03, 0x04, 0x05,
+                                      0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13};
+
+// The MAC as computed before the cache: a fresh key schedule and a vector per frame
+static void referenceMac(uint8_t *out, const uint8_t *key, const std::vector<uint8_t> &frame, const uint8_t *challenge,
+                         const uint8_t *sequence) {
+    std::vector<uint8_t> iv(16, 0);
+    buildInitialValue(iv.data(), frame.data(), frame.size(), challenge, sequence);
+    AES_ctx ctx;
+    AES_init_ctx(&ctx, key);
+    AES_ECB_encrypt(&ctx, iv.data());
+    memcpy(out, iv.data(), 16);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_native_vectors() {
+    uint8_t key[16];
+    memcpy(key, controller_key, 16);
+    encrypt_1W_key(node_address, key);
+    TEST_ASSERT_EQUAL_STRING("7e60491f976adf653db0ed785e49a201", bytesToHexString(key, 16).c_str());
+    // Same operation both ways
+    uint8_t clear[16];
+    memcpy(clear, key, 16);
+    encrypt_1W_key(node_address, clear);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(controller_key, clear, 16);
+
+    uint8_t frame30[17] = {0x30};
+    memcpy(frame30 + 1, key, 16);
+    uint8_t hmac[16];
+    create_1W_hmac(hmac, sequence_number, controller_key, frame30, sizeof(frame30));
+    TEST_ASSERT_EQUAL_STRING("19e81ec43d5e", bytesToHexString(hmac, 6).c_str());
+
+    // 2W key pull: key encrypted with the transfer key, then the 0x3d answer
+    uint8_t frame38[7] = {0x38};
+    memcpy(frame38 + 1, challenge, 6);
+    uint8_t iv[16];
+    TEST_ASSERT_TRUE(buildInitialValue(iv, frame38, sizeof(frame38), challenge, nullptr));
+    uint8_t encrypted[16];
+    encrypt_block(transfert_key, iv, encrypted);
+    for (int i = 0; i < 16; i++) encrypted[i] ^= pull_system_key[i];
+    TEST_ASSERT_EQUAL_STRING("ea425a7a182885d4eaeefd416d625e01", bytesToHexString(encrypted, 16).c_str());
+
+    uint8_t frame32[17] = {0x32};
+    memcpy(frame32 + 1, encrypted, 16);
+    uint8_t mac[6];
+    create_2W_hmac(mac, challenge, pull_system_key, frame32, sizeof(frame32));
+    TEST_ASSERT_EQUAL_STRING("0ae519a73c99", bytesToHexString(mac, 6).c_str());
+
+    // 2W key push, through the vector overload
+    std::vector<uint8_t> push32 = {0x32, 0xf8, 0x49, 0x58, 0x4f, 0xfc, 0xfc, 0x44, 0x2b,
+                                   0x1e, 0x97, 0xe4, 0xc3, 0x8d, 0xf7, 0xb1, 0x43};
+    create_2W_hmac(mac, challenge, controller_key, push32);
+    TEST_ASSERT_EQUAL_STRING("8dc9d40dc7a4", bytesToHexString(mac, 6).c_str());
+
+    TEST_ASSERT_FALSE(buildInitialValue(iv, frame32, sizeof(frame32), nullptr, nullptr));
+}
+
+// Random frames of every length, cached MACs against fresh key schedules
+void test_matches_reference() {
+    srand(0xae5);
+    uint8_t keys[7][16];
+    for (auto &key : keys)
+        for (auto &b : key) b = rand();
+    for (int round = 0; round < 3000; round++) {
+        const uint8_t *key = keys[rand() % 7];
+        std::vector<uint8_t> frame(rand() % 24);
+        for (auto &b : frame) b = rand();
+        uint8_t seq[2] = {(uint8_t)rand(), (uint8_t)rand()};
+        uint8_t chal[6];
+        for (auto &b : chal) b = rand();
+
+        uint8_t expected[16], got[16];
+        referenceMac(expected, key, frame, nullptr, seq);
+        create_1W_hmac(got, seq, key, frame.data(), frame.size());
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, got, 16);
+
+        referenceMac(expected, key, frame, chal, nullptr);
+        create_2W_hmac(got, chal, key, frame.data(), frame.size());
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, got, 6);
+    }
+}
+
+void test_lru() {
+    iohcAesCache cache;
+    uint8_t keys[IOHC_AES_CACHE_SIZE + 1][16];
+    for (size_t k = 0; k < IOHC_AES_CACHE_SIZE + 1; k++) memset(keys[k], k + 1, 16);
+    uint8_t block[16] = {}, out[16];
+
+    for (size_t k = 0; k < IOHC_AES_CACHE_SIZE; k++) cache.encrypt(keys[k], block, out);
+    TEST_ASSERT_EQUAL_UINT32(IOHC_AES_CACHE_SIZE, cache.stats().misses);
+    TEST_ASSERT_EQUAL_UINT32(0, cache.stats().evictions);
+    for (size_t k = 0; k < IOHC_AES_CACHE_SIZE; k++) cache.encrypt(keys[k], block, out);
+    TEST_ASSERT_EQUAL_UINT32(IOHC_AES_CACHE_SIZE, cache.stats().hits);
+
+    // Key 0 used last: key 1 is the one going out
+    cache.encrypt(keys[0], block, out);
+    cache.encrypt(keys[IOHC_AES_CACHE_SIZE], block, out);
+    TEST_ASSERT_EQUAL_UINT32(1, cache.stats().evictions);
+    cache.encrypt(keys[0], block, out);
+    TEST_ASSERT_EQUAL_UINT32(IOHC_AES_CACHE_SIZE + 1, cache.stats().misses);
+    cache.encrypt(keys[1], block, out);
+    TEST_ASSERT_EQUAL_UINT32(IOHC_AES_CACHE_SIZE + 2, cache.stats().misses);
+
+    // A key changed in place is a different key
+    uint8_t changed[16];
+    memcpy(changed, keys[0], 16);
+    changed[15] ^= 1;
+    uint8_t expected[16];
+    AES_ctx ctx;
+    AES_init_ctx(&ctx, changed);
+    memcpy(expected, block, 16);
+    AES_ECB_encrypt(&ctx, expected);
+    cache.encrypt(changed, block, out);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, 16);
+
+    cache.clear();
+    uint32_t misses = cache.stats().misses;
+    cache.encrypt(changed, block, out);
+    TEST_ASSERT_EQUAL_UINT32(misses + 1, cache.stats().misses);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, 16);
+}
+
+// A cmd() burst: each frame repeated, every job gets the MAC of its own frame
+void test_batch() {
+    const size_t frames = 11, repeats = 4;
+    uint8_t payload[frames][9];
+    uint8_t seq[frames][2];
+    for (size_t f = 0; f < frames; f++) {
+        for (auto &b : payload[f]) b = rand();
+        seq[f][0] = 0x22;
+        seq[f][1] = 0x60 + f;
+    }
+    // Same bytes under another sequence number is another MAC
+    memcpy(payload[5], payload[4], sizeof(payload[4]));
+
+    Hmac1WJob jobs[frames * repeats];
+    uint8_t macs[frames * repeats][HMAC_1W_LENGTH];
+    for (size_t j = 0; j < frames * repeats; j++) {
+        size_t f = j / repeats;
+        jobs[j] = {payload[f], 6u + f % 4, seq[f], macs[j]};
+    }
+
+    uint32_t before = iohcAesCache::instance().stats().hits + iohcAesCache::instance().stats().misses;
+    create_1W_hmacs(controller_key, jobs, frames * repeats);
+    uint32_t lookups = iohcAesCache::instance().stats().hits + iohcAesCache::instance().stats().misses - before;
+    // One lookup per chunk of 8 jobs
+    TEST_ASSERT_EQUAL_UINT32((frames * repeats + 7) / 8, lookups);
+
+    for (size_t j = 0; j < frames * repeats; j++) {
+        uint8_t expected[16];
+        create_1W_hmac(expected, jobs[j].sequence, controller_key, jobs[j].frame, jobs[j].length);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, macs[j], HMAC_1W_LENGTH);
+    }
+    TEST_ASSERT_TRUE(memcmp(macs[4 * repeats], macs[5 * repeats], HMAC_1W_LENGTH) != 0);
+
+    create_1W_hmacs(controller_key, jobs, 0);
+}
+
+void test_no_allocation() {
+    uint8_t frame[9] = {0x00, 0x01, 0x43, 0x00, 0x00, 0x80, 0xd3, 0x00, 0x00};
+    uint8_t hmac[16], key[16];
+    uint8_t macs[4][HMAC_1W_LENGTH];
+    Hmac1WJob jobs[4];
+    for (int i = 0; i < 4; i++) jobs[i] = {frame, sizeof(frame), sequence_number, macs[i]};
+
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < 1000; i++) {
+        create_1W_hmac(hmac, sequence_number, controller_key, frame, sizeof(frame));
+        create_2W_hmac(hmac, challenge, pull_system_key, frame, sizeof(frame));
+        create_1W_hmacs(controller_key, jobs, 4);
+        memcpy(key, controller_key, 16);
+        encrypt_1W_key(node_address, key);
+    }
+    counting = false;
+    TEST_ASSERT_EQUAL(0, allocations.load());
+}
+
+void test_benchmark() {
+    const int rounds = 50000;
+    uint8_t frame[9] = {0x00, 0x01, 0x43, 0x00, 0x00, 0x80, 0xd3, 0x00, 0x00};
+    std::vector<uint8_t> vframe(frame, frame + sizeof(frame));
+    uint8_t hmac[16];
+    volatile uint8_t sink = 0;
+
+    auto time = [&](const char *name, int macs, auto body) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+            frame[8] = vframe[8] = i;
+            body();
+            sink = sink ^ hmac[0];
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        printf("  %-26s %7.1f ns/MAC\n", name, ns / rounds / macs);
+    };
+
+    time("1W uncached (vector IV)", 1, [&] { referenceMac(hmac, controller_key, vframe, nullptr, sequence_number); });
+    time("1W cached, vector", 1, [&] { create_1W_hmac(hmac, sequence_number, controller_key, vframe); });
+    time("1W cached, pointer", 1, [&] { create_1W_hmac(hmac, sequence_number, controller_key, frame, sizeof(frame)); });
+    time("2W cached, pointer", 1, [&] { create_2W_hmac(hmac, challenge, pull_system_key, frame, sizeof(frame)); });
+
+    // Burst of 3 frames sent 4 times each
+    uint8_t seqs[3][2] = {{0x22, 0x62}, {0x22, 0x63}, {0x22, 0x64}};
+    uint8_t macs[12][HMAC_1W_LENGTH];
+    Hmac1WJob jobs[12];
+    for (int j = 0; j < 12; j++) jobs[j] = {frame, sizeof(frame), seqs[j / 4], macs[j]};
+    time("1W burst of 12, one by one", 12, [&] {
+        for (auto &job : jobs) create_1W_hmac(hmac, job.sequence, controller_key, job.frame, job.length);
+    });
+    time("1W burst of 12, batched", 12, [&] {
+        create_1W_hmacs(controller_key, jobs, 12);
+        hmac[0] = macs[11][0];
+    });
+
+    AesCacheStats stats = iohcAesCache::instance().stats();
+    printf("  cache: %u hits, %u misses, %u evictions\n", stats.hits, stats.misses, stats.evictions);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_native_vectors);
+    RUN_TEST(test_matches_reference);
+    RUN_TEST(test_lru);
+    RUN_TEST(test_batch);
+    RUN_TEST(test_no_allocation);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,296 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include <iohcChannelHopper.h>
+#include <iohcTxSequencer.h>
+
+using namespace IOHC;
+
+static const uint32_t CHANNELS[] = {868950000, 868250000, 869850000};  // CHANNEL2, CHANNEL1, CHANNEL3
+static constexpr uint32_t STEP_US = 50;
+static constexpr uint32_t DETECT_US = 1000;     // Preamble bits needed by the detector after tuning
+static constexpr uint32_t SETTLE_US = 100;      // Fast-hop PLL lock
+
+/*
+    Traffic replay: a frame is received if the radio sits on its channel long enough during the preamble to detect
+    it, then stays there until the end of the frame. Time advances in STEP_US steps.
+*/
+struct Frame {
+    uint64_t start;
+    uint8_t channel;
+    bool oneWay;
+    uint64_t syncAt;        // End of preamble
+    uint64_t end;
+};
+
+struct SimRadio {
+    uint8_t tuned = 0;
+    uint64_t tunedAt = 0;
+    uint64_t timerAt = UINT64_MAX;
+    uint64_t now = 0;
+    uint32_t tunes = 0;
+    bool busy = false;
+
+    void tune(const uint8_t frf[3]) {
+        uint32_t word = (frf[0] << 16) | (frf[1] << 8) | frf[2];
+        tuned = 0xFF;
+        for (uint8_t i = 0; i < 3; i++)
+            if (iohcFrfWord(CHANNELS[i]) == word) tuned = i;
+        tunedAt = now + SETTLE_US;
+        tunes++;
+    }
+    void arm(uint32_t delayUs) { timerAt = now + delayUs; }
+    bool idle() const { return !busy; }
+};
+
+struct Result {
+    uint32_t sent[3][2];        // [channel][oneWay]
+    uint32_t captured[3][2];
+    uint32_t aborted;
+};
+
+static std::vector<Frame> traffic(uint64_t durationUs, uint32_t seed) {
+    std::vector<Frame> frames;
+    srand(seed);
+    uint64_t t = 100000;
+    while (t < durationUs) {
+        Frame f{};
+        if (rand() % 5 == 0) {
+            // 1W remote: long preamble on CHANNEL2, a few repeats
+            f.channel = 0;
+            f.oneWay = true;
+            for (int r = 0; r < 2; r++) {
+                f.start = t;
+                f.syncAt = t + iohcAirtimeUs(r ? 40 : 1920, 0);
+                f.end = t + iohcAirtimeUs(r ? 40 : 1920, 21);
+                frames.push_back(f);
+                t = f.end + 25000;
+            }
+        } else {
+            // 2W exchange: command, challenge, answer, status, on one channel, 20-40 ms apart
+            int pick = rand() % 10;
+            f.channel = pick < 5 ? 0 : pick < 8 ? 1 : 2;
+            f.oneWay = false;
+            for (int r = 0; r < 4; r++) {
+                f.start = t;
+                f.syncAt = t + iohcAirtimeUs(52, 0);
+                f.end = t + iohcAirtimeUs(52, 16 + rand() % 16);
+                frames.push_back(f);
+                t = f.end + 20000 + rand() % 20000;
+            }
+        }
+        t += 50000 + rand() % 600000;
+    }
+    return frames;
+}
+
+static Result replay(const std::vector<Frame> &frames, uint64_t durationUs, uint32_t dwellUs, bool adaptive,
+                     iohcChannelHopper<SimRadio> **keep = nullptr) {
+    static SimRadio radio;
+    static iohcChannelHopper<SimRadio> hopper(radio);
+    radio = SimRadio();
+    hopper.configure(CHANNELS, 3, dwellUs, adaptive);
+    hopper.start(0);
+
+    Result result{};
+    for (const Frame &f : frames) result.sent[f.channel][f.oneWay]++;
+
+    size_t next = 0;                // First frame not finished yet
+    const Frame *locked = nullptr;  // Preamble detected, waiting for the end of frame
+    uint8_t lockedOn = 0;
+    for (radio.now = 0; radio.now < durationUs; radio.now += STEP_US) {
+        if (radio.now >= radio.timerAt) {
+            radio.timerAt = UINT64_MAX;
+            hopper.onTimer(radio.now);
+        }
+        if (locked && radio.tuned != lockedOn) {
+            result.aborted++;
+            locked = nullptr;
+        }
+        if (locked && radio.now >= locked->end) {
+            result.captured[locked->channel][locked->oneWay]++;
+            hopper.onFrame(radio.now);
+            locked = nullptr;
+        }
+        while (next < frames.size() && frames[next].end <= radio.now) next++;
+        if (locked) continue;
+        for (size_t i = next; i < frames.size() && frames[i].start <= radio.now; i++) {
+            const Frame &f = frames[i];
+            if (f.channel != radio.tuned || radio.now >= f.syncAt) continue;
+            if (radio.now < std::max(f.start, radio.tunedAt) + DETECT_US) continue;
+            locked = &f;
+            lockedOn = radio.tuned;
+            hopper.onPreamble(radio.now);
+            break;
+        }
+    }
+    if (keep) *keep = &hopper;
+    return result;
+}
+
+static void report(const char *name, const Result &r, uint32_t &captured, uint32_t &sent) {
+    static const char *names[] = {"CH2", "CH1", "CH3"};
+    printf("  %s:", name);
+    captured = sent = 0;
+    for (uint8_t c = 0; c < 3; c++)
+        for (uint8_t w = 0; w < 2; w++) {
+            if (!r.sent[c][w]) continue;
+            printf(" %s-%s %u/%u (%.0f%%)", names[c], w ? "1W" : "2W", r.captured[c][w], r.sent[c][w],
+                   100.0 * r.captured[c][w] / r.sent[c][w]);
+            captured += r.captured[c][w];
+            sent += r.sent[c][w];
+        }
+    printf(" total %.1f%% aborted %u\n", 100.0 * captured / sent, r.aborted);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_frequency_words() {
+    // Same rounding as the datasheet example: 868.95 MHz -> 0xD93CCD
+    TEST_ASSERT_EQUAL_HEX32(0xD93CCD, iohcFrfWord(868950000));
+    TEST_ASSERT_EQUAL_HEX32(0xD91000, iohcFrfWord(868250000));
+    TEST_ASSERT_EQUAL_HEX32(0xD97666, iohcFrfWord(869850000));
+}
+
+void test_fixed_dwell_rotation() {
+    SimRadio radio;
+    iohcChannelHopper<SimRadio> hopper(radio);
+    TEST_ASSERT_TRUE(hopper.configure(CHANNELS, 3, 10000, false));
+    hopper.start(0);
+    TEST_ASSERT_EQUAL_UINT8(0, radio.tuned);
+    TEST_ASSERT_EQUAL_UINT64(10000, radio.timerAt);
+
+    for (uint32_t i = 1; i <= 30; i++) {
+        radio.now = radio.timerAt;
+        hopper.onTimer(radio.now);
+        TEST_ASSERT_EQUAL_UINT8(i % 3, radio.tuned);
+        TEST_ASSERT_EQUAL_UINT8(i % 3, hopper.channel());
+        TEST_ASSERT_EQUAL_UINT64((i + 1) * 10000ULL, radio.timerAt);
+    }
+    TEST_ASSERT_EQUAL_UINT32(30, hopper.stats().hops);
+    TEST_ASSERT_EQUAL_UINT32(11, hopper.stats(0).dwells);
+    TEST_ASSERT_EQUAL_UINT64(100000, hopper.stats(1).totalDwellUs);
+    TEST_ASSERT_EQUAL_UINT32(0, hopper.stats().maxLateUs);
+
+    // A single channel does not hop at all
+    iohcChannelHopper<SimRadio> single(radio);
+    TEST_ASSERT_FALSE(single.configure(CHANNELS, 1, 10000));
+    single.start(0);
+    TEST_ASSERT_FALSE(single.running());
+}
+
+void test_preamble_hold_and_abort() {
+    SimRadio radio;
+    iohcChannelHopper<SimRadio> hopper(radio);
+    hopper.configure(CHANNELS, 3, 10000, false);
+    hopper.start(0);
+
+    // Preamble 2 ms before the end of the dwell: stay until the hold expires
+    radio.now = 8000;
+    hopper.onPreamble(radio.now);
+    radio.now = 10000;
+    hopper.onTimer(radio.now);
+    TEST_ASSERT_EQUAL_UINT8(0, radio.tuned);
+    TEST_ASSERT_EQUAL_UINT64(8000 + HOP_PREAMBLE_HOLD_US, radio.timerAt);
+    TEST_ASSERT_EQUAL_UINT32(1, hopper.stats(0).holds);
+
+    // Frame never came: hop, counted as an abort
+    radio.now = radio.timerAt;
+    hopper.onTimer(radio.now);
+    TEST_ASSERT_EQUAL_UINT8(1, radio.tuned);
+    TEST_ASSERT_EQUAL_UINT32(1, hopper.stats(0).preambleAborts);
+
+    // Frame received: stay for the follow-up frames, no abort
+    radio.now += 5000;
+    hopper.onPreamble(radio.now);
+    radio.now += 3000;
+    hopper.onFrame(radio.now);
+    TEST_ASSERT_EQUAL_UINT64(radio.now + HOP_FOLLOW_UP_US, radio.timerAt);
+    radio.now = radio.timerAt;
+    hopper.onTimer(radio.now);
+    TEST_ASSERT_EQUAL_UINT8(2, radio.tuned);
+    TEST_ASSERT_EQUAL_UINT32(0, hopper.stats(1).preambleAborts);
+    TEST_ASSERT_EQUAL_UINT32(1, hopper.stats(1).frames);
+
+    // Busy radio: the hop waits
+    radio.busy = true;
+    radio.now = radio.timerAt;
+    hopper.onTimer(radio.now);
+    TEST_ASSERT_EQUAL_UINT8(2, radio.tuned);
+    TEST_ASSERT_EQUAL_UINT32(1, hopper.stats().postponed);
+    radio.busy = false;
+    radio.now = radio.timerAt;
+    hopper.onTimer(radio.now);
+    TEST_ASSERT_EQUAL_UINT8(0, radio.tuned);
+}
+
+void test_adaptive_dwell_follows_traffic() {
+    SimRadio radio;
+    iohcChannelHopper<SimRadio> hopper(radio);
+    hopper.configure(CHANNELS, 3, 13520, true);
+    hopper.start(0);
+    TEST_ASSERT_EQUAL_UINT32(13520, hopper.stats(0).dwellUs);
+
+    // Traffic only on CHANNEL1 (index 1)
+    for (int cycle = 0; cycle < 20; cycle++)
+        for (int c = 0; c < 3; c++) {
+            if (hopper.channel() == 1) {
+                radio.now += 1000;
+                hopper.onFrame(radio.now);
+            }
+            radio.now = radio.timerAt;
+            hopper.onTimer(radio.now);
+        }
+    printf("  dwell CH2 %u CH1 %u CH3 %u us\n", hopper.stats(0).dwellUs, hopper.stats(1).dwellUs,
+           hopper.stats(2).dwellUs);
+    TEST_ASSERT_GREATER_THAN_UINT32(3 * hopper.stats(0).dwellUs, hopper.stats(1).dwellUs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(HOP_MIN_DWELL_US, hopper.stats(2).dwellUs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(HOP_MAX_DWELL_US, hopper.stats(1).dwellUs);
+    // The cycle stays close to the configured one
+    uint32_t cycle = hopper.stats(0).dwellUs + hopper.stats(1).dwellUs + hopper.stats(2).dwellUs;
+    TEST_ASSERT_UINT32_WITHIN(3 * 13520 / 20, 3 * 13520, cycle);
+}
+
+// Ten minutes of mixed 1W/2W traffic over the three channels, fixed versus adaptive dwell
+void test_replay_capture_rate() {
+    const uint64_t duration = 600000000ULL;
+    std::vector<Frame> frames = traffic(duration, 42);
+
+    uint32_t fixedCaptured, adaptiveCaptured, sent;
+    Result fixed = replay(frames, duration, 13520, false);
+    report("fixed   ", fixed, fixedCaptured, sent);
+    iohcChannelHopper<SimRadio> *hopper;
+    Result adaptive = replay(frames, duration, 13520, true, &hopper);
+    report("adaptive", adaptive, adaptiveCaptured, sent);
+    for (uint8_t c = 0; c < 3; c++) {
+        const HopChannelStats &s = hopper->stats(c);
+        printf("    channel %u: dwells %u avg %llu us preambles %u frames %u holds %u aborts %u\n", c, s.dwells,
+               (unsigned long long)(s.totalDwellUs / s.dwells), s.preambles, s.frames, s.holds, s.preambleAborts);
+    }
+
+    // Long 1W preambles are always caught, whatever the dwell
+    TEST_ASSERT_EQUAL_UINT32(fixed.sent[0][1], fixed.captured[0][1]);
+    TEST_ASSERT_EQUAL_UINT32(adaptive.sent[0][1], adaptive.captured[0][1]);
+    TEST_ASSERT_GREATER_THAN_UINT32(fixedCaptured, adaptiveCaptured);
+    for (uint8_t c = 0; c < 3; c++)
+        TEST_ASSERT_GREATER_THAN_UINT32(0, adaptive.captured[c][0]);
+    uint32_t aborts = 0;
+    for (uint8_t c = 0; c < 3; c++) aborts += hopper->stats(c).preambleAborts;
+    TEST_ASSERT_EQUAL_UINT32(adaptive.aborted, aborts);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_frequency_words);
+    RUN_TEST(test_fixed_dwell_rotation);
+    RUN_TEST(test_preamble_hold_and_abort);
+    RUN_TEST(test_adaptive_dwell_follows_traffic);
+    RUN_TEST(test_replay_capture_rate);
+    return UNITY_END();
+}
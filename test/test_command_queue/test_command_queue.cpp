@@ -0,0 +1,292 @@
+#include <unity.h>
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iohcCommandQueue.h>
+
+using namespace IOHC;
+
+static const uint8_t ABSOLUTE = 9;      // Stands for the RemoteButton values, opaque to the queue
+static const uint8_t STOP = 3;
+
+static Command position(uint32_t device, int32_t closed) {
+    Command command;
+    command.button = ABSOLUTE;
+    command.device = device;
+    command.value = closed;
+    command.coalesce = true;
+    return command;
+}
+
+static Command button(uint32_t device, uint8_t pressed) {
+    Command command;
+    command.button = pressed;
+    command.device = device;
+    return command;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_fifo_and_tickets() {
+    iohcCommandQueue queue;
+    Command line;
+    line.kind = CommandKind::Line;
+    line.text = "time1W 30";
+    line.argument = "Kitchen";
+    uint32_t first = 0, second = 0;
+    TEST_ASSERT_TRUE(queue.push(line, 100, &first) == iohcCommandQueue::Push::Queued);
+    TEST_ASSERT_TRUE(queue.push(button(0x123456, STOP), 200, &second) == iohcCommandQueue::Push::Queued);
+    TEST_ASSERT_TRUE(second > first);
+
+    Command out;
+    TEST_ASSERT_TRUE(queue.pop(out, 1100));
+    TEST_ASSERT_EQUAL(first, out.ticket);
+    TEST_ASSERT_TRUE(out.kind == CommandKind::Line);
+    TEST_ASSERT_EQUAL_STRING("time1W 30", out.text.c_str());
+    TEST_ASSERT_EQUAL_STRING("Kitchen", out.argument.c_str());
+    TEST_ASSERT_TRUE(queue.pop(out, 1200));
+    TEST_ASSERT_EQUAL(second, out.ticket);
+    TEST_ASSERT_EQUAL_HEX32(0x123456, out.device);
+    TEST_ASSERT_TRUE(out.text.empty());
+    TEST_ASSERT_FALSE(queue.pop(out, 1300));
+
+    CommandQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(2, stats.executed);
+    TEST_ASSERT_EQUAL_UINT32(1000, stats.waitLatency.maxUs);
+}
+
+// A slider drag: one command left, the newest target, with the newest ingress time
+void test_coalesce_newest_target() {
+    iohcCommandQueue queue;
+    uint32_t ticket = 0;
+    for (int i = 0; i <= 50; i++) queue.push(position(0xA1, i * 2), 1000 + i, &ticket);
+    TEST_ASSERT_EQUAL(1, queue.size());
+
+    Command out;
+    TEST_ASSERT_TRUE(queue.pop(out, 2000));
+    TEST_ASSERT_EQUAL(100, out.value);
+    TEST_ASSERT_EQUAL(ticket, out.ticket);
+    TEST_ASSERT_EQUAL(1050, out.queuedUs);
+    CommandQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.queued);
+    TEST_ASSERT_EQUAL_UINT32(50, stats.coalesced);
+}
+
+// Every push of a drag gets the first ticket, the one the worker reports; another source is never merged in
+void test_coalesce_keeps_ticket_and_source() {
+    iohcCommandQueue queue;
+    uint32_t first = 0, ticket = 0;
+    queue.push(position(0xA1, 10), 0, &first);
+    for (int i = 2; i <= 5; i++) {
+        TEST_ASSERT_TRUE(queue.push(position(0xA1, i * 10), i, &ticket) == iohcCommandQueue::Push::Coalesced);
+        TEST_ASSERT_EQUAL(first, ticket);
+    }
+    Command web = position(0xA1, 90);
+    web.source = CommandSource::Web;
+    uint32_t webTicket = 0;
+    TEST_ASSERT_TRUE(queue.push(web, 10, &webTicket) == iohcCommandQueue::Push::Queued);
+    TEST_ASSERT_TRUE(webTicket != first);
+    TEST_ASSERT_EQUAL(2, queue.size());
+
+    Command out;
+    TEST_ASSERT_TRUE(queue.pop(out, 20));
+    TEST_ASSERT_EQUAL(first, out.ticket);
+    TEST_ASSERT_TRUE(out.source == CommandSource::Mqtt);
+    TEST_ASSERT_EQUAL(50, out.value);
+    TEST_ASSERT_TRUE(queue.pop(out, 20));
+    TEST_ASSERT_EQUAL(webTicket, out.ticket);
+    TEST_ASSERT_TRUE(out.source == CommandSource::Web);
+    TEST_ASSERT_EQUAL(90, out.value);
+}
+
+// Only the last command waiting for the device is replaced, others devices in between do not matter
+void test_no_reordering() {
+    iohcCommandQueue queue;
+    queue.push(position(0xA1, 30), 0);
+    queue.push(button(0xA1, STOP), 0);
+    queue.push(position(0xA1, 60), 0);
+    queue.push(position(0xB2, 10), 0);
+    queue.push(position(0xA1, 70), 0);
+    queue.push(position(0xB2, 20), 0);
+    TEST_ASSERT_EQUAL(4, queue.size());
+
+    const struct { uint32_t device; uint8_t button; int32_t value; } expected[] = {
+        {0xA1, ABSOLUTE, 30}, {0xA1, STOP, 0}, {0xA1, ABSOLUTE, 70}, {0xB2, ABSOLUTE, 20},
+    };
+    Command out;
+    for (const auto &e : expected) {
+        TEST_ASSERT_TRUE(queue.pop(out, 0));
+        TEST_ASSERT_EQUAL_HEX32(e.device, out.device);
+        TEST_ASSERT_EQUAL(e.button, out.button);
+        TEST_ASSERT_EQUAL(e.value, out.value);
+    }
+}
+
+void test_bounded() {
+    iohcCommandQueue queue;
+    for (uint32_t device = 1; device <= COMMAND_QUEUE_DEPTH; device++)
+        TEST_ASSERT_TRUE(queue.push(position(device, 50), 0) == iohcCommandQueue::Push::Queued);
+    uint32_t ticket = 0;
+    TEST_ASSERT_TRUE(queue.push(button(1, STOP), 0, &ticket) == iohcCommandQueue::Push::Rejected);
+    TEST_ASSERT_EQUAL(0, ticket);
+    // A newer target still finds its place
+    TEST_ASSERT_TRUE(queue.push(position(5, 80), 0) == iohcCommandQueue::Push::Coalesced);
+
+    CommandQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.rejected);
+    TEST_ASSERT_EQUAL(COMMAND_QUEUE_DEPTH, stats.maxDepth);
+    queue.clear();
+    TEST_ASSERT_EQUAL(0, queue.size());
+}
+
+void test_results() {
+    iohcCommandQueue queue;
+    queue.push(button(0xA1, STOP), 1000);
+    queue.push(button(0xB2, STOP), 2000);
+    Command out;
+    queue.pop(out, 3000);
+    queue.done(out, true, 41000);
+    queue.pop(out, 4000);
+    queue.done(out, false);
+
+    CommandQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.acknowledged);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.failed);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.airLatency.count);
+    TEST_ASSERT_EQUAL_UINT32(40000, stats.airLatency.maxUs);
+    queue.resetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, queue.stats().acknowledged);
+}
+
+/*
+    Home Assistant slider drags on 4 covers at once, a position every 20 ms for 2 s each, on simulated time. The
+    worker sends one command per radio slot (a 1W frame and its repeats, about 120 ms). Before, every step went on
+    air in order; now each cover gets its newest target in the next slot free.
+*/
+void test_slider_flood() {
+    const int devices = 4, steps = 100;
+    const int64_t stepUs = 20000, slotUs = 120000;
+
+    iohcCommandQueue queue;
+    int64_t now = 0, radioFreeUs = 0, lastAirUs = 0;
+    int32_t lastSent[devices] = {-1, -1, -1, -1};
+    uint32_t frames = 0;
+    Command out;
+    // The worker takes a command when the radio is free, its frame goes on air right away
+    auto send = [&](int64_t at) {
+        queue.pop(out, at);
+        queue.done(out, true, at);
+        lastSent[out.device - 1] = out.value;
+        radioFreeUs = at + slotUs;
+        lastAirUs = at;
+        frames++;
+    };
+    for (int step = 0; step < steps; step++) {
+        for (int d = 0; d < devices; d++) {
+            now = step * stepUs + d * 1000;
+            while (radioFreeUs <= now && queue.size()) send(radioFreeUs);
+            queue.push(position(d + 1, step), now);
+            if (radioFreeUs <= now) send(now);
+        }
+    }
+    const int64_t dragEndUs = now;
+    while (queue.size()) send(radioFreeUs);
+
+    for (int d = 0; d < devices; d++) TEST_ASSERT_EQUAL(steps - 1, lastSent[d]);
+    CommandQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(devices * steps, stats.queued + stats.coalesced + stats.rejected);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.rejected);
+    TEST_ASSERT_EQUAL_UINT32(frames, stats.acknowledged);
+    TEST_ASSERT_TRUE(stats.maxDepth <= devices);
+    // Never more than a slot per cover waiting ahead
+    TEST_ASSERT_TRUE(stats.airLatency.maxUs <= (devices + 1) * slotUs);
+
+    const int64_t fifoLastUs = static_cast<int64_t>(devices * steps - 1) * slotUs;
+    printf("  %d slider steps: %u frames, last on air %lld ms after the drag (one frame per step: %lld ms), "
+           "ingress to air max %u ms\n", devices * steps, frames, static_cast<long long>((lastAirUs - dragEndUs) / 1000),
+           static_cast<long long>((fifoLastUs - dragEndUs) / 1000), stats.airLatency.maxUs / 1000);
+}
+
+// Producers on their own threads, faster than the worker: nothing lost, nothing out of order
+void test_threaded_flood() {
+    const int producers = 4, pushes = 20000;
+    iohcCommandQueue queue;
+    std::atomic<int> running{producers};
+    std::atomic<uint32_t> attempts{0};
+    std::vector<std::vector<int32_t>> seen(producers + 1);
+
+    std::thread worker([&] {
+        Command out;
+        for (;;) {
+            if (!queue.pop(out, 0)) {
+                if (!running) {
+                    if (!queue.size()) break;
+                    continue;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            seen[out.device].push_back(out.button == STOP ? -1 : out.value);
+            queue.done(out, true);
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int p = 1; p <= producers; p++)
+        threads.emplace_back([&, p] {
+            for (int i = 0; i < pushes; i++) {
+                // A stop every 1000 steps, never merged with the positions around it; rejected ones are sent again
+                const Command command = i % 1000 == 999 ? button(p, STOP) : position(p, i);
+                while (attempts++, queue.push(command, 0) == iohcCommandQueue::Push::Rejected)
+                    std::this_thread::yield();
+            }
+            running--;
+        });
+    for (auto &t : threads) t.join();
+    worker.join();
+
+    uint32_t executed = 0;
+    for (int p = 1; p <= producers; p++) {
+        const auto &values = seen[p];
+        int stops = 0;
+        int32_t last = -1;
+        for (int32_t value : values) {
+            if (value < 0) {
+                stops++;
+                continue;
+            }
+            TEST_ASSERT_TRUE(value > last);
+            last = value;
+        }
+        TEST_ASSERT_EQUAL(-1, values.back());
+        TEST_ASSERT_EQUAL(pushes - 2, last);
+        TEST_ASSERT_EQUAL(pushes / 1000, stops);
+        executed += values.size();
+    }
+    CommandQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(producers * pushes, stats.queued + stats.coalesced);
+    TEST_ASSERT_EQUAL_UINT32(attempts.load(), stats.queued + stats.coalesced + stats.rejected);
+    TEST_ASSERT_EQUAL_UINT32(executed, stats.executed);
+    TEST_ASSERT_EQUAL_UINT32(stats.queued, stats.executed);
+    TEST_ASSERT_EQUAL_UINT32(stats.executed, stats.acknowledged);
+    printf("  %d pushes from %d threads: %u executed, %u coalesced, %u rejected and sent again, max depth %u\n",
+           producers * pushes, producers, stats.executed, stats.coalesced, stats.rejected, stats.maxDepth);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_and_tickets);
+    RUN_TEST(test_coalesce_newest_target);
+    RUN_TEST(test_coalesce_keeps_ticket_and_source);
+    RUN_TEST(test_no_reordering);
+    RUN_TEST(test_bounded);
+    RUN_TEST(test_results);
+    RUN_TEST(test_slider_flood);
+    RUN_TEST(test_threaded_flood);
+    return UNITY_END();
+}
@@ -0,0 +1,282 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <iohcCommandTable.h>
+#include "../heap_accounting.h"
+
+using namespace IOHC;
+
+// Every "- **name**" of COMMANDS.md
+static const char *const documented[] = {
+    "powerOn", "setTemp", "setMode", "setPresence", "setWindow", "midnight", "associate", "custom", "custom60",
+    "discovery", "getName", "scanMode", "scanDump", "pairMode", "pair", "add", "remove", "open", "close", "stop",
+    "position", "absolute", "vent", "force", "mode1", "mode2", "mode3", "mode4", "new1W", "del1W", "edit1W",
+    "time1W", "list1W", "stats1W", "newRemote", "linkRemote", "unlinkRemote", "delRemote", "verbose", "help", "ls",
+    "cat", "rm", "lastAddr", "rxStats", "rxFilter", "rxDedupe", "deviceIndex", "linkStats", "wakeStats", "txStats",
+    "hopStats", "regCache", "mqttIp", "mqttUser", "mqttPass", "mqttDiscovery",
+};
+
+// What the last handler run was given
+static Tokens received;
+static int calls = 0;
+
+static void record(Tokens *cmd) {
+    received = *cmd;
+    calls++;
+}
+
+static void fillTable(iohcCommandTable &table) {
+    for (const auto &name : commandNames) TEST_ASSERT_TRUE(table.add(std::string(name).c_str(), "test", record));
+}
+
+void setUp(void) {
+    received.clear();
+    calls = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_every_documented_command() {
+    iohcCommandTable table;
+    fillTable(table);
+    for (const char *name : documented) {
+        const int index = commandIndex(name);
+        TEST_ASSERT_TRUE(index >= 0);
+        TEST_ASSERT_TRUE(commandNames[index] == name);
+
+        std::string line = std::string(name) + " abcd 42";
+        TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Done), static_cast<int>(table.dispatch(line)));
+        TEST_ASSERT_EQUAL(3, received.size());
+        TEST_ASSERT_EQUAL_STRING(name, received[0].c_str());
+        TEST_ASSERT_EQUAL_STRING("abcd", received[1].c_str());
+        TEST_ASSERT_EQUAL_STRING("42", received[2].c_str());
+    }
+    TEST_ASSERT_EQUAL(sizeof(documented) / sizeof(documented[0]), calls);
+
+    // And the file itself, when run from the project directory
+    FILE *f = fopen("COMMANDS.md", "r");
+    if (!f) return;
+    char line[512];
+    int listed = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "- **", 4)) continue;
+        char *end = strstr(line + 4, "**");
+        TEST_ASSERT_NOT_NULL(end);
+        TEST_ASSERT_TRUE(commandIndex(std::string_view(line + 4, end - line - 4)) >= 0);
+        listed++;
+    }
+    fclose(f);
+    TEST_ASSERT_TRUE(listed >= static_cast<int>(sizeof(documented) / sizeof(documented[0])));
+}
+
+void test_not_commands() {
+    for (const char *name : {"", "hel", "helpx", "HELP", "iown/help", "custom6", "custom600", "open ", " open"})
+        TEST_ASSERT_EQUAL(-1, commandIndex(name));
+
+    iohcCommandTable table;
+    TEST_ASSERT_FALSE(table.add("notACommand", "test", record));
+    TEST_ASSERT_TRUE(table.add("open", "first", record));
+    TEST_ASSERT_FALSE(table.add("open", "second", record));
+    TEST_ASSERT_EQUAL_STRING("first", table.find("open")->description);
+    // In the table but not registered by this build
+    TEST_ASSERT_NULL(table.find("powerOn"));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Unknown), static_cast<int>(table.dispatch("powerOn")));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Unknown), static_cast<int>(table.dispatch("opened now")));
+    TEST_ASSERT_EQUAL(0, calls);
+}
+
+void test_dispatch_words() {
+    iohcCommandTable table;
+    fillTable(table);
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Empty), static_cast<int>(table.dispatch("")));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Empty), static_cast<int>(table.dispatch("   ")));
+
+    table.dispatch("  close   abcd ");
+    TEST_ASSERT_EQUAL(2, received.size());
+    TEST_ASSERT_EQUAL_STRING("close", received[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("abcd", received[1].c_str());
+
+    // /api/command: the device description goes second
+    const std::string description = "wxyz";
+    table.dispatch("position 40", ' ', &description);
+    TEST_ASSERT_EQUAL(3, received.size());
+    TEST_ASSERT_EQUAL_STRING("wxyz", received[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("40", received[2].c_str());
+
+    std::string_view words[COMMAND_MAX_TOKENS];
+    std::string many;
+    for (int i = 0; i < 40; i++) many += "w ";
+    TEST_ASSERT_EQUAL(COMMAND_MAX_TOKENS, iohcCommandTable::split(many, ' ', words, COMMAND_MAX_TOKENS));
+    TEST_ASSERT_EQUAL(3, iohcCommandTable::split("a,b,,c", ',', words, COMMAND_MAX_TOKENS));
+}
+
+// MQTT: the last topic level is the command, no substring match
+void test_dispatch_topic() {
+    iohcCommandTable table;
+    fillTable(table);
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Done),
+                      static_cast<int>(table.dispatchTopic("iown/setTemp", "21.5")));
+    TEST_ASSERT_EQUAL(2, received.size());
+    TEST_ASSERT_EQUAL_STRING("iown/setTemp", received[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("21.5", received[1].c_str());
+
+    table.dispatchTopic("iown/custom60", "");
+    TEST_ASSERT_EQUAL(1, received.size());
+    TEST_ASSERT_EQUAL_STRING("iown/custom60", received[0].c_str());
+    // Used to run "custom", the first command found inside the topic
+    iohcCommandTable onlyCustom;
+    onlyCustom.add("custom", "test", record);
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Unknown),
+                      static_cast<int>(onlyCustom.dispatchTopic("iown/custom60", "")));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Done), static_cast<int>(table.dispatchTopic("midnight", "")));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Unknown),
+                      static_cast<int>(table.dispatchTopic("iown/setTemperature", "21")));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandResult::Unknown),
+                      static_cast<int>(table.dispatchTopic("iown/setTemp/", "21")));
+}
+
+void test_typed_args() {
+    uint32_t u = 0;
+    TEST_ASSERT_TRUE(commandArg::toU32("1000", u));
+    TEST_ASSERT_EQUAL_UINT32(1000, u);
+    TEST_ASSERT_TRUE(commandArg::toU32("4294967295", u));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, u);
+    TEST_ASSERT_FALSE(commandArg::toU32("4294967296", u));
+    TEST_ASSERT_FALSE(commandArg::toU32("", u));
+    TEST_ASSERT_FALSE(commandArg::toU32("12a", u));
+    TEST_ASSERT_FALSE(commandArg::toU32("-1", u));
+    TEST_ASSERT_TRUE(commandArg::toU32("fF", u, 16));
+    TEST_ASSERT_EQUAL_UINT32(255, u);
+
+    int32_t i = 0;
+    TEST_ASSERT_TRUE(commandArg::toI32("-40", i));
+    TEST_ASSERT_EQUAL(-40, i);
+    TEST_ASSERT_TRUE(commandArg::toI32("-2147483648", i));
+    TEST_ASSERT_EQUAL(INT32_MIN, i);
+    TEST_ASSERT_FALSE(commandArg::toI32("2147483648", i));
+    TEST_ASSERT_FALSE(commandArg::toI32("-", i));
+
+    uint8_t node[3];
+    TEST_ASSERT_TRUE(commandArg::toHex("F153fa", node, 3));
+    const uint8_t expected[3] = {0xF1, 0x53, 0xFA};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, node, 3);
+    TEST_ASSERT_FALSE(commandArg::toHex("F153f", node, 3));
+    TEST_ASSERT_FALSE(commandArg::toHex("F153fg", node, 3));
+}
+
+void test_zero_heap_lookup() {
+    iohcCommandTable table;
+    fillTable(table);
+    const char *line = "rxDedupe 1000 100";
+    std::string_view words[COMMAND_MAX_TOKENS];
+    int found = 0;
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < 1000; i++) {
+        size_t count = iohcCommandTable::split(line, ' ', words, COMMAND_MAX_TOKENS);
+        found += count == 3 && table.find(words[0]) != nullptr;
+    }
+    counting = false;
+    TEST_ASSERT_EQUAL(0, allocations.load());
+    TEST_ASSERT_EQUAL(1000, found);
+}
+
+// The stringstream tokenizer and strcmp scan of the previous dispatcher
+struct LegacyEntry {
+    char cmd[15];
+    void (*handler)(Tokens *);
+};
+
+static void legacyTokenize(std::string const &str, const char delim, Tokens &out) {
+    std::stringstream ss(str);
+    std::string s;
+    while (std::getline(ss, s, delim)) out.push_back(s);
+}
+
+static bool legacyDispatch(const std::vector<LegacyEntry> &entries, const char *line) {
+    Tokens segments;
+    legacyTokenize(line, ' ', segments);
+    for (const auto &entry : entries)
+        if (strcmp(entry.cmd, segments[0].c_str()) == 0) {
+            entry.handler(&segments);
+            return true;
+        }
+    return false;
+}
+
+static void nothing(Tokens *) {
+}
+
+void test_benchmark() {
+    iohcCommandTable table;
+    std::vector<LegacyEntry> entries;
+    for (const auto &name : commandNames) {
+        table.add(std::string(name).c_str(), "bench", nothing);
+        LegacyEntry entry{};
+        memcpy(entry.cmd, name.data(), name.size());
+        entry.handler = nothing;
+        entries.push_back(entry);
+    }
+    std::vector<std::string> lines;
+    for (const auto &name : commandNames) lines.push_back(std::string(name) + " abcd 50");
+
+    const int rounds = 2000;
+    int legacyHits = 0, hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (const auto &line : lines) legacyHits += legacyDispatch(entries, line.c_str());
+    const double legacyNs =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+        (rounds * lines.size());
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (const auto &line : lines) hits += table.dispatch(line) == CommandResult::Done;
+    const double dispatchNs =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+        (rounds * lines.size());
+
+    // Lookup alone: strcmp scan against the perfect hash
+    volatile int sink = 0;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (const auto &name : commandNames)
+            for (size_t e = 0; e < entries.size(); e++)
+                if (!strcmp(entries[e].cmd, name.data())) {
+                    sink += e;
+                    break;
+                }
+    const double scanNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                          (rounds * COMMAND_COUNT);
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (const auto &name : commandNames) sink += commandIndex(name);
+    const double hashNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                          (rounds * COMMAND_COUNT);
+
+    TEST_ASSERT_EQUAL(rounds * COMMAND_COUNT, legacyHits);
+    TEST_ASSERT_EQUAL(rounds * COMMAND_COUNT, hits);
+    TEST_ASSERT_TRUE(dispatchNs < legacyNs);
+    printf("  %zu commands: dispatch %.0f ns (stringstream + strcmp %.0f ns), lookup %.1f ns (strcmp scan %.1f ns)\n",
+           COMMAND_COUNT, dispatchNs, legacyNs, hashNs, scanNs);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_documented_command);
+    RUN_TEST(test_not_commands);
+    RUN_TEST(test_dispatch_words);
+    RUN_TEST(test_dispatch_topic);
+    RUN_TEST(test_typed_args);
+    RUN_TEST(test_zero_heap_lookup);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
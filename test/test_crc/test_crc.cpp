@@ -0,0 +1,128 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iohcCrc.h>
+#include <iohcCryptoHelpers.h>
+
+using namespace iohcCrypto;
+
+// The one bit at a time function every kernel has to match
+static uint16_t referenceCrc(const uint8_t *data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t n = 0; n < len; n++) {
+        crc ^= data[n];
+        for (int i = 0; i < 8; ++i) {
+            unsigned int remainder = (crc & 1) ? 0x8408 : 0;
+            crc = (crc >> 1) ^ remainder;
+        }
+    }
+    return crc;
+}
+
+// Frames with their CRC, from test_native
+static const char *frames[] = {
+    "fc0000003fabcdef307e60491f976adf653db0ed785e49a2010201123419e81ec43d5e9bf2",
+    "4e04feefeef00f0038123456789abc23b6",
+    "1804f00f00feefee32ea425a7a182885d4eaeefd416d625e016379",
+    "0e00feefeef00f003c123456789abc5eb1",
+    "8e00f00f00feefee3d0ae519a73c992400",
+    "4800feefeef00f0031fb60",
+    "0e00f00f00feefee3c123456789abc19db",
+    "1800f00f00feefee32102e49a16d3b69726f3192cf17534ad98043",
+    "0e00feefeef00f003d8dc9d40dc7a4f9e5",
+    "8800f00f00feefee335bfb",
+};
+
+typedef uint16_t (*Kernel)(const uint8_t *, size_t, uint16_t);
+
+static const struct {
+    const char *name;
+    Kernel kernel;
+} kernels[] = {
+    {"bitwise", crc16Bitwise},
+    {"table", crc16Table},
+    {"slice4", crc16Slice4},
+};
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_captured_frames() {
+    uint8_t frame[64];
+    for (const char *hex : frames) {
+        size_t len = hexStringToBytes(hex, frame) - 2;
+        uint16_t expected = frame[len] | frame[len + 1] << 8;
+        for (const auto &k : kernels) {
+            TEST_ASSERT_EQUAL_HEX16(expected, k.kernel(frame, len, 0));
+            // Frame and CRC together check to 0, as done on reception
+            TEST_ASSERT_EQUAL_HEX16(0, k.kernel(frame, len + 2, 0));
+        }
+        TEST_ASSERT_EQUAL_HEX16(0, radioPacketComputeCrc(frame, len + 2));
+    }
+}
+
+// Every length, every alignment, chained calls
+void test_random_inputs() {
+    srand(0x10c);
+    uint8_t buffer[300];
+    for (int round = 0; round < 2000; round++) {
+        for (auto &b : buffer) b = rand();
+        size_t offset = rand() % 4;
+        size_t len = rand() % (sizeof(buffer) - offset);
+        const uint8_t *data = buffer + offset;
+        uint16_t expected = referenceCrc(data, len);
+        for (const auto &k : kernels) TEST_ASSERT_EQUAL_HEX16(expected, k.kernel(data, len, 0));
+
+        size_t split = len ? rand() % len : 0;
+        TEST_ASSERT_EQUAL_HEX16(expected, crc16Slice4(data + split, len - split, crc16Slice4(data, split)));
+        uint16_t crc = 0;
+        for (size_t i = 0; i < len; i++) crc = computeCrc(data[i], crc);
+        TEST_ASSERT_EQUAL_HEX16(expected, crc);
+    }
+    for (size_t len = 0; len <= 64; len++)
+        TEST_ASSERT_EQUAL_HEX16(referenceCrc(buffer, len), crc16(buffer, len));
+}
+
+void test_constexpr() {
+    constexpr uint8_t check[9] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    // CRC-16/KERMIT check value
+    static_assert(crc16Table(check, 9) == 0x2189, "table kernel");
+    static_assert(crc16Slice4(check, 9) == 0x2189, "slice4 kernel");
+    static_assert(crc16Bitwise(check, 9) == 0x2189, "bitwise kernel");
+    TEST_ASSERT_EQUAL_HEX16(0x2189, crc16(check, 9));
+}
+
+void test_benchmark() {
+    const int rounds = 200000;
+    uint8_t frame[32];
+    for (auto &b : frame) b = rand();
+    printf("  IOHC_CRC_KERNEL %d\n", IOHC_CRC_KERNEL);
+    for (size_t len : {11, 32}) {
+        for (const auto &k : kernels) {
+            volatile uint16_t sink = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < rounds; i++) {
+                frame[0] = i;
+                sink = sink ^ k.kernel(frame, len, 0);
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            printf("  %-8s %2u bytes: %6.1f ns/frame\n", k.name, (unsigned)len, ns / rounds);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_captured_frames);
+    RUN_TEST(test_random_inputs);
+    RUN_TEST(test_constexpr);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
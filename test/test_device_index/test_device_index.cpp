@@ -0,0 +1,279 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include <iohcDeviceIndex.h>
+#include <iohcCryptoHelpers.h>
+#include "../heap_accounting.h"
+
+using namespace IOHC;
+
+struct Remote {
+    uint8_t node[3];
+    std::string description;
+    std::string name;
+};
+
+static void addressOf(uint32_t n, uint8_t *address) {
+    address[0] = n >> 16;
+    address[1] = n >> 8;
+    address[2] = n;
+}
+
+// Spread over the 24-bit space, no duplicates for n < 2^24
+static uint32_t scatter(uint32_t n) {
+    return (n * 0x9E3779u + 0x123456u) & 0xFFFFFF;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_parse_address() {
+    uint8_t address[3];
+    TEST_ASSERT_TRUE(iohcDeviceIndex::parseAddress(std::string("f153fa"), address));
+    const uint8_t expected[3] = {0xF1, 0x53, 0xFA};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, address, 3);
+    TEST_ASSERT_TRUE(iohcDeviceIndex::parseAddress(std::string("F153FA"), address));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, address, 3);
+    TEST_ASSERT_FALSE(iohcDeviceIndex::parseAddress(std::string("f153f"), address));
+    TEST_ASSERT_FALSE(iohcDeviceIndex::parseAddress(std::string("f153fg"), address));
+    TEST_ASSERT_FALSE(iohcDeviceIndex::parseAddress(std::string("f153fa0"), address));
+    TEST_ASSERT_EQUAL_HEX32(0xF153FA, iohcDeviceIndex::pack(expected));
+}
+
+// One row per address, one slot per kind
+void test_kinds_share_a_row() {
+    iohcDeviceIndex index;
+    const uint8_t remote[3] = {0xF1, 0x53, 0xFA};
+    const uint8_t other[3] = {0x26, 0x84, 0xDE};
+    TEST_ASSERT_EQUAL_UINT32(DEVICE_INDEX_NONE, index.find(DeviceKind::Remote1W, remote));
+
+    index.put(DeviceKind::Remote1W, remote, 3);
+    index.put(DeviceKind::RemoteMap, remote, 0);
+    index.put(DeviceKind::Device2W, other, 7);
+    TEST_ASSERT_EQUAL_UINT32(3, index.find(DeviceKind::Remote1W, remote));
+    TEST_ASSERT_EQUAL_UINT32(DEVICE_INDEX_NONE, index.find(DeviceKind::Device2W, remote));
+
+    DeviceSlots slots = index.find(remote);
+    TEST_ASSERT_TRUE(slots.has(DeviceKind::Remote1W));
+    TEST_ASSERT_TRUE(slots.has(DeviceKind::RemoteMap));
+    TEST_ASSERT_FALSE(slots.has(DeviceKind::SystemObject));
+    TEST_ASSERT_EQUAL_UINT32(0, slots[DeviceKind::RemoteMap]);
+    TEST_ASSERT_EQUAL_UINT32(2, index.stats().addresses);
+
+    // Moving an entry only updates its slot
+    index.put(DeviceKind::Remote1W, remote, 1);
+    TEST_ASSERT_EQUAL_UINT32(1, index.find(DeviceKind::Remote1W, remote));
+    TEST_ASSERT_EQUAL(1, index.size(DeviceKind::Remote1W));
+
+    TEST_ASSERT_TRUE(index.erase(DeviceKind::Remote1W, remote));
+    TEST_ASSERT_FALSE(index.erase(DeviceKind::Remote1W, remote));
+    TEST_ASSERT_EQUAL_UINT32(0, index.find(DeviceKind::RemoteMap, remote));
+    TEST_ASSERT_TRUE(index.erase(DeviceKind::RemoteMap, remote));
+    TEST_ASSERT_EQUAL_UINT32(1, index.stats().addresses);
+    TEST_ASSERT_EQUAL_UINT32(7, index.find(DeviceKind::Device2W, other));
+}
+
+// Names only keep a hash: the caller confirms, duplicates and collisions are told apart by the callback
+void test_names() {
+    iohcDeviceIndex index;
+    std::vector<Remote> remotes = {{{1, 0, 0}, "ABCD", "Kitchen"}, {{2, 0, 0}, "EFGH", "Kitchen"},
+                                   {{3, 0, 0}, "IJKL", "Bedroom"}};
+    for (uint32_t i = 0; i < remotes.size(); i++) {
+        index.putName(DeviceKind::Remote1W, remotes[i].description, i);
+        index.putName(DeviceKind::Remote1W, remotes[i].name, i);
+    }
+    auto byDescription = [&](const std::string &d) {
+        return index.findName(DeviceKind::Remote1W, d, [&](uint32_t slot) { return remotes[slot].description == d; });
+    };
+    auto byName = [&](const std::string &n, uint32_t skip = DEVICE_INDEX_NONE) {
+        return index.findName(DeviceKind::Remote1W, n,
+                              [&](uint32_t slot) { return slot != skip && remotes[slot].name == n; });
+    };
+    TEST_ASSERT_EQUAL_UINT32(1, byDescription("EFGH"));
+    TEST_ASSERT_EQUAL_UINT32(DEVICE_INDEX_NONE, byDescription("Kitchen"));
+    TEST_ASSERT_EQUAL_UINT32(DEVICE_INDEX_NONE, byDescription("ZZZZ"));
+    uint32_t first = byName("Kitchen");
+    TEST_ASSERT_TRUE(first == 0 || first == 1);
+    TEST_ASSERT_EQUAL_UINT32(1 - first, byName("Kitchen", first));
+    // Other kinds do not see them
+    TEST_ASSERT_EQUAL_UINT32(DEVICE_INDEX_NONE,
+                             index.findName(DeviceKind::RemoteMap, "ABCD", [](uint32_t) { return true; }));
+
+    // Rename
+    TEST_ASSERT_TRUE(index.eraseName(DeviceKind::Remote1W, "Bedroom", 2));
+    TEST_ASSERT_FALSE(index.eraseName(DeviceKind::Remote1W, "Bedroom", 2));
+    remotes[2].name = "Office";
+    index.putName(DeviceKind::Remote1W, "Office", 2);
+    TEST_ASSERT_EQUAL_UINT32(2, byName("Office"));
+    TEST_ASSERT_EQUAL_UINT32(DEVICE_INDEX_NONE, byName("Bedroom"));
+    TEST_ASSERT_EQUAL_UINT32(6, index.stats().names);
+}
+
+// A container re-registering its entries after an erase
+void test_clear_kind() {
+    iohcDeviceIndex index;
+    uint8_t address[3];
+    for (uint32_t i = 0; i < 100; i++) {
+        addressOf(scatter(i), address);
+        index.put(DeviceKind::Remote1W, address, i);
+        index.putName(DeviceKind::Remote1W, std::to_string(i), i);
+        if (i % 2) index.put(DeviceKind::Device2W, address, i);
+    }
+    index.clear(DeviceKind::Remote1W);
+    TEST_ASSERT_EQUAL(0, index.size(DeviceKind::Remote1W));
+    TEST_ASSERT_EQUAL(50, index.size(DeviceKind::Device2W));
+    TEST_ASSERT_EQUAL_UINT32(50, index.stats().addresses);
+    TEST_ASSERT_EQUAL_UINT32(0, index.stats().names);
+    for (uint32_t i = 0; i < 100; i++) {
+        addressOf(scatter(i), address);
+        TEST_ASSERT_EQUAL_UINT32(DEVICE_INDEX_NONE, index.find(DeviceKind::Remote1W, address));
+        TEST_ASSERT_EQUAL_UINT32(i % 2 ? i : DEVICE_INDEX_NONE, index.find(DeviceKind::Device2W, address));
+    }
+}
+
+// Random inserts and erases against std::map: backward shift deletion keeps every entry reachable
+void test_churn_against_map() {
+    iohcDeviceIndex index;
+    std::map<uint32_t, uint32_t> reference;
+    srand(0x1d3);
+    uint8_t address[3];
+    for (int op = 0; op < 200000; op++) {
+        // Small key space: many collisions, erases and re-inserts
+        uint32_t key = rand() % 3000;
+        addressOf(key * 5591 & 0xFFFFFF, address);
+        if (rand() % 3) {
+            index.put(DeviceKind::Device2W, address, op);
+            reference[key] = op;
+        } else {
+            TEST_ASSERT_EQUAL(reference.erase(key) == 1, index.erase(DeviceKind::Device2W, address));
+        }
+    }
+    for (uint32_t key = 0; key < 3000; key++) {
+        addressOf(key * 5591 & 0xFFFFFF, address);
+        auto it = reference.find(key);
+        TEST_ASSERT_EQUAL_UINT32(it == reference.end() ? DEVICE_INDEX_NONE : it->second,
+                                 index.find(DeviceKind::Device2W, address));
+    }
+    DeviceIndexStats stats = index.stats();
+    TEST_ASSERT_EQUAL_UINT32(reference.size(), stats.addresses);
+    TEST_ASSERT_EQUAL(reference.size(), index.size(DeviceKind::Device2W));
+    printf("  %u addresses in %u rows, longest probe %u\n", stats.addresses, stats.addressCapacity,
+           stats.longestProbe);
+}
+
+void test_zero_heap_lookups() {
+    iohcDeviceIndex index;
+    std::vector<Remote> remotes(1000);
+    for (uint32_t i = 0; i < remotes.size(); i++) {
+        addressOf(scatter(i), remotes[i].node);
+        remotes[i].description = "R" + std::to_string(i);
+        index.put(DeviceKind::Remote1W, remotes[i].node, i);
+        index.putName(DeviceKind::Remote1W, remotes[i].description, i);
+    }
+    const std::string wanted = "R512";
+    allocations = 0;
+    counting = true;
+    uint32_t found = 0;
+    for (const auto &r : remotes) found += index.find(DeviceKind::Remote1W, r.node) != DEVICE_INDEX_NONE;
+    uint32_t slot = index.findName(DeviceKind::Remote1W, wanted,
+                                   [&](uint32_t s) { return remotes[s].description == wanted; });
+    counting = false;
+    TEST_ASSERT_EQUAL(0, allocations.load());
+    TEST_ASSERT_EQUAL_UINT32(1000, found);
+    TEST_ASSERT_EQUAL_UINT32(512, slot);
+}
+
+static volatile uint64_t sink;
+
+// Per-frame lookup by source and per-command lookup by description, against what the containers did before:
+// find_if over the vector, and std::map keyed on the hex string of the address
+static void benchmark(size_t devices) {
+    std::vector<Remote> remotes(devices);
+    iohcDeviceIndex index;
+    index.reserve(devices);
+    std::map<std::string, uint32_t> byHex;
+    for (uint32_t i = 0; i < devices; i++) {
+        addressOf(scatter(i), remotes[i].node);
+        remotes[i].description = "D" + std::to_string(i);
+        index.put(DeviceKind::Remote1W, remotes[i].node, i);
+        index.putName(DeviceKind::Remote1W, remotes[i].description, i);
+        byHex[bytesToHexString(remotes[i].node, 3)] = i;
+    }
+
+    const size_t lookups = 200000;
+    std::vector<uint32_t> order(lookups);
+    for (auto &o : order) o = rand() % devices;
+    using clock = std::chrono::steady_clock;
+    uint64_t sum = 0;
+
+    auto start = clock::now();
+    for (uint32_t o : order) sum += index.find(DeviceKind::Remote1W, remotes[o].node);
+    double indexNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / lookups;
+
+    start = clock::now();
+    for (uint32_t o : order) {
+        const std::string &d = remotes[o].description;
+        sum += index.findName(DeviceKind::Remote1W, d, [&](uint32_t s) { return remotes[s].description == d; });
+    }
+    double nameNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / lookups;
+
+    start = clock::now();
+    for (uint32_t o : order) sum += byHex.find(bytesToHexString(remotes[o].node, 3))->second;
+    double mapNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / lookups;
+
+    // The linear scans get fewer lookups at 100k, they would take minutes otherwise
+    size_t linear = std::min(lookups, static_cast<size_t>(2000000000ull / (devices * 50)));
+    start = clock::now();
+    for (size_t l = 0; l < linear; l++) {
+        const uint8_t *node = remotes[order[l]].node;
+        auto it = std::find_if(remotes.begin(), remotes.end(),
+                               [&](const Remote &r) { return memcmp(r.node, node, 3) == 0; });
+        sum += it - remotes.begin();
+    }
+    double scanNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / linear;
+
+    start = clock::now();
+    for (size_t l = 0; l < linear; l++) {
+        const std::string &d = remotes[order[l]].description;
+        auto it = std::find_if(remotes.begin(), remotes.end(), [&](const Remote &r) { return r.description == d; });
+        sum += it - remotes.begin();
+    }
+    double scanNameNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / linear;
+
+    DeviceIndexStats stats = index.stats();
+    printf("  %6u devices: address %6.1f ns (find_if %9.1f, hex map %6.1f), name %6.1f ns (find_if %9.1f), "
+           "longest probe %u\n", static_cast<unsigned>(devices), indexNs, scanNs, mapNs, nameNs, scanNameNs,
+           stats.longestProbe);
+    sink = sum;
+    TEST_ASSERT_TRUE(indexNs < scanNs);
+    TEST_ASSERT_TRUE(nameNs < scanNameNs);
+}
+
+void test_benchmark() {
+    benchmark(1000);
+    benchmark(10000);
+    benchmark(100000);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_address);
+    RUN_TEST(test_kinds_share_a_row);
+    RUN_TEST(test_names);
+    RUN_TEST(test_clear_kind);
+    RUN_TEST(test_churn_against_map);
+    RUN_TEST(test_zero_heap_lookups);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,227 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <iohcDiscoveryCache.h>
+
+using namespace IOHC;
+
+struct Remote {
+    char id[7];
+    std::string name;
+    uint32_t travelTime;
+};
+
+struct Config {
+    std::string topic;
+    std::string payload;
+};
+
+static std::vector<Remote> makeRemotes(int count) {
+    std::vector<Remote> remotes(count);
+    for (int i = 0; i < count; i++) {
+        snprintf(remotes[i].id, sizeof(remotes[i].id), "%06x", 0x100000 + i * 7919);
+        remotes[i].name = "Blind " + std::to_string(i);
+        remotes[i].travelTime = 20;
+    }
+    return remotes;
+}
+
+// What handleMqttConnectImpl publishes: the frame sensor, then a cover, three buttons, a number and its value per remote
+static std::vector<Config> configsOf(const std::vector<Remote> &remotes, const std::string &prefix = "homeassistant") {
+    std::vector<Config> configs;
+    char payload[512];
+    snprintf(payload, sizeof(payload), R"({"~":"%s/sensor/iohc_frame","name":"IOHC Frame","stat_t":"~/state"})",
+             prefix.c_str());
+    configs.push_back({prefix + "/sensor/iohc_frame/config", payload});
+    for (const auto &r : remotes) {
+        const std::string id = r.id;
+        snprintf(payload, sizeof(payload), R"({"~":"iown/%s","name":"%s","uniq_id":"%s","cmd_t":"~/set","dev_cla":"blind"})",
+                 r.id, r.name.c_str(), r.id);
+        configs.push_back({prefix + "/cover/" + id + "/config", payload});
+        for (const char *action : {"pair", "add", "remove"}) {
+            snprintf(payload, sizeof(payload), R"({"~":"iown/%s","name":"%s %s","cmd_t":"~/%s"})", r.id,
+                     r.name.c_str(), action, action);
+            configs.push_back({prefix + "/button/" + id + "_" + action + "/config", payload});
+        }
+        snprintf(payload, sizeof(payload), R"({"~":"iown/%s","name":"%s travel time","unit_of_meas":"s"})", r.id,
+                 r.name.c_str());
+        configs.push_back({prefix + "/number/" + id + "_travel_time/config", payload});
+        configs.push_back({"iown/" + id + "/travel_time", std::to_string(r.travelTime)});
+    }
+    return configs;
+}
+
+struct Pass {
+    int published = 0;
+    std::vector<std::string> cleared;
+};
+
+static Pass runPass(iohcDiscoveryCache &cache, const std::vector<Config> &configs,
+                    const std::string &broker = "192.168.1.10") {
+    Pass pass;
+    cache.begin(broker);
+    for (const auto &c : configs) {
+        if (!cache.changed(c.topic, c.payload.data(), c.payload.size())) continue;
+        cache.published(c.topic, c.payload.data(), c.payload.size());
+        pass.published++;
+    }
+    pass.cleared = cache.end(0);
+    return pass;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_only_changes_published() {
+    iohcDiscoveryCache cache;
+    auto remotes = makeRemotes(100);
+    const auto configs = configsOf(remotes);
+    TEST_ASSERT_EQUAL(601, configs.size());
+
+    TEST_ASSERT_EQUAL(601, runPass(cache, configs).published);
+    TEST_ASSERT_TRUE(cache.dirty());
+    Pass again = runPass(cache, configs);
+    TEST_ASSERT_EQUAL(0, again.published);
+    TEST_ASSERT_EQUAL(0, again.cleared.size());
+
+    // A renamed remote: its five configs, not its travel time value
+    remotes[42].name = "Kitchen";
+    TEST_ASSERT_EQUAL(5, runPass(cache, configsOf(remotes)).published);
+    remotes[7].travelTime = 35;
+    TEST_ASSERT_EQUAL(1, runPass(cache, configsOf(remotes)).published);
+
+    DiscoveryStats stats = cache.stats();
+    TEST_ASSERT_EQUAL_UINT32(4, stats.passes);
+    TEST_ASSERT_EQUAL_UINT32(607, stats.published);
+    TEST_ASSERT_EQUAL_UINT32(601 + 596 + 600, stats.unchanged);
+}
+
+void test_new_broker_or_lost_retained() {
+    iohcDiscoveryCache cache;
+    const auto configs = configsOf(makeRemotes(10));
+    runPass(cache, configs);
+    TEST_ASSERT_EQUAL(61, runPass(cache, configs, "192.168.1.20").published);
+    TEST_ASSERT_EQUAL(0, runPass(cache, configs, "192.168.1.20").published);
+    cache.invalidate();
+    TEST_ASSERT_EQUAL(61, runPass(cache, configs, "192.168.1.20").published);
+}
+
+// Remotes removed while offline, a new discovery prefix: the configs nobody publishes any more are cleared
+void test_stale_configs_cleared() {
+    iohcDiscoveryCache cache;
+    auto remotes = makeRemotes(10);
+    runPass(cache, configsOf(remotes));
+    const std::string gone = remotes[3].id;
+    remotes.erase(remotes.begin() + 3);
+    Pass pass = runPass(cache, configsOf(remotes));
+    TEST_ASSERT_EQUAL(0, pass.published);
+    TEST_ASSERT_EQUAL(6, pass.cleared.size());
+    for (const auto &topic : pass.cleared) TEST_ASSERT_TRUE(topic.find(gone) != std::string::npos);
+    TEST_ASSERT_EQUAL(55, cache.size());
+
+    pass = runPass(cache, configsOf(remotes, "ha"));
+    TEST_ASSERT_EQUAL(46, pass.published);
+    TEST_ASSERT_EQUAL(46, pass.cleared.size());
+    for (const auto &topic : pass.cleared) TEST_ASSERT_EQUAL(0, topic.rfind("homeassistant/", 0));
+
+    // removeDiscovery while connected
+    cache.forget("ha/cover/" + std::string(remotes[0].id) + "/config");
+    TEST_ASSERT_EQUAL(54, cache.size());
+}
+
+void test_persisted_across_reboot() {
+    iohcDiscoveryCache cache;
+    const auto configs = configsOf(makeRemotes(20));
+    runPass(cache, configs);
+
+    // The DISCOVERY_FILE round trip, digests as hex strings
+    std::map<std::string, std::string> file;
+    cache.store([&file](const std::string &topic, uint64_t digest) {
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(digest));
+        file[topic] = hex;
+    });
+    TEST_ASSERT_FALSE(cache.dirty());
+    TEST_ASSERT_EQUAL(121, file.size());
+
+    iohcDiscoveryCache rebooted;
+    for (const auto &kv : file) rebooted.restore(kv.first, strtoull(kv.second.c_str(), nullptr, 16));
+    TEST_ASSERT_FALSE(rebooted.dirty());
+    Pass pass = runPass(rebooted, configs);
+    TEST_ASSERT_EQUAL(0, pass.published);
+    TEST_ASSERT_EQUAL(0, pass.cleared.size());
+    TEST_ASSERT_FALSE(rebooted.dirty());
+}
+
+void test_pacer() {
+    DiscoveryPacer pacer(50, 20);
+    int64_t now = 1000000;
+    for (int i = 0; i < 20; i++) TEST_ASSERT_EQUAL_UINT32(0, pacer.acquire(now));
+    TEST_ASSERT_EQUAL_UINT32(20000, pacer.acquire(now));
+    now += 20000;
+    TEST_ASSERT_EQUAL_UINT32(20000, pacer.acquire(now));
+    // Idle: the bucket refills up to the burst, not beyond
+    now += 10000000;
+    for (int i = 0; i < 20; i++) TEST_ASSERT_EQUAL_UINT32(0, pacer.acquire(now));
+    TEST_ASSERT_TRUE(pacer.acquire(now) > 0);
+}
+
+/*
+    Connect to ready on simulated time, 100 remotes: the fixed 200 ms per device this replaces, then the paced
+    incremental passes (publishing costs 1 ms per config on the MQTT task, the retained probe answers in 20 ms).
+*/
+void test_reconnect_to_ready() {
+    const int64_t publishUs = 1000, probeUs = 20000;
+    auto remotes = makeRemotes(100);
+
+    const int64_t fixedUs = static_cast<int64_t>(remotes.size()) * (200000 + 6 * publishUs) + publishUs;
+
+    iohcDiscoveryCache cache;
+    DiscoveryPacer pacer;
+    int64_t now = 0;
+    auto pass = [&](const std::vector<Config> &configs) {
+        const int64_t start = now;
+        now += probeUs;
+        cache.begin("192.168.1.10");
+        for (const auto &c : configs) {
+            if (!cache.changed(c.topic, c.payload.data(), c.payload.size())) continue;
+            now += pacer.acquire(now) + publishUs;
+            cache.published(c.topic, c.payload.data(), c.payload.size());
+        }
+        cache.end(0);
+        const int64_t elapsed = now - start;
+        now += 60000000;
+        return elapsed;
+    };
+
+    const int64_t firstUs = pass(configsOf(remotes));
+    const int64_t reconnectUs = pass(configsOf(remotes));
+    remotes[5].name = "Office";
+    const int64_t renamedUs = pass(configsOf(remotes));
+
+    TEST_ASSERT_TRUE(fixedUs > 20000000);
+    TEST_ASSERT_TRUE(firstUs < fixedUs);
+    TEST_ASSERT_TRUE(reconnectUs < 100000);
+    TEST_ASSERT_TRUE(renamedUs < 100000);
+    printf("  100 remotes connect to ready: fixed delays %lld ms, first pass %lld ms, reconnect %lld ms, "
+           "one renamed %lld ms\n", static_cast<long long>(fixedUs / 1000), static_cast<long long>(firstUs / 1000),
+           static_cast<long long>(reconnectUs / 1000), static_cast<long long>(renamedUs / 1000));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_only_changes_published);
+    RUN_TEST(test_new_broker_or_lost_retained);
+    RUN_TEST(test_stale_configs_cleared);
+    RUN_TEST(test_persisted_across_reboot);
+    RUN_TEST(test_pacer);
+    RUN_TEST(test_reconnect_to_ready);
+    return UNITY_END();
+}
@@ -0,0 +1,167 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <SX1276Helpers.h>
+
+// Simulated SX1276 FIFO; every readByte/readBytes call is one SPI transaction
+struct MockBus {
+    uint8_t fifo[64];
+    uint8_t head = 0;
+    uint8_t count = 0;
+    uint32_t transactions = 0;
+
+    void load(const uint8_t *data, uint8_t len) {
+        if (len) memcpy(fifo, data, len);
+        head = 0;
+        count = len;
+        transactions = 0;
+    }
+
+    uint8_t pop() {
+        if (head == count) return 0x00;
+        return fifo[head++];
+    }
+
+    uint8_t readByte(uint8_t regAddr) {
+        transactions++;
+        if (regAddr == REG_FIFO) return pop();
+        if (regAddr == REG_IRQFLAGS2) return head == count ? RF_IRQFLAGS2_FIFOEMPTY : 0;
+        return 0;
+    }
+
+    void readBytes(uint8_t regAddr, uint8_t *out, uint8_t len) {
+        transactions++;
+        for (uint8_t i = 0; i < len; i++)
+            out[i] = regAddr == REG_FIFO ? pop() : 0;
+    }
+};
+
+static constexpr uint8_t MAX_FRAME_LEN = 32;
+
+// Former receive() loop, kept as reference
+static uint8_t legacyRead(MockBus &bus, uint8_t *out) {
+    uint8_t length = 0;
+    while ((bus.readByte(REG_IRQFLAGS2) & RF_IRQFLAGS2_FIFOEMPTY) == 0)
+        out[length++] = bus.readByte(REG_FIFO);
+    return length;
+}
+
+static uint8_t makeFrame(uint8_t *frame, uint8_t length, uint8_t seed) {
+    frame[0] = (length - 1) & 0x1F;
+    for (uint8_t i = 1; i < length; i++)
+        frame[i] = static_cast<uint8_t>(seed * 31 + i * 7);
+    return length;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_identical_to_byte_loop() {
+    uint8_t frame[MAX_FRAME_LEN];
+    for (uint8_t length = 9; length <= MAX_FRAME_LEN; length++) {
+        for (uint8_t seed = 0; seed < 8; seed++) {
+            makeFrame(frame, length, seed);
+            MockBus bus;
+
+            uint8_t legacy[64] = {};
+            bus.load(frame, length);
+            uint8_t legacyLen = legacyRead(bus, legacy);
+
+            uint8_t burst[MAX_FRAME_LEN] = {};
+            bus.load(frame, length);
+            uint8_t burstLen = Radio::readFrame(bus, burst, MAX_FRAME_LEN);
+
+            TEST_ASSERT_EQUAL_UINT8(legacyLen, burstLen);
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(legacy, burst, burstLen);
+            TEST_ASSERT_EQUAL_UINT8(0, bus.count - bus.head);
+        }
+    }
+}
+
+void test_transaction_count() {
+    uint8_t frame[MAX_FRAME_LEN];
+    uint8_t out[64];
+    MockBus bus;
+
+    uint32_t legacyTotal = 0, burstTotal = 0;
+    for (uint8_t length = 9; length <= MAX_FRAME_LEN; length++) {
+        makeFrame(frame, length, length);
+
+        bus.load(frame, length);
+        legacyRead(bus, out);
+        TEST_ASSERT_EQUAL_UINT32(2 * length + 1, bus.transactions);
+        legacyTotal += bus.transactions;
+
+        bus.load(frame, length);
+        Radio::readFrame(bus, out, MAX_FRAME_LEN);
+        TEST_ASSERT_EQUAL_UINT32(4, bus.transactions);
+        burstTotal += bus.transactions;
+    }
+    printf("  SPI transactions for frames of 9..32 bytes: byte loop %u, burst %u\n", legacyTotal, burstTotal);
+}
+
+void test_empty_fifo() {
+    MockBus bus;
+    uint8_t out[MAX_FRAME_LEN];
+    bus.load(nullptr, 0);
+    TEST_ASSERT_EQUAL_UINT8(0, Radio::readFrame(bus, out, MAX_FRAME_LEN));
+    TEST_ASSERT_EQUAL_UINT32(1, bus.transactions);
+}
+
+void test_trailing_bytes_are_kept_like_the_loop() {
+    // MsgLen says 10 bytes but the FIFO holds 14
+    uint8_t frame[14];
+    makeFrame(frame, 10, 3);
+    for (uint8_t i = 10; i < 14; i++) frame[i] = 0xA0 + i;
+    MockBus bus;
+
+    uint8_t legacy[64] = {};
+    bus.load(frame, sizeof(frame));
+    uint8_t legacyLen = legacyRead(bus, legacy);
+
+    uint8_t burst[MAX_FRAME_LEN] = {};
+    bus.load(frame, sizeof(frame));
+    uint8_t burstLen = Radio::readFrame(bus, burst, MAX_FRAME_LEN);
+
+    TEST_ASSERT_EQUAL_UINT8(14, burstLen);
+    TEST_ASSERT_EQUAL_UINT8(legacyLen, burstLen);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(legacy, burst, burstLen);
+}
+
+void test_bounded_by_max_len() {
+    // A FIFO holding more than the buffer can take is drained without overflowing it
+    uint8_t frame[48];
+    makeFrame(frame, 32, 1);
+    for (uint8_t i = 32; i < sizeof(frame); i++) frame[i] = i;
+    MockBus bus;
+
+    uint8_t out[MAX_FRAME_LEN + 4];
+    memset(out, 0xEE, sizeof(out));
+    bus.load(frame, sizeof(frame));
+    uint8_t length = Radio::readFrame(bus, out, MAX_FRAME_LEN);
+
+    TEST_ASSERT_EQUAL_UINT8(MAX_FRAME_LEN, length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, out, MAX_FRAME_LEN);
+    for (uint8_t i = MAX_FRAME_LEN; i < sizeof(out); i++)
+        TEST_ASSERT_EQUAL_HEX8(0xEE, out[i]);
+    TEST_ASSERT_EQUAL_UINT8(0, bus.count - bus.head);
+
+    // Same with a small buffer and a short frame header
+    uint8_t small[4];
+    bus.load(frame, 32);
+    TEST_ASSERT_EQUAL_UINT8(4, Radio::readFrame(bus, small, sizeof(small)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, small, sizeof(small));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_identical_to_byte_loop);
+    RUN_TEST(test_transaction_count);
+    RUN_TEST(test_empty_fifo);
+    RUN_TEST(test_trailing_bytes_are_kept_like_the_loop);
+    RUN_TEST(test_bounded_by_max_len);
+    return UNITY_END();
+}
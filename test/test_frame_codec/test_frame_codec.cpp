@@ -0,0 +1,361 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <iohcFrame.h>
+#include "../heap_accounting.h"
+
+using namespace IOHC;
+
+// Frames as logged by the sniffer in analysis/*.txt, spaces collapsed
+static const char *captures[] = {
+    // control_plug_on_off.txt
+    "08:37:20.789 (10) 2W S 1 E 0 FROM AA9BFA TO 2684DE CMD 1E +0.000 > DATA(02) 0102",
+    "08:37:20.803 (14) 2W S 0 E 0 FROM 2684DE TO AA9BFA CMD 3C +14.792 DATA(06) 40034b8231bd",
+    "08:37:20.814 (14) 2W S 0 E 0 FROM AA9BFA TO 2684DE CMD 3D +11.285 DATA(06) 6add4ba7234b",
+    "08:37:20.824 (09) 2W S 0 E 1 FROM 2684DE TO AA9BFA CMD FE +11.411 < DATA(01) 05",
+    "08:38:29.467 (14) 2W S 1 E 0 FROM AA9BFA TO 2684DE CMD 00 +0.000 > DATA(06) 01e700000000",
+    "08:38:29.502 (22) 2W S 0 E 1 FROM 2684DE TO AA9BFA CMD 04 +15.896 < DATA(14) 04000000c8000002aa9bfa010000",
+    "08:38:57.034 (14) 2W S 1 E 0 FROM AA9BFA TO 2684DE CMD 00 +0.000 > DATA(06) 01e7c8000000",
+    "08:41:17.156 (11) 2W S 1 E 0 FROM AA9BFA TO 2684DE CMD 03 +0.000 > DATA(03) 030000",
+    // pairing_log_2w_shutter_verbose.txt
+    "17:51:29.353 (09) 2W S 1 E 1 [LPM] FROM AA9BFA TO 00003F CMD 2E +0.000 DATA(01) 00",
+    "17:51:29.740 (17) 1W S 1 E 1 FROM F153FA TO 00003F CMD 39 +383.384 > DATA(09) 000be6fa85353b2b10",
+    "17:51:29.892 (28) 1W S 1 E 1 FROM F153FA TO 00003F CMD 30 +75.195 > DATA(20) 249f715fcae888525b615d2af19dac4802010be7",
+    "17:51:30.067 (21) 1W S 1 E 1 FROM F153FA TO 00003F CMD 20 +87.465 > DATA(13) 02030e00000be87b3ea9da2b32",
+    "17:51:30.419 (08) 2W S 1 E 0 FROM AA9BFA TO CA5321 CMD 2C +105.407 > DATA(00)",
+    "17:51:30.481 (08) 2W S 0 E 1 FROM CA5321 TO AA9BFA CMD 2D +75.094 < DATA(00)",
+    "17:51:34.687 (20) 2W S 1 E 1 [LPM] FROM AA9BFA TO 00003B CMD 2A +0.000 DATA(12) 484bb93e6599f7d513fcb5ee",
+    "17:51:47.701 (09) 2W S 1 E 0 FROM AA9BFA TO 12C47D CMD 2E +0.000 > DATA(01) 02",
+    "17:51:47.762 (14) 2W S 0 E 0 FROM AA9BFA TO 12C47D CMD 3D +82.037 DATA(06) 885cfe56b5b7",
+    "17:51:49.011 (22) 1W S 1 E 1 FROM F153FA TO 00003F CMD 00 +91.265 > DATA(14) 0147000000000bead7b70808bcc5",
+    "17:51:56.143 (08) 2W S 1 E 0 FROM AA9BFA TO 01C9F9 CMD 54 +0.000 > DATA(00)",
+    "17:51:57.496 (08) 2W S 1 E 0 FROM AA9BFA TO E468A9 CMD 56 +0.000 > DATA(00)",
+    "17:51:57.560 (24) 2W S 0 E 1 FROM E468A9 TO AA9BFA CMD 57 +74.853 < DATA(16) 353135393332354130300080030b0000",
+    "17:52:02.119 (09) 2W S 1 E 0 FROM AA9BFA TO 01C9F9 CMD 19 +0.000 > DATA(01) 02",
+    "17:52:05.842 (12) 2W S 1 E 0 FROM AA9BFA TO 01C9F9 CMD 03 +0.000 > DATA(04) 03200100",
+    "17:52:06.413 (08) 2W S 1 E 0 FROM AA9BFA TO 01C9F9 CMD 50 +95.401 > DATA(00)",
+    "17:53:16.238 (22) 2W S 0 E 1 FROM E468A9 TO AA9BFA CMD 04 +74.769 < DATA(14) 0500000000000000f153fa010000",
+    // pairing_plug_after_reset.txt
+    "09:17:20.692 (08) 2W S 1 E 0 [PRIO] FROM AA9BFA TO 5325A9 CMD 36 +0.000 > DATA(00)",
+    "09:17:20.705 (11) 2W S 0 E 0 [PRIO] FROM 5325A9 TO AA9BFA CMD 37 +12.055 DATA(03) 5325a9",
+    "09:17:20.717 (14) 2W S 0 E 0 FROM AA9BFA TO 5325A9 CMD 3C +11.132 DATA(06) 2311204f01c4",
+    "09:17:20.730 (14) 2W S 0 E 1 FROM 5325A9 TO AA9BFA CMD 3D +13.691 < DATA(06) cb20cf0eae1e",
+    "09:17:20.960 (22) 2W S 0 E 1 FROM 5325A9 TO AA9BFA CMD 55 +16.639 < DATA(14) 353133363937344130350300ffff",
+    "09:17:21.430 (24) 2W S 0 E 1 FROM 5325A9 TO AA9BFA CMD 51 +16.885 < DATA(16) 004f4e2f4f464620504c554720696f00",
+    "09:20:07.090 (17) 2W S 1 E 1 FROM D129E4 TO AA9BFA CMD 29 +0.000 DATA(09) 03c0d129e402dc0012",
+    "09:20:07.949 (08) 2W S 1 E 1 FROM AA9BFA TO 00003B CMD 28 +0.000 DATA(00)",
+    "09:20:12.135 (09) 2W S 0 E 1 FROM D129E4 TO AA9BFA CMD 2F +11.962 < DATA(01) 02",
+    "09:35:59.362 (08) 2W S 1 E 0 FROM AA9BFA TO 217E04 CMD 31 +0.000 > DATA(00)",
+    "09:35:59.390 (24) 2W S 0 E 0 FROM AA9BFA TO 217E04 CMD 32 +13.911 DATA(16) 6ca21b8af30d9afbc97f70576115a063",
+    "09:35:59.398 (08) 2W S 0 E 1 FROM 217E04 TO AA9BFA CMD 33 +12.568 < DATA(00)",
+    // pairing_plug_logs.txt
+    "08:45:33.393 (14) 2W S 0 E 0 FROM 06F483 TO AA9BFA CMD 3C +12.821 DATA(06) 842ef50b4f5a",
+    "08:45:34.832 (09) 2W S 0 E 1 FROM BAD662 TO AA9BFA CMD FE +12.105 < DATA(01) 76",
+    "08:45:39.277 (24) 2W S 0 E 1 FROM 2684DE TO AA9BFA CMD 57 +16.401 < DATA(16) 3531323239363341303503c003000000",
+    "08:58:29.330 (22) 2W S 0 E 1 FROM 2684DE TO AA9BFA CMD 04 +16.130 < DATA(14) 0580000000000000aa9bfa010000",
+    "09:10:34.918 (17) 2W S 1 E 1 FROM 2684DE TO AA9BFA CMD 2B +0.000 DATA(09) 03c02684de02dc0a66",
+    "09:10:45.667 (22) 1W S 1 E 1 FROM 65FA9B TO 00003F CMD 20 +114.790 > DATA(14) 02e500000e10595ed79beef313f6",
+    // paring_log_2w_shutter.txt
+    "17:37:45.597 (17) 1W S 1 E 1 FROM F153FA TO 00003F CMD 2E +82.227 > DATA(09) 000bdae4f452d40081",
+    "17:38:23.347 (11) 2W S 1 E 0 FROM AA9BFA TO 01C9F9 CMD 4A +0.000 > DATA(03) 020001",
+};
+
+static const uint8_t controller[3] = {0xAA, 0x9B, 0xFA};
+
+static uint8_t hexNibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return c - 'A' + 10;
+}
+
+static void hexBytes(const char *text, uint8_t *out, size_t len) {
+    for (size_t i = 0; i < len; i++) out[i] = hexNibble(text[2 * i]) << 4 | hexNibble(text[2 * i + 1]);
+}
+
+// Rebuilds the raw frame from its log line; the length logged in brackets is CtrlByte1.MsgLen
+static uint8_t parseCapture(const char *line, uint8_t *frame) {
+    memset(frame, 0, IOHC_FRAME_MAX_LEN);
+    unsigned msgLen = 0, start = 0, end = 0;
+    char way[3] = {};
+    sscanf(strchr(line, '('), "(%u) %2s S %u E %u", &msgLen, way, &start, &end);
+    frame[0] = msgLen | (way[0] == '1' ? FRAME_CB1_ONE_WAY : 0) | (start ? FRAME_CB1_START : 0) |
+               (end ? FRAME_CB1_END : 0);
+    if (strstr(line, "[LPM]")) frame[1] |= FRAME_CB2_LPM;
+    if (strstr(line, "[PRIO]")) frame[1] |= FRAME_CB2_PRIO;
+    hexBytes(strstr(line, " TO ") + 4, frame + 2, 3);
+    hexBytes(strstr(line, "FROM ") + 5, frame + 5, 3);
+    hexBytes(strstr(line, "CMD ") + 4, frame + 8, 1);
+    const char *data = strstr(line, "DATA(");
+    unsigned dataLen = 0;
+    sscanf(data, "DATA(%u)", &dataLen);
+    if (dataLen) hexBytes(strchr(data, ')') + 2, frame + 9, dataLen);
+    return msgLen + 1;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+// Every captured frame decodes, and the protocol length of known commands matches
+void test_views_decode_captures() {
+    uint8_t frame[IOHC_FRAME_MAX_LEN];
+    for (const char *line : captures) {
+        uint8_t len = parseCapture(line, frame);
+        iohcFrameView view(frame, len + 2);
+        TEST_ASSERT_TRUE_MESSAGE(view.valid(), line);
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(len, view.length(), line);
+        int expected = frameParamsLen(view.cmd(), view.oneWay());
+        if (expected >= 0) TEST_ASSERT_TRUE_MESSAGE(view.is(static_cast<FrameCmd>(view.cmd())), line);
+    }
+}
+
+// The generic builder reproduces every captured frame from the view fields
+void test_round_trip_captures() {
+    uint8_t frame[IOHC_FRAME_MAX_LEN];
+    uint8_t rebuilt[IOHC_FRAME_MAX_LEN];
+    for (const char *line : captures) {
+        uint8_t len = parseCapture(line, frame);
+        iohcFrameView view(frame, len);
+        memset(rebuilt, 0xEE, sizeof(rebuilt));
+        iohcFrameBuilder builder(rebuilt, view.cmd());
+        builder.from(view.source()).to(view.target()).oneWay(view.oneWay()).first(view.first()).last(view.last());
+        builder.ctrl2(view.ctrl2()).bytes(view.params(), view.paramsLen());
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(len, builder.finish(), line);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(frame, rebuilt, len, line);
+    }
+}
+
+// Frames sent by the controller come out of the command builders with the flags seen on air
+void test_builders_match_controller_captures() {
+    uint8_t frame[IOHC_FRAME_MAX_LEN];
+    uint8_t built[IOHC_FRAME_MAX_LEN];
+    uint32_t checked = 0;
+    for (const char *line : captures) {
+        uint8_t len = parseCapture(line, frame);
+        iohcFrameView view(frame, len);
+        if (memcmp(view.source(), controller, 3)) continue;
+        const uint8_t *to = view.target();
+        const uint8_t *p = view.params();
+        uint8_t result = 0;
+        switch (static_cast<FrameCmd>(view.cmd())) {
+            case FrameCmd::Execute:
+                result = iohcFrames::execute(built, controller, to, p[0], p[1], view.word(2), p[4], p[5]).finish();
+                break;
+            case FrameCmd::GetStatus: {
+                iohcFrameBuilder builder = iohcFrames::getStatus(built, controller, to, p[0], view.word(1));
+                if (view.paramsLen() == 4) builder.byte(p[3]);
+                result = builder.finish();
+                break;
+            }
+            case FrameCmd::Identify: result = iohcFrames::identify(built, controller, to, view.word(0)).finish(); break;
+            case FrameCmd::Discover: result = iohcFrames::discover(built, controller, to).finish(); break;
+            case FrameCmd::DiscoverRemote: result = iohcFrames::discoverRemote(built, controller, to, p).finish(); break;
+            case FrameCmd::DiscoverActuator: result = iohcFrames::aliveCheck(built, controller, to).finish(); break;
+            case FrameCmd::LearningMode: {
+                iohcFrameBuilder builder = iohcFrames::learningMode(built, controller, to, p[0]);
+                // Broadcast to every 1W remote listening
+                if (view.last()) builder.last().lowPower();
+                result = builder.finish();
+                break;
+            }
+            case FrameCmd::AskChallenge: result = iohcFrames::askChallenge(built, controller, to).finish(); break;
+            case FrameCmd::KeyTransfer: result = iohcFrames::keyTransfer(built, controller, to, p).finish(); break;
+            case FrameCmd::AddressRequest: result = iohcFrames::addressRequest(built, controller, to).finish(); break;
+            case FrameCmd::ChallengeRequest:
+                result = iohcFrames::challengeRequest(built, controller, to, p).finish();
+                break;
+            case FrameCmd::ChallengeAnswer: result = iohcFrames::challengeAnswer(built, controller, to, p).finish(); break;
+            case FrameCmd::GetName: result = iohcFrames::getName(built, controller, to).finish(); break;
+            case FrameCmd::GetGeneralInfo1: result = iohcFrames::getGeneralInfo1(built, controller, to).finish(); break;
+            case FrameCmd::GetGeneralInfo2: result = iohcFrames::getGeneralInfo2(built, controller, to).finish(); break;
+            default: {
+                // Commands without a builder of their own
+                iohcFrameBuilder builder = iohcFrames::request(built, static_cast<FrameCmd>(view.cmd()), controller, to);
+                result = builder.bytes(p, view.paramsLen()).finish();
+                break;
+            }
+        }
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(len, result, line);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(frame, built, len, line);
+        checked++;
+    }
+    TEST_ASSERT_TRUE(checked >= 20);
+}
+
+// Authenticated 1W frames: sequence and MAC close the frame, the MAC covers command and parameters
+void test_1w_builders() {
+    const uint8_t remote[3] = {0xF1, 0x53, 0xFA};
+    const uint8_t all[3] = {0x00, 0x00, 0x3F};
+    uint8_t frame[IOHC_FRAME_MAX_LEN];
+    uint8_t built[IOHC_FRAME_MAX_LEN];
+
+    uint8_t len = parseCapture(captures[17], frame);
+    iohcExecuteView execute(frame, len);
+    TEST_ASSERT_TRUE(execute.valid());
+    TEST_ASSERT_EQUAL_UINT8(0x47, execute.acei());
+    TEST_ASSERT_FALSE(execute.hasData());
+    TEST_ASSERT_EQUAL_HEX16(0x0bea, execute.sequence());
+    const uint8_t mac[6] = {0xd7, 0xb7, 0x08, 0x08, 0xbc, 0xc5};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(mac, execute.mac(), 6);
+    TEST_ASSERT_EQUAL_UINT8(7, execute.macInputLen());
+
+    iohcFrameBuilder builder = iohcFrames::execute1W(built, remote, all, 0x01, 0x47, 0x0000);
+    TEST_ASSERT_EQUAL_UINT8(7, builder.macInputLen());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(execute.macInput(), builder.macInput(), 7);
+    TEST_ASSERT_EQUAL_UINT8(len, builder.sequence(0x0bea).mac(mac).finish());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, built, len);
+
+    len = parseCapture(captures[9], frame);
+    iohcAuth1WView remove(frame, len);
+    TEST_ASSERT_TRUE(remove.valid());
+    TEST_ASSERT_EQUAL_HEX16(0x0be6, remove.sequence());
+    TEST_ASSERT_EQUAL_UINT8(len, iohcFrames::removeController1W(built, remote, all).sequence(0x0be6)
+                                     .mac(remove.mac()).finish());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, built, len);
+
+    len = parseCapture(captures[43], frame);
+    iohcAuth1WView pair(frame, len);
+    TEST_ASSERT_TRUE(pair.valid());
+    TEST_ASSERT_EQUAL_UINT8(len, iohcFrames::learningMode1W(built, remote, all).sequence(0x0bda)
+                                     .mac(pair.mac()).finish());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, built, len);
+
+    len = parseCapture(captures[10], frame);
+    iohcKeyTransferView key(frame, len);
+    TEST_ASSERT_TRUE(key.valid());
+    TEST_ASSERT_EQUAL_UINT8(2, key.manufacturer());
+    TEST_ASSERT_EQUAL_UINT8(1, key.data());
+    TEST_ASSERT_EQUAL_HEX16(0x0be7, key.sequence());
+    TEST_ASSERT_EQUAL_UINT8(len, iohcFrames::keyTransfer1W(built, remote, all, key.key(), 2, 1, 0x0be7).finish());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, built, len);
+}
+
+void test_typed_views() {
+    uint8_t frame[IOHC_FRAME_MAX_LEN];
+
+    uint8_t len = parseCapture(captures[31], frame);
+    iohcDiscoverAnswerView discovered(frame, len);
+    TEST_ASSERT_TRUE(discovered.valid());
+    TEST_ASSERT_EQUAL_UINT16(15, discovered.nodeType());
+    TEST_ASSERT_EQUAL_UINT8(0, discovered.nodeSubtype());
+    const uint8_t backbone[3] = {0xd1, 0x29, 0xe4};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(backbone, discovered.backbone(), 3);
+    TEST_ASSERT_EQUAL_UINT8(0x02, discovered.manufacturer());
+    TEST_ASSERT_EQUAL_HEX8(0xdc, discovered.multiInfo());
+    TEST_ASSERT_EQUAL_HEX16(0x0012, discovered.timestamp());
+
+    len = parseCapture(captures[30], frame);
+    iohcNameView name(frame, len);
+    TEST_ASSERT_TRUE(name.valid());
+    // Leading zero byte: the name starts after it on this device
+    TEST_ASSERT_EQUAL_UINT8(0, name.nameLen());
+    TEST_ASSERT_EQUAL_STRING_LEN("ON/OFF PLUG io", name.name() + 1, 14);
+
+    len = parseCapture(captures[26], frame);
+    iohcAddressAnswerView address(frame, len);
+    TEST_ASSERT_TRUE(address.valid());
+    TEST_ASSERT_TRUE(address.priority());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame + 5, address.address(), 3);
+
+    len = parseCapture(captures[1], frame);
+    iohcChallengeView challenge(frame, len);
+    TEST_ASSERT_TRUE(challenge.valid());
+    TEST_ASSERT_EQUAL_HEX8(0x40, challenge.challenge()[0]);
+
+    len = parseCapture(captures[5], frame);
+    iohcInfoView status(frame, len);
+    TEST_ASSERT_TRUE(status.valid());
+    TEST_ASSERT_EQUAL_UINT8(14, status.infoLen());
+    TEST_ASSERT_FALSE(iohcChallengeView(frame, len).valid());
+
+    len = parseCapture(captures[6], frame);
+    iohcExecuteView execute(frame, len);
+    TEST_ASSERT_TRUE(execute.valid());
+    TEST_ASSERT_EQUAL_HEX16(0xc800, execute.main());
+}
+
+// A truncated or inconsistent frame is rejected before anything is read
+void test_malformed() {
+    uint8_t frame[IOHC_FRAME_MAX_LEN];
+    uint8_t len = parseCapture(captures[1], frame);
+    TEST_ASSERT_FALSE(iohcFrameView(frame, len - 1).valid());
+    TEST_ASSERT_FALSE(iohcFrameView(frame, 4).valid());
+    // 0x3C with 5 bytes of challenge
+    frame[0] = (frame[0] & ~0x1F) | (len - 2);
+    TEST_ASSERT_TRUE(iohcFrameView(frame, len).valid());
+    TEST_ASSERT_FALSE(iohcChallengeView(frame, len).valid());
+}
+
+void test_overflow() {
+    uint8_t frame[IOHC_FRAME_MAX_LEN];
+    const uint8_t data[24] = {};
+    TEST_ASSERT_EQUAL_UINT8(32, iohcFrames::writePrivate(frame, controller, controller, data, 23).finish());
+    TEST_ASSERT_EQUAL_UINT8(0, iohcFrames::writePrivate(frame, controller, controller, data, 24).finish());
+    TEST_ASSERT_EQUAL_UINT8(25, iohcFrames::setName(frame, controller, controller, "io").finish());
+    TEST_ASSERT_EQUAL_UINT8(0, frame[11]);
+}
+
+static constexpr uint8_t target[3] = {0x26, 0x84, 0xDE};
+
+struct Built {
+    uint8_t frame[IOHC_FRAME_MAX_LEN]{};
+    uint8_t length = 0;
+};
+
+static constexpr Built buildOn() {
+    Built built;
+    built.length = iohcFrames::execute(built.frame, controller, target, 0x01, 0xE7, 0xC800).finish();
+    return built;
+}
+
+// Everything above is usable at compile time: a frame checked by the compiler
+void test_constexpr() {
+    constexpr Built on = buildOn();
+    static_assert(on.length == 15, "execute is 9 + 6 bytes");
+    static_assert(on.frame[0] == 0x4E && on.frame[1] == 0x00, "S1 E0, MsgLen 14");
+    static_assert(iohcExecuteView(on.frame, on.length).valid(), "decodes");
+    static_assert(iohcExecuteView(on.frame, on.length).main() == 0xC800, "main parameter");
+    TEST_ASSERT_EQUAL_UINT8(15, on.length);
+}
+
+void test_zero_heap() {
+    uint8_t frame[IOHC_FRAME_MAX_LEN];
+    uint8_t built[IOHC_FRAME_MAX_LEN];
+    uint32_t frames = 0;
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < 1000; i++) {
+        for (const char *line : captures) {
+            uint8_t len = parseCapture(line, frame);
+            iohcFrameView view(frame, len);
+            iohcFrameBuilder builder(built, view.cmd());
+            builder.from(view.source()).to(view.target()).oneWay(view.oneWay()).first(view.first());
+            frames += builder.last(view.last()).ctrl2(view.ctrl2()).bytes(view.params(), view.paramsLen()).finish()
+                          ? 1 : 0;
+            iohcNameView(frame, len).valid();
+            iohcDiscoverAnswerView(frame, len).valid();
+        }
+    }
+    counting = false;
+    printf("  %u frames built and viewed: %ld allocations\n", frames, allocations.load());
+    TEST_ASSERT_EQUAL(0, allocations.load());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_views_decode_captures);
+    RUN_TEST(test_round_trip_captures);
+    RUN_TEST(test_builders_match_controller_captures);
+    RUN_TEST(test_1w_builders);
+    RUN_TEST(test_typed_views);
+    RUN_TEST(test_malformed);
+    RUN_TEST(test_overflow);
+    RUN_TEST(test_constexpr);
+    RUN_TEST(test_zero_heap);
+    return UNITY_END();
+}
@@ -0,0 +1,235 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <iohcFrameTemplates.h>
+#include "../heap_accounting.h"
+
+using namespace IOHC;
+
+static const uint8_t node[3] = {0xF1, 0x53, 0xFA};
+static const uint8_t key[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                                0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16};
+static const uint16_t typn = 0x0000;
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static uint32_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// A template is the frame remote::cmd() used to build: broadcast to the type, low power, sequence and 1W MAC
+void test_build() {
+    const uint16_t actions[] = {0x0000, 0xc800, 0xd200, 0xd803, 0x6400};
+    for (uint8_t a = 0; a < static_cast<uint8_t>(Action1W::Count); a++) {
+        uint8_t frame[IOHC_1W_TEMPLATE_LEN];
+        TEST_ASSERT_EQUAL_UINT8(23, iohcFrameTemplates::build(node, key, 0x0003, 0x0bea, static_cast<Action1W>(a), frame));
+
+        iohcExecuteView execute(frame, 23);
+        TEST_ASSERT_TRUE(execute.valid());
+        TEST_ASSERT_EQUAL_HEX8(0xF6, frame[0]);
+        TEST_ASSERT_EQUAL_HEX8(0x20, frame[1]);
+        const uint8_t target[3] = {0x00, 0x00, 0xFF};
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(target, execute.target(), 3);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(node, execute.source(), 3);
+        TEST_ASSERT_EQUAL_UINT8(0x01, execute.originator());
+        TEST_ASSERT_EQUAL_UINT8(0x43, execute.acei());
+        TEST_ASSERT_EQUAL_HEX16(actions[a], execute.main());
+        TEST_ASSERT_EQUAL_HEX16(0x0bea, execute.sequence());
+
+        const uint8_t seq[2] = {0x0b, 0xea};
+        uint8_t hmac[16];
+        iohcCrypto::create_1W_hmac(hmac, seq, key, execute.macInput(), execute.macInputLen());
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(hmac, execute.mac(), HMAC_1W_LENGTH);
+    }
+}
+
+// Only the exact node, key, type and sequence get the ready frame
+void test_hit_and_miss() {
+    iohcFrameTemplates templates;
+    TEST_ASSERT_TRUE(templates.track(node, key, typn, 100));
+    TEST_ASSERT_EQUAL(0, templates.ready());
+    TEST_ASSERT_EQUAL(5, templates.precompute());
+    TEST_ASSERT_EQUAL(5, templates.ready());
+    TEST_ASSERT_EQUAL(0, templates.precompute());
+
+    uint8_t frame[IOHC_1W_TEMPLATE_LEN];
+    uint8_t expected[IOHC_1W_TEMPLATE_LEN];
+    bool hit = false;
+    TEST_ASSERT_EQUAL_UINT8(23, templates.take(node, key, typn, 100, Action1W::Close, frame, &hit));
+    TEST_ASSERT_TRUE(hit);
+    iohcFrameTemplates::build(node, key, typn, 100, Action1W::Close, expected);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame, 23);
+
+    // Another sequence, key or type than the template's: built on the spot, still right
+    TEST_ASSERT_EQUAL_UINT8(23, templates.take(node, key, typn, 101, Action1W::Close, frame, &hit));
+    TEST_ASSERT_FALSE(hit);
+    iohcFrameTemplates::build(node, key, typn, 101, Action1W::Close, expected);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame, 23);
+
+    uint8_t other[16];
+    memcpy(other, key, 16);
+    other[15] ^= 1;
+    templates.take(node, other, typn, 100, Action1W::Close, frame, &hit);
+    TEST_ASSERT_FALSE(hit);
+    templates.take(node, key, 0x0003, 100, Action1W::Close, frame, &hit);
+    TEST_ASSERT_FALSE(hit);
+    const uint8_t stranger[3] = {0x12, 0x34, 0x56};
+    templates.take(stranger, key, typn, 100, Action1W::Close, frame, &hit);
+    TEST_ASSERT_FALSE(hit);
+
+    FrameTemplateStats stats = templates.stats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.hits);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.misses);
+    TEST_ASSERT_EQUAL_UINT32(5, stats.built);
+}
+
+// A new sequence number or key drops the ready frames; an unchanged remote keeps them
+void test_invalidation() {
+    iohcFrameTemplates templates;
+    templates.track(node, key, typn, 7);
+    templates.precompute();
+    templates.track(node, key, typn, 7);
+    TEST_ASSERT_EQUAL(5, templates.ready());
+
+    templates.track(node, key, typn, 8);
+    TEST_ASSERT_EQUAL(0, templates.ready());
+    TEST_ASSERT_EQUAL_UINT32(5, templates.stats().invalidated);
+
+    templates.precompute();
+    uint8_t other[16] = {0xaa};
+    templates.track(node, other, typn, 8);
+    TEST_ASSERT_EQUAL(0, templates.ready());
+    templates.precompute();
+    templates.track(node, other, 0x0003, 8);
+    TEST_ASSERT_EQUAL(0, templates.ready());
+    TEST_ASSERT_EQUAL_UINT32(15, templates.stats().invalidated);
+
+    templates.precompute();
+    bool hit = false;
+    uint8_t frame[IOHC_1W_TEMPLATE_LEN];
+    templates.take(node, other, 0x0003, 8, Action1W::Stop, frame, &hit);
+    TEST_ASSERT_TRUE(hit);
+
+    templates.forget(node);
+    TEST_ASSERT_EQUAL(0, templates.ready());
+    templates.take(node, other, 0x0003, 8, Action1W::Stop, frame, &hit);
+    TEST_ASSERT_FALSE(hit);
+}
+
+// Every slot taken: the next remote is not tracked and always built on the spot
+void test_capacity_and_budget() {
+    iohcFrameTemplates templates;
+    uint8_t address[3] = {0x10, 0x00, 0x00};
+    for (int i = 0; i < IOHC_1W_TEMPLATE_REMOTES; i++) {
+        address[2] = i;
+        TEST_ASSERT_TRUE(templates.track(address, key, typn, i));
+    }
+    address[2] = IOHC_1W_TEMPLATE_REMOTES;
+    TEST_ASSERT_FALSE(templates.track(address, key, typn, 0));
+    address[2] = 0;
+    templates.forget(address);
+    address[2] = IOHC_1W_TEMPLATE_REMOTES;
+    TEST_ASSERT_TRUE(templates.track(address, key, typn, 0));
+
+    // One frame per idle pass, as the main loop does
+    TEST_ASSERT_EQUAL(1, templates.precompute(1));
+    TEST_ASSERT_EQUAL(1, templates.ready());
+    TEST_ASSERT_EQUAL(3, templates.precompute(3));
+    TEST_ASSERT_EQUAL(4, templates.ready());
+    TEST_ASSERT_EQUAL(IOHC_1W_TEMPLATE_REMOTES * 5 - 4, templates.precompute());
+}
+
+void test_zero_heap() {
+    iohcFrameTemplates templates;
+    templates.track(node, key, typn, 1);
+    uint8_t frame[IOHC_1W_TEMPLATE_LEN];
+    allocations = 0;
+    counting = true;
+    templates.precompute();
+    for (uint16_t seq = 1; seq < 50; seq++) {
+        templates.take(node, key, typn, seq, Action1W::Open, frame);
+        templates.track(node, key, typn, seq + 1);
+        templates.precompute(2);
+    }
+    counting = false;
+    TEST_ASSERT_EQUAL(0, allocations.load());
+}
+
+// Press-to-frame latency with and without a ready template, through the histograms cmd() feeds
+void test_latency() {
+    iohcFrameTemplates templates;
+    const int presses = 20000;
+    uint8_t frame[IOHC_1W_TEMPLATE_LEN];
+    uint16_t seq = 0;
+    templates.track(node, key, typn, seq);
+    templates.precompute();
+
+    double hitNs = 0, missNs = 0;
+    for (int i = 0; i < presses; i++) {
+        bool hit = false;
+        // Hit: the idle pass ran since the previous press
+        auto start = std::chrono::steady_clock::now();
+        templates.take(node, key, typn, seq, Action1W::Open, frame, &hit);
+        templates.recordLatency(hit, elapsedUs(start));
+        hitNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        TEST_ASSERT_TRUE(hit);
+        templates.track(node, key, typn, ++seq);
+
+        // Miss: pressed again before the idle pass
+        start = std::chrono::steady_clock::now();
+        templates.take(node, key, typn, seq, Action1W::Close, frame, &hit);
+        templates.recordLatency(hit, elapsedUs(start));
+        missNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        TEST_ASSERT_FALSE(hit);
+        templates.track(node, key, typn, ++seq);
+        templates.precompute();
+    }
+
+    FrameTemplateStats stats = templates.stats();
+    TEST_ASSERT_EQUAL_UINT32(presses, stats.hit.count);
+    TEST_ASSERT_EQUAL_UINT32(presses, stats.miss.count);
+    TEST_ASSERT_TRUE(stats.hit.percentileUs(50) <= stats.hit.percentileUs(99));
+    TEST_ASSERT_TRUE(hitNs < missNs);
+    printf("  hit  %6.1f ns avg, p50 <%u us, p99 <%u us, max %u us\n", hitNs / presses, stats.hit.percentileUs(50),
+           stats.hit.percentileUs(99), stats.hit.maxUs);
+    printf("  miss %6.1f ns avg, p50 <%u us, p99 <%u us, max %u us\n", missNs / presses, stats.miss.percentileUs(50),
+           stats.miss.percentileUs(99), stats.miss.maxUs);
+
+    templates.resetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, templates.stats().hit.count);
+}
+
+void test_histogram() {
+    LatencyHistogram h{};
+    TEST_ASSERT_EQUAL(0, LatencyHistogram::bucket(0));
+    TEST_ASSERT_EQUAL(1, LatencyHistogram::bucket(1));
+    TEST_ASSERT_EQUAL(2, LatencyHistogram::bucket(3));
+    TEST_ASSERT_EQUAL(IOHC_LATENCY_BUCKETS - 1, LatencyHistogram::bucket(UINT32_MAX));
+    for (uint32_t us = 1; us <= 100; us++) h.add(us);
+    TEST_ASSERT_EQUAL_UINT32(1, h.minUs);
+    TEST_ASSERT_EQUAL_UINT32(100, h.maxUs);
+    TEST_ASSERT_EQUAL_UINT32(50, h.meanUs());
+    TEST_ASSERT_EQUAL_UINT32(64, h.percentileUs(50));
+    TEST_ASSERT_EQUAL_UINT32(128, h.percentileUs(99));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_build);
+    RUN_TEST(test_hit_and_miss);
+    RUN_TEST(test_invalidation);
+    RUN_TEST(test_capacity_and_budget);
+    RUN_TEST(test_zero_heap);
+    RUN_TEST(test_histogram);
+    RUN_TEST(test_latency);
+    return UNITY_END();
+}
@@ -0,0 +1,248 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <thread>
+#include <iohcJsonArena.h>
+#include "../heap_accounting.h"
+
+using namespace IOHC;
+
+// The heap allocator ArduinoJson uses by default, counting what it is asked for
+struct HeapAllocator {
+    long calls = 0;
+    void *allocate(size_t size) { calls++; return malloc(size); }
+    void deallocate(void *p) { free(p); }
+    void *reallocate(void *p, size_t size) { calls++; return realloc(p, size); }
+};
+
+/*
+    The calls ArduinoJson 7 makes for the frame publishMsg builds: a slot pool, the pool list, each string copied
+    in and grown while it is built, then everything freed when the document goes.
+*/
+template <typename Allocator>
+static size_t buildFrame(Allocator &allocator, char *out, size_t size, int frame) {
+    void *pool = allocator.allocate(1024);
+    void *pools = allocator.allocate(4 * sizeof(void *));
+    void *strings[6];
+    char text[64];
+    static const char *const keys[] = {"type", "from", "to", "cmd", "_data", "action"};
+    snprintf(text, sizeof(text), "1W|123456|%06x|00|0143000000000000|open", frame & 0xFFFFFF);
+    size_t length = 0;
+    for (size_t k = 0; k < 6; k++) {
+        // StringBuilder: 31 bytes first, doubled as needed, shrunk to the final length
+        char *s = static_cast<char *>(allocator.allocate(31));
+        size_t capacity = 31;
+        const size_t need = strlen(text) + k;
+        while (need > capacity) s = static_cast<char *>(allocator.reallocate(s, capacity *= 2));
+        memset(s, 'a' + k, need);
+        s = static_cast<char *>(allocator.reallocate(s, need));
+        strings[k] = s;
+        length += snprintf(out + length, size - length, "%s%.*s", keys[k], static_cast<int>(need), s);
+    }
+    for (size_t k = 6; k-- > 0;) allocator.deallocate(strings[k]);
+    allocator.deallocate(pools);
+    allocator.deallocate(pool);
+    return length;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_bump_and_pop() {
+    iohcJsonArena arena(1024);
+    void *a = arena.allocate(10);
+    void *b = arena.allocate(24);
+    TEST_ASSERT_TRUE(arena.owns(a) && arena.owns(b));
+    TEST_ASSERT_EQUAL(0, reinterpret_cast<uintptr_t>(a) % iohcJsonArena::ALIGN);
+    TEST_ASSERT_EQUAL(0, reinterpret_cast<uintptr_t>(b) % iohcJsonArena::ALIGN);
+    const size_t used = arena.used();
+
+    // Only the last block goes back
+    arena.deallocate(a);
+    TEST_ASSERT_EQUAL(used, arena.used());
+    arena.deallocate(b);
+    TEST_ASSERT_TRUE(arena.used() < used);
+    TEST_ASSERT_EQUAL(2, arena.stats().allocations);
+    TEST_ASSERT_EQUAL(0, arena.stats().fallbacks);
+}
+
+void test_reallocate() {
+    iohcJsonArena arena(1024);
+    char *s = static_cast<char *>(arena.allocate(31));
+    memcpy(s, "keep", 5);
+    // The last block grows and shrinks in place
+    TEST_ASSERT_EQUAL_PTR(s, arena.reallocate(s, 62));
+    TEST_ASSERT_EQUAL_PTR(s, arena.reallocate(s, 124));
+    TEST_ASSERT_EQUAL_PTR(s, arena.reallocate(s, 5));
+    const size_t used = arena.used();
+
+    // Not the last one: moved when growing, kept when shrinking
+    char *t = static_cast<char *>(arena.allocate(16));
+    TEST_ASSERT_EQUAL_PTR(s, arena.reallocate(s, 4));
+    char *moved = static_cast<char *>(arena.reallocate(s, 64));
+    TEST_ASSERT_TRUE(moved != s);
+    TEST_ASSERT_TRUE(arena.owns(moved));
+    TEST_ASSERT_EQUAL_STRING("keep", moved);
+    TEST_ASSERT_TRUE(arena.used() > used);
+    (void) t;
+}
+
+// Too big for what is left: the heap, freed by whoever frees it
+void test_fallback() {
+    iohcJsonArena arena(256);
+    void *a = arena.allocate(200);
+    void *b = arena.allocate(200);
+    TEST_ASSERT_TRUE(arena.owns(a));
+    TEST_ASSERT_FALSE(arena.owns(b));
+    TEST_ASSERT_EQUAL(1, arena.stats().fallbacks);
+    b = arena.reallocate(b, 400);
+    TEST_ASSERT_FALSE(arena.owns(b));
+    arena.deallocate(b);
+
+    // Grown out of the arena
+    arena.deallocate(a);
+    char *s = static_cast<char *>(arena.allocate(100));
+    strcpy(s, "moved");
+    char *big = static_cast<char *>(arena.reallocate(s, 1000));
+    TEST_ASSERT_FALSE(arena.owns(big));
+    TEST_ASSERT_EQUAL_STRING("moved", big);
+    TEST_ASSERT_EQUAL(0, arena.used());
+    arena.deallocate(big);
+    TEST_ASSERT_EQUAL(2, arena.stats().fallbacks);
+}
+
+void test_scopes() {
+    iohcJsonArena arena(2048);
+    {
+        JsonScratch outer(arena);
+        arena.allocate(100);
+        const size_t used = arena.used();
+        {
+            JsonScratch inner(arena);
+            arena.allocate(300);
+            TEST_ASSERT_NOT_NULL(inner.buffer(200));
+            // Bigger than the arena: from the heap, freed with the scope
+            TEST_ASSERT_NOT_NULL(inner.buffer(4096));
+        }
+        TEST_ASSERT_EQUAL(used, arena.used());
+    }
+    TEST_ASSERT_EQUAL(0, arena.used());
+    TEST_ASSERT_EQUAL(2, arena.stats().scopes);
+}
+
+void test_local_per_thread() {
+    iohcJsonArena *mine = &iohcJsonArena::local();
+    TEST_ASSERT_EQUAL_PTR(mine, &iohcJsonArena::local());
+    iohcJsonArena *other = nullptr;
+    std::thread([&other] { other = &iohcJsonArena::local(); }).join();
+    TEST_ASSERT_TRUE(other != mine);
+    size_t listed = 0;
+    iohcJsonArena::each([&listed](iohcJsonArena &) { listed++; });
+    TEST_ASSERT_EQUAL(2, listed);
+}
+
+// Same output, and the heap only while the arena warms up
+void test_allocations_per_frame() {
+    const int frames = 1000;
+    char expected[512], got[512];
+    HeapAllocator heap;
+    iohcJsonArena &arena = iohcJsonArena::local();
+    arena.resetStats();
+
+    allocations = 0;
+    counting = true;
+    for (int frame = 0; frame < frames; frame++) {
+        const size_t length = buildFrame(heap, expected, sizeof(expected), frame);
+        JsonScratch scratch;
+        char *out = scratch.buffer(length + 1);
+        TEST_ASSERT_NOT_NULL(out);
+        TEST_ASSERT_EQUAL(length, buildFrame(arena, got, sizeof(got), frame));
+        memcpy(out, got, length + 1);
+        TEST_ASSERT_EQUAL_STRING(expected, out);
+    }
+    counting = false;
+
+    JsonArenaStats stats = arena.stats();
+    TEST_ASSERT_EQUAL(0, allocations.load());
+    TEST_ASSERT_EQUAL_UINT32(0, stats.fallbacks);
+    TEST_ASSERT_EQUAL(0, arena.used());
+    TEST_ASSERT_TRUE(stats.peak <= JSON_ARENA_SIZE);
+    printf("  heap allocations per frame: default %.1f, arena %.1f (peak %u of %u bytes)\n",
+           static_cast<double>(heap.calls) / frames, static_cast<double>(stats.fallbacks) / frames, stats.peak,
+           JSON_ARENA_SIZE);
+}
+
+#ifdef ARDUINOJSON_VERSION
+struct CountingAllocator : ArduinoJson::Allocator {
+    long calls = 0;
+    void *allocate(size_t size) override { calls++; return malloc(size); }
+    void deallocate(void *p) override { free(p); }
+    void *reallocate(void *p, size_t size) override { calls++; return realloc(p, size); }
+};
+
+template <typename Doc>
+static void fillFrame(Doc &doc, int frame) {
+    char from[7];
+    snprintf(from, sizeof(from), "%06x", frame & 0xFFFFFF);
+    doc["type"] = "1W";
+    doc["from"] = std::string(from);
+    doc["to"] = std::string("123456");
+    doc["cmd"] = std::string("00");
+    doc["_data"] = std::string("0143000000000000");
+    doc["action"] = "open";
+    JsonArray devices = doc["devices"].template to<JsonArray>();
+    for (int i = 0; i < 4; i++) {
+        JsonObject d = devices.add<JsonObject>();
+        d["id"] = std::string(from);
+        d["position"] = i * 25;
+    }
+}
+
+// ArduinoJson itself: the output of publishMsg and the /api documents does not depend on the allocator
+void test_arduinojson_identical() {
+    const int frames = 500;
+    CountingAllocator heap;
+    iohcJsonArena &arena = iohcJsonArena::local();
+    arena.resetStats();
+    std::string expected;
+    for (int frame = 0; frame < frames; frame++) {
+        expected.clear();
+        {
+            JsonDocument doc(&heap);
+            fillFrame(doc, frame);
+            serializeJson(doc, expected);
+        }
+        JsonScratch scratch;
+        JsonDocument doc(scratch.allocator());
+        fillFrame(doc, frame);
+        const size_t length = measureJson(doc);
+        char *out = scratch.buffer(length + 1);
+        TEST_ASSERT_EQUAL(length, serializeJson(doc, out, length + 1));
+        TEST_ASSERT_EQUAL_STRING(expected.c_str(), out);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, arena.stats().fallbacks);
+    printf("  ArduinoJson %s allocations per document: default %.1f, arena heap %.1f\n", ARDUINOJSON_VERSION,
+           static_cast<double>(heap.calls) / frames, static_cast<double>(arena.stats().fallbacks) / frames);
+}
+#endif
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_bump_and_pop);
+    RUN_TEST(test_reallocate);
+    RUN_TEST(test_fallback);
+    RUN_TEST(test_scopes);
+    RUN_TEST(test_local_per_thread);
+    RUN_TEST(test_allocations_per_frame);
+#ifdef ARDUINOJSON_VERSION
+    RUN_TEST(test_arduinojson_identical);
+#endif
+    return UNITY_END();
+}
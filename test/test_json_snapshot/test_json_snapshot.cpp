@@ -0,0 +1,188 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <iohcJsonSnapshot.h>
+
+using namespace IOHC;
+
+// /api/devices as handleApiDevices writes it
+struct Remote {
+    std::string id;
+    std::string name;
+    int position;
+};
+
+static std::string devicesBody(const std::vector<Remote> &remotes) {
+    std::string body = "[";
+    char entry[160];
+    for (size_t i = 0; i < remotes.size(); i++) {
+        snprintf(entry, sizeof(entry), "%s{\"id\":\"%s\",\"name\":\"%s\",\"description\":\"Roller shutter\","
+                 "\"position\":%d,\"travel_time\":30}", i ? "," : "", remotes[i].id.c_str(), remotes[i].name.c_str(),
+                 remotes[i].position);
+        body += entry;
+    }
+    return body + "]";
+}
+
+static uint64_t devicesKey(uint32_t version, const std::vector<Remote> &remotes) {
+    uint64_t key = iohcJsonSnapshot::digest(&version, sizeof(version));
+    for (const auto &r : remotes) key = iohcJsonSnapshot::digest(&r.position, sizeof(r.position), key);
+    return key;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_if_none_match() {
+    const char *etag = "\"00000000deadbeef\"";
+    TEST_ASSERT_FALSE(iohcJsonSnapshot::matches(nullptr, etag));
+    TEST_ASSERT_FALSE(iohcJsonSnapshot::matches("", etag));
+    TEST_ASSERT_TRUE(iohcJsonSnapshot::matches("\"00000000deadbeef\"", etag));
+    TEST_ASSERT_TRUE(iohcJsonSnapshot::matches("W/\"00000000deadbeef\"", etag));
+    TEST_ASSERT_TRUE(iohcJsonSnapshot::matches("\"0000000000000001\", \"00000000deadbeef\" ", etag));
+    TEST_ASSERT_TRUE(iohcJsonSnapshot::matches("*", etag));
+    TEST_ASSERT_FALSE(iohcJsonSnapshot::matches("\"0000000000000001\"", etag));
+    TEST_ASSERT_FALSE(iohcJsonSnapshot::matches("00000000deadbeef", etag));
+    TEST_ASSERT_FALSE(iohcJsonSnapshot::matches("\"00000000deadbeef", etag));
+}
+
+// One build per key, the ETag follows the bytes and not the key
+void test_build_once_per_key() {
+    iohcJsonSnapshot snapshot;
+    int builds = 0;
+    std::string text = "[1,2,3]";
+    auto build = [&](std::string &body) {
+        builds++;
+        body = text;
+    };
+    iohcJsonSnapshot::Reply first = snapshot.serve(1, nullptr, build);
+    TEST_ASSERT_FALSE(first.notModified);
+    TEST_ASSERT_EQUAL_STRING("[1,2,3]", first.body->c_str());
+    TEST_ASSERT_EQUAL(18, strlen(first.etag));
+    TEST_ASSERT_EQUAL('"', first.etag[0]);
+    iohcJsonSnapshot::Reply again = snapshot.serve(1, nullptr, build);
+    TEST_ASSERT_EQUAL(1, builds);
+    TEST_ASSERT_EQUAL_PTR(first.body.get(), again.body.get());
+
+    // Saved without a change: rebuilt, same ETag
+    iohcJsonSnapshot::Reply same = snapshot.serve(2, first.etag, build);
+    TEST_ASSERT_EQUAL(2, builds);
+    TEST_ASSERT_TRUE(same.notModified);
+    TEST_ASSERT_EQUAL_STRING(first.etag, same.etag);
+
+    // The body still being sent is kept by its reply
+    text = "[4]";
+    iohcJsonSnapshot::Reply changed = snapshot.serve(3, first.etag, build);
+    TEST_ASSERT_FALSE(changed.notModified);
+    TEST_ASSERT_TRUE(strcmp(first.etag, changed.etag) != 0);
+    TEST_ASSERT_EQUAL_STRING("[1,2,3]", first.body->c_str());
+    TEST_ASSERT_EQUAL_STRING("[4]", changed.body->c_str());
+}
+
+void test_stats() {
+    iohcJsonSnapshot snapshot;
+    auto build = [](std::string &body) { body.assign(100, 'x'); };
+    iohcJsonSnapshot::Reply reply = snapshot.serve(7, nullptr, build);
+    snapshot.serve(7, nullptr, build);
+    iohcJsonSnapshot::Reply cached = snapshot.serve(7, reply.etag, build);
+    TEST_ASSERT_TRUE(cached.notModified);
+    TEST_ASSERT_NULL(cached.body.get());
+
+    SnapshotStats stats = snapshot.stats();
+    TEST_ASSERT_EQUAL_UINT32(3, stats.requests);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.builds);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.hits);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.notModified);
+    TEST_ASSERT_EQUAL_UINT64(200, stats.bytesSent);
+    TEST_ASSERT_EQUAL_UINT64(100, stats.bytesSaved);
+    snapshot.resetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, snapshot.stats().requests);
+}
+
+/*
+    3 dashboards polling /api/devices every 2 s for 10 min, on simulated time, 20 remotes. Covers move now and then
+    (their position changes on every poll while moving) and a remote gets renamed twice. Each dashboard sends back
+    the ETag of its last 200. Before, every poll serialized and sent the whole list.
+*/
+void test_dashboard_polling() {
+    const int dashboards = 3, remotes = 20;
+    const int64_t pollMs = 2000, durationMs = 10 * 60 * 1000;
+
+    std::vector<Remote> table;
+    char id[7], name[16];
+    for (int i = 0; i < remotes; i++) {
+        snprintf(id, sizeof(id), "%06x", 0xA00000 + i);
+        snprintf(name, sizeof(name), "Shutter %d", i + 1);
+        table.push_back({id, name, 100});
+    }
+    // Cover moves: device, start, 0 to 100 or back in 30 s
+    const struct { int device; int64_t startMs; int to; } moves[] = {
+        {0, 60000, 0}, {3, 61000, 0}, {7, 200000, 50}, {0, 400000, 100}, {12, 450000, 0},
+    };
+    // Renames, each a save of the remotes file
+    const int64_t renamesMs[] = {120000, 500000};
+    uint32_t version = 1;
+
+    iohcJsonSnapshot snapshot;
+    uint32_t builds = 0;
+    uint64_t uncachedBytes = 0;
+    std::vector<std::string> etags(dashboards);
+    std::vector<int> from(sizeof(moves) / sizeof(moves[0]), -1);
+    for (int64_t now = 0; now < durationMs; now += 100) {
+        for (size_t m = 0; m < sizeof(moves) / sizeof(moves[0]); m++) {
+            const int64_t elapsed = now - moves[m].startMs;
+            if (elapsed < 0 || elapsed > 30000) continue;
+            Remote &r = table[moves[m].device];
+            if (from[m] < 0) from[m] = r.position;
+            r.position = from[m] + static_cast<int>((moves[m].to - from[m]) * elapsed / 30000);
+        }
+        for (int64_t rename : renamesMs)
+            if (now == rename) {
+                table[5].name += " (upstairs)";
+                version++;
+            }
+        for (int d = 0; d < dashboards; d++) {
+            // Dashboards opened a few hundred ms apart
+            if ((now - d * 300) % pollMs) continue;
+            const std::string expected = devicesBody(table);
+            uncachedBytes += expected.size();
+            iohcJsonSnapshot::Reply reply = snapshot.serve(devicesKey(version, table),
+                                                           etags[d].empty() ? nullptr : etags[d].c_str(),
+                                                           [&](std::string &body) {
+                                                               builds++;
+                                                               body = devicesBody(table);
+                                                           });
+            if (reply.notModified) {
+                TEST_ASSERT_EQUAL_STRING(etags[d].c_str(), reply.etag);
+                continue;
+            }
+            TEST_ASSERT_EQUAL_STRING(expected.c_str(), reply.body->c_str());
+            etags[d] = reply.etag;
+        }
+    }
+
+    SnapshotStats stats = snapshot.stats();
+    TEST_ASSERT_EQUAL_UINT32(dashboards * durationMs / pollMs, stats.requests);
+    TEST_ASSERT_EQUAL_UINT32(builds, stats.builds);
+    TEST_ASSERT_EQUAL_UINT32(stats.requests, stats.notModified + stats.hits + stats.builds);
+    TEST_ASSERT_EQUAL_UINT64(uncachedBytes, stats.bytesSent + stats.bytesSaved);
+    const double hitRate = 100.0 * (stats.notModified + stats.hits) / stats.requests;
+    TEST_ASSERT_TRUE(hitRate > 80.0);
+    TEST_ASSERT_TRUE(stats.bytesSent < uncachedBytes / 4);
+    printf("  %u polls: %u built (one per poll before), %u not modified, %u from the snapshot, hit rate %.1f%%, "
+           "%llu of %llu bytes sent\n", stats.requests, stats.builds, stats.notModified, stats.hits, hitRate,
+           static_cast<unsigned long long>(stats.bytesSent), static_cast<unsigned long long>(uncachedBytes));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_if_none_match);
+    RUN_TEST(test_build_once_per_key);
+    RUN_TEST(test_stats);
+    RUN_TEST(test_dashboard_polling);
+    return UNITY_END();
+}
@@ -0,0 +1,172 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <iohcLinkStats.h>
+
+using namespace IOHC;
+
+static const uint32_t CH1 = 868250000, CH2 = 868950000, CH3 = 869850000;
+
+// Register burst REG_LNA..REG_FEILSB as the chip would return it
+static void burst(uint8_t *regs, uint8_t lnaGain, uint8_t rssiRaw, int16_t afc, int16_t fei, uint8_t thresh = 0xE4) {
+    memset(regs, 0, LINK_BURST_LEN);
+    regs[0] = (lnaGain << 5) | 0x03;
+    regs[REG_RSSITHRESH - REG_LNA] = thresh;
+    regs[REG_RSSIVALUE - REG_LNA] = rssiRaw;
+    regs[REG_AFCMSB - REG_LNA] = static_cast<uint16_t>(afc) >> 8;
+    regs[REG_AFCLSB - REG_LNA] = afc & 0xFF;
+    regs[REG_FEIMSB - REG_LNA] = static_cast<uint16_t>(fei) >> 8;
+    regs[REG_FEILSB - REG_LNA] = fei & 0xFF;
+}
+
+static LinkSample sample(uint8_t lnaGain, uint8_t rssiRaw, int16_t fei) {
+    uint8_t regs[LINK_BURST_LEN];
+    burst(regs, lnaGain, rssiRaw, 0, fei);
+    return linkSampleFromBurst(regs);
+}
+
+static void frame(uint8_t *buffer, uint32_t source) {
+    memset(buffer, 0, 16);
+    buffer[0] = 0x0F;
+    buffer[5] = source >> 16;
+    buffer[6] = source >> 8;
+    buffer[7] = source;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_burst_parsing() {
+    uint8_t regs[LINK_BURST_LEN];
+    TEST_ASSERT_EQUAL(19, LINK_BURST_LEN);
+    burst(regs, 2, 150, -33, 66);
+    LinkSample s = linkSampleFromBurst(regs);
+    TEST_ASSERT_EQUAL_UINT8(2, s.lna);
+    TEST_ASSERT_EQUAL_UINT8(150, s.rssi);
+    TEST_ASSERT_EQUAL_FLOAT(-75.0f, s.rssiDbm());
+    TEST_ASSERT_EQUAL_INT16(-33, s.afc);
+    TEST_ASSERT_EQUAL_INT32(-2014, s.afcHz());
+    TEST_ASSERT_EQUAL_INT16(66, s.fei);
+    TEST_ASSERT_EQUAL_INT32(4028, s.feiHz());
+    TEST_ASSERT_EQUAL_UINT8(6, s.lnaAttenuationDb());
+    TEST_ASSERT_EQUAL_UINT8((0xE4 - 150) / 2, s.snrDb());
+    // Compact: what the RX pool carries per frame
+    TEST_ASSERT_LESS_OR_EQUAL(8, sizeof(LinkSample));
+}
+
+void test_bucket_boundaries() {
+    // RSSI: 5 dB buckets from -130 dBm, clamped at both ends
+    TEST_ASSERT_EQUAL(0, LinkHistogram::rssiBucket(sample(1, 255, 0)));    // -127.5
+    TEST_ASSERT_EQUAL(0, LinkHistogram::rssiBucket(sample(1, 251, 0)));    // -125.5
+    TEST_ASSERT_EQUAL(1, LinkHistogram::rssiBucket(sample(1, 250, 0)));    // -125.0
+    TEST_ASSERT_EQUAL(8, LinkHistogram::rssiBucket(sample(1, 180, 0)));    // -90.0
+    TEST_ASSERT_EQUAL(LINK_RSSI_BUCKETS - 1, LinkHistogram::rssiBucket(sample(1, 20, 0)));   // -10.0
+
+    // FEI: 2 kHz buckets centred on 0
+    TEST_ASSERT_EQUAL(4, LinkHistogram::feiBucket(sample(1, 200, 0)));
+    TEST_ASSERT_EQUAL(4, LinkHistogram::feiBucket(sample(1, 200, 16)));     // +976 Hz
+    TEST_ASSERT_EQUAL(5, LinkHistogram::feiBucket(sample(1, 200, 17)));     // +1037 Hz
+    TEST_ASSERT_EQUAL(3, LinkHistogram::feiBucket(sample(1, 200, -17)));
+    TEST_ASSERT_EQUAL(0, LinkHistogram::feiBucket(sample(1, 200, -2000)));
+    TEST_ASSERT_EQUAL(LINK_FEI_BUCKETS - 1, LinkHistogram::feiBucket(sample(1, 200, 2000)));
+}
+
+void test_per_channel_and_source() {
+    iohcLinkStats stats;
+    uint8_t buffer[16];
+
+    frame(buffer, 0xABCDEF);
+    stats.record(sample(1, 120, 10), CH2, buffer, 16);
+    stats.record(sample(1, 130, 20), CH2, buffer, 16);
+    frame(buffer, 0x123456);
+    stats.record(sample(3, 200, -40), CH1, buffer, 16);
+    // Too short to carry a source: channel only
+    stats.record(sample(2, 180, 0), CH3, buffer, 4);
+
+    TEST_ASSERT_EQUAL_UINT32(4, stats.frames());
+    LinkChannel channels[LINK_MAX_CHANNELS];
+    TEST_ASSERT_EQUAL(3, stats.channels(channels, LINK_MAX_CHANNELS));
+    TEST_ASSERT_EQUAL_UINT32(CH2, channels[0].frequency);
+    TEST_ASSERT_EQUAL_UINT32(2, channels[0].histogram.frames);
+    TEST_ASSERT_EQUAL_FLOAT(-62.5f, channels[0].histogram.rssiMeanDbm());
+    TEST_ASSERT_EQUAL_INT16(-130, channels[0].histogram.rssiMinX2);
+    TEST_ASSERT_EQUAL_INT16(-120, channels[0].histogram.rssiMaxX2);
+    TEST_ASSERT_EQUAL_INT32((610 + 1220) / 2, channels[0].histogram.feiMeanHz());
+    TEST_ASSERT_EQUAL_UINT32(2, channels[0].histogram.lna[0]);
+    TEST_ASSERT_EQUAL_UINT32(CH1, channels[1].frequency);
+    TEST_ASSERT_EQUAL_UINT32(1, channels[1].histogram.lna[2]);
+    TEST_ASSERT_EQUAL_UINT32(1, channels[1].histogram.fei[3]);   // -2441 Hz
+
+    LinkSource sources[LINK_MAX_SOURCES];
+    TEST_ASSERT_EQUAL(2, stats.sources(sources, LINK_MAX_SOURCES));
+    TEST_ASSERT_EQUAL_HEX32(0xABCDEF, sources[0].address);
+    TEST_ASSERT_EQUAL_UINT32(2, sources[0].histogram.frames);
+    TEST_ASSERT_EQUAL_HEX32(0x123456, sources[1].address);
+    TEST_ASSERT_EQUAL_UINT32(1, sources[1].histogram.frames);
+
+    // Histogram totals match the frame count
+    uint32_t total = 0;
+    for (uint32_t c : channels[0].histogram.rssi) total += c;
+    TEST_ASSERT_EQUAL_UINT32(2, total);
+
+    stats.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.frames());
+    TEST_ASSERT_EQUAL(0, stats.channels(channels, LINK_MAX_CHANNELS));
+    TEST_ASSERT_EQUAL(0, stats.sources(sources, LINK_MAX_SOURCES));
+}
+
+void test_source_eviction_keeps_recent() {
+    iohcLinkStats stats;
+    uint8_t buffer[16];
+
+    // One chatty source, then more distinct sources than the table holds
+    frame(buffer, 0x000001);
+    stats.record(sample(1, 150, 0), CH2, buffer, 16);
+    for (uint32_t a = 2; a < LINK_MAX_SOURCES + 10; a++) {
+        frame(buffer, a);
+        stats.record(sample(1, 150, 0), CH2, buffer, 16);
+        frame(buffer, 0x000001);
+        stats.record(sample(1, 150, 0), CH2, buffer, 16);
+    }
+    LinkSource sources[LINK_MAX_SOURCES];
+    size_t count = stats.sources(sources, LINK_MAX_SOURCES);
+    TEST_ASSERT_EQUAL(LINK_MAX_SOURCES, count);
+    TEST_ASSERT_EQUAL_UINT32(9, stats.evicted());
+    bool found = false;
+    for (size_t i = 0; i < count; i++)
+        if (sources[i].address == 1) {
+            found = true;
+            TEST_ASSERT_EQUAL_UINT32(LINK_MAX_SOURCES + 9, sources[i].histogram.frames);
+        }
+    TEST_ASSERT_TRUE(found);
+}
+
+// Cost of the aggregation per frame, the part that runs for every received frame
+void test_record_cost() {
+    iohcLinkStats stats;
+    uint8_t buffer[16];
+    const uint32_t frames = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; i++) {
+        frame(buffer, 0x100000 + (i % 24));
+        stats.record(sample(1 + i % 6, 100 + i % 150, static_cast<int16_t>(i % 200) - 100), CH2 + (i % 3) * 700000,
+                     buffer, 16);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / frames;
+    printf("  record(): %.0f ns per frame (host), %u bytes of state\n", ns, (unsigned)sizeof(iohcLinkStats));
+    TEST_ASSERT_EQUAL_UINT32(frames, stats.frames());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_parsing);
+    RUN_TEST(test_bucket_boundaries);
+    RUN_TEST(test_per_channel_and_source);
+    RUN_TEST(test_source_eviction_keeps_recent);
+    RUN_TEST(test_record_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,319 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iohcMqttQueue.h>
+#include "../heap_accounting.h"
+
+using namespace IOHC;
+
+// The policies initMqtt sets
+static void gatewayPolicies(iohcMqttQueue &queue) {
+    queue.setDefaultPolicy({0, true, true});
+    TEST_ASSERT_TRUE(queue.setPolicy("iown/Frame", {1, false, false}));
+    TEST_ASSERT_TRUE(queue.setPolicy("+/sensor/iohc_frame/state", {0, false, true}));
+}
+
+static int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static iohcMqttQueue::Push push(iohcMqttQueue &queue, const char *topic, const char *payload, int64_t at = 0) {
+    return queue.push(topic, payload, strlen(payload), at);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_policies() {
+    iohcMqttQueue queue;
+    gatewayPolicies(queue);
+    MqttPolicy frame = queue.policyFor("iown/Frame");
+    TEST_ASSERT_EQUAL(1, frame.qos);
+    TEST_ASSERT_FALSE(frame.retain);
+    TEST_ASSERT_FALSE(frame.coalesce);
+    TEST_ASSERT_TRUE(queue.policyFor("iown/a1b2c3/position").retain);
+    TEST_ASSERT_TRUE(queue.policyFor("iown/status").coalesce);
+    TEST_ASSERT_TRUE(queue.policyFor("homeassistant/cover/a1b2c3/config").retain);
+    TEST_ASSERT_TRUE(queue.policyFor("homeassistant/button/a1b2c3_pair/config").coalesce);
+    MqttPolicy state = queue.policyFor("homeassistant/sensor/iohc_frame/state");
+    TEST_ASSERT_FALSE(state.retain);
+    TEST_ASSERT_TRUE(state.coalesce);
+
+    iohcMqttQueue plain;
+    MqttPolicy other = plain.policyFor("iown/status");
+    TEST_ASSERT_EQUAL(0, other.qos);
+    TEST_ASSERT_FALSE(other.retain);
+    TEST_ASSERT_FALSE(other.coalesce);
+}
+
+// State topics keep their last value, events are all kept
+void test_coalescing() {
+    iohcMqttQueue queue;
+    gatewayPolicies(queue);
+    TEST_ASSERT_EQUAL(static_cast<int>(iohcMqttQueue::Push::Queued), static_cast<int>(push(queue, "iown/a/position", "10")));
+    push(queue, "iown/Frame", "f1");
+    TEST_ASSERT_EQUAL(static_cast<int>(iohcMqttQueue::Push::Coalesced), static_cast<int>(push(queue, "iown/a/position", "20")));
+    push(queue, "iown/a/position", "30");
+    push(queue, "iown/Frame", "f2");
+    push(queue, "iown/b/position", "99");
+    TEST_ASSERT_EQUAL(4, queue.size());
+
+    iohcMqttQueue::Message m;
+    const char *expected[][2] = {{"iown/a/position", "30"}, {"iown/Frame", "f1"}, {"iown/Frame", "f2"},
+                                 {"iown/b/position", "99"}};
+    for (auto &e : expected) {
+        TEST_ASSERT_TRUE(queue.peek(m));
+        TEST_ASSERT_EQUAL_STRING(e[0], m.topic.c_str());
+        TEST_ASSERT_EQUAL_STRING(e[1], m.payload.c_str());
+        queue.pop(m, 0);
+    }
+    TEST_ASSERT_FALSE(queue.peek(m));
+    MqttQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(4, stats.queued);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.coalesced);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.published);
+}
+
+// An update arriving while its previous value is being published is published too
+void test_update_while_publishing() {
+    iohcMqttQueue queue;
+    gatewayPolicies(queue);
+    push(queue, "iown/a/state", "OPENING");
+    iohcMqttQueue::Message m;
+    TEST_ASSERT_TRUE(queue.peek(m));
+    push(queue, "iown/a/state", "OPEN");
+    queue.pop(m, 0);
+    TEST_ASSERT_TRUE(queue.peek(m));
+    TEST_ASSERT_EQUAL_STRING("OPEN", m.payload.c_str());
+    queue.pop(m, 0);
+    TEST_ASSERT_EQUAL(0, queue.size());
+
+    // Refused by the client: still first in line
+    push(queue, "iown/Frame", "f1");
+    TEST_ASSERT_TRUE(queue.peek(m));
+    queue.retried();
+    TEST_ASSERT_TRUE(queue.peek(m));
+    TEST_ASSERT_EQUAL_STRING("f1", m.payload.c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.stats().retries);
+}
+
+static std::vector<std::string> accepted;
+
+static void onAccepted(const iohcMqttQueue::Message &sent) {
+    accepted.push_back(sent.topic + "=" + sent.payload);
+}
+
+// The callback sees what the client accepted, not what was queued
+void test_published_callback() {
+    iohcMqttQueue queue;
+    gatewayPolicies(queue);
+    accepted.clear();
+    const char *config = "homeassistant/cover/a1b2c3/config";
+    queue.push(config, "v1", 2, 0, onAccepted);
+    push(queue, "iown/Frame", "f1");
+    TEST_ASSERT_TRUE(accepted.empty());
+
+    iohcMqttQueue::Message m;
+    TEST_ASSERT_TRUE(queue.peek(m));
+    queue.retried();
+    TEST_ASSERT_TRUE(accepted.empty());
+    // Changed while the first value is on its way: both get reported, in order
+    queue.push(config, "v2", 2, 0, onAccepted);
+    queue.pop(m, 0);
+    TEST_ASSERT_EQUAL(1, accepted.size());
+    TEST_ASSERT_EQUAL_STRING("homeassistant/cover/a1b2c3/config=v1", accepted[0].c_str());
+    while (queue.peek(m)) queue.pop(m, 0);
+    TEST_ASSERT_EQUAL(2, accepted.size());
+    TEST_ASSERT_EQUAL_STRING("homeassistant/cover/a1b2c3/config=v2", accepted[1].c_str());
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+// Full: events make room for anything, state is never pushed out
+void test_bounded() {
+    iohcMqttQueue queue;
+    gatewayPolicies(queue);
+    char topic[32];
+    for (int i = 0; i < MQTT_QUEUE_DEPTH - 2; i++) {
+        snprintf(topic, sizeof(topic), "iown/%06x/position", i);
+        push(queue, topic, "50");
+    }
+    push(queue, "iown/Frame", "f1");
+    push(queue, "iown/Frame", "f2");
+    TEST_ASSERT_EQUAL(MQTT_QUEUE_DEPTH, queue.size());
+
+    TEST_ASSERT_EQUAL(static_cast<int>(iohcMqttQueue::Push::Queued), static_cast<int>(push(queue, "iown/Frame", "f3")));
+    TEST_ASSERT_EQUAL(static_cast<int>(iohcMqttQueue::Push::Queued), static_cast<int>(push(queue, "iown/x/state", "OPEN")));
+    TEST_ASSERT_EQUAL(static_cast<int>(iohcMqttQueue::Push::Queued), static_cast<int>(push(queue, "iown/y/state", "OPEN")));
+    TEST_ASSERT_EQUAL(static_cast<int>(iohcMqttQueue::Push::Dropped), static_cast<int>(push(queue, "iown/z/state", "OPEN")));
+    TEST_ASSERT_EQUAL(static_cast<int>(iohcMqttQueue::Push::Dropped), static_cast<int>(push(queue, "iown/Frame", "f4")));
+    // Still coalesces when full
+    TEST_ASSERT_EQUAL(static_cast<int>(iohcMqttQueue::Push::Coalesced), static_cast<int>(push(queue, "iown/x/state", "CLOSE")));
+
+    MqttQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(3, stats.evicted);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(MQTT_QUEUE_DEPTH, stats.maxDepth);
+
+    // The events went first, the order of the others is kept
+    iohcMqttQueue::Message m;
+    for (int i = 0; i < MQTT_QUEUE_DEPTH - 2; i++) {
+        TEST_ASSERT_TRUE(queue.peek(m));
+        snprintf(topic, sizeof(topic), "iown/%06x/position", i);
+        TEST_ASSERT_EQUAL_STRING(topic, m.topic.c_str());
+        queue.pop(m, 0);
+    }
+    queue.peek(m);
+    TEST_ASSERT_EQUAL_STRING("CLOSE", m.payload.c_str());
+    queue.pop(m, 0);
+    queue.peek(m);
+    TEST_ASSERT_EQUAL_STRING("iown/y/state", m.topic.c_str());
+    queue.pop(m, 0);
+    TEST_ASSERT_EQUAL(0, queue.size());
+}
+
+void test_backpressure() {
+    iohcMqttQueue queue;
+    for (int i = 0; i < MQTT_QUEUE_HIGH_WATER - 1; i++) push(queue, "iown/Frame", "f");
+    TEST_ASSERT_FALSE(queue.congested());
+    push(queue, "iown/Frame", "f");
+    TEST_ASSERT_TRUE(queue.congested());
+
+    // Stays congested down to the low water mark
+    iohcMqttQueue::Message m;
+    while (queue.size() > MQTT_QUEUE_LOW_WATER + 1) {
+        queue.peek(m);
+        queue.pop(m, 0);
+        TEST_ASSERT_TRUE(queue.congested());
+    }
+    queue.peek(m);
+    queue.pop(m, 0);
+    TEST_ASSERT_FALSE(queue.congested());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.stats().congestions);
+}
+
+void test_zero_heap_when_warm() {
+    iohcMqttQueue queue;
+    gatewayPolicies(queue);
+    const std::string frame(200, 'x');
+    iohcMqttQueue::Message m;
+    auto cycle = [&] {
+        queue.push("iown/Frame", frame.data(), frame.size(), 0);
+        queue.push("homeassistant/sensor/iohc_frame/state", frame.data(), frame.size(), 0);
+        while (queue.peek(m)) queue.pop(m, 0);
+    };
+    // Every slot sees the longest topic and payload once
+    for (int i = 0; i < MQTT_QUEUE_DEPTH; i++) cycle();
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < 1000; i++) cycle();
+    counting = false;
+    TEST_ASSERT_EQUAL(0, allocations.load());
+}
+
+/*
+    Load test: an RX-like producer pushes frame events and position updates for a few remotes as fast as the
+    radio could, a broker-like consumer publishes with a per-message cost, stalls now and then and refuses some
+    publishes. The producer must never wait on the consumer, and every state topic must end on its last value.
+*/
+void test_load_slow_broker() {
+    iohcMqttQueue queue;
+    gatewayPolicies(queue);
+    const int frames = 20000;
+    const int remotes = 8;
+    std::atomic<bool> done{false};
+    std::map<std::string, std::string> broker;
+    uint32_t refused = 0;
+
+    std::thread publisher([&] {
+        iohcMqttQueue::Message m;
+        uint32_t sent = 0;
+        while (true) {
+            if (!queue.peek(m)) {
+                if (done) break;
+                std::this_thread::yield();
+                continue;
+            }
+            // TCP buffer full now and then, and a slow link
+            if (++sent % 97 == 0) {
+                refused++;
+                queue.retried();
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            if (sent % 1000 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            std::this_thread::sleep_for(std::chrono::microseconds(5));
+            broker[m.topic] = m.payload;
+            queue.pop(m, nowUs());
+        }
+    });
+
+    std::string last[remotes];
+    int64_t worstPushUs = 0;
+    int skipped = 0;
+    char topic[32], payload[128];
+    for (int i = 0; i < frames; i++) {
+        // The RX path skips building the frame JSON under backpressure
+        if (queue.congested()) {
+            queue.skipped();
+            skipped++;
+        } else {
+            int length = snprintf(payload, sizeof(payload), "{\"frame\":%d,\"type\":\"1W\",\"action\":\"open\"}", i);
+            int64_t start = nowUs();
+            queue.push("iown/Frame", payload, length, start);
+            worstPushUs = std::max(worstPushUs, nowUs() - start);
+        }
+        const int remote = i % remotes;
+        snprintf(topic, sizeof(topic), "iown/%06x/position", remote);
+        int length = snprintf(payload, sizeof(payload), "%d", i % 101);
+        int64_t start = nowUs();
+        queue.push(topic, payload, length, start);
+        worstPushUs = std::max(worstPushUs, nowUs() - start);
+        last[remote] = payload;
+        if (i % 50 == 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    done = true;
+    publisher.join();
+
+    MqttQueueStats stats = queue.stats();
+    for (int remote = 0; remote < remotes; remote++) {
+        snprintf(topic, sizeof(topic), "iown/%06x/position", remote);
+        TEST_ASSERT_EQUAL_STRING(last[remote].c_str(), broker[topic].c_str());
+    }
+    TEST_ASSERT_EQUAL(0, queue.size());
+    TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(refused, stats.retries);
+    TEST_ASSERT_EQUAL_UINT32(skipped, stats.skipped);
+    TEST_ASSERT_TRUE(stats.maxDepth <= MQTT_QUEUE_DEPTH);
+    TEST_ASSERT_TRUE(worstPushUs < 5000);
+    printf("  %d frames + %d positions: queued %u coalesced %u evicted %u skipped %u published %u retries %u\n",
+           frames, frames, stats.queued, stats.coalesced, stats.evicted, stats.skipped, stats.published,
+           stats.retries);
+    printf("  congestions %u max depth %u, worst push %lld us, latency p50 <%u us p99 <%u us max %u us\n",
+           stats.congestions, stats.maxDepth, static_cast<long long>(worstPushUs), stats.latency.percentileUs(50),
+           stats.latency.percentileUs(99), stats.latency.maxUs);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_policies);
+    RUN_TEST(test_coalescing);
+    RUN_TEST(test_update_while_publishing);
+    RUN_TEST(test_published_callback);
+    RUN_TEST(test_bounded);
+    RUN_TEST(test_backpressure);
+    RUN_TEST(test_zero_heap_when_warm);
+    RUN_TEST(test_load_slow_broker);
+    return UNITY_END();
+}
@@ -0,0 +1,243 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <SX1276Shadow.h>
+
+// Simulated SX1276 register file; every call is one SPI transaction
+struct SimChip {
+    uint8_t regs[0x80]{};
+    uint32_t reads = 0;
+    uint32_t writes = 0;
+
+    SimChip() {
+        regs[REG_OPMODE] = RF_OPMODE_STANDBY;
+        regs[REG_SYNCCONFIG] = RF_SYNCCONFIG_PREAMBLEPOLARITY_AA | RF_SYNCCONFIG_SYNC_ON | RF_SYNCCONFIG_SYNCSIZE_3;
+        regs[REG_PREAMBLELSB] = 52;
+    }
+
+    uint32_t transactions() const { return reads + writes; }
+    void resetCounters() { reads = writes = 0; }
+
+    uint8_t readByte(uint8_t regAddr) {
+        reads++;
+        // TxReady and PllLock are immediate in the simulation
+        if (regAddr == REG_IRQFLAGS1) return RF_IRQFLAGS1_TXREADY | RF_IRQFLAGS1_PLLLOCK;
+        return regs[regAddr];
+    }
+
+    void readBytes(uint8_t regAddr, uint8_t *out, uint8_t len) {
+        reads++;
+        for (uint8_t i = 0; i < len; i++) out[i] = regs[regAddr + i];
+    }
+
+    void writeBytes(uint8_t regAddr, uint8_t *in, uint8_t len) {
+        writes++;
+        if (regAddr == REG_FIFO) return;
+        for (uint8_t i = 0; i < len; i++) regs[regAddr + i] = in[i];
+    }
+};
+
+using Shadow = Radio::RegisterShadow<SimChip>;
+
+static constexpr uint16_t LONG_PREAMBLE = 52;
+static constexpr uint16_t SHORT_PREAMBLE = 8;
+static uint8_t frame[32] = {0x0C, 0x00, 0x00, 0x00, 0x3F, 0xAB, 0xCD, 0xEF, 0x01};
+
+// Transitions as they were before the shadow: read-modify-write on the chip
+namespace Legacy {
+    void setStandby(SimChip &chip) {
+        uint8_t v = (chip.readByte(REG_OPMODE) & RF_OPMODE_MASK) | RF_OPMODE_STANDBY;
+        chip.writeBytes(REG_OPMODE, &v, 1);
+    }
+    void setTx(SimChip &chip) {
+        uint8_t v = (chip.readByte(REG_SYNCCONFIG) & RF_SYNCCONFIG_SYNCSIZE_MASK) | RF_SYNCCONFIG_SYNCSIZE_2;
+        chip.writeBytes(REG_SYNCCONFIG, &v, 1);
+        v = (chip.readByte(REG_OPMODE) & RF_OPMODE_MASK) | RF_OPMODE_TRANSMITTER;
+        chip.writeBytes(REG_OPMODE, &v, 1);
+        while (!(chip.readByte(REG_IRQFLAGS1) & RF_IRQFLAGS1_TXREADY));
+    }
+    void setRx(SimChip &chip) {
+        uint8_t v = (chip.readByte(REG_SYNCCONFIG) & RF_SYNCCONFIG_SYNCSIZE_MASK) | RF_SYNCCONFIG_SYNCSIZE_3;
+        chip.writeBytes(REG_SYNCCONFIG, &v, 1);
+        v = (chip.readByte(REG_OPMODE) & RF_OPMODE_MASK) | RF_OPMODE_RECEIVER;
+        chip.writeBytes(REG_OPMODE, &v, 1);
+        while (!(chip.readByte(REG_IRQFLAGS1) & RF_IRQFLAGS1_PLLLOCK));
+    }
+    void setPreambleLength(SimChip &chip, uint16_t len) {
+        uint8_t msb = len >> 8, lsb = len & 0xFF;
+        chip.writeBytes(REG_PREAMBLEMSB, &msb, 1);
+        chip.writeBytes(REG_PREAMBLELSB, &lsb, 1);
+    }
+    void clearFlags(SimChip &chip) {
+        uint16_t flags = chip.readByte(REG_IRQFLAGS1) | (chip.readByte(REG_IRQFLAGS2) << 8);
+        flags &= ~0xFFFF;
+        uint8_t hi = flags >> 8, lo = flags & 0xFF;
+        chip.writeBytes(REG_IRQFLAGS1, &hi, 1);
+        chip.writeBytes(REG_IRQFLAGS2, &lo, 1);
+    }
+
+    // send() then one repeat from onTxTicker, back to RX, then one received frame handled by tickerCounter
+    void cycle(SimChip &chip) {
+        setPreambleLength(chip, LONG_PREAMBLE);
+        setStandby(chip);
+        clearFlags(chip);
+        chip.writeBytes(REG_FIFO, frame, 13);
+        setTx(chip);
+
+        setPreambleLength(chip, SHORT_PREAMBLE);
+        setStandby(chip);
+        clearFlags(chip);
+        chip.writeBytes(REG_FIFO, frame, 13);
+        setTx(chip);
+
+        setRx(chip);
+        clearFlags(chip);
+    }
+}
+
+// Same sequence through the shadow, as SX1276Helpers now does it
+namespace Shadowed {
+    void clearFlags(SimChip &chip) {
+        uint8_t out[2] = {0x00, 0x00};
+        chip.writeBytes(REG_IRQFLAGS1, out, sizeof(out));
+    }
+    void setTx(Shadow &regs, SimChip &chip) {
+        Radio::enterTx(regs);
+        while (!(chip.readByte(REG_IRQFLAGS1) & RF_IRQFLAGS1_TXREADY));
+    }
+    void setRx(Shadow &regs, SimChip &chip) {
+        Radio::enterRx(regs);
+        while (!(chip.readByte(REG_IRQFLAGS1) & RF_IRQFLAGS1_PLLLOCK));
+    }
+
+    void cycle(Shadow &regs, SimChip &chip) {
+        Radio::setPreamble(regs, LONG_PREAMBLE);
+        Radio::enterStandby(regs);
+        clearFlags(chip);
+        chip.writeBytes(REG_FIFO, frame, 13);
+        setTx(regs, chip);
+
+        Radio::setPreamble(regs, SHORT_PREAMBLE);
+        Radio::enterStandby(regs);
+        clearFlags(chip);
+        chip.writeBytes(REG_FIFO, frame, 13);
+        setTx(regs, chip);
+
+        setRx(regs, chip);
+        clearFlags(chip);
+    }
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_spi_operations_per_cycle() {
+    SimChip legacyChip;
+    Legacy::cycle(legacyChip);  // Warm-up, same as the shadow
+    legacyChip.resetCounters();
+    Legacy::cycle(legacyChip);
+
+    SimChip chip;
+    Shadow regs(chip);
+    Shadowed::cycle(regs, chip);  // First cycle fills the shadow
+    chip.resetCounters();
+    Shadowed::cycle(regs, chip);
+
+    printf("  SPI ops per TX(+1 repeat)/RX cycle: before %u (%u reads, %u writes), after %u (%u reads, %u writes)\n",
+           legacyChip.transactions(), legacyChip.reads, legacyChip.writes,
+           chip.transactions(), chip.reads, chip.writes);
+    printf("  shadow: writes %u skipped %u readsAvoided %u\n",
+           regs.stats().writes, regs.stats().skipped, regs.stats().readsAvoided);
+
+    TEST_ASSERT_EQUAL_UINT32(37, legacyChip.transactions());
+    TEST_ASSERT_EQUAL_UINT32(3, chip.reads);  // TxReady twice, PllLock once
+    TEST_ASSERT_LESS_THAN_UINT32(legacyChip.transactions() / 2, chip.transactions());
+    TEST_ASSERT_EQUAL_MEMORY(legacyChip.regs, chip.regs, sizeof(chip.regs));
+}
+
+void test_unchanged_writes_are_skipped() {
+    SimChip chip;
+    Shadow regs(chip);
+
+    Radio::setPreamble(regs, SHORT_PREAMBLE);
+    TEST_ASSERT_EQUAL_UINT32(1, chip.writes);
+    Radio::setPreamble(regs, SHORT_PREAMBLE);
+    TEST_ASSERT_EQUAL_UINT32(1, chip.writes);
+    TEST_ASSERT_EQUAL_UINT32(1, regs.stats().skipped);
+
+    // A burst with one changed register goes to the chip as a whole
+    uint8_t frf[3] = {0xD9, 0x3C, 0xCD};
+    regs.writeBurst(REG_FRFMSB, frf, 3);
+    frf[2] = 0xCE;
+    regs.writeBurst(REG_FRFMSB, frf, 3);
+    TEST_ASSERT_EQUAL_UINT32(3, chip.writes);
+    TEST_ASSERT_EQUAL_HEX8(0xCE, chip.regs[REG_FRFLSB]);
+    regs.writeBurst(REG_FRFMSB, frf, 3);
+    TEST_ASSERT_EQUAL_UINT32(3, chip.writes);
+}
+
+void test_volatile_registers_always_hit_the_chip() {
+    SimChip chip;
+    Shadow regs(chip);
+    uint8_t zero = 0;
+
+    regs.write(REG_IRQFLAGS2, zero);
+    regs.write(REG_IRQFLAGS2, zero);
+    TEST_ASSERT_EQUAL_UINT32(2, chip.writes);
+    regs.read(REG_RSSIVALUE);
+    regs.read(REG_RSSIVALUE);
+    TEST_ASSERT_EQUAL_UINT32(2, chip.reads);
+
+    // FIFO bursts do not touch the shadowed registers that follow address 0
+    regs.read(REG_OPMODE);
+    regs.track(REG_FIFO, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_HEX8(RF_OPMODE_STANDBY, regs.read(REG_OPMODE));
+}
+
+void test_direct_writes_are_tracked() {
+    SimChip chip;
+    Shadow regs(chip);
+
+    TEST_ASSERT_EQUAL_HEX8(RF_OPMODE_STANDBY, regs.read(REG_OPMODE));
+    uint8_t mode = RF_OPMODE_SLEEP;
+    chip.writeBytes(REG_OPMODE, &mode, 1);
+    regs.track(REG_OPMODE, &mode, 1);
+    chip.resetCounters();
+    TEST_ASSERT_EQUAL_HEX8(RF_OPMODE_SLEEP, regs.read(REG_OPMODE));
+    TEST_ASSERT_EQUAL_UINT32(0, chip.reads);
+}
+
+void test_verify_mode_detects_drift() {
+    SimChip chip;
+    Shadow regs(chip);
+
+    Radio::enterTx(regs);
+    TEST_ASSERT_EQUAL_UINT8(0, regs.verifyAll());
+
+    // Chip changes behind the shadow's back (reset, untracked write)
+    chip.regs[REG_OPMODE] = RF_OPMODE_STANDBY;
+    TEST_ASSERT_EQUAL_UINT8(1, regs.verifyAll());
+    TEST_ASSERT_EQUAL_UINT32(1, regs.stats().mismatches);
+    TEST_ASSERT_EQUAL_UINT8(0, regs.verifyAll());
+
+    // Without verify a stale shadow would skip this write; with verify it reaches the chip
+    Radio::enterTx(regs);
+    chip.regs[REG_OPMODE] = RF_OPMODE_STANDBY;
+    regs.setVerify(true);
+    Radio::enterTx(regs);
+    TEST_ASSERT_EQUAL_HEX8(RF_OPMODE_TRANSMITTER, chip.regs[REG_OPMODE] & ~RF_OPMODE_MASK);
+    TEST_ASSERT_EQUAL_UINT32(2, regs.stats().mismatches);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_spi_operations_per_cycle);
+    RUN_TEST(test_unchanged_writes_are_skipped);
+    RUN_TEST(test_volatile_registers_always_hit_the_chip);
+    RUN_TEST(test_direct_writes_are_tracked);
+    RUN_TEST(test_verify_mode_detects_drift);
+    return UNITY_END();
+}
@@ -0,0 +1,244 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <iohcRxDedupe.h>
+
+using namespace IOHC;
+
+static const uint8_t REMOTE[3] = {0xF1, 0x53, 0xFA};
+static const uint8_t DEVICE[3] = {0x26, 0x84, 0xDE};
+static const uint8_t ME[3] = {0xBA, 0x11, 0xAD};
+static const uint8_t ALL_1W[3] = {0x00, 0x00, 0x3F};
+
+// 1W execute from a remote: main parameter, then sequence number and MAC; 2 CRC bytes as read from the FIFO
+static uint8_t press(uint8_t *buffer, const uint8_t *source, uint16_t sequence, uint16_t main = 0x0000) {
+    const uint8_t length = IOHC_FRAME_HEADER_LEN + 6 + IOHC_1W_AUTH_LEN;
+    memset(buffer, 0, length + 2);
+    buffer[0] = (length - 1) | 0x20 | 0x40 | 0x80;
+    buffer[1] = 0x20;
+    memcpy(buffer + 2, ALL_1W, 3);
+    memcpy(buffer + 5, source, 3);
+    buffer[8] = 0x00;
+    buffer[9] = 0x01;
+    buffer[10] = 0x43;
+    buffer[11] = main >> 8;
+    buffer[12] = main;
+    buffer[15] = sequence >> 8;
+    buffer[16] = sequence;
+    // MAC: anything depending on the sequence number
+    for (int i = 0; i < 6; i++) buffer[17 + i] = static_cast<uint8_t>(sequence * 31 + i * 7);
+    return length + 2;
+}
+
+// 2W frame with a parameter payload
+static uint8_t frame2W(uint8_t *buffer, const uint8_t *source, const uint8_t *target, uint8_t cmd,
+                       const uint8_t *params, uint8_t count) {
+    const uint8_t length = IOHC_FRAME_HEADER_LEN + count;
+    buffer[0] = (length - 1) | 0x40 | 0x80;
+    buffer[1] = 0x00;
+    memcpy(buffer + 2, target, 3);
+    memcpy(buffer + 5, source, 3);
+    buffer[8] = cmd;
+    memcpy(buffer + IOHC_FRAME_HEADER_LEN, params, count);
+    return length;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+// One press: 4 repeats on each of 3 channels, 25 ms apart; only the first copy goes through
+void test_1w_press_burst() {
+    iohcRxDedupe dedupe;
+    uint8_t buffer[32];
+    uint32_t now = 5000;
+    int passed = 0;
+    for (int channel = 0; channel < 3; channel++)
+        for (int repeat = 0; repeat < 4; repeat++, now += 25)
+            if (!dedupe.isRepeat(buffer, press(buffer, REMOTE, 0x0bea), now)) passed++;
+    TEST_ASSERT_EQUAL(1, passed);
+
+    // The next press has the next rolling code, even right away
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, press(buffer, REMOTE, 0x0beb, 0xc800), now));
+    // Same rolling code from another remote: another frame
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, press(buffer, DEVICE, 0x0bea), now));
+
+    RxDedupeStats stats = dedupe.stats();
+    TEST_ASSERT_EQUAL_UINT32(3, stats.unique);
+    TEST_ASSERT_EQUAL_UINT32(11, stats.repeats1W);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.repeats2W);
+}
+
+// Each copy restarts the window: a held button stays one press, a copy after a silence is new
+void test_window_slides() {
+    iohcRxDedupe dedupe;
+    uint8_t buffer[32];
+    uint8_t len = press(buffer, REMOTE, 0x0100);
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len, 0));
+    for (uint32_t t = 200; t <= 3000; t += 200) TEST_ASSERT_TRUE(dedupe.isRepeat(buffer, len, t));
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len, 3000 + RX_DEDUPE_1W_WINDOW_MS));
+    TEST_ASSERT_TRUE(dedupe.isRepeat(buffer, len, 3001 + RX_DEDUPE_1W_WINDOW_MS));
+
+    // Across the wrap of the millisecond clock
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, press(buffer, DEVICE, 7), UINT32_MAX - 10));
+    TEST_ASSERT_TRUE(dedupe.isRepeat(buffer, press(buffer, DEVICE, 7), 20));
+}
+
+// 2W: same status twice within the short window is a copy, a later one with the same payload is news
+void test_2w_payload() {
+    iohcRxDedupe dedupe;
+    uint8_t buffer[32];
+    const uint8_t status[] = {0x04, 0x00, 0x00, 0x00, 0xc8, 0x00, 0x00, 0x02};
+    const uint8_t moved[] = {0x04, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x02};
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, frame2W(buffer, DEVICE, ME, 0x04, status, 8), 1000));
+    TEST_ASSERT_TRUE(dedupe.isRepeat(buffer, frame2W(buffer, DEVICE, ME, 0x04, status, 8), 1040));
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, frame2W(buffer, DEVICE, ME, 0x04, moved, 8), 1041));
+    // Same payload, other command or other target
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, frame2W(buffer, DEVICE, ME, 0x05, status, 8), 1042));
+    const uint8_t broadcast[3] = {0xFF, 0xFF, 0xFF};
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, frame2W(buffer, DEVICE, broadcast, 0x04, status, 8), 1043));
+    // A retry after the 2W window gets through
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, frame2W(buffer, DEVICE, ME, 0x04, moved, 8),
+                                      1041 + RX_DEDUPE_2W_WINDOW_MS));
+    TEST_ASSERT_EQUAL_UINT32(1, dedupe.stats().repeats2W);
+}
+
+void test_configuration() {
+    iohcRxDedupe dedupe;
+    uint8_t buffer[32];
+    uint8_t len = press(buffer, REMOTE, 42);
+    dedupe.setWindows(0, 0);
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len, 0));
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len, 1));
+
+    dedupe.setWindows(50, 10);
+    TEST_ASSERT_EQUAL_UINT32(50, dedupe.window1WMs());
+    TEST_ASSERT_EQUAL_UINT32(10, dedupe.window2WMs());
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len, 100));
+    TEST_ASSERT_TRUE(dedupe.isRepeat(buffer, len, 149));
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len, 199));
+
+    dedupe.clear();
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len, 200));
+    dedupe.resetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, dedupe.stats().unique);
+}
+
+// Truncated frames are never taken for copies and are not remembered
+void test_malformed() {
+    iohcRxDedupe dedupe;
+    uint8_t buffer[32];
+    uint8_t len = press(buffer, REMOTE, 42);
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, 0, 0));
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len - 4, 0));
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len - 4, 1));
+    buffer[0] = 0x40 | 0x03;
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len, 2));
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, len, 3));
+    TEST_ASSERT_EQUAL_UINT32(0, dedupe.stats().unique);
+}
+
+// More talkers than entries: the one heard longest ago goes first
+void test_eviction() {
+    iohcRxDedupe dedupe;
+    uint8_t buffer[32];
+    uint8_t source[3] = {0x30, 0x00, 0x00};
+    for (int i = 0; i < RX_DEDUPE_ENTRIES; i++) {
+        source[2] = i;
+        dedupe.isRepeat(buffer, press(buffer, source, 1), i);
+    }
+    // Heard again: now the most recent
+    source[2] = 0;
+    TEST_ASSERT_TRUE(dedupe.isRepeat(buffer, press(buffer, source, 1), 100));
+    source[2] = 0xFF;
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, press(buffer, source, 1), 101));
+    TEST_ASSERT_EQUAL_UINT32(1, dedupe.stats().evicted);
+    source[2] = 0;
+    TEST_ASSERT_TRUE(dedupe.isRepeat(buffer, press(buffer, source, 1), 102));
+    source[2] = 1;
+    TEST_ASSERT_FALSE(dedupe.isRepeat(buffer, press(buffer, source, 1), 103));
+}
+
+// Bursty trace: several remotes pressing at random, each press repeated on 1 to 3 channels with jitter,
+// interleaved with 2W traffic. Every press and every 2W frame passes exactly once.
+void test_bursty_trace() {
+    struct Event {
+        uint32_t ms;
+        uint8_t frame[32];
+        uint8_t length;
+        int id;
+    };
+    std::vector<Event> trace;
+    srand(0xd3d0);
+    const int remotes = 6;
+    uint16_t sequence[remotes] = {};
+    int ids = 0;
+    uint32_t t = 0;
+    for (int p = 0; p < 400; p++) {
+        t += rand() % 300;
+        int r = rand() % remotes;
+        const uint8_t source[3] = {0xA0, 0x00, static_cast<uint8_t>(r)};
+        Event e;
+        e.length = press(e.frame, source, ++sequence[r]);
+        e.id = ids++;
+        e.ms = t;
+        for (int copies = 4 * (1 + rand() % 3); copies; copies--) {
+            trace.push_back(e);
+            e.ms += 20 + rand() % 15;
+        }
+        if (rand() % 3 == 0) {
+            uint8_t params[4] = {static_cast<uint8_t>(p), static_cast<uint8_t>(p >> 8), 0x00, 0x01};
+            e.length = frame2W(e.frame, DEVICE, ME, 0x04, params, 4);
+            e.id = ids++;
+            e.ms = t + rand() % 50;
+            trace.push_back(e);
+        }
+    }
+    std::stable_sort(trace.begin(), trace.end(), [](const Event &a, const Event &b) { return a.ms < b.ms; });
+
+    iohcRxDedupe dedupe;
+    std::vector<int> seen(ids, 0);
+    for (auto &e : trace)
+        if (!dedupe.isRepeat(e.frame, e.length, e.ms)) seen[e.id]++;
+    int once = 0;
+    for (int count : seen) once += count == 1;
+    RxDedupeStats stats = dedupe.stats();
+    printf("  %u frames, %d events, %u unique, %u 1W repeats, %u 2W repeats, %u evicted\n",
+           static_cast<unsigned>(trace.size()), ids, stats.unique, stats.repeats1W, stats.repeats2W, stats.evicted);
+    TEST_ASSERT_EQUAL(ids, once);
+    TEST_ASSERT_EQUAL_UINT32(trace.size(), stats.unique + stats.repeats1W + stats.repeats2W);
+}
+
+void test_benchmark() {
+    iohcRxDedupe dedupe;
+    const int frames = 200000;
+    uint8_t buffer[32];
+    auto start = std::chrono::steady_clock::now();
+    int repeats = 0;
+    for (int i = 0; i < frames; i++) {
+        uint8_t source[3] = {0xA0, 0x00, static_cast<uint8_t>(i % 8)};
+        repeats += dedupe.isRepeat(buffer, press(buffer, source, i / 12), i * 5);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("  %.1f ns per frame, %d repeats\n", ns / frames, repeats);
+    TEST_ASSERT_TRUE(repeats > 0);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_1w_press_burst);
+    RUN_TEST(test_window_slides);
+    RUN_TEST(test_2w_payload);
+    RUN_TEST(test_configuration);
+    RUN_TEST(test_malformed);
+    RUN_TEST(test_eviction);
+    RUN_TEST(test_bursty_trace);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
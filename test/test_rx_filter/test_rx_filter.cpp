@@ -0,0 +1,176 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iohcRxFilter.h>
+
+using namespace IOHC;
+
+static const uint8_t ME[3] = {0xBA, 0x11, 0xAD};
+static const uint8_t GATEWAY[3] = {0x12, 0x34, 0x56};
+
+// Frame as read from the FIFO: header, payload, then the 2 CRC bytes
+static uint8_t frame(uint8_t *buffer, const uint8_t *target, uint8_t payloadLen = 2, bool oneWay = false) {
+    uint8_t length = RX_HEADER_LEN + payloadLen;
+    memset(buffer, 0, length + 2);
+    buffer[0] = (length - 1) | (oneWay ? 0x20 : 0x00) | 0x40;
+    memcpy(buffer + 2, target, 3);
+    buffer[5] = 0xAB;
+    buffer[6] = 0xCD;
+    buffer[7] = 0xEF;
+    buffer[8] = 0x03;
+    return length + 2;
+}
+
+static iohcRxFilter &configured(iohcRxFilter &filter) {
+    filter.addAddress(ME);
+    filter.addAddress(GATEWAY);
+    return filter;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_keep_own_and_broadcast() {
+    iohcRxFilter filter;
+    configured(filter);
+    uint8_t buffer[32];
+    const uint8_t broadcast2W[3] = {0xFF, 0xFF, 0xFF};
+    const uint8_t group1W[3] = {0x00, 0x00, 0x3F};
+
+    TEST_ASSERT_EQUAL(RxVerdict::Keep, filter.classify(buffer, frame(buffer, ME)));
+    TEST_ASSERT_EQUAL(RxVerdict::Keep, filter.classify(buffer, frame(buffer, GATEWAY)));
+    TEST_ASSERT_EQUAL(RxVerdict::Keep, filter.classify(buffer, frame(buffer, broadcast2W)));
+    TEST_ASSERT_EQUAL(RxVerdict::Keep, filter.classify(buffer, frame(buffer, group1W, 7, true)));
+    // Frame without CRC bytes, as replayed from a capture
+    TEST_ASSERT_EQUAL(RxVerdict::Keep, filter.classify(buffer, frame(buffer, ME) - 2));
+
+    RxFilterStats stats = filter.stats();
+    TEST_ASSERT_EQUAL_UINT32(5, stats.kept);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+}
+
+void test_broadcast_patterns() {
+    const uint8_t in[][3] = {{0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x3B}, {0x00, 0x00, 0x3F}};
+    const uint8_t out[][3] = {{0xFF, 0xFF, 0xFE}, {0x00, 0x00, 0x3A}, {0x00, 0x00, 0x40}, {0x00, 0x01, 0x3F}};
+    for (auto &target : in) TEST_ASSERT_TRUE(iohcRxFilter::isBroadcast(target));
+    for (auto &target : out) TEST_ASSERT_FALSE(iohcRxFilter::isBroadcast(target));
+}
+
+void test_others_sniff_or_drop() {
+    iohcRxFilter filter;
+    configured(filter);
+    uint8_t buffer[32];
+    const uint8_t other[3] = {0x7A, 0x00, 0x01};
+
+    TEST_ASSERT_EQUAL(RxVerdict::Drop, filter.others());
+    TEST_ASSERT_EQUAL(RxVerdict::Drop, filter.classify(buffer, frame(buffer, other)));
+    filter.setOthers(RxVerdict::Sniff);
+    TEST_ASSERT_EQUAL(RxVerdict::Sniff, filter.classify(buffer, frame(buffer, other)));
+    // Keep is not a policy for other controllers: that is what promiscuous mode is for
+    filter.setOthers(RxVerdict::Keep);
+    TEST_ASSERT_EQUAL(RxVerdict::Sniff, filter.others());
+
+    RxFilterStats stats = filter.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.kept);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.sniffed);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.malformed);
+}
+
+void test_malformed_header() {
+    iohcRxFilter filter;
+    configured(filter);
+    uint8_t buffer[32];
+
+    TEST_ASSERT_EQUAL(RxVerdict::Drop, filter.classify(buffer, 0));
+    // Header cut short
+    frame(buffer, ME);
+    TEST_ASSERT_EQUAL(RxVerdict::Drop, filter.classify(buffer, RX_HEADER_LEN - 1));
+    // MsgLen announcing less than a header
+    buffer[0] = (buffer[0] & 0xE0) | (RX_HEADER_LEN - 2);
+    TEST_ASSERT_EQUAL(RxVerdict::Drop, filter.classify(buffer, 16));
+    // MsgLen announcing more than was received
+    uint8_t length = frame(buffer, ME, 10);
+    TEST_ASSERT_EQUAL(RxVerdict::Drop, filter.classify(buffer, length - 4));
+
+    RxFilterStats stats = filter.stats();
+    TEST_ASSERT_EQUAL_UINT32(4, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.malformed);
+
+    filter.resetStats();
+    stats = filter.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.dropped + stats.malformed + stats.kept + stats.sniffed);
+}
+
+void test_promiscuous_keeps_everything() {
+    iohcRxFilter filter;
+    configured(filter);
+    uint8_t buffer[32];
+    const uint8_t other[3] = {0x7A, 0x00, 0x01};
+
+    filter.setPromiscuous(true);
+    TEST_ASSERT_EQUAL(RxVerdict::Keep, filter.classify(buffer, frame(buffer, other)));
+    TEST_ASSERT_EQUAL(RxVerdict::Keep, filter.classify(buffer, 3));
+    filter.setPromiscuous(false);
+    TEST_ASSERT_EQUAL(RxVerdict::Drop, filter.classify(buffer, frame(buffer, other)));
+    TEST_ASSERT_EQUAL_UINT32(2, filter.stats().kept);
+}
+
+void test_address_table() {
+    iohcRxFilter filter;
+    uint8_t address[3] = {0x10, 0x00, 0x00};
+    for (uint8_t i = 0; i < RX_FILTER_MAX_ADDRESSES; i++) {
+        address[2] = i;
+        TEST_ASSERT_TRUE(filter.addAddress(address));
+    }
+    // Already known: accepted without taking a slot
+    TEST_ASSERT_TRUE(filter.addAddress(address));
+    address[2] = 0xEE;
+    TEST_ASSERT_FALSE(filter.addAddress(address));
+    TEST_ASSERT_FALSE(filter.isOwn(address));
+    address[2] = 0;
+    TEST_ASSERT_TRUE(filter.isOwn(address));
+}
+
+// Dense site: most frames belong to other controllers and stop in the radio task
+void test_dense_site_mix() {
+    iohcRxFilter filter;
+    configured(filter);
+    uint8_t frames[64][32];
+    uint8_t lengths[64];
+    srand(9);
+    for (int i = 0; i < 64; i++) {
+        uint8_t target[3] = {static_cast<uint8_t>(rand()), static_cast<uint8_t>(rand()), static_cast<uint8_t>(rand())};
+        if (i % 10 == 0) memcpy(target, ME, 3);
+        lengths[i] = frame(frames[i], target, rand() % 20);
+    }
+    const uint32_t rounds = 100000;
+    uint32_t kept = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rounds; r++)
+        for (int i = 0; i < 64; i++)
+            kept += filter.classify(frames[i], lengths[i]) == RxVerdict::Keep;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                (rounds * 64.0);
+    RxFilterStats stats = filter.stats();
+    printf("  classify(): %.1f ns per frame (host), kept %u dropped %u\n", ns, stats.kept, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(7 * rounds, kept);
+    TEST_ASSERT_EQUAL_UINT32(57 * rounds, stats.dropped);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_keep_own_and_broadcast);
+    RUN_TEST(test_broadcast_patterns);
+    RUN_TEST(test_others_sniff_or_drop);
+    RUN_TEST(test_malformed_header);
+    RUN_TEST(test_promiscuous_keeps_everything);
+    RUN_TEST(test_address_table);
+    RUN_TEST(test_dense_site_mix);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <iohcRxRing.h>
+
+using namespace IOHC;
+
+struct TestRecord {
+    uint32_t seq;
+    uint8_t buffer[32];
+    uint8_t length;
+};
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_fifo_order_and_recycling() {
+    iohcRxRing<TestRecord, 4> ring;
+
+    for (uint32_t round = 0; round < 10; round++) {
+        for (uint32_t i = 0; i < 3; i++) {
+            TestRecord *rec = ring.acquire();
+            TEST_ASSERT_NOT_NULL(rec);
+            rec->seq = round * 10 + i;
+            ring.commit(rec);
+        }
+        for (uint32_t i = 0; i < 3; i++) {
+            TestRecord *rec = ring.pop();
+            TEST_ASSERT_NOT_NULL(rec);
+            TEST_ASSERT_EQUAL_UINT32(round * 10 + i, rec->seq);
+            ring.release(rec);
+        }
+        TEST_ASSERT_NULL(ring.pop());
+    }
+
+    RxRingStats stats = ring.stats();
+    TEST_ASSERT_EQUAL_UINT32(30, stats.pushed);
+    TEST_ASSERT_EQUAL_UINT32(30, stats.popped);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.highWater);
+}
+
+void test_drop_newest_keeps_queued_frames() {
+    iohcRxRing<TestRecord, 4> ring(RxOverflowPolicy::DropNewest);
+
+    for (uint32_t i = 0; i < 6; i++) {
+        TestRecord *rec = ring.acquire();
+        if (!rec) continue;
+        rec->seq = i;
+        ring.commit(rec);
+    }
+
+    RxRingStats stats = ring.stats();
+    TEST_ASSERT_EQUAL_UINT32(4, stats.pushed);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.highWater);
+
+    for (uint32_t i = 0; i < 4; i++) {
+        TestRecord *rec = ring.pop();
+        TEST_ASSERT_NOT_NULL(rec);
+        TEST_ASSERT_EQUAL_UINT32(i, rec->seq);
+        ring.release(rec);
+    }
+    TEST_ASSERT_NULL(ring.pop());
+}
+
+void test_drop_oldest_recycles_queued_frames() {
+    iohcRxRing<TestRecord, 4> ring(RxOverflowPolicy::DropOldest);
+
+    for (uint32_t i = 0; i < 6; i++) {
+        TestRecord *rec = ring.acquire();
+        TEST_ASSERT_NOT_NULL(rec);
+        rec->seq = i;
+        ring.commit(rec);
+    }
+
+    RxRingStats stats = ring.stats();
+    TEST_ASSERT_EQUAL_UINT32(6, stats.pushed);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.overwritten);
+
+    for (uint32_t i = 2; i < 6; i++) {
+        TestRecord *rec = ring.pop();
+        TEST_ASSERT_NOT_NULL(rec);
+        TEST_ASSERT_EQUAL_UINT32(i, rec->seq);
+        ring.release(rec);
+    }
+    TEST_ASSERT_NULL(ring.pop());
+}
+
+// One producer thread, one consumer thread; every frame must arrive intact, in order, exactly once
+static void stress(RxOverflowPolicy policy) {
+    constexpr uint32_t FRAMES = 1000000;
+    static iohcRxRing<TestRecord, 16> ring;
+    ring.setOverflowPolicy(policy);
+    ring.resetStats();
+
+    std::atomic<bool> done{false};
+    uint32_t received = 0;
+    uint32_t corrupted = 0;
+    uint32_t outOfOrder = 0;
+
+    std::thread consumer([&] {
+        uint32_t last = 0;
+        bool first = true;
+        while (true) {
+            TestRecord *rec = ring.pop();
+            if (!rec) {
+                if (done.load(std::memory_order_acquire) && ring.depth() == 0) break;
+                std::this_thread::yield();
+                continue;
+            }
+            for (uint8_t i = 0; i < rec->length; i++)
+                if (rec->buffer[i] != static_cast<uint8_t>(rec->seq + i)) corrupted++;
+            if (!first && rec->seq <= last) outOfOrder++;
+            last = rec->seq;
+            first = false;
+            received++;
+            ring.release(rec);
+        }
+    });
+
+    std::thread producer([&] {
+        for (uint32_t seq = 0; seq < FRAMES; seq++) {
+            // Mostly pace on the consumer, but fire a 32-frame burst every 4096 frames to overflow the pool
+            bool burst = (seq % 4096) < 32;
+            while (!burst && ring.depth() >= ring.capacity() - 1)
+                std::this_thread::yield();
+            TestRecord *rec = ring.acquire();
+            if (!rec) continue;
+            rec->seq = seq;
+            rec->length = 9 + (seq % 24);
+            for (uint8_t i = 0; i < rec->length; i++)
+                rec->buffer[i] = static_cast<uint8_t>(seq + i);
+            ring.commit(rec);
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    producer.join();
+    consumer.join();
+
+    RxRingStats stats = ring.stats();
+    printf("  %s: pushed %u popped %u dropped %u overwritten %u highWater %u\n",
+           policy == RxOverflowPolicy::DropNewest ? "DropNewest" : "DropOldest",
+           stats.pushed, stats.popped, stats.dropped, stats.overwritten, stats.highWater);
+
+    TEST_ASSERT_EQUAL_UINT32(0, corrupted);
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(received, stats.popped);
+    TEST_ASSERT_EQUAL_UINT32(FRAMES, stats.pushed + stats.dropped);
+    TEST_ASSERT_GREATER_THAN_UINT32(FRAMES / 2, stats.pushed);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.dropped + stats.overwritten);
+    TEST_ASSERT_EQUAL_UINT32(stats.pushed, stats.popped + stats.overwritten);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(16, stats.highWater);
+}
+
+void test_stress_drop_newest() {
+    stress(RxOverflowPolicy::DropNewest);
+}
+
+void test_stress_drop_oldest() {
+    stress(RxOverflowPolicy::DropOldest);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_order_and_recycling);
+    RUN_TEST(test_drop_newest_keeps_queued_frames);
+    RUN_TEST(test_drop_oldest_recycles_queued_frames);
+    RUN_TEST(test_stress_drop_newest);
+    RUN_TEST(test_stress_drop_oldest);
+    return UNITY_END();
+}
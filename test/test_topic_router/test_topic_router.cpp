@@ -0,0 +1,251 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+#include <iohcTopicRouter.h>
+#include <iohcDeviceIndex.h>
+#include "../heap_accounting.h"
+
+using namespace IOHC;
+
+// The routes onMqttMessage registers
+enum Route { Set = 1, Position, Absolute, Pair, Add, Remove, TravelTime };
+
+static void addGatewayRoutes(iohcTopicRouter<int> &router) {
+    TEST_ASSERT_TRUE(router.add("iown/+/set", Set));
+    TEST_ASSERT_TRUE(router.add("iown/+/position/set", Position));
+    TEST_ASSERT_TRUE(router.add("iown/+/absolute/set", Absolute));
+    TEST_ASSERT_TRUE(router.add("iown/+/pair", Pair));
+    TEST_ASSERT_TRUE(router.add("iown/+/add", Add));
+    TEST_ASSERT_TRUE(router.add("iown/+/remove", Remove));
+    TEST_ASSERT_TRUE(router.add("iown/+/travel_time/set", TravelTime));
+}
+
+// Literals outlive the captures pointing into them
+static bool route(const iohcTopicRouter<int> &router, const char *topic, iohcTopicRouter<int>::Match &m) {
+    return router.match(topic, strlen(topic), m);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_gateway_routes() {
+    iohcTopicRouter<int> router;
+    addGatewayRoutes(router);
+    TEST_ASSERT_EQUAL(7, router.routes());
+
+    iohcTopicRouter<int>::Match m;
+    TEST_ASSERT_TRUE(route(router, "iown/a1b2c3/set", m));
+    TEST_ASSERT_EQUAL(Set, m.handler);
+    TEST_ASSERT_EQUAL(1, m.count);
+    TEST_ASSERT_TRUE(m.params[0] == "a1b2c3");
+    TEST_ASSERT_EQUAL_STRING("a1b2c3", m.params[0].str().c_str());
+
+    TEST_ASSERT_TRUE(route(router, "iown/a1b2c3/position/set", m));
+    TEST_ASSERT_EQUAL(Position, m.handler);
+    TEST_ASSERT_TRUE(route(router, "iown/A1B2C3/travel_time/set", m));
+    TEST_ASSERT_EQUAL(TravelTime, m.handler);
+    TEST_ASSERT_TRUE(m.params[0] == "A1B2C3");
+    TEST_ASSERT_TRUE(route(router, "iown/a1b2c3/remove", m));
+    TEST_ASSERT_EQUAL(Remove, m.handler);
+
+    // The substring checks this replaces took these for device commands
+    TEST_ASSERT_FALSE(route(router, "iown/a1b2c3/settings", m));
+    TEST_ASSERT_FALSE(route(router, "iown/a1b2c3/position", m));
+    TEST_ASSERT_FALSE(route(router, "iown/a1b2c3/set/more", m));
+    TEST_ASSERT_FALSE(route(router, "iown/set", m));
+    TEST_ASSERT_FALSE(route(router, "homeassistant/cover/a1b2c3/set", m));
+    TEST_ASSERT_FALSE(route(router, "", m));
+    TEST_ASSERT_FALSE(route(router, "iown", m));
+}
+
+// Literal before "+", "+" before "#", backtracking out of a dead end
+void test_precedence() {
+    iohcTopicRouter<int> router;
+    TEST_ASSERT_TRUE(router.add("a/+/c", 1));
+    TEST_ASSERT_TRUE(router.add("a/b/d", 2));
+    TEST_ASSERT_TRUE(router.add("a/#", 3));
+    TEST_ASSERT_TRUE(router.add("a/b/c", 4));
+
+    iohcTopicRouter<int>::Match m;
+    TEST_ASSERT_TRUE(route(router, "a/b/c", m));
+    TEST_ASSERT_EQUAL(4, m.handler);
+    TEST_ASSERT_EQUAL(0, m.count);
+    TEST_ASSERT_TRUE(route(router, "a/x/c", m));
+    TEST_ASSERT_EQUAL(1, m.handler);
+    TEST_ASSERT_TRUE(m.params[0] == "x");
+    TEST_ASSERT_TRUE(route(router, "a/b/d", m));
+    TEST_ASSERT_EQUAL(2, m.handler);
+
+    // "a/b/e": the literal b and then "+" lead nowhere, "#" takes it
+    TEST_ASSERT_TRUE(route(router, "a/b/e", m));
+    TEST_ASSERT_EQUAL(3, m.handler);
+    TEST_ASSERT_EQUAL(1, m.count);
+    TEST_ASSERT_TRUE(m.params[0] == "b/e");
+
+    // "#" includes the parent level
+    TEST_ASSERT_TRUE(route(router, "a", m));
+    TEST_ASSERT_EQUAL(3, m.handler);
+    TEST_ASSERT_EQUAL(0, m.params[0].length);
+    TEST_ASSERT_FALSE(route(router, "b", m));
+}
+
+void test_wildcards_and_captures() {
+    iohcTopicRouter<int> router;
+    TEST_ASSERT_TRUE(router.add("+/+/x/#", 1));
+    TEST_ASSERT_TRUE(router.add("#", 2));
+    TEST_ASSERT_TRUE(router.add("s/+", 3));
+
+    iohcTopicRouter<int>::Match m;
+    TEST_ASSERT_TRUE(route(router, "p/q/x/r/s", m));
+    TEST_ASSERT_EQUAL(1, m.handler);
+    TEST_ASSERT_EQUAL(3, m.count);
+    TEST_ASSERT_TRUE(m.params[0] == "p");
+    TEST_ASSERT_TRUE(m.params[1] == "q");
+    TEST_ASSERT_TRUE(m.params[2] == "r/s");
+
+    // Empty levels are levels
+    TEST_ASSERT_TRUE(route(router, "s/", m));
+    TEST_ASSERT_EQUAL(3, m.handler);
+    TEST_ASSERT_EQUAL(0, m.params[0].length);
+    TEST_ASSERT_TRUE(route(router, "/q/x", m));
+    TEST_ASSERT_EQUAL(1, m.handler);
+    TEST_ASSERT_EQUAL(0, m.params[0].length);
+
+    TEST_ASSERT_TRUE(route(router, "anything/else", m));
+    TEST_ASSERT_EQUAL(2, m.handler);
+
+    // No wildcard in the first level for system topics
+    TEST_ASSERT_FALSE(route(router, "$SYS/broker/load", m));
+    TEST_ASSERT_TRUE(router.add("$SYS/#", 4));
+    TEST_ASSERT_TRUE(route(router, "$SYS/broker/load", m));
+    TEST_ASSERT_EQUAL(4, m.handler);
+}
+
+void test_invalid_filters() {
+    iohcTopicRouter<int> router;
+    TEST_ASSERT_FALSE(router.add("", 1));
+    TEST_ASSERT_FALSE(router.add("a/#/b", 1));
+    TEST_ASSERT_FALSE(router.add("a/b+", 1));
+    TEST_ASSERT_FALSE(router.add("a/#b", 1));
+    TEST_ASSERT_FALSE(router.add("+/+/+/+/+", 1));
+    TEST_ASSERT_TRUE(router.add("a/+", 1));
+    TEST_ASSERT_FALSE(router.add("a/+", 2));
+    TEST_ASSERT_TRUE(router.add("a/#", 2));
+    TEST_ASSERT_FALSE(router.add("a/#", 3));
+    TEST_ASSERT_EQUAL(2, router.routes());
+}
+
+void test_zero_heap() {
+    iohcTopicRouter<int> router;
+    addGatewayRoutes(router);
+    router.add("iown/#", 99);
+    const std::string topics[] = {"iown/a1b2c3/set", "iown/a1b2c3/travel_time/set", "iown/powerOn", "other/topic"};
+    iohcTopicRouter<int>::Match m;
+    int matched = 0;
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < 1000; i++)
+        for (const auto &topic : topics) matched += router.match(topic, m);
+    counting = false;
+    TEST_ASSERT_EQUAL(0, allocations.load());
+    TEST_ASSERT_EQUAL(3000, matched);
+}
+
+// The rfind/find cascade and find_if over hex strings onMqttMessage used, down to the device it picked
+static int cascade(const std::string &topicStr, const std::vector<uint32_t> &remotes, int *device) {
+    static const char *const suffixes[] = {"/travel_time/set", "/position/set", "/absolute/set", "/set", "/pair",
+                                           "/add", "/remove"};
+    static const int routes[] = {TravelTime, Position, Absolute, Set, Pair, Add, Remove};
+    for (int s = 0; s < 7; s++) {
+        if (topicStr.rfind("iown/", 0) == 0 && topicStr.find(suffixes[s], 5) != std::string::npos) {
+            std::string id = topicStr.substr(5, topicStr.find(suffixes[s], 5) - 5);
+            std::transform(id.begin(), id.end(), id.begin(), ::tolower);
+            auto it = std::find_if(remotes.begin(), remotes.end(), [&](uint32_t r) {
+                char hex[7];
+                snprintf(hex, sizeof(hex), "%06x", r);
+                return std::string(hex) == id;
+            });
+            *device = it == remotes.end() ? -1 : static_cast<int>(it - remotes.begin());
+            return routes[s];
+        }
+    }
+    return 0;
+}
+
+void test_benchmark() {
+    iohcTopicRouter<int> router;
+    addGatewayRoutes(router);
+    static const char *const commands[] = {"set", "position/set", "absolute/set", "pair", "travel_time/set"};
+
+    for (uint32_t devices : {10u, 100u, 1000u}) {
+        iohcDeviceIndex index;
+        std::vector<uint32_t> remotes;
+        std::vector<std::string> topics;
+        srand(0x7091c);
+        for (uint32_t i = 0; i < devices; i++) {
+            uint32_t packed = (rand() & 0xFFFFFF) | 1;
+            remotes.push_back(packed);
+            const uint8_t node[3] = {static_cast<uint8_t>(packed >> 16), static_cast<uint8_t>(packed >> 8),
+                                     static_cast<uint8_t>(packed)};
+            index.put(DeviceKind::Remote1W, node, i);
+        }
+        for (int i = 0; i < 512; i++) {
+            char topic[64];
+            snprintf(topic, sizeof(topic), "iown/%06x/%s", remotes[rand() % devices], commands[rand() % 5]);
+            topics.emplace_back(topic);
+        }
+
+        const int rounds = devices >= 1000 ? 4 : 40;
+        long checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++)
+            for (const auto &topic : topics) {
+                int device = -1;
+                checksum += cascade(topic, remotes, &device) + device;
+            }
+        const double cascadeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+                                     .count() / (rounds * topics.size());
+
+        long routed = 0;
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++)
+            for (const auto &topic : topics) {
+                iohcTopicRouter<int>::Match m;
+                int device = -1;
+                uint8_t node[3];
+                if (router.match(topic, m) &&
+                    iohcDeviceIndex::parseAddress(m.params[0].data, m.params[0].length, node)) {
+                    uint32_t slot = index.find(DeviceKind::Remote1W, node);
+                    device = slot == DEVICE_INDEX_NONE ? -1 : static_cast<int>(slot);
+                }
+                routed += m.handler + device;
+            }
+        const double routerNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+                                    .count() / (rounds * topics.size());
+
+        TEST_ASSERT_EQUAL(checksum, routed);
+        TEST_ASSERT_TRUE(routerNs < cascadeNs);
+        printf("  %4u devices: cascade %8.0f ns, router %5.0f ns per topic\n", devices, cascadeNs, routerNs);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_gateway_routes);
+    RUN_TEST(test_precedence);
+    RUN_TEST(test_wildcards_and_captures);
+    RUN_TEST(test_invalid_filters);
+    RUN_TEST(test_zero_heap);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
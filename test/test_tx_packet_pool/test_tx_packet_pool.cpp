@@ -0,0 +1,230 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <iohcPacketPool.h>
+#include <iohcTxQueue.h>
+#include "../heap_accounting.h"
+
+using namespace IOHC;
+
+struct Packet {
+    uint8_t payload[32];
+    uint8_t length;
+};
+
+using Pool = iohcPacketPool<Packet, 8>;
+
+static Pool *disposer;
+static void dispose(Packet *packet) { disposer->dispose(packet); }
+
+static uint32_t reports[3];
+static TxReport last;
+static void onDone(const TxReport &report) {
+    reports[static_cast<uint8_t>(report.status)]++;
+    last = report;
+}
+
+void setUp(void) {
+    memset(reports, 0, sizeof(reports));
+    last = {};
+}
+
+void tearDown(void) {
+}
+
+void test_acquire_release() {
+    Pool pool;
+    Packet *packets[8];
+    for (auto &packet : packets) {
+        packet = pool.acquire();
+        TEST_ASSERT_NOT_NULL(packet);
+        TEST_ASSERT_EQUAL_UINT8(1, pool.refs(packet));
+        packet->length = 9;
+    }
+    TEST_ASSERT_NULL(pool.acquire());
+    TEST_ASSERT_EQUAL_UINT32(1, pool.stats().exhausted);
+    TEST_ASSERT_EQUAL_UINT32(8, pool.stats().highWater);
+
+    TEST_ASSERT_TRUE(pool.release(packets[3]));
+    Packet *again = pool.acquire();
+    TEST_ASSERT_EQUAL_PTR(packets[3], again);
+    // Handed out reset
+    TEST_ASSERT_EQUAL_UINT8(0, again->length);
+
+    for (auto &packet : packets) pool.release(packet);
+    TEST_ASSERT_EQUAL(8, pool.available());
+    TEST_ASSERT_EQUAL_UINT32(0, pool.stats().inUse);
+}
+
+// A sender keeping the buffer for a retry holds its own reference: the radio letting go does not free it
+void test_retain_keeps_buffer() {
+    Pool pool;
+    disposer = &pool;
+    iohcTxQueue<Packet> queue;
+    Packet *packet = pool.acquire();
+    pool.retain(packet);
+
+    std::vector<Packet *> packets{packet};
+    TEST_ASSERT_TRUE(queue.push(packets, TxPriority::Normal, TxSource::Device2W, 100, 0, 0, 0, onDone));
+    TxBatch<Packet> batch;
+    TEST_ASSERT_TRUE(queue.pop(batch, 200));
+    batch.startedUs = 200;
+    queue.complete(std::move(batch), TxStatus::Sent, 300);
+    TEST_ASSERT_EQUAL(1, queue.drainCompleted(dispose));
+
+    TEST_ASSERT_EQUAL_UINT8(1, pool.refs(packet));
+    TEST_ASSERT_EQUAL(7, pool.available());
+    TEST_ASSERT_TRUE(pool.release(packet));
+    TEST_ASSERT_EQUAL(8, pool.available());
+}
+
+void test_reports_with_timestamps() {
+    Pool pool;
+    disposer = &pool;
+    iohcTxQueue<Packet> queue;
+
+    std::vector<Packet *> packets{pool.acquire(), pool.acquire()};
+    queue.push(packets, TxPriority::Normal, TxSource::Device2W, 1000, 0, 0, 0, onDone);
+    TxBatch<Packet> batch;
+    TEST_ASSERT_TRUE(queue.pop(batch, 1500));
+    batch.startedUs = 1600;
+    queue.complete(std::move(batch), TxStatus::Sent, 9000);
+    // Nothing reported until drained
+    TEST_ASSERT_EQUAL_UINT32(0, reports[0]);
+    TEST_ASSERT_EQUAL(1, queue.completed());
+    queue.drainCompleted(dispose);
+    TEST_ASSERT_EQUAL_UINT32(1, reports[static_cast<uint8_t>(TxStatus::Sent)]);
+    TEST_ASSERT_EQUAL_UINT8(2, last.frames);
+    TEST_ASSERT_EQUAL_UINT64(1000, last.queuedUs);
+    TEST_ASSERT_EQUAL_UINT64(1600, last.startedUs);
+    TEST_ASSERT_EQUAL_UINT64(9000, last.doneUs);
+
+    packets = {pool.acquire()};
+    queue.push(packets, TxPriority::Normal, TxSource::Discovery, 2000, 5000, 0, 0, onDone);
+    TEST_ASSERT_FALSE(queue.pop(batch, 6000));
+    queue.drainCompleted(dispose);
+    TEST_ASSERT_EQUAL_UINT32(1, reports[static_cast<uint8_t>(TxStatus::Expired)]);
+    TEST_ASSERT_EQUAL(TxSource::Discovery, last.source);
+    TEST_ASSERT_EQUAL_UINT64(0, last.startedUs);
+    TEST_ASSERT_EQUAL_UINT64(6000, last.doneUs);
+
+    // Refused by a full queue: reported aborted, packets still given back
+    TxBatch<Packet> rejected;
+    rejected.packets = {pool.acquire()};
+    rejected.source = TxSource::Pairing;
+    rejected.queuedUs = 7000;
+    rejected.onDone = onDone;
+    queue.complete(std::move(rejected), TxStatus::Aborted, 7000);
+    queue.drainCompleted(dispose);
+    TEST_ASSERT_EQUAL_UINT32(1, reports[static_cast<uint8_t>(TxStatus::Aborted)]);
+    TEST_ASSERT_EQUAL_UINT32(1, queue.stats(TxSource::Pairing).aborted);
+
+    TEST_ASSERT_EQUAL(8, pool.available());
+}
+
+// Packets allocated outside of the pool are still accepted, and deleted
+void test_heap_fallback() {
+    Pool pool;
+    disposer = &pool;
+    iohcTxQueue<Packet> queue;
+    Packet *heap = new Packet();
+    TEST_ASSERT_FALSE(pool.owns(heap));
+    std::vector<Packet *> packets{heap, pool.acquire()};
+    queue.push(packets, TxPriority::Normal, TxSource::Device2W, 0);
+    TxBatch<Packet> batch;
+    queue.pop(batch, 0);
+    long before = frees;
+    counting = true;
+    queue.complete(std::move(batch), TxStatus::Sent, 10);
+    queue.drainCompleted(dispose);
+    counting = false;
+    TEST_ASSERT_TRUE(frees > before);
+    TEST_ASSERT_EQUAL(8, pool.available());
+}
+
+// A callback may queue the next batch: no lock is held while it runs
+static iohcTxQueue<Packet> *chainQueue;
+static Pool *chainPool;
+static uint32_t chained;
+static void onDoneChain(const TxReport &report) {
+    if (chained++ >= 3) return;
+    std::vector<Packet *> packets{chainPool->acquire()};
+    chainQueue->push(packets, TxPriority::Normal, TxSource::Device2W, report.doneUs, 0, 0, 0, onDoneChain);
+}
+
+void test_callback_chains_next_batch() {
+    Pool pool;
+    iohcTxQueue<Packet> queue;
+    disposer = chainPool = &pool;
+    chainQueue = &queue;
+    chained = 0;
+    std::vector<Packet *> packets{pool.acquire()};
+    queue.push(packets, TxPriority::Normal, TxSource::Device2W, 0, 0, 0, 0, onDoneChain);
+    TxBatch<Packet> batch;
+    uint64_t now = 0;
+    while (queue.pop(batch, now)) {
+        queue.complete(std::move(batch), TxStatus::Sent, now += 100);
+        queue.drainCompleted(dispose);
+    }
+    TEST_ASSERT_EQUAL_UINT32(4, chained);
+    TEST_ASSERT_EQUAL(8, pool.available());
+}
+
+// Steady state command traffic: every packet comes from the pool and goes back to it
+void test_no_net_allocation() {
+    Pool pool;
+    disposer = &pool;
+    iohcTxQueue<Packet> queue;
+    std::vector<Packet *> packets;
+    TxBatch<Packet> batch;
+    const uint32_t commands = 100000;
+    uint64_t now = 0;
+    auto run = [&](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            uint8_t frames = 1 + i % 3;
+            for (uint8_t f = 0; f < frames; f++) {
+                Packet *packet = pool.acquire();
+                packet->length = 9 + f;
+                packets.push_back(packet);
+            }
+            queue.push(packets, TxPriority::Normal, TxSource::Device2W, now, i % 5 ? 0 : now + 1, 0, 0, onDone);
+            packets.clear();
+            now += 10;
+            if (queue.pop(batch, now)) {
+                batch.startedUs = now;
+                queue.complete(std::move(batch), TxStatus::Sent, now + 5);
+            }
+            queue.drainCompleted(dispose);
+        }
+    };
+
+    // Queue storage reaches its steady size first
+    run(1000);
+    memset(reports, 0, sizeof(reports));
+    allocations = frees = 0;
+    counting = true;
+    run(commands);
+    counting = false;
+
+    printf("  %u commands: %ld allocations, %ld frees, pool high water %u\n", commands, allocations.load(),
+           frees.load(), pool.stats().highWater);
+    TEST_ASSERT_EQUAL(allocations.load(), frees.load());
+    TEST_ASSERT_EQUAL(8, pool.available());
+    TEST_ASSERT_EQUAL_UINT32(0, pool.stats().exhausted);
+    TEST_ASSERT_EQUAL_UINT32(commands, reports[0] + reports[1]);
+    TEST_ASSERT_EQUAL_UINT32(commands / 5, reports[static_cast<uint8_t>(TxStatus::Expired)]);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_acquire_release);
+    RUN_TEST(test_retain_keeps_buffer);
+    RUN_TEST(test_reports_with_timestamps);
+    RUN_TEST(test_heap_fallback);
+    RUN_TEST(test_callback_chains_next_batch);
+    RUN_TEST(test_no_net_allocation);
+    return UNITY_END();
+}
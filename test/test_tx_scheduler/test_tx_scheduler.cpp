@@ -0,0 +1,316 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include <iohcTxQueue.h>
+#include <iohcTxSequencer.h>
+
+using namespace IOHC;
+
+/*
+    Virtual-clock model of iohcRadio's TX path: send() pushes into the queue, dispatch pops what is due or arms
+    the scheduler timer for the earliest delayed batch, the sequencer runs the frames. Timer callbacks arrive
+    timerLatencyUs late, PacketSent interrupts isrLatencyUs late.
+*/
+struct Packet {
+    uint32_t id;
+    uint8_t length;
+    uint8_t repeat;
+    uint32_t repeatTimeMs;
+    uint32_t delayedMs;
+    bool shortPreamble;
+};
+
+static constexpr uint16_t LONG_PREAMBLE = 1920;
+static constexpr uint16_t SHORT_PREAMBLE = 40;
+
+struct Start {
+    uint32_t id;
+    uint64_t at;
+    uint64_t scheduledUs;   // 0: as soon as possible
+};
+
+struct SimRadio {
+    uint32_t timerLatencyUs = 0;
+    uint32_t isrLatencyUs = 0;
+
+    uint64_t now = 0;
+    uint64_t packetSentAt = UINT64_MAX;
+    uint64_t packetSentStamp = 0;
+    uint64_t seqTimerAt = UINT64_MAX;
+    uint64_t schedTimerAt = UINT64_MAX;
+    bool listening = true;
+    uint64_t busyUntil = 0;     // End of the last transmission
+
+    iohcTxQueue<Packet> queue;
+    iohcTxSequencer<SimRadio> seq{*this};
+    std::vector<Packet *> current;
+    std::vector<Start> starts;              // First frame of each batch
+    std::vector<uint64_t> txStart, txEnd;   // Every transmission
+    std::vector<uint32_t> expired;
+
+    static uint32_t durationUs(const std::vector<Packet *> &packets) {
+        uint32_t total = 0;
+        for (size_t i = 0; i < packets.size(); i++) {
+            const Packet *p = packets[i];
+            if (i) total += std::max(packets[i - 1]->repeatTimeMs, p->delayedMs) * 1000;
+            total += p->repeat * p->repeatTimeMs * 1000;
+            total += (p->repeat + 1) * iohcAirtimeUs(SHORT_PREAMBLE, p->length);
+        }
+        if (!packets[0]->shortPreamble)
+            total += iohcAirtimeUs(LONG_PREAMBLE, 0) - iohcAirtimeUs(SHORT_PREAMBLE, 0);
+        return total;
+    }
+
+    // iohcRadio::send() / sendAt()
+    bool send(std::vector<Packet *> packets, TxPriority priority, uint64_t startUs = 0, uint64_t deadlineUs = 0) {
+        if (!startUs && packets[0]->delayedMs) startUs = now + packets[0]->delayedMs * 1000ULL;
+        uint32_t duration = durationUs(packets);
+        if (!queue.push(packets, priority, TxSource::Other, now, deadlineUs, startUs, duration)) return false;
+        if (!seq.busy()) dispatch();
+        return true;
+    }
+
+    // iohcRadio::dispatchNext()
+    bool dispatch() {
+        TxBatch<Packet> batch;
+        auto onExpired = [this](TxBatch<Packet> &b) { expired.push_back(b.packets[0]->id); };
+        if (!queue.pop(batch, now, onExpired)) {
+            uint64_t next = queue.nextStartUs(now);
+            schedTimerAt = next ? next + timerLatencyUs : UINT64_MAX;
+            return false;
+        }
+        current = std::move(batch.packets);
+        starts.push_back({current[0]->id, now, batch.startUs});
+        return seq.start(current.size(), now);
+    }
+
+    // Sequencer driver
+    TxSlot slot(size_t frame, bool first) const {
+        const Packet *p = current[frame];
+        uint16_t preamble = first && !p->shortPreamble ? LONG_PREAMBLE : SHORT_PREAMBLE;
+        return {p->repeat, p->repeatTimeMs * 1000, iohcAirtimeUs(preamble, p->length), p->delayedMs * 1000};
+    }
+
+    void transmit(size_t frame, bool first) {
+        const Packet *p = current[frame];
+        uint32_t airtime = iohcAirtimeUs(first && !p->shortPreamble ? LONG_PREAMBLE : SHORT_PREAMBLE, p->length);
+        listening = false;
+        txStart.push_back(now);
+        txEnd.push_back(now + airtime);
+        busyUntil = now + airtime;
+        packetSentStamp = now + airtime;
+        packetSentAt = now + airtime + isrLatencyUs;
+    }
+
+    void arm(uint32_t delayUs) { seqTimerAt = now + delayUs + timerLatencyUs; }
+    void listen() { listening = true; }
+    void finish() {
+        seqTimerAt = UINT64_MAX;
+        current.clear();
+        if (!dispatch()) listening = true;
+    }
+
+    // Processes every event up to untilUs
+    void runUntil(uint64_t untilUs) {
+        while (true) {
+            uint64_t next = std::min({packetSentAt, seqTimerAt, schedTimerAt});
+            if (next > untilUs) break;
+            now = next;
+            if (next == packetSentAt) {
+                packetSentAt = UINT64_MAX;
+                seq.onPacketSent(packetSentStamp, now);
+            } else if (next == seqTimerAt) {
+                seqTimerAt = UINT64_MAX;
+                seq.onTimer(now);
+            } else {
+                schedTimerAt = UINT64_MAX;
+                if (!seq.busy()) dispatch();
+            }
+        }
+        now = untilUs;
+    }
+};
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_delayed_batch_waits_in_rx() {
+    SimRadio radio;
+    radio.timerLatencyUs = 30;
+    Packet reply = {1, 16, 0, 0, 250, true};
+
+    radio.now = 1000;
+    TEST_ASSERT_TRUE(radio.send({&reply}, TxPriority::Urgent));
+    TEST_ASSERT_TRUE(radio.starts.empty());
+    TEST_ASSERT_EQUAL_UINT64(251000, radio.queue.nextStartUs(radio.now));
+
+    radio.runUntil(250999);
+    TEST_ASSERT_TRUE(radio.starts.empty());
+    TEST_ASSERT_TRUE(radio.listening);
+
+    radio.runUntil(1000000);
+    TEST_ASSERT_EQUAL(1, radio.starts.size());
+    TEST_ASSERT_EQUAL_UINT64(251030, radio.starts[0].at);
+
+    TxSourceStats stats = radio.queue.stats(TxSource::Other);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.scheduled);
+    TEST_ASSERT_EQUAL_UINT32(30, stats.maxStartErrorUs);
+    TEST_ASSERT_EQUAL_UINT32(30, stats.maxWaitUs);
+}
+
+void test_ready_batch_goes_ahead_of_delayed() {
+    SimRadio radio;
+    Packet reply = {1, 16, 0, 0, 250, true};
+    Packet command = {2, 21, 1, 25, 0, true};
+
+    radio.send({&reply}, TxPriority::Urgent);
+    radio.runUntil(10000);
+    radio.send({&command}, TxPriority::Normal);
+    radio.runUntil(1000000);
+
+    TEST_ASSERT_EQUAL(2, radio.starts.size());
+    TEST_ASSERT_EQUAL_UINT32(2, radio.starts[0].id);
+    TEST_ASSERT_EQUAL_UINT64(10000, radio.starts[0].at);
+    TEST_ASSERT_EQUAL_UINT32(1, radio.starts[1].id);
+    TEST_ASSERT_EQUAL_UINT64(250000, radio.starts[1].at);
+}
+
+void test_long_batch_held_until_scheduled_one_is_sent() {
+    SimRadio radio;
+    Packet reply = {1, 16, 0, 0, 250, true};
+    // Long preamble (400 ms) would still be on air when the reply is due
+    Packet discovery = {2, 13, 2, 25, 0, false};
+
+    radio.send({&reply}, TxPriority::Urgent);
+    radio.runUntil(100000);
+    radio.send({&discovery}, TxPriority::Background);
+    radio.runUntil(100000);
+    TEST_ASSERT_TRUE(radio.starts.empty());
+
+    radio.runUntil(2000000);
+    TEST_ASSERT_EQUAL(2, radio.starts.size());
+    TEST_ASSERT_EQUAL_UINT32(1, radio.starts[0].id);
+    TEST_ASSERT_EQUAL_UINT64(250000, radio.starts[0].at);
+    TEST_ASSERT_EQUAL_UINT32(2, radio.starts[1].id);
+    TEST_ASSERT_EQUAL_UINT64(radio.txEnd[0], radio.starts[1].at);
+
+    // A short one still fits in front of the reply
+    SimRadio other;
+    Packet shortOne = {3, 13, 0, 0, 0, true};
+    other.send({&reply}, TxPriority::Urgent);
+    other.runUntil(100000);
+    other.send({&shortOne}, TxPriority::Background);
+    other.runUntil(2000000);
+    TEST_ASSERT_EQUAL(2, other.starts.size());
+    TEST_ASSERT_EQUAL_UINT32(3, other.starts[0].id);
+    TEST_ASSERT_EQUAL_UINT64(100000, other.starts[0].at);
+    TEST_ASSERT_EQUAL_UINT64(250000, other.starts[1].at);
+}
+
+void test_absolute_start_and_expiry() {
+    SimRadio radio;
+    Packet atTime = {1, 16, 0, 0, 0, true};
+    Packet tooLate = {2, 16, 0, 0, 0, true};
+
+    radio.send({&atTime}, TxPriority::Normal, 500000);
+    radio.send({&tooLate}, TxPriority::Normal, 700000, 600000);
+    radio.runUntil(2000000);
+
+    TEST_ASSERT_EQUAL(1, radio.starts.size());
+    TEST_ASSERT_EQUAL_UINT64(500000, radio.starts[0].at);
+    TEST_ASSERT_EQUAL(1, radio.expired.size());
+    TEST_ASSERT_EQUAL_UINT32(2, radio.expired[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, radio.queue.stats(TxSource::Other).expired);
+    TEST_ASSERT_EQUAL(0, radio.queue.size());
+}
+
+void test_delayed_packet_inside_batch() {
+    SimRadio radio;
+    radio.isrLatencyUs = 80;
+    radio.timerLatencyUs = 40;
+    // Second packet waits for the device to answer the first one
+    Packet first = {1, 16, 1, 25, 0, true};
+    Packet second = {2, 16, 0, 25, 250, true};
+
+    radio.send({&first, &second}, TxPriority::Normal);
+    radio.runUntil(2000000);
+
+    TEST_ASSERT_EQUAL(3, radio.txStart.size());
+    TEST_ASSERT_EQUAL_UINT64(radio.txEnd[0] + 25000 + 40, radio.txStart[1]);
+    TEST_ASSERT_EQUAL_UINT64(radio.txEnd[1] + 250000 + 40, radio.txStart[2]);
+}
+
+// Mixed traffic over ten virtual minutes: 1W commands and discovery bursts at random, 2W replies 250 ms after
+// the frame they answer. The legacy radio ignored `delayed` and sent each reply as soon as it was free
+void test_random_traffic_start_error() {
+    SimRadio radio;
+    radio.timerLatencyUs = 50;
+    radio.isrLatencyUs = 100;
+    srand(1234);
+
+    std::vector<Packet> packets(20000);
+    uint32_t count = 0, replies = 0;
+    uint64_t legacyError = 0, legacyFree = 0;
+    for (uint64_t t = 0; t < 600000000ULL && count + 1 < packets.size(); t += 200000 + rand() % 1800000) {
+        radio.runUntil(t);
+        Packet &p = packets[count];
+        switch (rand() % 4) {
+            case 0:     // 1W command
+                p = {count, 21, 3, 25, 0, false};
+                radio.send({&p}, TxPriority::Normal);
+                break;
+            case 1:     // Discovery
+                p = {count, 13, 1, 25, 0, true};
+                radio.send({&p}, TxPriority::Background);
+                break;
+            default:    // 2W answer
+                p = {count, 16, 0, 25, 250, true};
+                radio.send({&p}, TxPriority::Urgent);
+                // Legacy: on air at once if the radio is free, i.e. 250 ms too early
+                uint64_t legacyStart = std::max(t, legacyFree);
+                legacyError += t + 250000 - std::min<uint64_t>(legacyStart, t + 250000);
+                legacyFree = legacyStart + iohcAirtimeUs(SHORT_PREAMBLE, 16);
+                replies++;
+                break;
+        }
+        count++;
+    }
+    radio.runUntil(700000000ULL);
+
+    uint32_t onTime = 0;
+    uint64_t totalError = 0, maxError = 0;
+    for (const Start &s : radio.starts) {
+        if (!s.scheduledUs) continue;
+        uint64_t error = s.at - s.scheduledUs;
+        totalError += error;
+        maxError = std::max(maxError, error);
+        if (error <= radio.timerLatencyUs) onTime++;
+    }
+    TxSourceStats stats = radio.queue.stats(TxSource::Other);
+    printf("  %u batches, %u delayed replies: %u within timer latency, start error avg %lluus max %lluus\n",
+           count, replies, onTime, (unsigned long long)(totalError / replies), (unsigned long long)maxError);
+    printf("  legacy: replies sent avg %llu us before their window\n", (unsigned long long)(legacyError / replies));
+
+    TEST_ASSERT_EQUAL(count, radio.starts.size());
+    TEST_ASSERT_EQUAL_UINT32(replies, stats.scheduled);
+    TEST_ASSERT_EQUAL_UINT64(totalError, stats.totalStartErrorUs);
+    TEST_ASSERT_EQUAL_UINT32(maxError, stats.maxStartErrorUs);
+    TEST_ASSERT_GREATER_THAN_UINT32(replies * 9 / 10, onTime);
+    TEST_ASSERT_TRUE(totalError < legacyError / 10);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_delayed_batch_waits_in_rx);
+    RUN_TEST(test_ready_batch_goes_ahead_of_delayed);
+    RUN_TEST(test_long_batch_held_until_scheduled_one_is_sent);
+    RUN_TEST(test_absolute_start_and_expiry);
+    RUN_TEST(test_delayed_packet_inside_batch);
+    RUN_TEST(test_random_traffic_start_error);
+    return UNITY_END();
+}
@@ -0,0 +1,236 @@
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include <iohcTxSequencer.h>
+
+using namespace IOHC;
+
+/*
+    Discrete-event simulation: the radio raises PacketSent once the computed airtime has elapsed,
+    the interrupt reaches the sequencer after isrLatencyUs, timer callbacks after timerLatencyUs.
+*/
+struct Frame {
+    uint8_t length;
+    uint8_t repeat;
+    uint32_t repeatTimeMs;
+};
+
+struct SimRadio {
+    std::vector<Frame> frames;
+    uint16_t longPreamble = 1920;
+    uint16_t shortPreamble = 40;
+    uint32_t isrLatencyUs = 0;
+    uint32_t timerLatencyUs = 0;
+    uint32_t dropPacketSentEvery = 0;   // Lose one PacketSent interrupt in N
+
+    uint64_t now = 0;
+    uint64_t packetSentAt = UINT64_MAX;
+    uint64_t packetSentStamp = 0;
+    uint64_t timerAt = UINT64_MAX;
+    bool listening = false;
+    bool finished = false;
+    uint32_t transmissions = 0;
+    std::vector<uint32_t> txPerFrame;
+    std::vector<uint64_t> txStart, txEnd;
+
+    TxSlot slot(size_t frame, bool first) const {
+        const Frame &f = frames[frame];
+        return {f.repeat, f.repeatTimeMs * 1000, iohcAirtimeUs(first ? longPreamble : shortPreamble, f.length), 0};
+    }
+
+    void transmit(size_t frame, bool first) {
+        uint32_t airtime = iohcAirtimeUs(first ? longPreamble : shortPreamble, frames[frame].length);
+        txPerFrame.resize(frames.size());
+        txPerFrame[frame]++;
+        transmissions++;
+        listening = false;
+        txStart.push_back(now);
+        txEnd.push_back(now + airtime);
+        bool lost = dropPacketSentEvery && transmissions % dropPacketSentEvery == 0;
+        packetSentStamp = now + airtime;
+        packetSentAt = lost ? UINT64_MAX : now + airtime + isrLatencyUs;
+    }
+
+    void arm(uint32_t delayUs) { timerAt = now + delayUs + timerLatencyUs; }
+    void listen() { listening = true; }
+    void finish() {
+        finished = true;
+        timerAt = UINT64_MAX;
+    }
+};
+
+// Runs the event loop until the batch is done
+static void run(SimRadio &radio, iohcTxSequencer<SimRadio> &seq) {
+    radio.finished = false;
+    TEST_ASSERT_TRUE(seq.start(radio.frames.size(), radio.now));
+    uint32_t guard = 0;
+    while (seq.busy() && guard++ < 100000) {
+        if (radio.packetSentAt <= radio.timerAt) {
+            radio.now = radio.packetSentAt;
+            radio.packetSentAt = UINT64_MAX;
+            seq.onPacketSent(radio.packetSentStamp, radio.now);
+        } else {
+            radio.now = radio.timerAt;
+            radio.timerAt = UINT64_MAX;
+            seq.onTimer(radio.now);
+        }
+    }
+    TEST_ASSERT_FALSE(seq.busy());
+    TEST_ASSERT_TRUE(radio.finished);
+}
+
+// The former onTxTicker: periodic ticker at repeatTime, a frame goes out on the first tick after TXDONE.
+// Returns the summed distance between achieved and requested gaps
+static uint64_t legacyGapError(const SimRadio &model, uint32_t &gaps) {
+    uint32_t period = model.frames[0].repeatTimeMs * 1000;
+    uint64_t now = 0, end = 0, error = 0;
+    gaps = 0;
+    for (size_t f = 0; f < model.frames.size(); f++) {
+        for (uint8_t r = 0; r <= model.frames[f].repeat; r++) {
+            bool first = f == 0 && r == 0;
+            if (!first) {
+                uint64_t tick = ((end + model.isrLatencyUs) / period + 1) * period + model.timerLatencyUs;
+                uint64_t gap = tick - end;
+                error += gap > period ? gap - period : period - gap;
+                gaps++;
+                now = tick;
+            }
+            end = now + iohcAirtimeUs(first ? model.longPreamble : model.shortPreamble, model.frames[f].length);
+        }
+    }
+    return error;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_repeat_count_and_order() {
+    SimRadio radio;
+    radio.frames = {{16, 2, 25}, {13, 0, 25}, {20, 1, 10}};
+    iohcTxSequencer<SimRadio> seq(radio);
+    run(radio, seq);
+
+    TEST_ASSERT_EQUAL_UINT32(6, radio.transmissions);
+    TEST_ASSERT_EQUAL_UINT32(3, radio.txPerFrame[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, radio.txPerFrame[1]);
+    TEST_ASSERT_EQUAL_UINT32(2, radio.txPerFrame[2]);
+    TEST_ASSERT_EQUAL_UINT32(1, seq.stats().batches);
+    TEST_ASSERT_EQUAL_UINT32(6, seq.stats().frames);
+    TEST_ASSERT_EQUAL_UINT32(5, seq.stats().gaps);
+}
+
+void test_gap_is_exact_from_end_of_frame() {
+    SimRadio radio;
+    radio.frames = {{16, 4, 25}, {16, 3, 25}};
+    iohcTxSequencer<SimRadio> seq(radio);
+    run(radio, seq);
+
+    for (size_t i = 1; i < radio.txStart.size(); i++)
+        TEST_ASSERT_EQUAL_UINT32(25000, radio.txStart[i] - radio.txEnd[i - 1]);
+    TEST_ASSERT_EQUAL_UINT32(25000, seq.stats().minGapUs);
+    TEST_ASSERT_EQUAL_UINT32(25000, seq.stats().maxGapUs);
+    TEST_ASSERT_EQUAL_UINT32(0, seq.stats().maxLateUs);
+}
+
+void test_interrupt_latency_is_absorbed() {
+    SimRadio radio;
+    radio.frames = {{16, 9, 25}};
+    radio.isrLatencyUs = 180;
+    radio.timerLatencyUs = 40;
+    iohcTxSequencer<SimRadio> seq(radio);
+    run(radio, seq);
+
+    // Only the timer latency remains, the gap is counted from the PacketSent time stamp
+    for (size_t i = 1; i < radio.txStart.size(); i++)
+        TEST_ASSERT_EQUAL_UINT32(25000 + 40, radio.txStart[i] - radio.txEnd[i - 1]);
+    TEST_ASSERT_EQUAL_UINT32(25000 + 40, seq.stats().maxGapUs);
+    TEST_ASSERT_EQUAL_UINT32(40, seq.stats().maxLateUs);
+    TEST_ASSERT_TRUE(radio.listening == false);
+}
+
+void test_zero_gap_is_back_to_back() {
+    SimRadio radio;
+    radio.frames = {{16, 2, 0}, {16, 0, 0}};
+    iohcTxSequencer<SimRadio> seq(radio);
+    run(radio, seq);
+
+    TEST_ASSERT_EQUAL_UINT32(4, radio.transmissions);
+    TEST_ASSERT_EQUAL_UINT32(0, seq.stats().maxGapUs);
+}
+
+void test_missed_packet_sent_recovers_through_watchdog() {
+    SimRadio radio;
+    radio.frames = {{16, 5, 25}};
+    radio.dropPacketSentEvery = 3;
+    iohcTxSequencer<SimRadio> seq(radio);
+    run(radio, seq);
+
+    TEST_ASSERT_EQUAL_UINT32(6, radio.transmissions);
+    TEST_ASSERT_EQUAL_UINT32(2, seq.stats().timeouts);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(TX_WATCHDOG_MARGIN_US, seq.stats().maxLateUs);
+}
+
+// The repeats of the first frame have the short preamble: a lost PacketSent does not stretch their gap
+void test_watchdog_of_a_repeat_uses_its_own_airtime() {
+    SimRadio radio;
+    radio.frames = {{16, 2, 25}};
+    radio.dropPacketSentEvery = 2;
+    iohcTxSequencer<SimRadio> seq(radio);
+    run(radio, seq);
+
+    TEST_ASSERT_EQUAL_UINT32(3, radio.transmissions);
+    TEST_ASSERT_EQUAL_UINT32(1, seq.stats().timeouts);
+    TEST_ASSERT_EQUAL_UINT32(25000, radio.txStart[2] - radio.txEnd[1]);
+}
+
+void test_busy_and_stale_timer() {
+    SimRadio radio;
+    radio.frames = {{16, 1, 25}};
+    iohcTxSequencer<SimRadio> seq(radio);
+
+    TEST_ASSERT_TRUE(seq.start(1, 0));
+    TEST_ASSERT_FALSE(seq.start(1, 0));
+    // The watchdog of the first frame firing after PacketSent re-armed the gap must not send early
+    radio.now = radio.packetSentAt;
+    seq.onPacketSent(radio.packetSentStamp, radio.now);
+    seq.onTimer(radio.now + 1);
+    TEST_ASSERT_EQUAL_UINT32(1, radio.transmissions);
+    seq.abort();
+    TEST_ASSERT_FALSE(seq.busy());
+    TEST_ASSERT_TRUE(radio.finished);
+}
+
+void test_compare_with_polling_ticker() {
+    SimRadio radio;
+    radio.frames = {{16, 4, 25}, {13, 2, 25}};
+    radio.isrLatencyUs = 100;
+    radio.timerLatencyUs = 50;
+    iohcTxSequencer<SimRadio> seq(radio);
+    run(radio, seq);
+
+    uint32_t legacyGaps;
+    uint64_t legacyError = legacyGapError(radio, legacyGaps);
+    uint32_t errOld = legacyError / legacyGaps;
+    uint32_t errNew = (seq.stats().totalGapUs - 25000ULL * seq.stats().gaps) / seq.stats().gaps;
+    printf("  requested gap 25000 us, mean error: polling ticker %u us, event driven %u us (min %u max %u)\n",
+           errOld, errNew, seq.stats().minGapUs, seq.stats().maxGapUs);
+    TEST_ASSERT_EQUAL_UINT32(legacyGaps, seq.stats().gaps);
+    TEST_ASSERT_EQUAL_UINT32(50, errNew);
+    TEST_ASSERT_LESS_THAN_UINT32(errOld, errNew);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_repeat_count_and_order);
+    RUN_TEST(test_gap_is_exact_from_end_of_frame);
+    RUN_TEST(test_interrupt_latency_is_absorbed);
+    RUN_TEST(test_zero_gap_is_back_to_back);
+    RUN_TEST(test_missed_packet_sent_recovers_through_watchdog);
+    RUN_TEST(test_watchdog_of_a_repeat_uses_its_own_airtime);
+    RUN_TEST(test_busy_and_stale_timer);
+    RUN_TEST(test_compare_with_polling_ticker);
+    return UNITY_END();
+}
@@ -0,0 +1,268 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iohcWakeTracker.h>
+
+using namespace IOHC;
+
+// Exchanges captured in analysis/*.txt, controller AA9BFA
+static const char *CONTROL_PLUG_ON_OFF[] = {
+    "08:37:20.789 > (10) 2W S 1 E 0  FROM AA9BFA TO 2684DE CMD 1E +0.000      >  DATA(02)  0102",
+    "08:37:20.803 > (14) 2W S 0 E 0  FROM 2684DE TO AA9BFA CMD 3C +14.792        DATA(06)  40034b8231bd",
+    "08:37:20.814 > (14) 2W S 0 E 0  FROM AA9BFA TO 2684DE CMD 3D +11.285        DATA(06)  6add4ba7234b",
+    "08:37:20.824 > (09) 2W S 0 E 1  FROM 2684DE TO AA9BFA CMD FE +11.411     <  DATA(01)  05",
+    "08:38:29.467 > (14) 2W S 1 E 0  FROM AA9BFA TO 2684DE CMD 00 +0.000      >  DATA(06)  01e700000000",
+    "08:38:29.475 > (14) 2W S 0 E 0  FROM 2684DE TO AA9BFA CMD 3C +13.741        DATA(06)  575188bac42f",
+    "08:38:29.485 > (14) 2W S 0 E 0  FROM AA9BFA TO 2684DE CMD 3D +11.215        DATA(06)  b3509415ee41",
+    "08:38:29.502 > (22) 2W S 0 E 1  FROM 2684DE TO AA9BFA CMD 04 +15.896     <  DATA(14)  04000000c8000002aa9bfa010000",
+    "08:38:57.034 > (14) 2W S 1 E 0  FROM AA9BFA TO 2684DE CMD 00 +0.000      >  DATA(06)  01e7c8000000",
+    "08:38:57.043 > (14) 2W S 0 E 0  FROM 2684DE TO AA9BFA CMD 3C +13.640        DATA(06)  53ef430d74ca",
+    "08:38:57.054 > (14) 2W S 0 E 0  FROM AA9BFA TO 2684DE CMD 3D +11.209        DATA(06)  eaa112377312",
+    "08:38:57.071 > (22) 2W S 0 E 1  FROM 2684DE TO AA9BFA CMD 04 +15.906     <  DATA(14)  0400c80000000002aa9bfa010000",
+    "08:41:17.156 > (11) 2W S 1 E 0  FROM AA9BFA TO 2684DE CMD 03 +0.000      >  DATA(03)  030000",
+    "08:41:17.173 > (22) 2W S 0 E 1  FROM 2684DE TO AA9BFA CMD 04 +15.667     <  DATA(14)  05800000c8000000aa9bfa010000",
+};
+
+static const char *PAIRING_PLUG_AFTER_RESET[] = {
+    "09:17:20.692 > (08) 2W S 1 E 0 [PRIO]   FROM AA9BFA TO 5325A9 CMD 36 +0.000      >  DATA(00) ",
+    "09:17:20.705 > (11) 2W S 0 E 0 [PRIO]   FROM 5325A9 TO AA9BFA CMD 37 +12.055        DATA(03)  5325a9",
+    "09:17:20.717 > (14) 2W S 0 E 0  FROM AA9BFA TO 5325A9 CMD 3C +11.132        DATA(06)  2311204f01c4",
+    "09:17:20.730 > (14) 2W S 0 E 1  FROM 5325A9 TO AA9BFA CMD 3D +13.691     <  DATA(06)  cb20cf0eae1e",
+    "09:17:20.939 > (08) 2W S 1 E 0  FROM AA9BFA TO 5325A9 CMD 54 +222.802    >  DATA(00) ",
+    "09:17:20.960 > (22) 2W S 0 E 1  FROM 5325A9 TO AA9BFA CMD 55 +16.639     <  DATA(14)  353133363937344130350300ffff",
+    "09:17:21.410 > (08) 2W S 1 E 0  FROM AA9BFA TO 5325A9 CMD 50 +473.403    >  DATA(00) ",
+    "09:17:21.430 > (24) 2W S 0 E 1  FROM 5325A9 TO AA9BFA CMD 51 +16.885     <  DATA(16)  004f4e2f4f464620504c554720696f00",
+    "09:18:12.278 > (11) 2W S 1 E 0  FROM AA9BFA TO 5325A9 CMD 03 +0.000      >  DATA(03)  030000",
+    "09:18:12.294 > (22) 2W S 0 E 1  FROM 5325A9 TO AA9BFA CMD 04 +15.143     <  DATA(14)  0580c800c8000000000000000000",
+    "09:18:15.370 > (14) 2W S 1 E 0  FROM AA9BFA TO 5325A9 CMD 00 +0.000      >  DATA(06)  01e700000000",
+    "09:18:15.379 > (14) 2W S 0 E 0  FROM 5325A9 TO AA9BFA CMD 3C +13.783        DATA(06)  14d0b1fd76f7",
+    "09:18:15.389 > (14) 2W S 0 E 0  FROM AA9BFA TO 5325A9 CMD 3D +11.149        DATA(06)  c21a5526639f",
+    "09:18:15.406 > (22) 2W S 0 E 1  FROM 5325A9 TO AA9BFA CMD 04 +15.958     <  DATA(14)  04000000c8000002aa9bfa010000",
+    "09:18:16.551 > (14) 2W S 1 E 0  FROM AA9BFA TO 5325A9 CMD 00 +0.000      >  DATA(06)  01e7c8000000",
+    "09:18:16.560 > (14) 2W S 0 E 0  FROM 5325A9 TO AA9BFA CMD 3C +13.672        DATA(06)  5a7bb35f1f58",
+    "09:18:16.570 > (14) 2W S 0 E 0  FROM AA9BFA TO 5325A9 CMD 3D +11.285        DATA(06)  47e0d4bd4c15",
+    "09:18:16.587 > (22) 2W S 0 E 1  FROM 5325A9 TO AA9BFA CMD 04 +15.868     <  DATA(14)  0400c80000000002aa9bfa010000",
+};
+
+static const char *PAIRING_PLUG_LOGS[] = {
+    "08:45:21.172 > (09) 2W S 1 E 1 [LPM]    FROM AA9BFA TO 00003F CMD 2E +0.000         DATA(01)  00",
+    "08:45:22.107 > (08) 2W S 1 E 0  FROM AA9BFA TO CA5321 CMD 2C +0.000      >  DATA(00) ",
+    "08:45:22.116 > (08) 2W S 0 E 1  FROM CA5321 TO AA9BFA CMD 2D +10.830     <  DATA(00) ",
+    "08:45:22.500 > (08) 2W S 1 E 0  FROM AA9BFA TO 780A9C CMD 2C +397.135    >  DATA(00) ",
+    "08:45:22.510 > (08) 2W S 0 E 1  FROM 780A9C TO AA9BFA CMD 2D +11.455     <  DATA(00) ",
+    "08:45:33.662 > (09) 2W S 1 E 0  FROM AA9BFA TO 780A9C CMD 2E +256.920    >  DATA(01)  02",
+    "08:45:33.677 > (14) 2W S 0 E 0  FROM 780A9C TO AA9BFA CMD 3C +13.568        DATA(06)  1f4da3eea56a",
+    "08:45:33.688 > (14) 2W S 0 E 0  FROM AA9BFA TO 780A9C CMD 3D +11.669        DATA(06)  83b0393f1140",
+    "08:45:33.699 > (09) 2W S 0 E 1      FROM 780A9C TO AA9BFA CMD 2F +12.056     <  DATA(01)  02",
+    "08:45:39.025 > (09) 2W S 1 E 0  FROM AA9BFA TO 2684DE CMD 2E +0.000      >  DATA(01)  02",
+    "08:45:39.041 > (14) 2W S 0 E 0  FROM 2684DE TO AA9BFA CMD 3C +14.073        DATA(06)  983b2cf26224",
+    "08:45:39.052 > (14) 2W S 0 E 0  FROM AA9BFA TO 2684DE CMD 3D +11.074        DATA(06)  fb123e5be541",
+    "08:45:39.063 > (09) 2W S 0 E 1      FROM 2684DE TO AA9BFA CMD 2F +11.625     <  DATA(01)  02",
+    "08:45:39.258 > (08) 2W S 1 E 0      FROM AA9BFA TO 2684DE CMD 56 +197.879    >  DATA(00) ",
+    "08:45:39.277 > (24) 2W S 0 E 1  FROM 2684DE TO AA9BFA CMD 57 +16.401     <  DATA(16)  3531323239363341303503c003000000",
+};
+
+static const uint8_t CONTROLLER[3] = {0xAA, 0x9B, 0xFA};
+
+struct Line {
+    uint64_t us;
+    bool start, end, lpm;
+    uint8_t from[3], to[3];
+};
+
+static void hex3(const char *text, uint8_t *out) {
+    for (int i = 0; i < 3; i++) {
+        char byte[3] = {text[i * 2], text[i * 2 + 1], 0};
+        out[i] = static_cast<uint8_t>(strtoul(byte, nullptr, 16));
+    }
+}
+
+static Line parse(const char *text) {
+    Line line{};
+    int h, m, s, ms, start, end;
+    TEST_ASSERT_EQUAL(4, sscanf(text, "%d:%d:%d.%d", &h, &m, &s, &ms));
+    line.us = ((h * 3600ULL + m * 60 + s) * 1000 + ms) * 1000;
+    const char *flags = strstr(text, "2W S ");
+    TEST_ASSERT_NOT_NULL(flags);
+    TEST_ASSERT_EQUAL(2, sscanf(flags, "2W S %d E %d", &start, &end));
+    line.start = start;
+    line.end = end;
+    line.lpm = strstr(text, "[LPM]") != nullptr;
+    const char *from = strstr(text, "FROM ");
+    TEST_ASSERT_NOT_NULL(from);
+    hex3(from + 5, line.from);
+    hex3(from + 15, line.to);
+    return line;
+}
+
+struct Replay {
+    uint32_t shortPreambles = 0;
+    uint32_t longPreambles = 0;
+};
+
+// Frames we start an exchange with ask the caller's default (long); every frame from a device feeds the tracker
+static Replay replay(iohcWakeTracker &tracker, const char **lines, size_t count) {
+    Replay result;
+    for (size_t i = 0; i < count; i++) {
+        Line line = parse(lines[i]);
+        if (!memcmp(line.from, CONTROLLER, 3)) {
+            if (!line.start || (line.to[0] == 0 && line.to[1] == 0)) continue;
+            bool useShort = tracker.shortPreamble(line.to, false, line.start && !line.end, line.us);
+            (useShort ? result.shortPreambles : result.longPreambles)++;
+        } else {
+            tracker.onReceived(line.from, line.lpm ? WAKE_LPM_FLAG : 0, line.us);
+        }
+    }
+    return result;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_unknown_device_follows_caller_until_heard() {
+    iohcWakeTracker tracker;
+    Replay result = replay(tracker, CONTROL_PLUG_ON_OFF, sizeof(CONTROL_PLUG_ON_OFF) / sizeof(*CONTROL_PLUG_ON_OFF));
+    // Commands minutes apart, nothing known about the plug: long preamble every time
+    TEST_ASSERT_EQUAL_UINT32(0, result.shortPreambles);
+    TEST_ASSERT_EQUAL_UINT32(4, result.longPreambles);
+    TEST_ASSERT_EQUAL_UINT32(0, tracker.stats().shortened);
+}
+
+void test_always_on_device_from_discovery_answer() {
+    iohcWakeTracker tracker;
+    // Discovery answer of the plug in pairing_plug_after_reset.txt: 03c0d129e402dc0012, multiInfo dc
+    const uint8_t discovery[] = {0x03, 0xc0, 0xd1, 0x29, 0xe4, 0x02, 0xdc, 0x00, 0x12};
+    const uint8_t plug[3] = {0x26, 0x84, 0xDE};
+    TEST_ASSERT_EQUAL(WakePower::AlwaysOn, wakePowerFromMultiInfo(discovery[6]));
+    tracker.setPower(plug, wakePowerFromMultiInfo(discovery[6]));
+
+    Replay result = replay(tracker, CONTROL_PLUG_ON_OFF, sizeof(CONTROL_PLUG_ON_OFF) / sizeof(*CONTROL_PLUG_ON_OFF));
+    WakeStats stats = tracker.stats();
+    TEST_ASSERT_EQUAL_UINT32(4, result.shortPreambles);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.shortened);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.misses);
+    TEST_ASSERT_EQUAL_UINT64(4ULL * iohcWakeTracker::longExtraUs(), stats.savedUs);
+    printf("  long preamble costs %u us more airtime, %llu us saved on control_plug_on_off\n",
+           (unsigned)iohcWakeTracker::longExtraUs(), (unsigned long long)stats.savedUs);
+}
+
+void test_recent_exchange_keeps_device_awake() {
+    iohcWakeTracker tracker;
+    Replay result = replay(tracker, PAIRING_PLUG_AFTER_RESET,
+                           sizeof(PAIRING_PLUG_AFTER_RESET) / sizeof(*PAIRING_PLUG_AFTER_RESET));
+    // 0x54 and 0x50 follow an answer by 209 and 450 ms; 0x03 and both 0x00 come seconds later
+    TEST_ASSERT_EQUAL_UINT32(2, result.shortPreambles);
+    TEST_ASSERT_EQUAL_UINT32(4, result.longPreambles);
+
+    iohcWakeTracker pairing;
+    result = replay(pairing, PAIRING_PLUG_LOGS, sizeof(PAIRING_PLUG_LOGS) / sizeof(*PAIRING_PLUG_LOGS));
+    // Alive checks and the 0x2E to 780A9C 11 s later need waking up; 0x56 comes 195 ms after the 0x2F
+    TEST_ASSERT_EQUAL_UINT32(1, result.shortPreambles);
+    TEST_ASSERT_EQUAL_UINT32(4, result.longPreambles);
+    TEST_ASSERT_EQUAL(3, pairing.devices());
+}
+
+void test_lpm_flag_marks_sleeping_device() {
+    iohcWakeTracker tracker;
+    const uint8_t shutter[3] = {0x12, 0x29, 0xC1};
+    tracker.onReceived(shutter, WAKE_LPM_FLAG, 1000000);
+    TEST_ASSERT_EQUAL(WakePower::LowPower, tracker.power(shutter));
+
+    // Still awake right after its frame
+    TEST_ASSERT_TRUE(tracker.shortPreamble(shutter, true, false, 1300000));
+    // Asleep later on: the caller's short preamble would not be heard
+    TEST_ASSERT_FALSE(tracker.shortPreamble(shutter, true, true, 1000000 + WAKE_AWAKE_WINDOW_US + 1));
+    WakeStats stats = tracker.stats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.lengthened);
+    TEST_ASSERT_EQUAL_UINT64(iohcWakeTracker::longExtraUs(), stats.spentUs);
+
+    // Discovery answer wins over the flag
+    tracker.setPower(shutter, WakePower::AlwaysOn);
+    tracker.onReceived(shutter, WAKE_LPM_FLAG, 5000000);
+    TEST_ASSERT_EQUAL(WakePower::AlwaysOn, tracker.power(shutter));
+}
+
+void test_miss_falls_back_to_long() {
+    iohcWakeTracker tracker;
+    const uint8_t plug[3] = {0x53, 0x25, 0xA9};
+    tracker.setPower(plug, WakePower::AlwaysOn);
+
+    uint64_t now = 10000000;
+    TEST_ASSERT_TRUE(tracker.shortPreamble(plug, false, true, now));
+    // Answer within the timeout: not a miss
+    tracker.onReceived(plug, 0, now + 16000);
+    now += 2000000;
+    TEST_ASSERT_TRUE(tracker.shortPreamble(plug, false, true, now));
+    // No answer: retry with the long preamble
+    now += WAKE_REPLY_TIMEOUT_US + 1;
+    TEST_ASSERT_FALSE(tracker.shortPreamble(plug, false, true, now));
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.stats().misses);
+    // Long preamble without answer either: stays long, no new miss
+    now += 2000000;
+    TEST_ASSERT_FALSE(tracker.shortPreamble(plug, false, true, now));
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.stats().misses);
+    // Heard again: back to short
+    tracker.onReceived(plug, 0, now + 400000);
+    now += 5000000;
+    TEST_ASSERT_TRUE(tracker.shortPreamble(plug, false, true, now));
+
+    WakeStats stats = tracker.stats();
+    TEST_ASSERT_EQUAL_UINT32(3, stats.shortPreambles);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.longPreambles);
+}
+
+// The estimate of a queued batch agrees with the choice made when it starts, and changes nothing
+void test_expects_short_has_no_side_effects() {
+    iohcWakeTracker tracker;
+    const uint8_t plug[3] = {0x53, 0x25, 0xA9};
+    const uint8_t unknown[3] = {0x01, 0x02, 0x03};
+    tracker.setPower(plug, WakePower::AlwaysOn);
+
+    uint64_t now = 10000000;
+    TEST_ASSERT_TRUE(tracker.expectsShort(plug, false, now));
+    TEST_ASSERT_TRUE(tracker.expectsShort(unknown, true, now));
+    TEST_ASSERT_FALSE(tracker.expectsShort(unknown, false, now));
+    TEST_ASSERT_EQUAL_UINT32(0, tracker.stats().shortPreambles);
+    TEST_ASSERT_EQUAL(1, tracker.devices());
+
+    // Short preamble unanswered: expected long before the miss is even counted
+    TEST_ASSERT_TRUE(tracker.shortPreamble(plug, false, true, now));
+    now += WAKE_REPLY_TIMEOUT_US + 1;
+    TEST_ASSERT_FALSE(tracker.expectsShort(plug, false, now));
+    TEST_ASSERT_EQUAL_UINT32(0, tracker.stats().misses);
+    TEST_ASSERT_FALSE(tracker.shortPreamble(plug, false, true, now));
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.stats().misses);
+}
+
+void test_table_replacement() {
+    iohcWakeTracker tracker;
+    uint8_t address[3] = {0x40, 0x00, 0x00};
+    for (uint32_t i = 0; i < WAKE_MAX_DEVICES + 5; i++) {
+        address[2] = static_cast<uint8_t>(i);
+        tracker.onReceived(address, 0, 1000 + i);
+    }
+    TEST_ASSERT_EQUAL(WAKE_MAX_DEVICES, tracker.devices());
+    TEST_ASSERT_EQUAL_UINT32(5, tracker.stats().evicted);
+    // Oldest ones went first
+    address[2] = 0;
+    TEST_ASSERT_EQUAL(WakePower::Unknown, tracker.power(address));
+    TEST_ASSERT_FALSE(tracker.shortPreamble(address, false, false, 2000));
+    address[2] = WAKE_MAX_DEVICES + 4;
+    TEST_ASSERT_TRUE(tracker.shortPreamble(address, false, false, 2000));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unknown_device_follows_caller_until_heard);
+    RUN_TEST(test_always_on_device_from_discovery_answer);
+    RUN_TEST(test_recent_exchange_keeps_device_awake);
+    RUN_TEST(test_lpm_flag_marks_sleeping_device);
+    RUN_TEST(test_miss_falls_back_to_long);
+    RUN_TEST(test_expects_short_has_no_side_effects);
+    RUN_TEST(test_table_replacement);
+    return UNITY_END();
+}